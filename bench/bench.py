@@ -0,0 +1,368 @@
+# SPDX-License-Identifier: LGPL-2.1-or-later
+
+"""Measure the throughput of python-systemd.
+
+Read benchmarks run against fixtures generated by genjournal.py, and write
+benchmarks send to a journal.JournalServer, which validates the entries and
+records the latency of send_latency. --target=journald sends to the running
+journald instead, and --target=auto uses journald if it is running.
+
+Each benchmark is run --repeat times and the fastest run is reported. With
+--stats, the read benchmarks also record the counters of Reader.stats(), to
+show where the time goes. Results are printed as a table, and written as JSON
+with --output. With --compare, the results are checked against an earlier
+JSON file, and the exit status is 1 if a benchmark became slower by more than
+--threshold.
+
+    python3 bench/bench.py --size 10M,1G --output results.json
+    python3 bench/bench.py --size 10M --compare results.json
+
+Exits with 77 (skipped) if no benchmark could be run.
+"""
+
+import argparse
+import contextlib
+import json
+import logging
+import os
+import platform
+import random
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import genjournal
+
+from systemd import journal, _reader
+
+RESULTS_VERSION = 2
+JOURNAL_SOCKET = '/run/systemd/journal/socket'
+
+
+class Skip(Exception):
+    pass
+
+
+# Read benchmarks: called with an open journal.Reader and the fixture
+# description, return (items, bytes, unit).
+
+def bench_iterate(j, fixture):
+    n = 0
+    for _ in j:
+        n += 1
+    return n, fixture['payload_bytes'], 'entries'
+
+
+def bench_get_next(j, fixture):
+    # The calls made by journal.Reader.get_next(), without conversion of
+    # the fields and building of the entry dictionary.
+    n = 0
+    while j._next():
+        j._get_all()
+        j._get_realtime()
+        n += 1
+    return n, fixture['payload_bytes'], 'entries'
+
+
+def _match(j, unit):
+    j.add_match(_SYSTEMD_UNIT=unit)
+    n = 0
+    while j._next():
+        j._get_all()
+        n += 1
+    return n, None, 'entries'
+
+
+def bench_match(j, fixture):
+    if not fixture['units']:
+        raise Skip('fixture is empty')
+    return _match(j, fixture['units'][0][0])
+
+
+def bench_match_rare(j, fixture):
+    if not fixture['units']:
+        raise Skip('fixture is empty')
+    return _match(j, fixture['units'][-1][0])
+
+
+def bench_seek_realtime(j, fixture, count=1000):
+    rng = random.Random(0)
+    first, last = fixture['first_realtime'], fixture['last_realtime']
+    for _ in range(count):
+        j.seek_realtime(rng.randint(first, last))
+        j._next()
+    return count, None, 'seeks'
+
+
+def bench_query_unique(j, fixture):
+    n = 0
+    for field in ('_SYSTEMD_UNIT', 'PRIORITY', 'FIELD_0', 'REQUEST_ID'):
+        n += len(j.query_unique(field))
+    return n, None, 'values'
+
+
+READ_BENCHMARKS = {
+    'iterate': bench_iterate,
+    'get_next': bench_get_next,
+    'match': bench_match,
+    'match_rare': bench_match_rare,
+    'seek_realtime': bench_seek_realtime,
+    'query_unique': bench_query_unique,
+}
+
+
+# Write benchmarks: called with a list of messages and the JournalServer, or
+# None when sending to journald, return (items, bytes, unit).
+
+LATENCY_FIELD = 'BENCH_SENT_USEC'
+
+
+def bench_send(messages, server):
+    for message in messages:
+        journal.send(message, SYSLOG_IDENTIFIER='python-systemd-bench', BENCH='1')
+    return len(messages), sum(len(m) for m in messages), 'entries'
+
+
+def bench_send_latency(messages, server):
+    if server is None:
+        raise Skip('needs --target=server')
+    for message in messages:
+        journal.send(message, SYSLOG_IDENTIFIER='python-systemd-bench',
+                     **{LATENCY_FIELD: time.monotonic_ns() // 1000})
+    return len(messages), sum(len(m) for m in messages), 'entries'
+
+
+def bench_journal_handler(messages, server):
+    log = logging.getLogger('python-systemd-bench')
+    log.propagate = False
+    log.setLevel(logging.INFO)
+    handler = journal.JournalHandler(SYSLOG_IDENTIFIER='python-systemd-bench')
+    log.addHandler(handler)
+    try:
+        for message in messages:
+            log.info('%s', message)
+    finally:
+        log.removeHandler(handler)
+    return len(messages), sum(len(m) for m in messages), 'entries'
+
+
+WRITE_BENCHMARKS = {
+    'send': bench_send,
+    'send_latency': bench_send_latency,
+    'journal_handler': bench_journal_handler,
+}
+
+
+def measure(func, repeat):
+    runs = []
+    for _ in range(repeat):
+        start = time.perf_counter()
+        items, nbytes, unit = func()
+        runs.append(time.perf_counter() - start)
+    best = min(runs)
+    return {
+        'items': items,
+        'unit': unit,
+        'bytes': nbytes,
+        'seconds': best,
+        'runs': runs,
+        'items_per_s': items / best if best else None,
+        'bytes_per_s': nbytes / best if best and nbytes is not None else None,
+    }
+
+
+def run_read(name, func, fixture, repeat, collect_stats=False):
+    stats = []
+
+    def once():
+        with journal.Reader(path=fixture['path'], collect_stats=collect_stats) as j:
+            try:
+                return func(j, fixture)
+            finally:
+                stats.append(j.stats())
+    result = measure(once, repeat)
+    result.update(name=name, fixture=fixture['name'])
+    if collect_stats:
+        # The statistics of the last run, all runs do the same work
+        result['reader'] = stats[-1]
+    return result
+
+
+def run_write(name, func, messages, repeat, server):
+    if server is not None:
+        server.reset()
+    result = measure(lambda: func(messages, server), repeat)
+    result.update(name=name, fixture='server' if server is not None else 'journald')
+    if server is not None:
+        # The entries are received asynchronously, wait for the stragglers
+        server.wait(result['items'] * repeat, timeout=10)
+        result['server'] = server.stats()
+    return result
+
+
+def percentile(histogram, q):
+    """Return the upper bound of the latency bucket containing the q-th percentile."""
+    total = sum(histogram.values())
+    seen = 0
+    for bound in sorted(histogram):
+        seen += histogram[bound]
+        if seen >= total * q / 100:
+            return bound
+    return None
+
+
+def key(result):
+    return result['name'], result['fixture']
+
+
+def compare(results, baseline, threshold):
+    """Print the change relative to the baseline, and return the names of regressions."""
+    old = {key(r): r for r in baseline['results']}
+    regressions = []
+    for r in results:
+        b = old.get(key(r))
+        if not b or not b.get('items_per_s') or not r.get('items_per_s'):
+            continue
+        ratio = r['items_per_s'] / b['items_per_s']
+        mark = ''
+        if ratio < 1 - threshold:
+            regressions.append('{}[{}]'.format(*key(r)))
+            mark = '  REGRESSION'
+        print('{:<16} {:<24} {:+7.1%}{}'.format(r['name'], r['fixture'] or '-',
+                                               ratio - 1, mark))
+    return regressions
+
+
+def print_result(r):
+    bps = r['bytes_per_s']
+    print('{:<16} {:<24} {:>12.0f} {}/s {:>10}  ({:.3f}s)'.format(
+        r['name'], r['fixture'] or '-', r['items_per_s'] or 0, r['unit'],
+        '{:.1f} MB/s'.format(bps / 1e6) if bps else '', r['seconds']))
+    stats = r.get('reader')
+    if stats:
+        print('{:<41} {} visited, {} returned, {:.3f}s in sd-journal, {:.3f}s converting'.format(
+            '', stats['visited'], stats['returned'],
+            stats['journal_ns'] / 1e9, stats['convert_ns'] / 1e9))
+    stats = r.get('server')
+    if stats:
+        if stats['latency']:
+            print('{:<41} latency p50 < {} µs, p99 < {} µs'.format(
+                '', percentile(stats['latency'], 50), percentile(stats['latency'], 99)))
+        if stats['invalid']:
+            print('{:<41} {} INVALID entries'.format('', stats['invalid']))
+    sys.stdout.flush()
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--size', default='10M',
+                        help='comma-separated fixture sizes, e.g. 10M,1G,10G')
+    parser.add_argument('--profile', default=','.join(sorted(genjournal.PROFILES)),
+                        help='comma-separated fixture profiles')
+    parser.add_argument('--seed', type=int, default=0)
+    parser.add_argument('--fixtures', default='bench-fixtures',
+                        help='directory in which fixtures are kept')
+    parser.add_argument('--journal-remote', help='path of systemd-journal-remote')
+    parser.add_argument('--only', help='comma-separated names of benchmarks to run')
+    parser.add_argument('--repeat', type=int, default=3)
+    parser.add_argument('--stats', action='store_true',
+                        help='collect Reader statistics in the read benchmarks')
+    parser.add_argument('--messages', type=int, default=10000,
+                        help='number of entries sent by the write benchmarks')
+    parser.add_argument('--target', choices=('auto', 'journald', 'server'), default='server',
+                        help='where the write benchmarks send entries to')
+    parser.add_argument('--output', help='write the results as JSON to this file')
+    parser.add_argument('--compare', help='compare with the results in this file')
+    parser.add_argument('--threshold', type=float, default=0.1,
+                        help='slowdown reported as a regression by --compare')
+    args = parser.parse_args(argv)
+
+    only = set(args.only.split(',')) if args.only else None
+    results = []
+    skipped = []
+    invalid = []
+
+    def wanted(name):
+        return only is None or name in only
+
+    for profile in args.profile.split(','):
+        for size in args.size.split(','):
+            if not any(wanted(name) for name in READ_BENCHMARKS):
+                break
+            try:
+                fixture = genjournal.generate(args.fixtures, profile, size, args.seed,
+                                              args.journal_remote)
+            except FileNotFoundError as e:
+                skipped.append(('{}-{}'.format(profile, size), str(e)))
+                continue
+            for name, func in READ_BENCHMARKS.items():
+                if not wanted(name):
+                    continue
+                try:
+                    r = run_read(name, func, fixture, args.repeat, args.stats)
+                except Skip as e:
+                    skipped.append(('{}[{}]'.format(name, fixture['name']), str(e)))
+                    continue
+                results.append(r)
+                print_result(r)
+
+    messages = genjournal.messages(args.messages, args.seed)
+    target = args.target
+    if target == 'auto':
+        target = 'journald' if os.path.exists(JOURNAL_SOCKET) else 'server'
+    with contextlib.ExitStack() as stack:
+        server = None
+        if target == 'server':
+            server = stack.enter_context(journal.JournalServer(timestamp_field=LATENCY_FIELD))
+            stack.callback(journal.set_socket, journal.set_socket(server.path))
+
+        for name, func in WRITE_BENCHMARKS.items():
+            if not wanted(name):
+                continue
+            try:
+                if server is None and not os.path.exists(JOURNAL_SOCKET):
+                    raise Skip('journald is not running')
+                r = run_write(name, func, messages, args.repeat, server)
+            except Skip as e:
+                skipped.append((name, str(e)))
+                continue
+            if r.get('server', {}).get('invalid'):
+                invalid.append(name)
+            results.append(r)
+            print_result(r)
+
+    for name, reason in skipped:
+        print('{:<41} skipped: {}'.format(name, reason))
+
+    if args.output:
+        out = {
+            'version': RESULTS_VERSION,
+            'time': time.strftime('%Y-%m-%dT%H:%M:%SZ', time.gmtime()),
+            'python': platform.python_version(),
+            'implementation': platform.python_implementation(),
+            'machine': platform.machine(),
+            'systemd_python': _reader.__version__,
+            'repeat': args.repeat,
+            'results': results,
+            'skipped': [{'name': n, 'reason': r} for n, r in skipped],
+        }
+        with open(args.output, 'w') as f:
+            json.dump(out, f, indent=1)
+
+    if invalid:
+        print('Invalid entries were sent by: ' + ', '.join(invalid))
+        return 1
+
+    if args.compare:
+        with open(args.compare) as f:
+            baseline = json.load(f)
+        regressions = compare(results, baseline, args.threshold)
+        if regressions:
+            print('Regressions: ' + ', '.join(regressions))
+            return 1
+
+    return 0 if results else 77
+
+
+if __name__ == '__main__':
+    sys.exit(main())
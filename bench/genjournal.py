@@ -0,0 +1,308 @@
+# SPDX-License-Identifier: LGPL-2.1-or-later
+
+"""Generate deterministic journal files for the benchmarks.
+
+Entries are produced from a seeded random generator in the Journal Export
+Format and fed to systemd-journal-remote, which writes them to journal files.
+The same seed, profile and size always result in the same entries, with the
+same timestamps, boot and machine IDs. The journal files themselves are not
+byte-identical, because journald assigns a random file ID and seqnum ID.
+
+A fixture is a directory with the journal files and fixture.json, which
+describes the contents. Fixtures are reused if they already exist.
+
+    python3 bench/genjournal.py --profile wide --size 100M fixtures/
+"""
+
+import argparse
+import collections
+import json
+import os
+import random
+import shutil
+import struct
+import subprocess
+import sys
+
+FORMAT_VERSION = 1
+
+Profile = collections.namedtuple('Profile', [
+    'message_width',    # (min, max) length of MESSAGE=
+    'units',            # number of distinct _SYSTEMD_UNIT= values
+    'extra_fields',     # number of additional FIELD_n= fields per entry
+    'field_width',      # (min, max) length of the additional field values
+    'field_values',     # number of distinct values of each additional field
+    'unique_field',     # whether each entry has a unique REQUEST_ID=
+    'binary_ratio',     # fraction of entries with a binary BLOB= field
+])
+
+PROFILES = {
+    # Short syslog-style lines from a handful of services
+    'narrow': Profile(message_width=(20, 100), units=20, extra_fields=2,
+                      field_width=(4, 16), field_values=10,
+                      unique_field=False, binary_ratio=0.0),
+    # Long structured entries with many fields and some binary data
+    'wide': Profile(message_width=(200, 2000), units=50, extra_fields=16,
+                    field_width=(16, 256), field_values=1000,
+                    unique_field=False, binary_ratio=0.01),
+    # Many services and a field which is different in every entry
+    'highcard': Profile(message_width=(40, 200), units=5000, extra_fields=4,
+                        field_width=(8, 64), field_values=100000,
+                        unique_field=True, binary_ratio=0.0),
+}
+
+# 2023-11-14 22:13:20 UTC
+START_REALTIME = 1700000000000000
+
+JOURNAL_REMOTE_PATHS = [
+    '/usr/lib/systemd/systemd-journal-remote',
+    '/lib/systemd/systemd-journal-remote',
+]
+
+SUFFIXES = {'K': 1 << 10, 'M': 1 << 20, 'G': 1 << 30, 'T': 1 << 40}
+
+WORDS = ('the of and to in is was for on that with as by at from it be are this '
+         'an or which not connection request failed started stopped service '
+         'socket timeout retry session user device mount network address '
+         'received sent bytes error warning reloading configuration done').split()
+
+
+def parse_size(s):
+    """Parse a size like '10M' or '1G' into a number of bytes."""
+    s = s.strip().upper().rstrip('B')
+    if s and s[-1] in SUFFIXES:
+        return int(float(s[:-1]) * SUFFIXES[s[-1]])
+    return int(s)
+
+
+def format_size(n):
+    for suffix in 'TGMK':
+        if n >= SUFFIXES[suffix] and n % SUFFIXES[suffix] == 0:
+            return '{}{}'.format(n // SUFFIXES[suffix], suffix)
+    return str(n)
+
+
+def find_journal_remote():
+    """Return the path of systemd-journal-remote, or None."""
+    path = shutil.which('systemd-journal-remote')
+    if path:
+        return path
+    for path in JOURNAL_REMOTE_PATHS:
+        if os.access(path, os.X_OK):
+            return path
+    return None
+
+
+def _text(rng, width):
+    words = []
+    n = -1
+    while n < width:
+        word = rng.choice(WORDS)
+        words.append(word)
+        n += len(word) + 1
+    return ' '.join(words)[:width]
+
+
+def _field(name, value):
+    if isinstance(value, bytes):
+        return b''.join([name.encode(), b'\n', struct.pack('<Q', len(value)), value, b'\n'])
+    return '{}={}\n'.format(name, value).encode()
+
+
+class Generator:
+    """Produce entries in the Journal Export Format.
+
+    Each call of entry() returns the next entry as bytes, and updates
+    `entries`, `payload_bytes` and `export_bytes`. `payload_bytes` counts the
+    field data as it is returned by the journal, i.e. b'FIELD=value' for each
+    field without the address fields.
+    """
+
+    def __init__(self, profile, seed=0):
+        self.profile = profile
+        self.rng = random.Random(seed)
+        self.boot_id = '{:032x}'.format(self.rng.getrandbits(128))
+        self.machine_id = '{:032x}'.format(self.rng.getrandbits(128))
+        self.units = ['bench-{}.service'.format(i) for i in range(profile.units)]
+        self.values = [
+            [_text(self.rng, self.rng.randint(*profile.field_width))
+             for _ in range(min(profile.field_values, 1000))]
+            for _ in range(profile.extra_fields)]
+        self.realtime = START_REALTIME
+        self.monotonic = 1000000
+        self.entries = 0
+        self.payload_bytes = 0
+        self.export_bytes = 0
+        self.unit_counts = collections.Counter()
+
+    def _skewed(self, n):
+        # Roughly Zipf-distributed: low indices are much more common
+        return min(int(n ** self.rng.random()) - 1, n - 1)
+
+    def entry(self):
+        rng = self.rng
+        profile = self.profile
+
+        step = rng.randint(1, 2000)
+        self.realtime += step
+        self.monotonic += step
+
+        index = self._skewed(len(self.units))
+        unit = self.units[index]
+        self.unit_counts[unit] += 1
+        fields = [
+            ('_BOOT_ID', self.boot_id),
+            ('_MACHINE_ID', self.machine_id),
+            ('_HOSTNAME', 'bench'),
+            ('_TRANSPORT', 'journal'),
+            ('_SYSTEMD_UNIT', unit),
+            ('SYSLOG_IDENTIFIER', unit[:-len('.service')]),
+            ('_PID', str(1000 + index)),
+            ('PRIORITY', str(rng.choice('6666666655443'))),
+            ('MESSAGE', _text(rng, rng.randint(*profile.message_width))),
+        ]
+        for i, values in enumerate(self.values):
+            if profile.field_values > len(values):
+                value = '{}-{}'.format(rng.choice(values),
+                                       rng.randrange(profile.field_values))
+            else:
+                value = values[self._skewed(len(values))]
+            fields.append(('FIELD_{}'.format(i), value))
+        if profile.unique_field:
+            fields.append(('REQUEST_ID', '{:016x}'.format(self.entries)))
+        if profile.binary_ratio and rng.random() < profile.binary_ratio:
+            fields.append(('BLOB', bytes(rng.getrandbits(8) for _ in range(rng.randint(16, 512)))))
+
+        data = [
+            '__REALTIME_TIMESTAMP={}\n'.format(self.realtime).encode(),
+            '__MONOTONIC_TIMESTAMP={}\n'.format(self.monotonic).encode(),
+        ]
+        for name, value in fields:
+            data.append(_field(name, value))
+            self.payload_bytes += len(name) + 1 + len(value)
+        data.append(b'\n')
+
+        self.entries += 1
+        out = b''.join(data)
+        self.export_bytes += len(out)
+        return out
+
+
+def messages(count, seed=0, width=(20, 120)):
+    """Return a list of `count` log messages for the write benchmarks."""
+    rng = random.Random(seed)
+    return [_text(rng, rng.randint(*width)) for _ in range(count)]
+
+
+def fixture_name(profile, size, seed):
+    return '{}-{}-s{}-v{}'.format(profile, format_size(size), seed, FORMAT_VERSION)
+
+
+def generate(directory, profile='narrow', size='10M', seed=0, journal_remote=None):
+    """Create the fixture in `directory` unless it exists, and return its description.
+
+    Raises FileNotFoundError if systemd-journal-remote is needed but cannot be found.
+    """
+    if isinstance(size, str):
+        size = parse_size(size)
+    path = os.path.join(directory, fixture_name(profile, size, seed))
+    info_path = os.path.join(path, 'fixture.json')
+
+    try:
+        with open(info_path) as f:
+            return json.load(f)
+    except FileNotFoundError:
+        pass
+
+    journal_remote = journal_remote or find_journal_remote()
+    if not journal_remote:
+        raise FileNotFoundError('systemd-journal-remote not found')
+
+    tmp = path + '.tmp'
+    shutil.rmtree(tmp, ignore_errors=True)
+    os.makedirs(tmp)
+
+    gen = Generator(PROFILES[profile], seed)
+    # journal-remote rotates the output file when it becomes too large, so
+    # a fixture may consist of several files, and is opened as a directory.
+    proc = subprocess.Popen([journal_remote,
+                             '--split-mode=none',
+                             '--seal=no',
+                             '--output=' + os.path.join(tmp, 'remote.journal'),
+                             '-'],
+                            stdin=subprocess.PIPE)
+    try:
+        buf = []
+        buffered = 0
+        while gen.export_bytes < size:
+            entry = gen.entry()
+            buf.append(entry)
+            buffered += len(entry)
+            if buffered >= 1 << 20:
+                proc.stdin.write(b''.join(buf))
+                buf, buffered = [], 0
+        proc.stdin.write(b''.join(buf))
+        proc.stdin.close()
+    except BaseException:
+        proc.kill()
+        raise
+    finally:
+        status = proc.wait()
+    if status != 0:
+        raise subprocess.CalledProcessError(status, journal_remote)
+
+    info = {
+        'name': os.path.basename(path),
+        'path': path,
+        'profile': profile,
+        'size': size,
+        'seed': seed,
+        'format_version': FORMAT_VERSION,
+        'entries': gen.entries,
+        'payload_bytes': gen.payload_bytes,
+        'export_bytes': gen.export_bytes,
+        'journal_bytes': sum(os.path.getsize(os.path.join(tmp, f)) for f in os.listdir(tmp)),
+        'first_realtime': START_REALTIME,
+        'last_realtime': gen.realtime,
+        'boot_id': gen.boot_id,
+        'machine_id': gen.machine_id,
+        # (unit, number of entries), most common first
+        'units': gen.unit_counts.most_common(),
+    }
+    with open(os.path.join(tmp, 'fixture.json'), 'w') as f:
+        json.dump(info, f, indent=1)
+
+    shutil.rmtree(path, ignore_errors=True)
+    os.rename(tmp, path)
+    return info
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('directory', nargs='?', default='fixtures',
+                        help='directory in which fixtures are created')
+    parser.add_argument('--profile', choices=sorted(PROFILES), default='narrow')
+    parser.add_argument('--size', default='10M',
+                        help='size of the generated export stream, e.g. 10M or 10G')
+    parser.add_argument('--seed', type=int, default=0)
+    parser.add_argument('--journal-remote', help='path of systemd-journal-remote')
+    parser.add_argument('--export', action='store_true',
+                        help='write the export stream to stdout instead')
+    args = parser.parse_args(argv)
+
+    if args.export:
+        gen = Generator(PROFILES[args.profile], args.seed)
+        size = parse_size(args.size)
+        out = sys.stdout.buffer
+        while gen.export_bytes < size:
+            out.write(gen.entry())
+        return
+
+    info = generate(args.directory, args.profile, args.size, args.seed,
+                    args.journal_remote)
+    json.dump(info, sys.stdout, indent=1)
+    print()
+
+
+if __name__ == '__main__':
+    main()
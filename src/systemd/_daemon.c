@@ -8,23 +8,42 @@
 
 #include <stdbool.h>
 #include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <mqueue.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <linux/vm_sockets.h>
 
 #include "systemd/sd-daemon.h"
 #include "pyutil.h"
 #include "macro.h"
+#include "probes.h"
 #include "util.h"
 
 #define HAVE_PID_NOTIFY               (LIBSYSTEMD_VERSION >= 214)
 #define HAVE_PID_NOTIFY_WITH_FDS      (LIBSYSTEMD_VERSION >= 219)
 #define HAVE_SD_LISTEN_FDS_WITH_NAMES (LIBSYSTEMD_VERSION >= 227)
 #define HAVE_IS_SOCKET_SOCKADDR       (LIBSYSTEMD_VERSION >= 233)
+#define HAVE_NOTIFY_BARRIER           (LIBSYSTEMD_VERSION >= 246)
+#define HAVE_PID_NOTIFY_BARRIER       (LIBSYSTEMD_VERSION >= 254)
 
 
 PyDoc_STRVAR(module__doc__,
         "Python interface to the libsystemd-daemon library.\n\n"
         "Provides _listen_fds*, notify, booted, and is_* functions\n"
-        "which wrap sd_listen_fds*, sd_notify, sd_booted, sd_is_*;\n"
+        "which wrap sd_listen_fds*, sd_notify, sd_booted, sd_is_*,\n"
+        "the Notifier connection, the StatusPublisher and the Watchdog\n"
+        "keep-alive threads;\n"
         "useful for socket activation and checking if the system is\n"
         "running under systemd."
 );
@@ -51,17 +70,59 @@ static inline void PyMem_Free_intp(int **p) {
         PyMem_Free(*p);
 }
 
+/* Converts a sequence of integers to an array, and returns its length, or -1
+ * with an exception set. */
+static int parse_fds(PyObject *fds, int **ret) {
+        _cleanup_(PyMem_Free_intp) int *arr = NULL;
+        Py_ssize_t i, len;
+
+        len = PySequence_Length(fds);
+        if (len < 0)
+                return -1;
+        if (len > INT_MAX) {
+                PyErr_SetString(PyExc_OverflowError, "Too many file descriptors");
+                return -1;
+        }
+
+        arr = PyMem_NEW(int, len);
+        if (!arr)
+                return -1;
+
+        for (i = 0; i < len; i++) {
+                _cleanup_Py_DECREF_ PyObject *item = PySequence_GetItem(fds, i);
+                if (!item)
+                        return -1;
+
+                long value = PyLong_AsLong(item);
+                if (PyErr_Occurred())
+                        return -1;
+
+                arr[i] = value;
+                if (arr[i] != value) {
+                        PyErr_SetString(PyExc_OverflowError, "Value to large for an integer");
+                        return -1;
+                }
+        }
+
+        *ret = arr;
+        arr = NULL;
+        return len;
+}
+
 PyDoc_STRVAR(notify__doc__,
              "notify(status, unset_environment=False, pid=0, fds=None) -> bool\n\n"
              "Send a message to the init system about a status change.\n"
              "Wraps sd_notify(3).");
 
-static PyObject* notify(PyObject *self _unused_, PyObject *args, PyObject *keywds) {
+DEFINE_PROBE(notify);
+
+static PyObject* notify(PyObject *self _unused_, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
         int r;
         const char* msg;
-        int unset = false, n_fds;
+        int unset = false, n_fds = 0;
         int _pid = 0;
         pid_t pid;
+        uint64_t start;
         PyObject *fds = NULL;
         _cleanup_(PyMem_Free_intp) int *arr = NULL;
 
@@ -72,8 +133,8 @@ static PyObject* notify(PyObject *self _unused_, PyObject *args, PyObject *keywd
                 "fds",
                 NULL,
         };
-        if (!PyArg_ParseTupleAndKeywords(args, keywds, "s|piO:notify",
-                                         (char**) kwlist, &msg, &unset, &_pid, &fds))
+        if (!parse_fastcall(args, nargs, kwnames, "s|piO:notify",
+                            kwlist, &msg, &unset, &_pid, &fds))
                 return NULL;
         pid = _pid;
         if (pid < 0 || pid != _pid) {
@@ -82,35 +143,12 @@ static PyObject* notify(PyObject *self _unused_, PyObject *args, PyObject *keywd
         }
 
         if (fds) {
-                Py_ssize_t i, len;
-
-                len = PySequence_Length(fds);
-                if (len < 0)
-                        return NULL;
-
-                arr = PyMem_NEW(int, len);
-                if (!arr)
+                n_fds = parse_fds(fds, &arr);
+                if (n_fds < 0)
                         return NULL;
-
-                for (i = 0; i < len; i++) {
-                        _cleanup_Py_DECREF_ PyObject *item = PySequence_GetItem(fds, i);
-                        if (!item)
-                                return NULL;
-
-                        long value = PyLong_AsLong(item);
-                        if (PyErr_Occurred())
-                                return NULL;
-
-                        arr[i] = value;
-                        if (arr[i] != value) {
-                                PyErr_SetString(PyExc_OverflowError, "Value to large for an integer");
-                                return NULL;
-                        }
-                }
-
-                n_fds = len;
         }
 
+        start = PROBE_START(notify);
         if (pid == 0 && !fds)
                 r = sd_notify(unset, msg);
         else if (!fds) {
@@ -128,6 +166,58 @@ static PyObject* notify(PyObject *self _unused_, PyObject *args, PyObject *keywd
                 return NULL;
 #endif
         }
+        PROBE4(notify, msg, pid, r, PROBE_ELAPSED(start));
+
+        if (set_error(r, NULL, NULL) < 0)
+                return NULL;
+
+        return PyBool_FromLong(r);
+}
+
+PyDoc_STRVAR(notify_barrier__doc__,
+             "_notify_barrier(unset_environment=False, timeout=-1, pid=0) -> bool\n\n"
+             "Wait until the init system has processed all previously sent messages.\n"
+             "`timeout` is in microseconds, -1 means to wait forever. Raises\n"
+             "TimeoutError if the timeout elapses first. Returns False if no\n"
+             "notification socket is set.\n"
+             "Wraps sd_notify_barrier(3) and sd_pid_notify_barrier(3).");
+
+static PyObject* notify_barrier(PyObject *self _unused_, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+        int r;
+        int unset = false;
+        long long timeout = -1;
+        int _pid = 0;
+        pid_t pid;
+
+        static const char* const kwlist[] = {"unset_environment", "timeout", "pid", NULL};
+        if (!parse_fastcall(args, nargs, kwnames, "|pLi:_notify_barrier",
+                            kwlist, &unset, &timeout, &_pid))
+                return NULL;
+        pid = _pid;
+        if (pid < 0 || pid != _pid) {
+                PyErr_SetString(PyExc_OverflowError, "Bad pid_t");
+                return NULL;
+        }
+
+#if HAVE_NOTIFY_BARRIER
+        if (pid == 0) {
+                Py_BEGIN_ALLOW_THREADS
+                r = sd_notify_barrier(unset, timeout < 0 ? UINT64_MAX : (uint64_t) timeout);
+                Py_END_ALLOW_THREADS
+        } else {
+#  if HAVE_PID_NOTIFY_BARRIER
+                Py_BEGIN_ALLOW_THREADS
+                r = sd_pid_notify_barrier(pid, unset, timeout < 0 ? UINT64_MAX : (uint64_t) timeout);
+                Py_END_ALLOW_THREADS
+#  else
+                set_error(-ENOSYS, NULL, "Compiled without support for sd_pid_notify_barrier");
+                return NULL;
+#  endif
+        }
+#else
+        set_error(-ENOSYS, NULL, "Compiled without support for sd_notify_barrier");
+        return NULL;
+#endif
 
         if (set_error(r, NULL, NULL) < 0)
                 return NULL;
@@ -143,13 +233,13 @@ PyDoc_STRVAR(listen_fds__doc__,
              "Wraps sd_listen_fds(3)."
 );
 
-static PyObject* listen_fds(PyObject *self _unused_, PyObject *args, PyObject *keywds) {
+static PyObject* listen_fds(PyObject *self _unused_, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
         int r;
         int unset = true;
 
         static const char* const kwlist[] = {"unset_environment", NULL};
-        if (!PyArg_ParseTupleAndKeywords(args, keywds, "|p:_listen_fds",
-                                         (char**) kwlist, &unset))
+        if (!parse_fastcall(args, nargs, kwnames, "|p:_listen_fds",
+                            kwlist, &unset))
                 return NULL;
 
         r = sd_listen_fds(unset);
@@ -178,15 +268,15 @@ static void free_names(char **names) {
         free(names);
 }
 
-static PyObject* listen_fds_with_names(PyObject *self _unused_, PyObject *args, PyObject *keywds) {
+static PyObject* listen_fds_with_names(PyObject *self _unused_, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
         int r;
         int unset = false;
         char **names = NULL;
         PyObject *tpl, *item;
 
         static const char* const kwlist[] = {"unset_environment", NULL};
-        if (!PyArg_ParseTupleAndKeywords(args, keywds, "|p:_listen_fds_with_names",
-                                         (char**) kwlist, &unset))
+        if (!parse_fastcall(args, nargs, kwnames, "|p:_listen_fds_with_names",
+                            kwlist, &unset))
                 return NULL;
 
 #if HAVE_SD_LISTEN_FDS_WITH_NAMES
@@ -230,14 +320,14 @@ PyDoc_STRVAR(is_fifo__doc__,
 );
 
 
-static PyObject* is_fifo(PyObject *self _unused_, PyObject *args) {
+static PyObject* is_fifo(PyObject *self _unused_, PyObject *const *args, Py_ssize_t nargs) {
         int r;
         int fd;
         const char *path = NULL;
 
         _cleanup_Py_DECREF_ PyObject *_path = NULL;
-        if (!PyArg_ParseTuple(args, "i|O&:_is_fifo",
-                              &fd, Unicode_FSConverter, &_path))
+        if (!parse_fastcall(args, nargs, NULL, "i|O&:_is_fifo", NULL,
+                            &fd, Unicode_FSConverter, &_path))
                 return NULL;
         if (_path)
                 path = PyBytes_AsString(_path);
@@ -256,14 +346,14 @@ PyDoc_STRVAR(is_mq__doc__,
              "Wraps sd_is_mq(3)."
 );
 
-static PyObject* is_mq(PyObject *self _unused_, PyObject *args) {
+static PyObject* is_mq(PyObject *self _unused_, PyObject *const *args, Py_ssize_t nargs) {
         int r;
         int fd;
         const char *path = NULL;
 
         _cleanup_Py_DECREF_ PyObject *_path = NULL;
-        if (!PyArg_ParseTuple(args, "i|O&:_is_mq",
-                              &fd, Unicode_FSConverter, &_path))
+        if (!parse_fastcall(args, nargs, NULL, "i|O&:_is_mq", NULL,
+                            &fd, Unicode_FSConverter, &_path))
                 return NULL;
         if (_path)
                 path = PyBytes_AsString(_path);
@@ -284,12 +374,12 @@ PyDoc_STRVAR(is_socket__doc__,
              "Constants for `family` are defined in the socket module."
 );
 
-static PyObject* is_socket(PyObject *self _unused_, PyObject *args) {
+static PyObject* is_socket(PyObject *self _unused_, PyObject *const *args, Py_ssize_t nargs) {
         int r;
         int fd, family = AF_UNSPEC, type = 0, listening = -1;
 
-        if (!PyArg_ParseTuple(args, "i|iii:_is_socket",
-                              &fd, &family, &type, &listening))
+        if (!parse_fastcall(args, nargs, NULL, "i|iii:_is_socket", NULL,
+                            &fd, &family, &type, &listening))
                 return NULL;
 
         r = sd_is_socket(fd, family, type, listening);
@@ -306,12 +396,12 @@ PyDoc_STRVAR(is_socket_inet__doc__,
              "Constants for `family` are defined in the socket module."
 );
 
-static PyObject* is_socket_inet(PyObject *self _unused_, PyObject *args) {
+static PyObject* is_socket_inet(PyObject *self _unused_, PyObject *const *args, Py_ssize_t nargs) {
         int r;
         int fd, family = AF_UNSPEC, type = 0, listening = -1, port = 0;
 
-        if (!PyArg_ParseTuple(args, "i|iiii:_is_socket_inet",
-                              &fd, &family, &type, &listening, &port))
+        if (!parse_fastcall(args, nargs, NULL, "i|iiii:_is_socket_inet", NULL,
+                            &fd, &family, &type, &listening, &port))
                 return NULL;
 
         if (port < 0 || port > UINT16_MAX) {
@@ -339,19 +429,19 @@ PyDoc_STRVAR(is_socket_sockaddr__doc__,
 #endif
 );
 
-static PyObject* is_socket_sockaddr(PyObject *self _unused_, PyObject *args) {
+static PyObject* is_socket_sockaddr(PyObject *self _unused_, PyObject *const *args, Py_ssize_t nargs) {
         int r;
         int fd, type = 0, flowinfo = 0, listening = -1;
         const char *address;
         union sockaddr_union addr = {};
         unsigned addr_len;
 
-        if (!PyArg_ParseTuple(args, "is|iii:_is_socket_sockaddr",
-                              &fd,
-                              &address,
-                              &type,
-                              &flowinfo,
-                              &listening))
+        if (!parse_fastcall(args, nargs, NULL, "is|iii:_is_socket_sockaddr", NULL,
+                            &fd,
+                            &address,
+                            &type,
+                            &flowinfo,
+                            &listening))
                 return NULL;
 
         r = parse_sockaddr(address, &addr, &addr_len);
@@ -386,15 +476,15 @@ PyDoc_STRVAR(is_socket_unix__doc__,
              "Wraps sd_is_socket_unix(3)."
 );
 
-static PyObject* is_socket_unix(PyObject *self _unused_, PyObject *args) {
+static PyObject* is_socket_unix(PyObject *self _unused_, PyObject *const *args, Py_ssize_t nargs) {
         int r;
         int fd, type = 0, listening = -1;
         char* path = NULL;
         Py_ssize_t length = 0;
 
         _cleanup_Py_DECREF_ PyObject *_path = NULL;
-        if (!PyArg_ParseTuple(args, "i|iiO&:_is_socket_unix",
-                              &fd, &type, &listening, Unicode_FSConverter, &_path))
+        if (!parse_fastcall(args, nargs, NULL, "i|iiO&:_is_socket_unix", NULL,
+                            &fd, &type, &listening, Unicode_FSConverter, &_path))
                 return NULL;
         if (_path) {
                 assert(PyBytes_Check(_path));
@@ -409,46 +499,1586 @@ static PyObject* is_socket_unix(PyObject *self _unused_, PyObject *args) {
         return PyBool_FromLong(r);
 }
 
+typedef struct {
+        PyTypeObject *FdInfoType;
+        PyTypeObject *WatchdogType;
+        PyTypeObject *NotifierType;
+        PyTypeObject *StatusPublisherType;
+} ModuleState;
+
+static PyModuleDef module;
+
+PyDoc_STRVAR(FdInfoType__doc__,
+             "Description of a file descriptor, as returned by describe_fds()");
+
+static PyStructSequence_Field FdInfoType_fields[] = {
+        {(char*) "fd", (char*) "The file descriptor"},
+        {(char*) "kind", (char*) "One of 'socket', 'fifo', 'mq', 'regular', 'directory', 'character', 'block', 'other'"},
+        {(char*) "family", (char*) "Socket address family, e.g. socket.AF_INET"},
+        {(char*) "type", (char*) "Socket type, e.g. socket.SOCK_STREAM"},
+        {(char*) "protocol", (char*) "Socket protocol"},
+        {(char*) "listening", (char*) "True iff the socket is listening"},
+        {(char*) "address", (char*) "Numerical address of an inet socket"},
+        {(char*) "port", (char*) "Port of an inet socket"},
+        {(char*) "path", (char*) "Path of a unix socket ('@' for abstract ones) or of a file"},
+        {(char*) "mq_maxmsg", (char*) "Maximum number of messages in a POSIX message queue"},
+        {(char*) "mq_msgsize", (char*) "Maximum message size of a POSIX message queue"},
+        {(char*) "mq_curmsgs", (char*) "Number of messages currently in a POSIX message queue"},
+        {} /* Sentinel */
+};
+
+static PyStructSequence_Desc FdInfo_desc = {
+        (char*) "_daemon.FdInfo",
+        FdInfoType__doc__,
+        FdInfoType_fields,
+        12,
+};
+
+enum {
+        FDINFO_FD,
+        FDINFO_KIND,
+        FDINFO_FAMILY,
+        FDINFO_TYPE,
+        FDINFO_PROTOCOL,
+        FDINFO_LISTENING,
+        FDINFO_ADDRESS,
+        FDINFO_PORT,
+        FDINFO_PATH,
+        FDINFO_MQ_MAXMSG,
+        FDINFO_MQ_MSGSIZE,
+        FDINFO_MQ_CURMSGS,
+        _FDINFO_MAX,
+};
+
+static int getsockopt_int(int fd, int option, int *ret) {
+        socklen_t len = sizeof(*ret);
+
+        if (getsockopt(fd, SOL_SOCKET, option, ret, &len) < 0)
+                return -errno;
+        return 0;
+}
+
+static int describe_socket(int fd, PyObject *items[]) {
+        union {
+                struct sockaddr sa;
+                struct sockaddr_in in;
+                struct sockaddr_in6 in6;
+                struct sockaddr_un un;
+                struct sockaddr_storage storage;
+        } sa = {};
+        socklen_t len = sizeof(sa);
+        int family, type, protocol, listening = 0, r;
+
+        r = getsockopt_int(fd, SO_DOMAIN, &family);
+        if (r == 0)
+                r = getsockopt_int(fd, SO_TYPE, &type);
+        if (r == 0)
+                r = getsockopt_int(fd, SO_PROTOCOL, &protocol);
+        if (r == 0 && (type == SOCK_STREAM || type == SOCK_SEQPACKET))
+                r = getsockopt_int(fd, SO_ACCEPTCONN, &listening);
+        if (r < 0)
+                return set_error(r, NULL, NULL);
+
+        if (getsockname(fd, &sa.sa, &len) < 0)
+                return set_error(-errno, NULL, NULL);
+
+        items[FDINFO_FAMILY] = PyLong_FromLong(family);
+        items[FDINFO_TYPE] = PyLong_FromLong(type);
+        items[FDINFO_PROTOCOL] = PyLong_FromLong(protocol);
+        items[FDINFO_LISTENING] = PyBool_FromLong(listening);
+
+        if (family == AF_INET || family == AF_INET6) {
+                char buf[INET6_ADDRSTRLEN];
+
+                if (!inet_ntop(family,
+                               family == AF_INET ? (void*) &sa.in.sin_addr : (void*) &sa.in6.sin6_addr,
+                               buf, sizeof(buf)))
+                        return set_error(-errno, NULL, NULL);
+
+                items[FDINFO_ADDRESS] = PyUnicode_FromString(buf);
+                /* sin_port and sin6_port are at the same offset */
+                items[FDINFO_PORT] = PyLong_FromLong(ntohs(sa.in.sin_port));
+
+        } else if (family == AF_UNIX && len > offsetof(struct sockaddr_un, sun_path)) {
+                size_t n = len - offsetof(struct sockaddr_un, sun_path);
+
+                if (sa.un.sun_path[0] == '\0') {
+                        /* abstract socket, the name is not NUL terminated */
+                        sa.un.sun_path[0] = '@';
+                        items[FDINFO_PATH] = PyUnicode_DecodeFSDefaultAndSize(sa.un.sun_path, n);
+                } else
+                        items[FDINFO_PATH] = PyUnicode_DecodeFSDefaultAndSize(sa.un.sun_path,
+                                                                            strnlen(sa.un.sun_path, n));
+        }
+
+        return 0;
+}
+
+static int describe_fd(int fd, PyObject *items[]) {
+        struct stat st;
+        const char *kind;
+
+        if (fstat(fd, &st) < 0)
+                return set_error(-errno, NULL, NULL);
+
+        if (S_ISSOCK(st.st_mode)) {
+                kind = "socket";
+                if (describe_socket(fd, items) < 0)
+                        return -1;
+
+        } else if (S_ISREG(st.st_mode)) {
+                struct mq_attr attr;
+
+                /* POSIX message queues are regular files on the mqueue file
+                 * system, which support mq_getattr(). Use the syscall directly
+                 * to avoid linking against librt. */
+                if (syscall(SYS_mq_getsetattr, fd, NULL, &attr) >= 0) {
+                        kind = "mq";
+                        items[FDINFO_MQ_MAXMSG] = PyLong_FromLong(attr.mq_maxmsg);
+                        items[FDINFO_MQ_MSGSIZE] = PyLong_FromLong(attr.mq_msgsize);
+                        items[FDINFO_MQ_CURMSGS] = PyLong_FromLong(attr.mq_curmsgs);
+                } else
+                        kind = "regular";
+
+        } else if (S_ISFIFO(st.st_mode))
+                kind = "fifo";
+        else if (S_ISDIR(st.st_mode))
+                kind = "directory";
+        else if (S_ISCHR(st.st_mode))
+                kind = "character";
+        else if (S_ISBLK(st.st_mode))
+                kind = "block";
+        else
+                kind = "other";
+
+        if (!S_ISSOCK(st.st_mode)) {
+                char proc[32], buf[PATH_MAX];
+                ssize_t n;
+
+                sprintf(proc, "/proc/self/fd/%i", fd);
+                n = readlink(proc, buf, sizeof(buf));
+                if (n > 0 && buf[0] == '/')
+                        items[FDINFO_PATH] = PyUnicode_DecodeFSDefaultAndSize(buf, n);
+        }
+
+        items[FDINFO_FD] = PyLong_FromLong(fd);
+        items[FDINFO_KIND] = PyUnicode_FromString(kind);
+        return 0;
+}
+
+PyDoc_STRVAR(describe_fds__doc__,
+             "describe_fds(fds) -> list of FdInfo\n\n"
+             "Describe each of the given file descriptors in a single call: its kind,\n"
+             "and for sockets family, type, protocol, listening state and bound address,\n"
+             "and for POSIX message queues their attributes. Fields which do not apply\n"
+             "are None. This answers the questions of the _is_socket*(), _is_fifo() and\n"
+             "_is_mq() functions for many descriptors at once.");
+
+static PyObject* describe_fds(PyObject *self, PyObject *fds) {
+        ModuleState *state = PyModule_GetState(self);
+        _cleanup_Py_DECREF_ PyObject *list = NULL;
+        _cleanup_(PyMem_Free_intp) int *arr = NULL;
+        int n;
+
+        n = parse_fds(fds, &arr);
+        if (n < 0)
+                return NULL;
+
+        list = PyList_New(n);
+        if (!list)
+                return NULL;
+
+        for (int i = 0; i < n; i++) {
+                PyObject *items[_FDINFO_MAX] = {};
+                PyObject *info;
+                int r;
+
+                /* A failed allocation of one of the items leaves an exception set */
+                r = describe_fd(arr[i], items);
+                info = r == 0 && !PyErr_Occurred() ? PyStructSequence_New(state->FdInfoType) : NULL;
+                for (int j = 0; j < _FDINFO_MAX; j++) {
+                        if (!info)
+                                Py_XDECREF(items[j]);
+                        else if (items[j])
+                                PyStructSequence_SET_ITEM(info, j, items[j]);
+                        else {
+                                Py_INCREF(Py_None);
+                                PyStructSequence_SET_ITEM(info, j, Py_None);
+                        }
+                }
+                if (!info)
+                        return NULL;
+
+                PyList_SET_ITEM(list, i, info);
+        }
+
+        Py_INCREF(list);
+        return list;
+}
+
+/* Watchdog: sends WATCHDOG=1 from a native thread, so that keep-alive pings
+ * do not depend on the GIL. Pings are only sent while the application keeps
+ * calling beat(), which bumps a counter without taking any lock; if the
+ * counter does not advance for stall_timeout, pinging stops and the service
+ * manager will eventually act on the missed deadline. */
+
+typedef struct {
+        PyObject_HEAD
+        uint64_t usec;           /* the watchdog timeout, 0 if disabled */
+        uint64_t period;         /* time between pings in µs */
+        uint64_t stall_timeout;  /* in µs, 0 if pings are not gated on beats */
+        uint64_t beats;          /* bumped by beat(), read by the thread */
+        uint64_t pings;
+        bool stalled;
+        int error;               /* errno of a failed sd_notify() in the thread */
+        bool stop;
+        bool initialized;
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        pthread_t thread;
+        pid_t thread_pid;        /* the process in which the thread is running, or 0 */
+} Watchdog;
+
+static uint64_t now_usec(void) {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Initializes a mutex, and a condition variable which uses CLOCK_MONOTONIC
+ * for timed waits. */
+static int init_sync(pthread_mutex_t *mutex, pthread_cond_t *cond) {
+        pthread_condattr_t attr;
+        int r;
+
+        r = pthread_condattr_init(&attr);
+        if (r == 0) {
+                r = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+                if (r == 0)
+                        r = pthread_cond_init(cond, &attr);
+                pthread_condattr_destroy(&attr);
+        }
+        if (r != 0)
+                return -r;
+
+        r = pthread_mutex_init(mutex, NULL);
+        if (r != 0) {
+                pthread_cond_destroy(cond);
+                return -r;
+        }
+
+        return 0;
+}
+
+static void* watchdog_thread(void *p) {
+        Watchdog *self = p;
+        uint64_t last_beats, last_change;
+
+        last_beats = __atomic_load_n(&self->beats, __ATOMIC_RELAXED);
+        last_change = now_usec();
+
+        pthread_mutex_lock(&self->mutex);
+        while (!self->stop) {
+                uint64_t now, beats;
+                struct timespec ts;
+
+                now = now_usec();
+                beats = __atomic_load_n(&self->beats, __ATOMIC_RELAXED);
+                if (beats != last_beats) {
+                        last_beats = beats;
+                        last_change = now;
+                }
+
+                self->stalled = self->stall_timeout > 0 && now - last_change > self->stall_timeout;
+                if (!self->stalled) {
+                        int r;
+
+                        /* Not under the mutex, so that it is not held by this
+                         * thread if another thread forks meanwhile */
+                        pthread_mutex_unlock(&self->mutex);
+                        r = sd_notify(false, "WATCHDOG=1");
+                        pthread_mutex_lock(&self->mutex);
+                        if (r < 0)
+                                self->error = -r;
+                        else
+                                self->pings++;
+                }
+
+                now += self->period;
+                ts.tv_sec = now / 1000000;
+                ts.tv_nsec = now % 1000000 * 1000;
+                while (!self->stop &&
+                       pthread_cond_timedwait(&self->cond, &self->mutex, &ts) != ETIMEDOUT)
+                        ;
+        }
+        pthread_mutex_unlock(&self->mutex);
+
+        return NULL;
+}
+
+static void watchdog_stop(Watchdog *self) {
+        if (self->thread_pid != getpid())
+                return;
+
+        pthread_mutex_lock(&self->mutex);
+        self->stop = true;
+        pthread_cond_signal(&self->cond);
+        pthread_mutex_unlock(&self->mutex);
+
+        pthread_join(self->thread, NULL);
+        self->thread_pid = 0;
+}
+
+static void Watchdog_dealloc(Watchdog *self) {
+        PyTypeObject *type = Py_TYPE(self);
+
+        if (self->initialized) {
+                Py_BEGIN_ALLOW_THREADS
+                watchdog_stop(self);
+                Py_END_ALLOW_THREADS
+                pthread_cond_destroy(&self->cond);
+                pthread_mutex_destroy(&self->mutex);
+        }
+        type->tp_free((PyObject*)self);
+        Py_DECREF(type);
+}
+
+PyDoc_STRVAR(Watchdog__doc__,
+             "Watchdog(usec=None, fraction=0.5, stall_timeout=None, unset_environment=False) -> ...\n\n"
+             "Keep-alive pings for the service manager watchdog, sent from a native\n"
+             "thread every `fraction` of the watchdog timeout.\n\n"
+             "The timeout is taken from `usec` if given, and otherwise queried with\n"
+             "sd_watchdog_enabled(3). If the watchdog is not enabled for this process,\n"
+             ".start() does nothing. Since the thread does not need the GIL, long pauses\n"
+             "of the interpreter do not cause missed pings.\n\n"
+             "Pings are only sent while .beat() is called at least once every\n"
+             "`stall_timeout` microseconds (by default, the watchdog timeout), e.g. from\n"
+             "the event loop, so that a wedged application is still detected. With\n"
+             "`stall_timeout=0`, pings are sent unconditionally.");
+static int Watchdog_init(Watchdog *self, PyObject *args, PyObject *keywds) {
+        PyObject *usec_obj = Py_None, *stall_obj = Py_None;
+        double fraction = 0.5;
+        int unset = false, r;
+        uint64_t usec = 0;
+
+        static const char* const kwlist[] = {"usec", "fraction", "stall_timeout", "unset_environment", NULL};
+        if (!PyArg_ParseTupleAndKeywords(args, keywds, "|OdOp:__init__", (char**) kwlist,
+                                         &usec_obj, &fraction, &stall_obj, &unset))
+                return -1;
+
+        if (self->initialized) {
+                PyErr_SetString(PyExc_RuntimeError, "Watchdog is already initialized");
+                return -1;
+        }
+
+        if (!(fraction > 0 && fraction < 1)) {
+                PyErr_SetString(PyExc_ValueError, "fraction must be in the range (0, 1)");
+                return -1;
+        }
+
+        if (usec_obj != Py_None) {
+                usec = PyLong_AsUnsignedLongLong(usec_obj);
+                if (PyErr_Occurred())
+                        return -1;
+        } else {
+                r = sd_watchdog_enabled(unset, &usec);
+                if (set_error(r, NULL, NULL) < 0)
+                        return -1;
+                if (r == 0)
+                        usec = 0;
+        }
+
+        if (stall_obj != Py_None) {
+                self->stall_timeout = PyLong_AsUnsignedLongLong(stall_obj);
+                if (PyErr_Occurred())
+                        return -1;
+        } else
+                self->stall_timeout = usec;
+
+        r = init_sync(&self->mutex, &self->cond);
+        if (r < 0)
+                return set_error(r, NULL, NULL);
+
+        self->usec = usec;
+        self->period = usec * fraction;
+        if (self->period == 0 && usec > 0)
+                self->period = 1;
+        self->initialized = true;
+        return 0;
+}
+
+static int watchdog_check_initialized(Watchdog *self) {
+        if (!self->initialized) {
+                PyErr_SetString(PyExc_RuntimeError, "Watchdog is not initialized");
+                return -1;
+        }
+        return 0;
+}
+
+PyDoc_STRVAR(Watchdog_beat__doc__,
+             "beat() -> None\n\n"
+             "Signal that the application is making progress.");
+static PyObject* Watchdog_beat(Watchdog *self, PyObject *args _unused_) {
+        __atomic_add_fetch(&self->beats, 1, __ATOMIC_RELAXED);
+        Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(Watchdog_start__doc__,
+             "start() -> bool\n\n"
+             "Start the pinging thread, unless the watchdog is disabled.\n"
+             "Return True iff the thread is running.");
+static PyObject* Watchdog_start(Watchdog *self, PyObject *args _unused_) {
+        int r;
+
+        if (watchdog_check_initialized(self) < 0)
+                return NULL;
+
+        if (self->usec == 0)
+                Py_RETURN_FALSE;
+        if (self->thread_pid == getpid())
+                Py_RETURN_TRUE;
+
+        /* A thread inherited over fork() does not exist in this process, and
+         * the mutex might have been held by it, so the synchronization
+         * primitives are recreated first. */
+        if (self->thread_pid != 0) {
+                r = init_sync(&self->mutex, &self->cond);
+                if (r < 0) {
+                        set_error(r, NULL, NULL);
+                        return NULL;
+                }
+                self->thread_pid = 0;
+        }
+
+        self->stop = false;
+        self->error = 0;
+        r = pthread_create(&self->thread, NULL, watchdog_thread, self);
+        if (r != 0) {
+                set_error(-r, NULL, NULL);
+                return NULL;
+        }
+
+        self->thread_pid = getpid();
+        Py_RETURN_TRUE;
+}
+
+PyDoc_STRVAR(Watchdog_stop__doc__,
+             "stop() -> None\n\n"
+             "Stop the pinging thread. Raises OSError if a ping failed.");
+static PyObject* Watchdog_stop(Watchdog *self, PyObject *args _unused_) {
+        if (watchdog_check_initialized(self) < 0)
+                return NULL;
+
+        Py_BEGIN_ALLOW_THREADS
+        watchdog_stop(self);
+        Py_END_ALLOW_THREADS
+
+        if (self->error > 0) {
+                int r = -self->error;
+
+                self->error = 0;
+                set_error(r, NULL, NULL);
+                return NULL;
+        }
+
+        Py_RETURN_NONE;
+}
+
+static PyObject* Watchdog___enter__(Watchdog *self, PyObject *args _unused_) {
+        PyObject *r;
+
+        r = Watchdog_start(self, NULL);
+        if (!r)
+                return NULL;
+        Py_DECREF(r);
+
+        Py_INCREF(self);
+        return (PyObject*) self;
+}
+
+static PyObject* Watchdog___exit__(Watchdog *self, PyObject *const *args _unused_, Py_ssize_t nargs _unused_) {
+        return Watchdog_stop(self, NULL);
+}
+
+PyDoc_STRVAR(Watchdog_usec__doc__,
+             "The watchdog timeout in microseconds, 0 if the watchdog is disabled.");
+static PyObject* Watchdog_get_usec(Watchdog *self, void *closure _unused_) {
+        return PyLong_FromUnsignedLongLong(self->usec);
+}
+
+PyDoc_STRVAR(Watchdog_enabled__doc__,
+             "True iff the watchdog is enabled for this process.");
+static PyObject* Watchdog_get_enabled(Watchdog *self, void *closure _unused_) {
+        return PyBool_FromLong(self->usec > 0);
+}
+
+PyDoc_STRVAR(Watchdog_running__doc__,
+             "True iff the pinging thread is running in this process.");
+static PyObject* Watchdog_get_running(Watchdog *self, void *closure _unused_) {
+        return PyBool_FromLong(self->initialized && self->thread_pid == getpid());
+}
+
+PyDoc_STRVAR(Watchdog_pings__doc__,
+             "The number of pings sent so far.");
+static PyObject* Watchdog_get_pings(Watchdog *self, void *closure _unused_) {
+        unsigned long long pings;
+
+        if (watchdog_check_initialized(self) < 0)
+                return NULL;
+
+        pthread_mutex_lock(&self->mutex);
+        pings = self->pings;
+        pthread_mutex_unlock(&self->mutex);
+        return PyLong_FromUnsignedLongLong(pings);
+}
+
+PyDoc_STRVAR(Watchdog_stalled__doc__,
+             "True iff the last ping was skipped because .beat() was not called\n"
+             "within stall_timeout.");
+static PyObject* Watchdog_get_stalled(Watchdog *self, void *closure _unused_) {
+        bool stalled;
+
+        if (watchdog_check_initialized(self) < 0)
+                return NULL;
+
+        pthread_mutex_lock(&self->mutex);
+        stalled = self->stalled;
+        pthread_mutex_unlock(&self->mutex);
+        return PyBool_FromLong(stalled);
+}
+
+static PyGetSetDef Watchdog_getsetters[] = {
+        { (char*) "usec",    (getter) Watchdog_get_usec,    NULL, (char*) Watchdog_usec__doc__,    NULL },
+        { (char*) "enabled", (getter) Watchdog_get_enabled, NULL, (char*) Watchdog_enabled__doc__, NULL },
+        { (char*) "running", (getter) Watchdog_get_running, NULL, (char*) Watchdog_running__doc__, NULL },
+        { (char*) "pings",   (getter) Watchdog_get_pings,   NULL, (char*) Watchdog_pings__doc__,   NULL },
+        { (char*) "stalled", (getter) Watchdog_get_stalled, NULL, (char*) Watchdog_stalled__doc__, NULL },
+        {} /* Sentinel */
+};
+
+DISABLE_WARNING_CAST_FUNCTION_TYPE;
+static PyMethodDef Watchdog_methods[] = {
+        { "beat",      (PyCFunction) Watchdog_beat,      METH_NOARGS,   Watchdog_beat__doc__  },
+        { "start",     (PyCFunction) Watchdog_start,     METH_NOARGS,   Watchdog_start__doc__ },
+        { "stop",      (PyCFunction) Watchdog_stop,      METH_NOARGS,   Watchdog_stop__doc__  },
+        { "__enter__", (PyCFunction) Watchdog___enter__, METH_NOARGS,   NULL                  },
+        { "__exit__",  (PyCFunction) Watchdog___exit__,  METH_FASTCALL, NULL                  },
+        {} /* Sentinel */
+};
+REENABLE_WARNING;
+
+static PyType_Slot Watchdog_slots[] = {
+        { Py_tp_dealloc, Watchdog_dealloc        },
+        { Py_tp_doc,     (void*) Watchdog__doc__ },
+        { Py_tp_methods, Watchdog_methods        },
+        { Py_tp_getset,  Watchdog_getsetters     },
+        { Py_tp_init,    Watchdog_init           },
+        { Py_tp_new,     PyType_GenericNew       },
+        {}  /* Sentinel */
+};
+
+static PyType_Spec Watchdog_spec = {
+        .name = "_daemon.Watchdog",
+        .basicsize = sizeof(Watchdog),
+        .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_IMMUTABLETYPE,
+        .slots = Watchdog_slots,
+};
+
+/* Notifier: a socket connected to $NOTIFY_SOCKET once, so that each
+ * notification costs a single sendmsg(). Supports the address forms
+ * understood by sd_notify(3): a file system path, an abstract socket
+ * name prefixed with '@', and vsock:CID:PORT. */
+
+typedef struct {
+        PyObject_HEAD
+        int fd;
+        int family;
+        union {
+                struct sockaddr sa;
+                struct sockaddr_un un;
+                struct sockaddr_vm vm;
+        } address;
+        socklen_t address_len;
+        int type;
+        char *name;              /* the value of $NOTIFY_SOCKET, or NULL */
+        ObjectLock lock;
+} Notifier;
+
+static int parse_vsock_address(const char *s, Notifier *self) {
+        unsigned cid, port;
+        int n = 0;
+
+        if (sscanf(s, "%u:%u%n", &cid, &port, &n) < 2 || s[n] != '\0')
+                return -EINVAL;
+
+        self->address.vm = (struct sockaddr_vm) {
+                .svm_family = AF_VSOCK,
+                .svm_cid = cid,
+                .svm_port = port,
+        };
+        self->address_len = sizeof(struct sockaddr_vm);
+        return 0;
+}
+
+static int notifier_parse_address(Notifier *self, const char *name) {
+        size_t len;
+
+        if (name[0] == '/' || name[0] == '@') {
+                len = strlen(name);
+                if (len >= sizeof(self->address.un.sun_path))
+                        return -EINVAL;
+
+                self->address.un.sun_family = AF_UNIX;
+                memcpy(self->address.un.sun_path, name, len);
+                if (name[0] == '@') {
+                        self->address.un.sun_path[0] = '\0';
+                        self->address_len = offsetof(struct sockaddr_un, sun_path) + len;
+                } else
+                        self->address_len = offsetof(struct sockaddr_un, sun_path) + len + 1;
+                self->type = SOCK_DGRAM;
+                return 0;
+        }
+
+        if (strncmp(name, "vsock:", 6) == 0) {
+                self->type = SOCK_DGRAM;
+                return parse_vsock_address(name + 6, self);
+        }
+        if (strncmp(name, "vsock-dgram:", 12) == 0) {
+                self->type = SOCK_DGRAM;
+                return parse_vsock_address(name + 12, self);
+        }
+        if (strncmp(name, "vsock-seqpacket:", 16) == 0) {
+                self->type = SOCK_SEQPACKET;
+                return parse_vsock_address(name + 16, self);
+        }
+        if (strncmp(name, "vsock-stream:", 13) == 0) {
+                self->type = SOCK_STREAM;
+                return parse_vsock_address(name + 13, self);
+        }
+
+        return -EAFNOSUPPORT;
+}
+
+static int notifier_connect(Notifier *self) {
+        int fd, r;
+
+        fd = socket(self->address.sa.sa_family, self->type | SOCK_CLOEXEC, 0);
+        if (fd < 0 && self->address.sa.sa_family == AF_VSOCK && self->type == SOCK_DGRAM &&
+            (errno == ESOCKTNOSUPPORT || errno == EPROTONOSUPPORT) &&
+            strncmp(self->name, "vsock:", 6) == 0) {
+                /* Like sd_notify(), fall back to SOCK_SEQPACKET for plain vsock: */
+                self->type = SOCK_SEQPACKET;
+                fd = socket(AF_VSOCK, self->type | SOCK_CLOEXEC, 0);
+        }
+        if (fd < 0)
+                return -errno;
+
+        if (connect(fd, &self->address.sa, self->address_len) < 0) {
+                r = -errno;
+                close(fd);
+                return r;
+        }
+
+        if (self->fd >= 0)
+                close(self->fd);
+        self->fd = fd;
+        return 0;
+}
+
+static void notifier_close(Notifier *self) {
+        if (self->fd >= 0)
+                close(self->fd);
+        self->fd = -1;
+        self->name = mfree(self->name);
+}
+
+static void Notifier_dealloc(Notifier *self) {
+        PyTypeObject *type = Py_TYPE(self);
+
+        notifier_close(self);
+        type->tp_free((PyObject*)self);
+        Py_DECREF(type);
+}
+
+static PyObject* Notifier_new(PyTypeObject *type, PyObject *args _unused_, PyObject *kwds _unused_) {
+        Notifier *self;
+
+        self = (Notifier*) type->tp_alloc(type, 0);
+        if (!self)
+                return NULL;
+
+        self->fd = -1;
+        return (PyObject*) self;
+}
+
+PyDoc_STRVAR(Notifier__doc__,
+             "Notifier(unset_environment=False, address=None) -> ...\n\n"
+             "A connection to the notification socket of the service manager.\n\n"
+             "The socket named by $NOTIFY_SOCKET, or by `address` if given, is\n"
+             "connected once, and each .notify() call then sends a single datagram.\n"
+             "If `unset_environment` is true, $NOTIFY_SOCKET is removed from the\n"
+             "environment after connecting, but the connection remains usable.\n"
+             "If no notification socket is set, .notify() does nothing and returns\n"
+             "False, like sd_notify(3).");
+static int Notifier_init(Notifier *self, PyObject *args, PyObject *keywds) {
+        int unset = false, r;
+        const char *name = NULL;
+        LOCK_OBJECT(self);
+
+        static const char* const kwlist[] = {"unset_environment", "address", NULL};
+        if (!PyArg_ParseTupleAndKeywords(args, keywds, "|pz:__init__", (char**) kwlist,
+                                         &unset, &name))
+                return -1;
+
+        if (self->name || self->fd >= 0) {
+                PyErr_SetString(PyExc_RuntimeError, "Notifier is already initialized");
+                return -1;
+        }
+
+        if (!name)
+                name = getenv("NOTIFY_SOCKET");
+
+        if (name) {
+                self->name = strdup(name);
+                if (!self->name)
+                        return set_error(-ENOMEM, NULL, NULL);
+
+                r = notifier_parse_address(self, name);
+                if (r == 0) {
+                        Py_BEGIN_ALLOW_THREADS
+                        r = notifier_connect(self);
+                        Py_END_ALLOW_THREADS
+                }
+                if (r < 0) {
+                        r = set_error(r, self->name, "Invalid notification socket address");
+                        notifier_close(self);
+                        return r;
+                }
+        }
+
+        if (unset)
+                unsetenv("NOTIFY_SOCKET");
+
+        return 0;
+}
+
+static ssize_t notifier_send(Notifier *self, const char *msg, size_t len,
+                             pid_t pid, const int *fds, size_t n_fds) {
+        union {
+                struct cmsghdr cmsghdr;
+                uint8_t buf[CMSG_SPACE(sizeof(struct ucred)) + CMSG_SPACE(sizeof(int) * 253)];
+        } control;
+        struct iovec iov = {
+                .iov_base = (char*) msg,
+                .iov_len = len,
+        };
+        struct msghdr mh = {
+                .msg_iov = &iov,
+                .msg_iovlen = 1,
+                .msg_control = &control,
+        };
+        struct cmsghdr *cmsg;
+        bool send_ucred;
+        ssize_t n;
+
+        if (n_fds > 253)
+                return -E2BIG;
+
+        send_ucred = pid != 0 && pid != getpid() && self->address.sa.sa_family == AF_UNIX;
+        memset(&control, 0, sizeof(control));
+        mh.msg_controllen = (n_fds > 0 ? CMSG_SPACE(sizeof(int) * n_fds) : 0) +
+                            (send_ucred ? CMSG_SPACE(sizeof(struct ucred)) : 0);
+        if (mh.msg_controllen == 0)
+                mh.msg_control = NULL;
+
+        cmsg = mh.msg_controllen > 0 ? CMSG_FIRSTHDR(&mh) : NULL;
+        if (n_fds > 0) {
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type = SCM_RIGHTS;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(int) * n_fds);
+                memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * n_fds);
+
+                cmsg = CMSG_NXTHDR(&mh, cmsg);
+        }
+        if (send_ucred) {
+                struct ucred ucred = {
+                        .pid = pid,
+                        .uid = getuid(),
+                        .gid = getgid(),
+                };
+
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type = SCM_CREDENTIALS;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(struct ucred));
+                memcpy(CMSG_DATA(cmsg), &ucred, sizeof(ucred));
+        }
+
+        for (bool retried = false;; retried = true) {
+                n = sendmsg(self->fd, &mh, MSG_NOSIGNAL);
+                if (n >= 0)
+                        return n;
+                if (errno == EINTR)
+                        continue;
+
+                /* The receiving end was recreated, e.g. after the service manager
+                 * was restarted. Reconnect once. */
+                if (!retried && (errno == ECONNREFUSED || errno == ENOTCONN || errno == EPIPE)) {
+                        int r = notifier_connect(self);
+                        if (r < 0)
+                                return r;
+                        continue;
+                }
+
+                return -errno;
+        }
+}
+
+PyDoc_STRVAR(Notifier_notify__doc__,
+             "notify(status, pid=0, fds=None) -> bool\n\n"
+             "Send a message to the init system about a status change, see\n"
+             "sd_notify(3). With `pid`, the message is sent on behalf of another\n"
+             "process, and `fds` are passed along with the message.\n"
+             "Return False if no notification socket is set, and True otherwise.");
+static PyObject* Notifier_notify(Notifier *self, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+        const char *msg;
+        Py_ssize_t len;
+        int _pid = 0, n_fds = 0;
+        pid_t pid;
+        PyObject *fds = NULL;
+        _cleanup_(PyMem_Free_intp) int *arr = NULL;
+        ssize_t r;
+        LOCK_OBJECT(self);
+
+        static const char* const kwlist[] = {"status", "pid", "fds", NULL};
+        if (!parse_fastcall(args, nargs, kwnames, "s#|iO:notify", kwlist,
+                            &msg, &len, &_pid, &fds))
+                return NULL;
+        pid = _pid;
+        if (pid < 0 || pid != _pid) {
+                PyErr_SetString(PyExc_OverflowError, "Bad pid_t");
+                return NULL;
+        }
+
+        if (fds) {
+                n_fds = parse_fds(fds, &arr);
+                if (n_fds < 0)
+                        return NULL;
+        }
+
+        if (self->fd < 0) {
+                if (self->name) {
+                        PyErr_SetString(PyExc_ValueError, "I/O operation on closed Notifier");
+                        return NULL;
+                }
+                Py_RETURN_FALSE;
+        }
+
+        /* The GIL (or the object lock) is kept, so that reconnecting cannot race
+         * with other senders */
+        r = notifier_send(self, msg, len, pid, arr, n_fds);
+        if (set_error(r, NULL, NULL) < 0)
+                return NULL;
+
+        Py_RETURN_TRUE;
+}
+
+PyDoc_STRVAR(Notifier_close__doc__,
+             "close() -> None\n\n"
+             "Close the notification socket.");
+static PyObject* Notifier_close(Notifier *self, PyObject *args _unused_) {
+        LOCK_OBJECT(self);
+
+        if (self->fd >= 0)
+                close(self->fd);
+        self->fd = -1;
+        Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(Notifier_fileno__doc__,
+             "fileno() -> int\n\n"
+             "Return the connected socket, or -1 if no notification socket is set.");
+static PyObject* Notifier_fileno(Notifier *self, PyObject *args _unused_) {
+        LOCK_OBJECT(self);
+
+        return PyLong_FromLong(self->fd);
+}
+
+static PyObject* Notifier___enter__(PyObject *self, PyObject *args _unused_) {
+        Py_INCREF(self);
+        return self;
+}
+
+static PyObject* Notifier___exit__(Notifier *self, PyObject *const *args _unused_, Py_ssize_t nargs _unused_) {
+        return Notifier_close(self, NULL);
+}
+
+PyDoc_STRVAR(Notifier_address__doc__,
+             "The address of the notification socket, or None if it is not set.");
+static PyObject* Notifier_get_address(Notifier *self, void *closure _unused_) {
+        LOCK_OBJECT(self);
+
+        if (!self->name)
+                Py_RETURN_NONE;
+        return PyUnicode_DecodeFSDefault(self->name);
+}
+
+static PyGetSetDef Notifier_getsetters[] = {
+        { (char*) "address", (getter) Notifier_get_address, NULL, (char*) Notifier_address__doc__, NULL },
+        {} /* Sentinel */
+};
+
+DISABLE_WARNING_CAST_FUNCTION_TYPE;
+static PyMethodDef Notifier_methods[] = {
+        { "notify",    (PyCFunction) Notifier_notify,    METH_FASTCALL | METH_KEYWORDS, Notifier_notify__doc__ },
+        { "close",     (PyCFunction) Notifier_close,     METH_NOARGS,                   Notifier_close__doc__  },
+        { "fileno",    (PyCFunction) Notifier_fileno,    METH_NOARGS,                   Notifier_fileno__doc__ },
+        { "__enter__", (PyCFunction) Notifier___enter__, METH_NOARGS,                   NULL                   },
+        { "__exit__",  (PyCFunction) Notifier___exit__,  METH_FASTCALL,                 NULL                   },
+        {} /* Sentinel */
+};
+REENABLE_WARNING;
+
+static PyType_Slot Notifier_slots[] = {
+        { Py_tp_dealloc, Notifier_dealloc        },
+        { Py_tp_doc,     (void*) Notifier__doc__ },
+        { Py_tp_methods, Notifier_methods        },
+        { Py_tp_getset,  Notifier_getsetters     },
+        { Py_tp_init,    Notifier_init           },
+        { Py_tp_new,     Notifier_new            },
+        {}  /* Sentinel */
+};
+
+static PyType_Spec Notifier_spec = {
+        .name = "_daemon.Notifier",
+        .basicsize = sizeof(Notifier),
+        .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_IMMUTABLETYPE,
+        .slots = Notifier_slots,
+};
+
+/* StatusPublisher: keeps the latest value of each notification field in a
+ * small table, and sends changed fields in a single message from a background
+ * thread, at most once per min_interval, through a Notifier connected when the
+ * publisher is created. Updates only replace the stored value, so they cost
+ * the same however often they happen. */
+
+/* How long the thread waits before it tries again after a failed send */
+#define PUBLISHER_RETRY_USEC (100 * 1000)
+
+typedef struct {
+        char *key;
+        char *value;
+        size_t size;             /* allocated size of value */
+        bool dirty;
+} StatusField;
+
+typedef struct {
+        PyObject_HEAD
+        uint64_t interval;       /* in µs */
+        uint64_t last_flush;     /* CLOCK_MONOTONIC time in µs of the last send */
+        uint64_t retry_after;    /* CLOCK_MONOTONIC time in µs before which the thread does not send */
+        Notifier *notifier;
+        StatusField *fields;
+        size_t n_fields;
+        bool dirty;
+        uint64_t sent;
+        int error;               /* errno of a failed sd_notify() in the thread */
+        bool stop;
+        bool initialized;        /* the notifier and the sync primitives exist until dealloc */
+        bool closed;
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        pthread_mutex_t send_mutex;  /* serializes sends, taken before mutex */
+        pthread_t thread;
+        pid_t thread_pid;        /* the process in which the thread is running, or 0 */
+} StatusPublisher;
+
+static int publisher_init_sync(StatusPublisher *self) {
+        int r;
+
+        r = init_sync(&self->mutex, &self->cond);
+        if (r < 0)
+                return r;
+
+        r = pthread_mutex_init(&self->send_mutex, NULL);
+        if (r != 0) {
+                pthread_cond_destroy(&self->cond);
+                pthread_mutex_destroy(&self->mutex);
+                return -r;
+        }
+
+        return 0;
+}
+
+static void publisher_destroy_sync(StatusPublisher *self) {
+        pthread_mutex_destroy(&self->send_mutex);
+        pthread_cond_destroy(&self->cond);
+        pthread_mutex_destroy(&self->mutex);
+}
+
+/* Collects all dirty fields into a message, and marks them clean. Must be
+ * called with the mutex held. Returns NULL if nothing is dirty or on OOM. */
+static char* publisher_take_message(StatusPublisher *self) {
+        size_t len = 0;
+        char *msg, *p;
+
+        if (!self->dirty)
+                return NULL;
+
+        for (size_t i = 0; i < self->n_fields; i++)
+                if (self->fields[i].dirty)
+                        len += strlen(self->fields[i].key) + 1 + strlen(self->fields[i].value) + 1;
+
+        p = msg = malloc(len + 1);
+        if (!msg)
+                return NULL;
+
+        for (size_t i = 0; i < self->n_fields; i++) {
+                StatusField *f = self->fields + i;
+
+                if (!f->dirty)
+                        continue;
+                p = stpcpy(p, f->key);
+                *p++ = '=';
+                p = stpcpy(p, f->value);
+                *p++ = '\n';
+                f->dirty = false;
+        }
+        *p = '\0';
+
+        self->dirty = false;
+        return msg;
+}
+
+/* Sends the pending fields. Must be called without the mutex held. Sends are
+ * serialized, so that an older state is never sent after a newer one. */
+static int publisher_flush(StatusPublisher *self) {
+        _cleanup_free_ char *msg = NULL;
+        ssize_t n = 0;
+        int r = 0;
+
+        pthread_mutex_lock(&self->send_mutex);
+
+        pthread_mutex_lock(&self->mutex);
+        msg = publisher_take_message(self);
+        if (msg)
+                self->last_flush = now_usec();
+        else if (self->dirty)
+                r = -ENOMEM;
+        pthread_mutex_unlock(&self->mutex);
+
+        if (msg && self->notifier->fd >= 0) {
+                n = notifier_send(self->notifier, msg, strlen(msg), 0, NULL, 0);
+                if (n > 0) {
+                        pthread_mutex_lock(&self->mutex);
+                        self->sent++;
+                        pthread_mutex_unlock(&self->mutex);
+                }
+        }
+
+        pthread_mutex_unlock(&self->send_mutex);
+        return n < 0 ? (int) n : r;
+}
+
+static void* publisher_thread(void *p) {
+        StatusPublisher *self = p;
+
+        pthread_mutex_lock(&self->mutex);
+        while (!self->stop) {
+                uint64_t deadline = self->last_flush + self->interval;
+
+                if (deadline < self->retry_after)
+                        deadline = self->retry_after;
+
+                if (!self->dirty)
+                        pthread_cond_wait(&self->cond, &self->mutex);
+                else if (now_usec() < deadline) {
+                        struct timespec ts = {
+                                .tv_sec = deadline / 1000000,
+                                .tv_nsec = (deadline % 1000000) * 1000,
+                        };
+
+                        (void) pthread_cond_timedwait(&self->cond, &self->mutex, &ts);
+                } else {
+                        int r;
+
+                        pthread_mutex_unlock(&self->mutex);
+                        r = publisher_flush(self);
+                        pthread_mutex_lock(&self->mutex);
+                        if (r < 0) {
+                                /* e.g. if the message could not be allocated, dirty
+                                 * is still set, so do not try again right away */
+                                self->error = -r;
+                                self->retry_after = now_usec() + PUBLISHER_RETRY_USEC;
+                        }
+                }
+        }
+        pthread_mutex_unlock(&self->mutex);
+
+        return NULL;
+}
+
+/* After fork(), the thread of the parent is gone, and the mutexes might have
+ * been held by it, so the synchronization primitives are recreated before
+ * they are used in the child. Must be called with the GIL held. */
+static int publisher_check_fork(StatusPublisher *self) {
+        int r;
+
+        if (self->thread_pid == 0 || self->thread_pid == getpid())
+                return 0;
+
+        r = publisher_init_sync(self);
+        if (r < 0)
+                return set_error(r, NULL, NULL);
+
+        self->thread_pid = 0;
+        return 0;
+}
+
+/* Starts the thread in this process, if it is not running yet. */
+static int publisher_ensure_thread(StatusPublisher *self) {
+        pid_t pid = getpid();
+        int r;
+
+        if (self->thread_pid == pid)
+                return 0;
+
+        self->stop = false;
+        r = pthread_create(&self->thread, NULL, publisher_thread, self);
+        if (r != 0)
+                return -r;
+
+        self->thread_pid = pid;
+        return 0;
+}
+
+static void publisher_stop_thread(StatusPublisher *self) {
+        if (self->thread_pid != getpid())
+                return;
+
+        pthread_mutex_lock(&self->mutex);
+        self->stop = true;
+        pthread_cond_signal(&self->cond);
+        pthread_mutex_unlock(&self->mutex);
+
+        pthread_join(self->thread, NULL);
+        self->thread_pid = 0;
+}
+
+static void publisher_free_fields(StatusPublisher *self) {
+        for (size_t i = 0; i < self->n_fields; i++) {
+                free(self->fields[i].key);
+                free(self->fields[i].value);
+        }
+        self->fields = mfree(self->fields);
+        self->n_fields = 0;
+}
+
+static void StatusPublisher_dealloc(StatusPublisher *self) {
+        PyTypeObject *type = Py_TYPE(self);
+
+        if (self->initialized && publisher_check_fork(self) < 0)
+                PyErr_WriteUnraisable((PyObject*) self);
+        else if (self->initialized) {
+                Py_BEGIN_ALLOW_THREADS
+                publisher_stop_thread(self);
+                (void) publisher_flush(self);
+                Py_END_ALLOW_THREADS
+                publisher_destroy_sync(self);
+        }
+        Py_CLEAR(self->notifier);
+        publisher_free_fields(self);
+        type->tp_free((PyObject*)self);
+        Py_DECREF(type);
+}
+
+PyDoc_STRVAR(StatusPublisher__doc__,
+             "StatusPublisher(min_interval=1000000) -> ...\n\n"
+             "Coalescing publisher of service state, e.g. STATUS= progress messages.\n\n"
+             "Each .update() only stores the new values. A background thread sends\n"
+             "the fields which changed since the last notification, at most once\n"
+             "every `min_interval` microseconds. The final state is always sent by\n"
+             ".close(), which is also called when used as a context manager.\n\n"
+             "Notifications are sent through a Notifier, i.e. $NOTIFY_SOCKET is\n"
+             "connected once when the publisher is created.");
+static int StatusPublisher_init(StatusPublisher *self, PyObject *args, PyObject *keywds) {
+        unsigned long long interval = 1000000;
+        ModuleState *state;
+        int r;
+
+        static const char* const kwlist[] = {"min_interval", NULL};
+        if (!PyArg_ParseTupleAndKeywords(args, keywds, "|K:__init__", (char**) kwlist, &interval))
+                return -1;
+
+        if (self->initialized) {
+                PyErr_SetString(PyExc_RuntimeError, "StatusPublisher is already initialized");
+                return -1;
+        }
+
+        state = get_module_state(Py_TYPE(self), &module);
+        if (!state)
+                return -1;
+
+        Py_XSETREF(self->notifier, (Notifier*) PyObject_CallNoArgs((PyObject*) state->NotifierType));
+        if (!self->notifier)
+                return -1;
+
+        r = publisher_init_sync(self);
+        if (r < 0)
+                return set_error(r, NULL, NULL);
+
+        self->interval = interval;
+        self->initialized = true;
+        return 0;
+}
+
+static int publisher_check_open(StatusPublisher *self) {
+        if (!self->initialized || self->closed) {
+                PyErr_SetString(PyExc_ValueError, "I/O operation on closed StatusPublisher");
+                return -1;
+        }
+        return 0;
+}
+
+/* Stores value for key. Must be called with the mutex held. */
+static int publisher_set_locked(StatusPublisher *self, const char *key, const char *value) {
+        size_t len = strlen(value);
+        StatusField *f = NULL;
+
+        for (size_t i = 0; i < self->n_fields; i++)
+                if (strcmp(self->fields[i].key, key) == 0) {
+                        f = self->fields + i;
+                        break;
+                }
+
+        if (!f) {
+                StatusField *fields;
+                char *k;
+
+                k = strdup(key);
+                if (!k)
+                        return -ENOMEM;
+
+                fields = realloc(self->fields, (self->n_fields + 1) * sizeof(StatusField));
+                if (!fields) {
+                        free(k);
+                        return -ENOMEM;
+                }
+
+                self->fields = fields;
+                f = self->fields + self->n_fields++;
+                *f = (StatusField) { .key = k };
+        } else if (!f->dirty && strcmp(f->value, value) == 0)
+                return 0;
+
+        if (len + 1 > f->size) {
+                char *v;
+
+                v = realloc(f->value, len + 1);
+                if (!v)
+                        return -ENOMEM;
+                f->value = v;
+                f->size = len + 1;
+        }
+
+        memcpy(f->value, value, len + 1);
+        f->dirty = self->dirty = true;
+        return 0;
+}
+
+static inline void PyMem_Free_charpp(const char ***p) {
+        PyMem_Free(*p);
+}
+
+/* Stores str(value) in strings, which keeps the returned UTF-8 buffer alive. */
+static int publisher_convert_value(PyObject *strings, const char *key, PyObject *value, const char **ret) {
+        _cleanup_Py_DECREF_ PyObject *s = NULL;
+        const char *v;
+        Py_ssize_t len;
+
+        s = PyObject_Str(value);
+        if (!s || PyList_Append(strings, s) < 0)
+                return -1;
+
+        v = PyUnicode_AsUTF8AndSize(s, &len);
+        if (!v)
+                return -1;
+        if (strlen(v) != (size_t) len || strchr(v, '\n')) {
+                PyErr_Format(PyExc_ValueError, "Invalid value for %s: %R", key, value);
+                return -1;
+        }
+
+        *ret = v;
+        return 0;
+}
+
+PyDoc_STRVAR(StatusPublisher_update__doc__,
+             "update(status=None, **fields) -> None\n\n"
+             "Set STATUS= to `status` if given, and each FIELD= to the given value.\n"
+             "The values are converted with str().");
+static PyObject* StatusPublisher_update(StatusPublisher *self, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+        PyObject *status = Py_None, *key, *value;
+        _cleanup_Py_DECREF_ PyObject *strings = NULL;
+        _cleanup_(PyMem_Free_charpp) const char **keys = NULL, **values = NULL;
+        Py_ssize_t nkw = kwnames ? PyTuple_GET_SIZE(kwnames) : 0, n = 0, i;
+        int r = 0, error;
+
+        /* All keyword arguments are fields, so only the positional ones are parsed. */
+        if (!parse_fastcall(args, nargs, NULL, "|O:update", NULL, &status))
+                return NULL;
+
+        if (publisher_check_open(self) < 0)
+                return NULL;
+
+        /* Convert everything first, so that no Python code runs with the mutex held */
+        strings = PyList_New(0);
+        keys = PyMem_New(const char*, nkw + 1);
+        values = PyMem_New(const char*, nkw + 1);
+        if (!strings || !keys || !values)
+                return PyErr_NoMemory();
+
+        if (status != Py_None) {
+                keys[n] = "STATUS";
+                if (publisher_convert_value(strings, keys[n], status, &values[n]) < 0)
+                        return NULL;
+                n++;
+        }
+
+        for (i = 0; i < nkw; i++) {
+                key = PyTuple_GET_ITEM(kwnames, i);
+                value = args[nargs + i];
+
+                keys[n] = PyUnicode_AsUTF8(key);
+                if (!keys[n])
+                        return NULL;
+                if (keys[n][0] == '\0' || strpbrk(keys[n], "=\n")) {
+                        PyErr_Format(PyExc_ValueError, "Invalid field name: %R", key);
+                        return NULL;
+                }
+
+                if (publisher_convert_value(strings, keys[n], value, &values[n]) < 0)
+                        return NULL;
+                n++;
+        }
+
+        /* The conversions might have run code which closed the publisher */
+        if (publisher_check_open(self) < 0 || publisher_check_fork(self) < 0)
+                return NULL;
+
+        pthread_mutex_lock(&self->mutex);
+        for (i = 0; i < n && r >= 0; i++)
+                r = publisher_set_locked(self, keys[i], values[i]);
+        if (r >= 0 && self->dirty) {
+                r = publisher_ensure_thread(self);
+                pthread_cond_signal(&self->cond);
+        }
+        error = self->error;
+        self->error = 0;
+        pthread_mutex_unlock(&self->mutex);
+
+        if (set_error(r, NULL, NULL) < 0 || set_error(-error, NULL, NULL) < 0)
+                return NULL;
+
+        Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(StatusPublisher_flush__doc__,
+             "flush() -> None\n\n"
+             "Send pending changes immediately.");
+static PyObject* StatusPublisher_flush(StatusPublisher *self, PyObject *args _unused_) {
+        int r;
+
+        if (publisher_check_open(self) < 0 || publisher_check_fork(self) < 0)
+                return NULL;
+
+        Py_BEGIN_ALLOW_THREADS
+        r = publisher_flush(self);
+        pthread_mutex_lock(&self->mutex);
+        if (r >= 0 && self->error > 0)
+                r = -self->error;
+        self->error = 0;
+        pthread_mutex_unlock(&self->mutex);
+        Py_END_ALLOW_THREADS
+
+        if (set_error(r, NULL, NULL) < 0)
+                return NULL;
+
+        Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(StatusPublisher_close__doc__,
+             "close() -> None\n\n"
+             "Stop the background thread, and send the final state.");
+static PyObject* StatusPublisher_close(StatusPublisher *self, PyObject *args _unused_) {
+        int r;
+
+        if (!self->initialized || self->closed)
+                Py_RETURN_NONE;
+
+        if (publisher_check_fork(self) < 0)
+                return NULL;
+
+        /* A flush() in another thread might still be running without the GIL,
+         * so the notifier and the sync primitives are only freed in dealloc. */
+        self->closed = true;
+
+        Py_BEGIN_ALLOW_THREADS
+        publisher_stop_thread(self);
+        r = publisher_flush(self);
+        pthread_mutex_lock(&self->mutex);
+        if (r >= 0 && self->error > 0)
+                r = -self->error;
+        pthread_mutex_unlock(&self->mutex);
+        Py_END_ALLOW_THREADS
+
+        if (set_error(r, NULL, NULL) < 0)
+                return NULL;
+
+        Py_RETURN_NONE;
+}
+
+static PyObject* StatusPublisher___enter__(PyObject *self, PyObject *args _unused_) {
+        Py_INCREF(self);
+        return self;
+}
+
+static PyObject* StatusPublisher___exit__(StatusPublisher *self, PyObject *const *args _unused_, Py_ssize_t nargs _unused_) {
+        return StatusPublisher_close(self, NULL);
+}
+
+PyDoc_STRVAR(StatusPublisher_sent__doc__,
+             "The number of notifications sent so far.");
+static PyObject* StatusPublisher_get_sent(StatusPublisher *self, void *closure _unused_) {
+        unsigned long long sent;
+
+        if (!self->initialized)
+                return PyLong_FromUnsignedLongLong(self->sent);
+
+        pthread_mutex_lock(&self->mutex);
+        sent = self->sent;
+        pthread_mutex_unlock(&self->mutex);
+        return PyLong_FromUnsignedLongLong(sent);
+}
+
+PyDoc_STRVAR(StatusPublisher_closed__doc__,
+             "True iff the publisher is closed.");
+static PyObject* StatusPublisher_get_closed(StatusPublisher *self, void *closure _unused_) {
+        return PyBool_FromLong(!self->initialized || self->closed);
+}
+
+static PyGetSetDef StatusPublisher_getsetters[] = {
+        { (char*) "sent",   (getter) StatusPublisher_get_sent,   NULL, (char*) StatusPublisher_sent__doc__,   NULL },
+        { (char*) "closed", (getter) StatusPublisher_get_closed, NULL, (char*) StatusPublisher_closed__doc__, NULL },
+        {} /* Sentinel */
+};
+
+DISABLE_WARNING_CAST_FUNCTION_TYPE;
+static PyMethodDef StatusPublisher_methods[] = {
+        { "update",    (PyCFunction) StatusPublisher_update,    METH_FASTCALL | METH_KEYWORDS, StatusPublisher_update__doc__ },
+        { "flush",     (PyCFunction) StatusPublisher_flush,     METH_NOARGS,                   StatusPublisher_flush__doc__  },
+        { "close",     (PyCFunction) StatusPublisher_close,     METH_NOARGS,                   StatusPublisher_close__doc__  },
+        { "__enter__", (PyCFunction) StatusPublisher___enter__, METH_NOARGS,                   NULL                          },
+        { "__exit__",  (PyCFunction) StatusPublisher___exit__,  METH_FASTCALL,                 NULL                          },
+        {} /* Sentinel */
+};
+REENABLE_WARNING;
+
+static PyType_Slot StatusPublisher_slots[] = {
+        { Py_tp_dealloc, StatusPublisher_dealloc        },
+        { Py_tp_doc,     (void*) StatusPublisher__doc__ },
+        { Py_tp_methods, StatusPublisher_methods        },
+        { Py_tp_getset,  StatusPublisher_getsetters     },
+        { Py_tp_init,    StatusPublisher_init           },
+        { Py_tp_new,     PyType_GenericNew              },
+        {}  /* Sentinel */
+};
+
+static PyType_Spec StatusPublisher_spec = {
+        .name = "_daemon.StatusPublisher",
+        .basicsize = sizeof(StatusPublisher),
+        .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_IMMUTABLETYPE,
+        .slots = StatusPublisher_slots,
+};
+
 
 DISABLE_WARNING_CAST_FUNCTION_TYPE;
 static PyMethodDef methods[] = {
-        { "booted",                 booted,                   METH_NOARGS,                  booted__doc__                },
-        { "notify",                 (PyCFunction) notify,     METH_VARARGS | METH_KEYWORDS, notify__doc__                },
-        { "_listen_fds",            (PyCFunction) listen_fds, METH_VARARGS | METH_KEYWORDS, listen_fds__doc__            },
-        { "_listen_fds_with_names", (PyCFunction) listen_fds_with_names,
-                                                              METH_VARARGS | METH_KEYWORDS, listen_fds_with_names__doc__ },
-        { "_is_fifo",               is_fifo,                  METH_VARARGS,                 is_fifo__doc__               },
-        { "_is_mq",                 is_mq,                    METH_VARARGS,                 is_mq__doc__                 },
-        { "_is_socket",             is_socket,                METH_VARARGS,                 is_socket__doc__             },
-        { "_is_socket_inet",        is_socket_inet,           METH_VARARGS,                 is_socket_inet__doc__        },
-        { "_is_socket_sockaddr",    is_socket_sockaddr,       METH_VARARGS,                 is_socket_sockaddr__doc__    },
-        { "_is_socket_unix",        is_socket_unix,           METH_VARARGS,                 is_socket_unix__doc__        },
+        { "booted",                 booted,                              METH_NOARGS,                   booted__doc__                },
+        { "notify",                 (PyCFunction) notify,                METH_FASTCALL | METH_KEYWORDS, notify__doc__                },
+        { "_notify_barrier",        (PyCFunction) notify_barrier,        METH_FASTCALL | METH_KEYWORDS, notify_barrier__doc__        },
+        { "_listen_fds",            (PyCFunction) listen_fds,            METH_FASTCALL | METH_KEYWORDS, listen_fds__doc__            },
+        { "_listen_fds_with_names", (PyCFunction) listen_fds_with_names, METH_FASTCALL | METH_KEYWORDS, listen_fds_with_names__doc__ },
+        { "_is_fifo",               (PyCFunction) is_fifo,               METH_FASTCALL,                 is_fifo__doc__               },
+        { "_is_mq",                 (PyCFunction) is_mq,                 METH_FASTCALL,                 is_mq__doc__                 },
+        { "_is_socket",             (PyCFunction) is_socket,             METH_FASTCALL,                 is_socket__doc__             },
+        { "_is_socket_inet",        (PyCFunction) is_socket_inet,        METH_FASTCALL,                 is_socket_inet__doc__        },
+        { "_is_socket_sockaddr",    (PyCFunction) is_socket_sockaddr,    METH_FASTCALL,                 is_socket_sockaddr__doc__    },
+        { "_is_socket_unix",        (PyCFunction) is_socket_unix,        METH_FASTCALL,                 is_socket_unix__doc__        },
+        { "describe_fds",           describe_fds,                        METH_O,                        describe_fds__doc__          },
         {}        /* Sentinel */
 };
 REENABLE_WARNING;
 
+static int module_traverse(PyObject *m, visitproc visit, void *arg) {
+        ModuleState *state = PyModule_GetState(m);
+
+        Py_VISIT(state->FdInfoType);
+        Py_VISIT(state->WatchdogType);
+        Py_VISIT(state->NotifierType);
+        Py_VISIT(state->StatusPublisherType);
+        return 0;
+}
+
+static int module_clear(PyObject *m) {
+        ModuleState *state = PyModule_GetState(m);
+
+        Py_CLEAR(state->FdInfoType);
+        Py_CLEAR(state->WatchdogType);
+        Py_CLEAR(state->NotifierType);
+        Py_CLEAR(state->StatusPublisherType);
+        return 0;
+}
+
+static void module_free(void *m) {
+        module_clear(m);
+}
+
+static int module_exec(PyObject *m) {
+        ModuleState *state = PyModule_GetState(m);
+
+        if (PyModule_AddIntConstant(m, "LISTEN_FDS_START", SD_LISTEN_FDS_START) ||
+            PyModule_AddStringConstant(m, "__version__", PACKAGE_VERSION))
+                return -1;
+
+        if (module_add_struct_type(m, &FdInfo_desc, &state->FdInfoType) < 0 ||
+            module_add_type(m, &Watchdog_spec, &state->WatchdogType) < 0 ||
+            module_add_type(m, &Notifier_spec, &state->NotifierType) < 0 ||
+            module_add_type(m, &StatusPublisher_spec, &state->StatusPublisherType) < 0)
+                return -1;
+
+        return 0;
+}
+
+/* Watchdog, Notifier and StatusPublisher still rely on the GIL to serialize
+ * start() and close() against the other methods. */
+static PyModuleDef_Slot module_slots[] = {
+        MODULE_SLOTS_WITH_GIL(module_exec),
+};
+
 static struct PyModuleDef module = {
         PyModuleDef_HEAD_INIT,
         .m_name = "_daemon", /* name of module */
         .m_doc = module__doc__, /* module documentation, may be NULL */
-        .m_size = 0, /* size of per-interpreter state of the module */
+        .m_size = sizeof(ModuleState), /* size of per-interpreter state of the module */
         .m_methods = methods,
+        .m_slots = module_slots,
+        .m_traverse = module_traverse,
+        .m_clear = module_clear,
+        .m_free = module_free,
 };
 
 DISABLE_WARNING_MISSING_PROTOTYPES;
 PyMODINIT_FUNC PyInit__daemon(void) {
-        PyObject *m;
-
-        m = PyModule_Create(&module);
-        if (!m)
-                return NULL;
-
-        if (PyModule_AddIntConstant(m, "LISTEN_FDS_START", SD_LISTEN_FDS_START) ||
-            PyModule_AddStringConstant(m, "__version__", PACKAGE_VERSION)) {
-                Py_DECREF(m);
-                return NULL;
-        }
-
-        return m;
+        return PyModuleDef_Init(&module);
 }
 REENABLE_WARNING;
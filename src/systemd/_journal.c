@@ -1,50 +1,302 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
 #include <alloca.h>
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 
 #define SD_JOURNAL_SUPPRESS_LOCATION
 #include "systemd/sd-journal.h"
 
 #include "macro.h"
+#include "probes.h"
 #include "pyutil.h"
 
+DEFINE_PROBE(journal_sendv);
+
+/* Fill iov with the contents of the argc str or bytes objects in args.
+ * Strings are encoded as UTF-8, and the encoded objects are stored in encoded,
+ * which must be released by the caller, also on failure. */
+static int fill_iovec(PyObject *const *args, Py_ssize_t argc, struct iovec *iov, PyObject **encoded) {
+        for (Py_ssize_t i = 0; i < argc; ++i) {
+                PyObject *item = args[i];
+                char *stritem;
+                Py_ssize_t length;
+
+                if (PyUnicode_Check(item)) {
+                        encoded[i] = PyUnicode_AsEncodedString(item, "utf-8", "strict");
+                        if (!encoded[i])
+                                return -1;
+                        item = encoded[i];
+                }
+                if (PyBytes_AsStringAndSize(item, &stritem, &length))
+                        return -1;
+
+                iov[i].iov_base = stritem;
+                iov[i].iov_len = length;
+        }
+
+        return 0;
+}
+
+/* The native journal protocol, see https://systemd.io/JOURNAL_NATIVE_PROTOCOL/.
+ * Fields are serialized as "FIELD=value\n", or, if the value contains a
+ * newline, as "FIELD\n", followed by the length of the value as a little
+ * endian 64-bit integer, the value, and "\n". */
+
+#define JOURNAL_SOCKET_PATH "/run/systemd/journal/socket"
+
+/* Returns the size of the serialized entry, or -EINVAL if one of the fields
+ * is not of the form FIELD=value. */
+static ssize_t native_entry_size(const struct iovec *iov, size_t n) {
+        size_t size = 0;
+
+        for (size_t i = 0; i < n; i++) {
+                const char *field = iov[i].iov_base;
+                const char *eq = memchr(field, '=', iov[i].iov_len);
+
+                if (!eq || eq == field)
+                        return -EINVAL;
+
+                if (memchr(eq + 1, '\n', iov[i].iov_len - (eq + 1 - field)))
+                        size += iov[i].iov_len + 9;
+                else
+                        size += iov[i].iov_len + 1;
+        }
+
+        return size;
+}
+
+/* Serializes the entry into buf, which must be at least native_entry_size() long. */
+static void native_entry_write(const struct iovec *iov, size_t n, char *buf) {
+        for (size_t i = 0; i < n; i++) {
+                const char *field = iov[i].iov_base;
+                const char *eq = memchr(field, '=', iov[i].iov_len);
+                size_t key_len = eq - field, value_len = iov[i].iov_len - key_len - 1;
+
+                if (memchr(eq + 1, '\n', value_len)) {
+                        uint64_t le = htole64(value_len);
+
+                        memcpy(buf, field, key_len);
+                        buf += key_len;
+                        *buf++ = '\n';
+                        memcpy(buf, &le, sizeof(le));
+                        buf += sizeof(le);
+                        memcpy(buf, eq + 1, value_len);
+                        buf += value_len;
+                } else {
+                        memcpy(buf, field, iov[i].iov_len);
+                        buf += iov[i].iov_len;
+                }
+                *buf++ = '\n';
+        }
+}
+
+/* The journal socket. Entries are sent with sd_journal_sendv(), unless the
+ * socket was redirected with set_socket() or $PYTHON_SYSTEMD_JOURNAL_SOCKET,
+ * e.g. to a JournalServer in tests. Then entries are serialized with the
+ * encoder above and sent to that socket, in a sealed memfd if they are too
+ * large for a datagram, like sd_journal_sendv() does. Like the socket used by
+ * libsystemd, this is per process. */
+static struct {
+        pthread_rwlock_t lock;
+        bool redirected;
+        struct sockaddr_un un;
+        socklen_t len;
+        int fd;
+} journal_socket = {
+        .lock = PTHREAD_RWLOCK_INITIALIZER,
+        .un.sun_family = AF_UNIX,
+        .un.sun_path = JOURNAL_SOCKET_PATH,
+        .len = offsetof(struct sockaddr_un, sun_path) + sizeof(JOURNAL_SOCKET_PATH),
+        .fd = -1,
+};
+
+/* Sets the path of the journal socket, or restores the default if path is NULL. */
+static int journal_socket_set(const char *path) {
+        size_t l = strlen(path ?: JOURNAL_SOCKET_PATH);
+
+        if (l == 0 || l >= sizeof(journal_socket.un.sun_path))
+                return -EINVAL;
+
+        pthread_rwlock_wrlock(&journal_socket.lock);
+        memcpy(journal_socket.un.sun_path, path ?: JOURNAL_SOCKET_PATH, l + 1);
+        journal_socket.len = offsetof(struct sockaddr_un, sun_path) + l + 1;
+        __atomic_store_n(&journal_socket.redirected, !!path, __ATOMIC_RELEASE);
+        pthread_rwlock_unlock(&journal_socket.lock);
+
+        return 0;
+}
+
+static void journal_socket_init_once(void) {
+        const char *path = getenv("PYTHON_SYSTEMD_JOURNAL_SOCKET");
+
+        if (path && *path)
+                (void) journal_socket_set(path);
+}
+
+/* Copies the current address of the journal socket. */
+static void journal_socket_address(struct sockaddr_un *un, socklen_t *len) {
+        pthread_rwlock_rdlock(&journal_socket.lock);
+        *un = journal_socket.un;
+        *len = journal_socket.len;
+        pthread_rwlock_unlock(&journal_socket.lock);
+}
+
+/* Returns the datagram socket used to send entries natively, creating it on first use. */
+static int journal_socket_fd(void) {
+        int fd = __atomic_load_n(&journal_socket.fd, __ATOMIC_ACQUIRE), unset = -1;
+
+        if (fd >= 0)
+                return fd;
+
+        fd = socket(AF_UNIX, SOCK_DGRAM|SOCK_CLOEXEC, 0);
+        if (fd < 0)
+                return -errno;
+
+        if (!__atomic_compare_exchange_n(&journal_socket.fd, &unset, fd, false,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                /* Another thread was faster */
+                close(fd);
+                return unset;
+        }
+
+        return fd;
+}
+
+static int send_memfd(int fd, const struct sockaddr_un *un, socklen_t len, const char *buf, size_t size) {
+        union {
+                struct cmsghdr cmsghdr;
+                uint8_t buf[CMSG_SPACE(sizeof(int))];
+        } control = {};
+        struct msghdr mh = {
+                .msg_name = (void*) un,
+                .msg_namelen = len,
+                .msg_control = &control,
+                .msg_controllen = sizeof(control),
+        };
+        struct cmsghdr *cmsg;
+        int memfd, r = 0;
+
+        memfd = memfd_create("journal-data", MFD_ALLOW_SEALING|MFD_CLOEXEC);
+        if (memfd < 0)
+                return -errno;
+
+        while (size > 0) {
+                ssize_t k = write(memfd, buf, size);
+                if (k < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        r = -errno;
+                        goto finish;
+                }
+                buf += k;
+                size -= k;
+        }
+
+        if (fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK|F_SEAL_GROW|F_SEAL_WRITE|F_SEAL_SEAL) < 0) {
+                r = -errno;
+                goto finish;
+        }
+
+        cmsg = CMSG_FIRSTHDR(&mh);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &memfd, sizeof(int));
+
+        if (sendmsg(fd, &mh, MSG_NOSIGNAL) < 0)
+                r = -errno;
+
+finish:
+        close(memfd);
+        return r;
+}
+
+static int journal_send_native(const struct iovec *iov, size_t n) {
+        _cleanup_free_ char *heap = NULL;
+        char stack[4096], *buf = stack;
+        struct sockaddr_un un;
+        socklen_t len;
+        ssize_t size;
+        int fd;
+
+        size = native_entry_size(iov, n);
+        if (size < 0)
+                return size;
+        if ((size_t) size > sizeof(stack)) {
+                buf = heap = malloc(size);
+                if (!buf)
+                        return -ENOMEM;
+        }
+        native_entry_write(iov, n, buf);
+
+        fd = journal_socket_fd();
+        if (fd < 0)
+                return fd;
+        journal_socket_address(&un, &len);
+
+        if (sendto(fd, buf, size, MSG_NOSIGNAL, (struct sockaddr*) &un, len) >= 0)
+                return 0;
+        if (errno != EMSGSIZE && errno != ENOBUFS)
+                return -errno;
+
+        return send_memfd(fd, &un, len, buf, size);
+}
+
+/* Sends an entry to the journal, or to the socket set with set_socket(). */
+static int journal_send(const struct iovec *iov, size_t n) {
+        if (!__atomic_load_n(&journal_socket.redirected, __ATOMIC_ACQUIRE))
+                return sd_journal_sendv(iov, n);
+
+        return journal_send_native(iov, n);
+}
+
 PyDoc_STRVAR(journal_sendv__doc__,
              "sendv('FIELD=value', 'FIELD=value', ...) -> None\n\n"
              "Send an entry to the journal."
 );
 
-static PyObject* journal_sendv(PyObject *self _unused_, PyObject *args) {
+static PyObject* journal_sendv(PyObject *self _unused_, PyObject *const *args, Py_ssize_t nargs) {
         PyObject *ret = NULL;
+        uint64_t start;
         int r;
 
         /* Allocate an array for the argument strings */
-        int argc = PyTuple_Size(args);
+        int argc = nargs;
         PyObject **encoded = alloca0(argc * sizeof(PyObject*));
 
         /* Allocate sufficient iovector space for the arguments. */
         struct iovec *iov = alloca(argc * sizeof(struct iovec));
 
         /* Iterate through the Python arguments and fill the iovector. */
-        for (int i = 0; i < argc; ++i) {
-                PyObject *item = PyTuple_GetItem(args, i);
-                char *stritem;
-                Py_ssize_t length;
+        if (fill_iovec(args, argc, iov, encoded) < 0)
+                goto out;
 
-                if (PyUnicode_Check(item)) {
-                        encoded[i] = PyUnicode_AsEncodedString(item, "utf-8", "strict");
-                        if (!encoded[i])
-                                goto out;
-                        item = encoded[i];
-                }
-                if (PyBytes_AsStringAndSize(item, &stritem, &length))
-                        goto out;
+        /* Send the iovector to the journal. */
+        start = PROBE_START(journal_sendv);
+        r = journal_send(iov, argc);
+        if (PROBE_ENABLED(journal_sendv)) {
+                size_t size = 0;
 
-                iov[i].iov_base = stritem;
-                iov[i].iov_len = length;
+                for (int i = 0; i < argc; i++)
+                        size += iov[i].iov_len;
+                PROBE4(journal_sendv, argc, size, r, PROBE_ELAPSED(start));
         }
-
-        /* Send the iovector to the journal. */
-        r = sd_journal_sendv(iov, argc);
         if (r < 0) {
                 errno = -r;
                 PyErr_SetFromErrno(PyExc_OSError);
@@ -62,18 +314,204 @@ out:
         return ret;
 }
 
+PyDoc_STRVAR(journal_set_socket__doc__,
+             "set_socket(path=None) -> str or None\n\n"
+             "Send entries to the datagram socket at `path` instead of journald, or to\n"
+             "journald again if `path` is None, and return the previous path, or None.\n"
+             "This is meant for tests and benchmarks, see JournalServer. The initial\n"
+             "path is taken from $PYTHON_SYSTEMD_JOURNAL_SOCKET. It applies to\n"
+             "sendv(), send(), JournalHandler and SharedLogRing, but not to stream().");
+
+static PyObject* journal_set_socket(PyObject *self _unused_, PyObject *const *args, Py_ssize_t nargs) {
+        _cleanup_Py_DECREF_ PyObject *_path = NULL;
+        PyObject *old = Py_None;
+        int r;
+
+        if (!parse_fastcall(args, nargs, NULL, "|O&:set_socket", NULL,
+                            Unicode_FSConverter, &_path))
+                return NULL;
+
+        pthread_rwlock_rdlock(&journal_socket.lock);
+        if (journal_socket.redirected)
+                old = PyUnicode_DecodeFSDefault(journal_socket.un.sun_path);
+        else
+                Py_INCREF(old);
+        pthread_rwlock_unlock(&journal_socket.lock);
+        if (!old)
+                return NULL;
+
+        r = journal_socket_set(_path ? PyBytes_AS_STRING(_path) : NULL);
+        if (r < 0) {
+                Py_DECREF(old);
+                set_error(r, NULL, "Invalid socket path");
+                return NULL;
+        }
+
+        return old;
+}
+
+#define FIELD_NAME_MAX 64
+
+static bool valid_field_char(char c) {
+        return (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+/* Like journald, names must not start with a digit, and fields whose name
+ * starts with an underscore are reserved for journald itself. */
+static bool valid_field_name(const char *name, size_t len) {
+        if (len == 0 || len > FIELD_NAME_MAX ||
+            (name[0] >= '0' && name[0] <= '9') || name[0] == '_')
+                return false;
+
+        for (size_t i = 0; i < len; i++)
+                if (!valid_field_char(name[i]))
+                        return false;
+
+        return true;
+}
+
+static char upcase_field_char(char c) {
+        return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+}
+
+PyDoc_STRVAR(journal_encode_fields__doc__,
+             "_encode_fields(mapping, skip, reserved=None) -> list\n\n"
+             "Return a list of b'FIELD=value' lines for the items in `mapping`\n"
+             "whose keys are not in the set `skip`. Keys are converted to upper\n"
+             "case, and items whose keys are not valid field names, or whose\n"
+             "upper case keys are in the set `reserved`, are ignored. Like journald,\n"
+             "names must not start with '_' or a digit, or be longer than 64.\n"
+             "Values are sent as-is if bytes, UTF-8 encoded if str, and converted\n"
+             "with str() otherwise. A MESSAGE_ID value is converted to its hex form\n"
+             "if it has a 'hex' attribute.");
+
+static PyObject* journal_encode_fields(PyObject *self _unused_, PyObject *const *args, Py_ssize_t nargs) {
+        PyObject *mapping, *skip, *reserved = Py_None;
+        _cleanup_Py_DECREF_ PyObject *_ans = NULL, *items = NULL;
+        PyObject *ans;
+
+        if (!parse_fastcall(args, nargs, NULL, "O!O|O:_encode_fields", NULL,
+                            &PyDict_Type, &mapping, &skip, &reserved))
+                return NULL;
+
+        if (!PyAnySet_Check(skip)) {
+                PyErr_SetString(PyExc_TypeError, "skip must be a set or frozenset");
+                return NULL;
+        }
+        if (reserved == Py_None)
+                reserved = NULL;
+        else if (!PyAnySet_Check(reserved)) {
+                PyErr_SetString(PyExc_TypeError, "reserved must be a set or frozenset");
+                return NULL;
+        }
+
+        ans = _ans = PyList_New(0);
+        if (!ans)
+                return NULL;
+
+        /* Iterate over a copy, since __str__() of a value or the hex attribute
+         * might run code which modifies the mapping and frees its items. */
+        items = PyDict_Items(mapping);
+        if (!items)
+                return NULL;
+
+        for (Py_ssize_t pos = 0; pos < PyList_GET_SIZE(items); pos++) {
+                PyObject *key = PyTuple_GET_ITEM(PyList_GET_ITEM(items, pos), 0);
+                PyObject *value = PyTuple_GET_ITEM(PyList_GET_ITEM(items, pos), 1);
+                _cleanup_Py_DECREF_ PyObject *converted = NULL, *line = NULL;
+                char upper[FIELD_NAME_MAX];
+                const char *name, *data;
+                Py_ssize_t name_len, data_len;
+                char *buf;
+                int r;
+
+                if (!PyUnicode_Check(key))
+                        continue;
+
+                r = PySet_Contains(skip, key);
+                if (r < 0)
+                        return NULL;
+                if (r > 0)
+                        continue;
+
+                name = PyUnicode_AsUTF8AndSize(key, &name_len);
+                if (!name)
+                        return NULL;
+                if (name_len > FIELD_NAME_MAX)
+                        continue;
+
+                for (Py_ssize_t i = 0; i < name_len; i++)
+                        upper[i] = upcase_field_char(name[i]);
+                if (!valid_field_name(upper, name_len))
+                        continue;
+
+                if (reserved) {
+                        _cleanup_Py_DECREF_ PyObject *upper_key = PyUnicode_FromStringAndSize(upper, name_len);
+                        if (!upper_key)
+                                return NULL;
+
+                        r = PySet_Contains(reserved, upper_key);
+                        if (r < 0)
+                                return NULL;
+                        if (r > 0)
+                                continue;
+                }
+
+                if (name_len == strlen("MESSAGE_ID") &&
+                    strncasecmp(name, "MESSAGE_ID", name_len) == 0 &&
+                    PyObject_HasAttrString(value, "hex")) {
+                        converted = PyObject_GetAttrString(value, "hex");
+                        if (!converted)
+                                return NULL;
+                        value = converted;
+                }
+
+                if (PyBytes_Check(value)) {
+                        data = PyBytes_AS_STRING(value);
+                        data_len = PyBytes_GET_SIZE(value);
+                } else {
+                        if (!PyUnicode_Check(value)) {
+                                PyObject *str = PyObject_Str(value);
+                                if (!str)
+                                        return NULL;
+                                Py_XDECREF(converted);
+                                value = converted = str;
+                        }
+
+                        data = PyUnicode_AsUTF8AndSize(value, &data_len);
+                        if (!data)
+                                return NULL;
+                }
+
+                line = PyBytes_FromStringAndSize(NULL, name_len + 1 + data_len);
+                if (!line)
+                        return NULL;
+
+                buf = PyBytes_AS_STRING(line);
+                memcpy(buf, upper, name_len);
+                buf[name_len] = '=';
+                memcpy(buf + name_len + 1, data, data_len);
+
+                if (PyList_Append(ans, line) < 0)
+                        return NULL;
+        }
+
+        _ans = NULL;
+        return ans;
+}
+
 PyDoc_STRVAR(journal_stream_fd__doc__,
              "stream_fd(identifier, priority, level_prefix) -> fd\n\n"
              "Open a stream to journal by calling sd_journal_stream_fd(3)."
 );
 
-static PyObject* journal_stream_fd(PyObject *self _unused_, PyObject *args) {
+static PyObject* journal_stream_fd(PyObject *self _unused_, PyObject *const *args, Py_ssize_t nargs) {
         const char* identifier;
         int priority, level_prefix;
         int fd;
 
-        if (!PyArg_ParseTuple(args, "sii:stream_fd",
-                              &identifier, &priority, &level_prefix))
+        if (!parse_fastcall(args, nargs, NULL, "sii:stream_fd", NULL,
+                            &identifier, &priority, &level_prefix))
                 return NULL;
 
         fd = sd_journal_stream_fd(identifier, priority, level_prefix);
@@ -85,32 +523,2486 @@ static PyObject* journal_stream_fd(PyObject *self _unused_, PyObject *args) {
         return PyLong_FromLong(fd);
 }
 
-static PyMethodDef methods[] = {
-        { "sendv",     journal_sendv,     METH_VARARGS, journal_sendv__doc__     },
-        { "stream_fd", journal_stream_fd, METH_VARARGS, journal_stream_fd__doc__ },
-        {}        /* Sentinel */
-};
+/* JournalStream: a buffered writer for a stream file descriptor as returned by
+ * sd_journal_stream_fd(3). Data is accumulated in a buffer, which is written
+ * out when it would overflow, on flush(), or by a background thread at most
+ * flush_interval after the first byte was buffered. The buffer is protected
+ * by a mutex, so that the thread does not need the GIL. */
 
-static struct PyModuleDef module = {
-        PyModuleDef_HEAD_INIT,
-        .m_name = "_journal", /* name of module */
-        .m_size = -1, /* size of per-interpreter state of the module */
-        .m_methods = methods,
-};
+typedef struct {
+        PyObject_HEAD
+        int fd;
+        char *buf;
+        size_t size, len;
+        uint64_t interval;       /* in µs */
+        uint64_t first_write;    /* CLOCK_MONOTONIC time in µs when buf became non-empty */
+        int error;               /* errno of a failed write in the flusher thread */
+        bool stop;
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        pthread_t flusher;
+        pid_t flusher_pid;       /* the process in which the thread is running, or 0 */
+} JournalStream;
 
-DISABLE_WARNING_MISSING_PROTOTYPES;
-PyMODINIT_FUNC PyInit__journal(void) {
-        PyObject *m;
+static uint64_t now_usec(void) {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int write_all(int fd, const char *p, size_t len) {
+        while (len > 0) {
+                ssize_t n = write(fd, p, len);
+                if (n < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return -errno;
+                }
+
+                p += n;
+                len -= n;
+        }
+
+        return 0;
+}
+
+/* Must be called with the mutex held. The buffer is emptied even if the write
+ * fails, so that a broken stream does not grow it indefinitely. */
+static int stream_flush_locked(JournalStream *self) {
+        int r;
+
+        if (self->len == 0)
+                return 0;
+
+        r = write_all(self->fd, self->buf, self->len);
+        self->len = 0;
+        return r;
+}
+
+static void* stream_flusher_thread(void *p) {
+        JournalStream *self = p;
+
+        pthread_mutex_lock(&self->mutex);
+        while (!self->stop) {
+                if (self->len == 0)
+                        pthread_cond_wait(&self->cond, &self->mutex);
+                else {
+                        uint64_t deadline = self->first_write + self->interval;
+                        struct timespec ts = {
+                                .tv_sec = deadline / 1000000,
+                                .tv_nsec = (deadline % 1000000) * 1000,
+                        };
+
+                        if (pthread_cond_timedwait(&self->cond, &self->mutex, &ts) == ETIMEDOUT &&
+                            self->len > 0 && now_usec() >= self->first_write + self->interval) {
+                                int r = stream_flush_locked(self);
+                                if (r < 0)
+                                        self->error = -r;
+                        }
+                }
+        }
+        pthread_mutex_unlock(&self->mutex);
+
+        return NULL;
+}
+
+static int stream_init_sync(JournalStream *self) {
+        pthread_condattr_t attr;
+        int r;
+
+        r = pthread_mutex_init(&self->mutex, NULL);
+        if (r != 0)
+                return -r;
+
+        r = pthread_condattr_init(&attr);
+        if (r == 0) {
+                r = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+                if (r == 0)
+                        r = pthread_cond_init(&self->cond, &attr);
+                pthread_condattr_destroy(&attr);
+        }
+        if (r != 0) {
+                pthread_mutex_destroy(&self->mutex);
+                return -r;
+        }
+
+        return 0;
+}
+
+/* After fork(), the flusher thread of the parent is gone, and the mutex might
+ * have been held by it, so the synchronization primitives are recreated
+ * before they are used in the child. Must be called with the GIL held. */
+static int stream_check_fork(JournalStream *self) {
+        int r;
+
+        if (self->flusher_pid == 0 || self->flusher_pid == getpid())
+                return 0;
+
+        r = stream_init_sync(self);
+        if (r < 0)
+                return r;
+
+        self->flusher_pid = 0;
+        return 0;
+}
+
+/* Starts the flusher thread in this process, if it is not running yet. */
+static int stream_ensure_flusher(JournalStream *self) {
+        pid_t pid = getpid();
+        int r;
+
+        if (self->flusher_pid == pid)
+                return 0;
+
+        r = pthread_create(&self->flusher, NULL, stream_flusher_thread, self);
+        if (r != 0)
+                return -r;
+
+        self->flusher_pid = pid;
+        return 0;
+}
+
+static void stream_stop_flusher(JournalStream *self) {
+        if (self->flusher_pid != getpid())
+                return;
+
+        pthread_mutex_lock(&self->mutex);
+        self->stop = true;
+        pthread_cond_signal(&self->cond);
+        pthread_mutex_unlock(&self->mutex);
+
+        (void) pthread_join(self->flusher, NULL);
+        self->flusher_pid = 0;
+        self->stop = false;
+}
+
+/* The buffer and the synchronization primitives are only freed in dealloc,
+ * because other threads may still be waiting for the mutex in write(). */
+static int stream_close(JournalStream *self) {
+        int fd = -1, r = 0;
+
+        if (self->fd < 0)
+                return 0;
+
+        r = stream_check_fork(self);
+        if (r < 0)
+                return r;
+
+        Py_BEGIN_ALLOW_THREADS
+        pthread_mutex_lock(&self->mutex);
+        if (self->fd >= 0) {
+                r = stream_flush_locked(self);
+                fd = self->fd;
+                self->fd = -1;
+        }
+        pthread_mutex_unlock(&self->mutex);
+
+        /* Once fd is unset under the mutex, write() cannot start the thread again */
+        if (fd >= 0) {
+                stream_stop_flusher(self);
+                close(fd);
+        }
+        Py_END_ALLOW_THREADS
+
+        return r;
+}
+
+static void JournalStream_dealloc(JournalStream *self) {
+        PyTypeObject *type = Py_TYPE(self);
+
+        (void) stream_close(self);
+        if (self->buf) {
+                self->buf = mfree(self->buf);
+                pthread_cond_destroy(&self->cond);
+                pthread_mutex_destroy(&self->mutex);
+        }
+        type->tp_free((PyObject*)self);
+        Py_DECREF(type);
+}
+
+static PyObject* JournalStream_new(PyTypeObject *type, PyObject *args _unused_, PyObject *kwds _unused_) {
+        JournalStream *self;
+
+        self = (JournalStream*) type->tp_alloc(type, 0);
+        if (!self)
+                return NULL;
+
+        self->fd = -1;
+        return (PyObject*) self;
+}
+
+PyDoc_STRVAR(JournalStream__doc__,
+             "JournalStream(fd, buffer_size=16384, flush_interval=100000) -> ...\n\n"
+             "A buffered binary writer for a stream to the journal, as returned by\n"
+             "stream_fd(). The stream takes ownership of `fd`.\n\n"
+             "Written data is collected in a buffer of `buffer_size` bytes, which is\n"
+             "written to the stream with a single write(2) when it would overflow,\n"
+             "when .flush() is called, and at the latest `flush_interval` microseconds\n"
+             "after the first byte was buffered. Data is passed through unmodified, so\n"
+             "the journal still splits it into entries at newlines, and interprets\n"
+             "'<N>' priority prefixes if the stream was opened with level_prefix.");
+static int JournalStream_init(JournalStream *self, PyObject *args, PyObject *keywds) {
+        int fd, r;
+        unsigned long long buffer_size = 16384, interval = 100000;
+
+        static const char* const kwlist[] = {"fd", "buffer_size", "flush_interval", NULL};
+        if (!PyArg_ParseTupleAndKeywords(args, keywds, "i|KK:__init__", (char**) kwlist,
+                                         &fd, &buffer_size, &interval))
+                return -1;
+
+        if (self->fd >= 0) {
+                PyErr_SetString(PyExc_RuntimeError, "JournalStream is already initialized");
+                return -1;
+        }
+
+        if (fd < 0)
+                return set_error(-EBADF, NULL, NULL);
+
+        if (buffer_size < 1 || buffer_size > SSIZE_MAX) {
+                PyErr_SetString(PyExc_ValueError, "buffer_size must be positive");
+                return -1;
+        }
+
+        self->buf = malloc(buffer_size);
+        if (!self->buf)
+                return set_error(-ENOMEM, NULL, NULL);
+
+        r = stream_init_sync(self);
+        if (r < 0) {
+                self->buf = mfree(self->buf);
+                return set_error(r, NULL, NULL);
+        }
+
+        self->fd = fd;
+        self->size = buffer_size;
+        self->interval = interval;
+        return 0;
+}
+
+static int stream_check_open(JournalStream *self) {
+        if (self->fd < 0) {
+                PyErr_SetString(PyExc_ValueError, "I/O operation on closed JournalStream");
+                return -1;
+        }
+        return 0;
+}
+
+PyDoc_STRVAR(JournalStream_write__doc__,
+             "write(data) -> int\n\n"
+             "Buffer `data`, a bytes-like object or a string which is encoded as\n"
+             "UTF-8. Returns the length of `data`.");
+static PyObject* JournalStream_write(JournalStream *self, PyObject *data) {
+        _cleanup_Py_DECREF_ PyObject *encoded = NULL;
+        Py_ssize_t ret = -1;
+        Py_buffer view;
+        int r = 0;
+
+        if (stream_check_open(self) < 0)
+                return NULL;
+
+        if (PyUnicode_Check(data)) {
+                ret = PyUnicode_GET_LENGTH(data);
+                encoded = PyUnicode_AsUTF8String(data);
+                if (!encoded)
+                        return NULL;
+                data = encoded;
+        }
+
+        if (set_error(stream_check_fork(self), NULL, NULL) < 0)
+                return NULL;
+
+        if (PyObject_GetBuffer(data, &view, PyBUF_SIMPLE) < 0)
+                return NULL;
+        if (ret < 0)
+                ret = view.len;
 
-        m = PyModule_Create(&module);
-        if (!m)
+        Py_BEGIN_ALLOW_THREADS
+        pthread_mutex_lock(&self->mutex);
+
+        /* closed by another thread while we were waiting */
+        if (self->fd < 0)
+                r = -EBADF;
+        else
+                r = -self->error;
+        self->error = 0;
+
+        if (r == 0 && self->len + view.len > self->size)
+                r = stream_flush_locked(self);
+
+        if (r == 0) {
+                if ((size_t) view.len >= self->size)
+                        r = write_all(self->fd, view.buf, view.len);
+                else if (view.len > 0) {
+                        if (self->len == 0) {
+                                self->first_write = now_usec();
+                                r = stream_ensure_flusher(self);
+                                pthread_cond_signal(&self->cond);
+                        }
+
+                        memcpy(self->buf + self->len, view.buf, view.len);
+                        self->len += view.len;
+                }
+        }
+
+        pthread_mutex_unlock(&self->mutex);
+        Py_END_ALLOW_THREADS
+
+        PyBuffer_Release(&view);
+
+        if (set_error(r, NULL, NULL) < 0)
                 return NULL;
 
-        if (PyModule_AddStringConstant(m, "__version__", PACKAGE_VERSION)) {
-                Py_DECREF(m);
+        return PyLong_FromSsize_t(ret);
+}
+
+PyDoc_STRVAR(JournalStream_writelines__doc__,
+             "writelines(lines) -> None\n\n"
+             "Write an iterable of bytes-like objects or strings.");
+static PyObject* JournalStream_writelines(JournalStream *self, PyObject *lines) {
+        _cleanup_Py_DECREF_ PyObject *iter = NULL;
+        PyObject *item;
+
+        iter = PyObject_GetIter(lines);
+        if (!iter)
                 return NULL;
+
+        while ((item = PyIter_Next(iter))) {
+                PyObject *r = JournalStream_write(self, item);
+                Py_DECREF(item);
+                if (!r)
+                        return NULL;
+                Py_DECREF(r);
         }
+        if (PyErr_Occurred())
+                return NULL;
+
+        Py_RETURN_NONE;
+}
 
-        return m;
+PyDoc_STRVAR(JournalStream_flush__doc__,
+             "flush() -> None\n\n"
+             "Write out buffered data.");
+static PyObject* JournalStream_flush(JournalStream *self, PyObject *args) {
+        int r;
+
+        assert(!args);
+
+        if (stream_check_open(self) < 0 ||
+            set_error(stream_check_fork(self), NULL, NULL) < 0)
+                return NULL;
+
+        Py_BEGIN_ALLOW_THREADS
+        pthread_mutex_lock(&self->mutex);
+        r = self->fd < 0 ? -EBADF : stream_flush_locked(self);
+        if (r == 0)
+                r = -self->error;
+        self->error = 0;
+        pthread_mutex_unlock(&self->mutex);
+        Py_END_ALLOW_THREADS
+
+        if (set_error(r, NULL, NULL) < 0)
+                return NULL;
+
+        Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(JournalStream_close__doc__,
+             "close() -> None\n\n"
+             "Write out buffered data and close the stream.");
+static PyObject* JournalStream_close(JournalStream *self, PyObject *args) {
+        assert(!args);
+
+        if (set_error(stream_close(self), NULL, NULL) < 0)
+                return NULL;
+
+        Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(JournalStream_fileno__doc__,
+             "fileno() -> int\n\n"
+             "Return the underlying file descriptor. Data written to it directly\n"
+             "bypasses the buffer.");
+static PyObject* JournalStream_fileno(JournalStream *self, PyObject *args) {
+        assert(!args);
+
+        if (stream_check_open(self) < 0)
+                return NULL;
+
+        return PyLong_FromLong(self->fd);
+}
+
+static PyObject* JournalStream_writable(JournalStream *self, PyObject *args) {
+        assert(!args);
+
+        if (stream_check_open(self) < 0)
+                return NULL;
+
+        Py_RETURN_TRUE;
+}
+
+static PyObject* JournalStream___enter__(PyObject *self, PyObject *args) {
+        assert(!args);
+
+        Py_INCREF(self);
+        return self;
+}
+
+static PyObject* JournalStream___exit__(JournalStream *self, PyObject *const *args _unused_, Py_ssize_t nargs _unused_) {
+        return JournalStream_close(self, NULL);
+}
+
+PyDoc_STRVAR(JournalStream_closed__doc__,
+             "True iff the stream is closed.");
+static PyObject* JournalStream_get_closed(JournalStream *self, void *closure _unused_) {
+        return PyBool_FromLong(self->fd < 0);
+}
+
+static PyGetSetDef JournalStream_getsetters[] = {
+        { (char*) "closed", (getter) JournalStream_get_closed, NULL, (char*) JournalStream_closed__doc__, NULL },
+        {} /* Sentinel */
+};
+
+DISABLE_WARNING_CAST_FUNCTION_TYPE;
+static PyMethodDef JournalStream_methods[] = {
+        { "write",      (PyCFunction) JournalStream_write,      METH_O,        JournalStream_write__doc__      },
+        { "writelines", (PyCFunction) JournalStream_writelines, METH_O,        JournalStream_writelines__doc__ },
+        { "flush",      (PyCFunction) JournalStream_flush,      METH_NOARGS,   JournalStream_flush__doc__      },
+        { "close",      (PyCFunction) JournalStream_close,      METH_NOARGS,   JournalStream_close__doc__      },
+        { "fileno",     (PyCFunction) JournalStream_fileno,     METH_NOARGS,   JournalStream_fileno__doc__     },
+        { "writable",   (PyCFunction) JournalStream_writable,   METH_NOARGS,   NULL                            },
+        { "__enter__",  (PyCFunction) JournalStream___enter__,  METH_NOARGS,   NULL                            },
+        { "__exit__",   (PyCFunction) JournalStream___exit__,   METH_FASTCALL, NULL                            },
+        {} /* Sentinel */
+};
+REENABLE_WARNING;
+
+static PyType_Slot JournalStream_slots[] = {
+        { Py_tp_dealloc, JournalStream_dealloc        },
+        { Py_tp_doc,     (void*) JournalStream__doc__ },
+        { Py_tp_methods, JournalStream_methods        },
+        { Py_tp_getset,  JournalStream_getsetters     },
+        { Py_tp_init,    JournalStream_init           },
+        { Py_tp_new,     JournalStream_new            },
+        {}  /* Sentinel */
+};
+
+static PyType_Spec JournalStream_spec = {
+        .name = "_journal.JournalStream",
+        .basicsize = sizeof(JournalStream),
+        .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_IMMUTABLETYPE,
+        .slots = JournalStream_slots,
+};
+
+/* RateLimiter: per-key token buckets and sampling, used to shed repeated
+ * messages before any work is spent on encoding them. Keys are arbitrary
+ * hashable objects, kept in an open-addressing hash table which is only
+ * compacted in flush(), so entries never need to be deleted individually.
+ * Keys beyond max_keys share a single overflow bucket. All state is
+ * protected by the GIL, or by the object lock in the free-threaded build. */
+
+typedef struct {
+        PyObject *key;           /* NULL for unused slots */
+        Py_hash_t hash;
+        double tokens;
+        uint64_t updated;        /* CLOCK_MONOTONIC time in µs of the last refill */
+        uint64_t suppressed;     /* messages dropped since the last flush() */
+} RateBucket;
+
+typedef struct {
+        PyObject_HEAD
+        double rate, burst;      /* rate is in messages per second, 0 means unlimited */
+        uint64_t sample;         /* messages pass if a random number is below this */
+        uint64_t interval;       /* minimum time between summaries in µs */
+        uint64_t next_summary;
+        uint64_t random_state;
+        uint64_t total_suppressed;
+        uint64_t pending;        /* messages dropped since the last summary */
+        uint64_t generation;     /* changed whenever a key is added or removed */
+        RateBucket *buckets;
+        size_t n_buckets, n_used, max_keys;
+        RateBucket overflow;
+        ObjectLock lock;
+} RateLimiter;
+
+static uint64_t ratelimiter_random(RateLimiter *self) {
+        /* xorshift64* */
+        uint64_t x = self->random_state;
+
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        self->random_state = x;
+        return x * UINT64_C(0x2545F4914F6CDD1D);
+}
+
+static void ratelimiter_refill(RateLimiter *self, RateBucket *b, uint64_t now) {
+        if (now <= b->updated)
+                return;
+
+        b->tokens += (double) (now - b->updated) * self->rate / 1e6;
+        if (b->tokens > self->burst)
+                b->tokens = self->burst;
+        b->updated = now;
+}
+
+/* Inserts a bucket into a table which is known not to contain it. */
+static RateBucket* ratelimiter_insert(RateBucket *buckets, size_t n_buckets, Py_hash_t hash) {
+        size_t i;
+
+        for (i = (size_t) hash & (n_buckets - 1); buckets[i].key; i = (i + 1) & (n_buckets - 1))
+                ;
+        return buckets + i;
+}
+
+/* Moves all buckets which pass the filter into a new table with n_buckets
+ * slots, and drops the others. */
+static int ratelimiter_rehash(RateLimiter *self, size_t n_buckets, bool drop_idle, uint64_t now) {
+        RateBucket *buckets;
+
+        buckets = calloc(n_buckets, sizeof(RateBucket));
+        if (!buckets)
+                return -ENOMEM;
+
+        self->n_used = 0;
+        for (size_t i = 0; i < self->n_buckets; i++) {
+                RateBucket *b = self->buckets + i;
+
+                if (!b->key)
+                        continue;
+
+                if (drop_idle && b->suppressed == 0) {
+                        ratelimiter_refill(self, b, now);
+                        if (b->tokens >= self->burst) {
+                                Py_DECREF(b->key);
+                                continue;
+                        }
+                }
+
+                *ratelimiter_insert(buckets, n_buckets, b->hash) = *b;
+                self->n_used++;
+        }
+
+        free(self->buckets);
+        self->buckets = buckets;
+        self->n_buckets = n_buckets;
+        self->generation++;
+        return 0;
+}
+
+/* Returns the bucket for key, creating it if necessary, or NULL with an
+ * exception set. */
+static RateBucket* ratelimiter_find(RateLimiter *self, PyObject *key, uint64_t now) {
+        Py_hash_t hash;
+        size_t i;
+        RateBucket *b;
+
+        hash = PyObject_Hash(key);
+        if (hash == -1)
+                return NULL;
+
+restart:
+        for (i = (size_t) hash & (self->n_buckets - 1);
+             self->buckets[i].key;
+             i = (i + 1) & (self->n_buckets - 1)) {
+                uint64_t generation = self->generation;
+                PyObject *other;
+                int r;
+
+                b = self->buckets + i;
+                if (b->hash != hash)
+                        continue;
+                if (b->key == key)
+                        return b;
+
+                /* __eq__ may run arbitrary code, which might also use this
+                 * rate limiter, so the table has to be looked at again if it
+                 * was modified in the meantime. */
+                other = b->key;
+                Py_INCREF(other);
+                r = PyObject_RichCompareBool(other, key, Py_EQ);
+                Py_DECREF(other);
+                if (r < 0)
+                        return NULL;
+                if (self->generation != generation)
+                        goto restart;
+                if (r > 0)
+                        return b;
+        }
+
+        if (self->n_used >= self->max_keys)
+                return &self->overflow;
+
+        if ((self->n_used + 1) * 2 > self->n_buckets) {
+                int r;
+
+                r = ratelimiter_rehash(self, self->n_buckets * 2, false, now);
+                if (r < 0) {
+                        set_error(r, NULL, NULL);
+                        return NULL;
+                }
+                b = ratelimiter_insert(self->buckets, self->n_buckets, hash);
+        } else
+                b = self->buckets + i;
+
+        Py_INCREF(key);
+        *b = (RateBucket) {
+                .key = key,
+                .hash = hash,
+                .tokens = self->burst,
+                .updated = now,
+        };
+        self->n_used++;
+        self->generation++;
+        return b;
+}
+
+static void RateLimiter_dealloc(RateLimiter *self) {
+        PyTypeObject *type = Py_TYPE(self);
+
+        for (size_t i = 0; i < self->n_buckets; i++)
+                Py_XDECREF(self->buckets[i].key);
+        free(self->buckets);
+        type->tp_free((PyObject*)self);
+        Py_DECREF(type);
+}
+
+PyDoc_STRVAR(RateLimiter__doc__,
+             "RateLimiter(rate, burst=None, sample=1.0, interval=10.0, max_keys=4096) -> ...\n\n"
+             "Per-key rate limiting and sampling of messages.\n\n"
+             "Every key gets a token bucket which holds up to `burst` tokens (by default\n"
+             "`rate`, but at least 1) and is refilled with `rate` tokens per second.\n"
+             "Each message which is let through uses up one token. If `rate` is None,\n"
+             "messages are only sampled. Of the messages which are not rate limited,\n"
+             "each is passed on with probability `sample`.\n\n"
+             "The number of dropped messages is accumulated per key and returned by\n"
+             ".flush() at most once every `interval` seconds, so that it can be logged\n"
+             "as a summary. At most `max_keys` keys are tracked individually, further\n"
+             "keys share a single bucket, which is reported with the key None. Keys\n"
+             "which have not dropped any messages recently are forgotten in .flush().");
+static int RateLimiter_init(RateLimiter *self, PyObject *args, PyObject *keywds) {
+        PyObject *rate = Py_None, *burst = Py_None;
+        double sample = 1.0, interval = 10.0;
+        Py_ssize_t max_keys = 4096;
+        size_t n_buckets = 16;
+        LOCK_OBJECT(self);
+
+        static const char* const kwlist[] = {"rate", "burst", "sample", "interval", "max_keys", NULL};
+        if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|Oddn:__init__", (char**) kwlist,
+                                         &rate, &burst, &sample, &interval, &max_keys))
+                return -1;
+
+        if (self->buckets) {
+                PyErr_SetString(PyExc_RuntimeError, "RateLimiter is already initialized");
+                return -1;
+        }
+
+        if (rate == Py_None)
+                self->rate = 0;
+        else {
+                self->rate = PyFloat_AsDouble(rate);
+                if (self->rate == -1.0 && PyErr_Occurred())
+                        return -1;
+                if (!(self->rate > 0 && self->rate < 1e18)) {
+                        PyErr_SetString(PyExc_ValueError, "rate must be a positive number or None");
+                        return -1;
+                }
+        }
+
+        if (burst == Py_None)
+                self->burst = self->rate < 1 ? 1 : self->rate;
+        else {
+                self->burst = PyFloat_AsDouble(burst);
+                if (self->burst == -1.0 && PyErr_Occurred())
+                        return -1;
+                if (!(self->burst >= 1 && self->burst < 1e18)) {
+                        PyErr_SetString(PyExc_ValueError, "burst must be at least 1");
+                        return -1;
+                }
+        }
+
+        if (!(sample > 0 && sample <= 1)) {
+                PyErr_SetString(PyExc_ValueError, "sample must be in the range (0, 1]");
+                return -1;
+        }
+
+        if (!(interval >= 0 && interval < 1e12)) {
+                PyErr_SetString(PyExc_ValueError, "interval must not be negative");
+                return -1;
+        }
+
+        if (max_keys < 1) {
+                PyErr_SetString(PyExc_ValueError, "max_keys must be positive");
+                return -1;
+        }
+
+        self->buckets = calloc(n_buckets, sizeof(RateBucket));
+        if (!self->buckets) {
+                set_error(-ENOMEM, NULL, NULL);
+                return -1;
+        }
+
+        self->n_buckets = n_buckets;
+        self->max_keys = max_keys;
+        self->sample = sample >= 1 ? UINT64_MAX : (uint64_t) (sample * 0x1p64);
+        self->interval = interval * 1e6;
+        self->next_summary = now_usec() + self->interval;
+        self->random_state = (self->next_summary ^ ((uint64_t) getpid() << 32) ^ (uintptr_t) self) | 1;
+        self->overflow = (RateBucket) {
+                .tokens = self->burst,
+                .updated = now_usec(),
+        };
+        return 0;
+}
+
+PyDoc_STRVAR(RateLimiter_check__doc__,
+             "check(key) -> bool\n\n"
+             "Return True if a message with the given key may be sent, and False if\n"
+             "it should be dropped.");
+static PyObject* RateLimiter_check(RateLimiter *self, PyObject *key) {
+        RateBucket *b;
+        uint64_t now;
+        LOCK_OBJECT(self);
+
+        now = now_usec();
+        b = ratelimiter_find(self, key, now);
+        if (!b)
+                return NULL;
+
+        if (self->rate > 0) {
+                ratelimiter_refill(self, b, now);
+                if (b->tokens < 1)
+                        goto drop;
+        }
+
+        if (self->sample != UINT64_MAX && ratelimiter_random(self) >= self->sample)
+                goto drop;
+
+        if (self->rate > 0)
+                b->tokens -= 1;
+        Py_RETURN_TRUE;
+
+drop:
+        b->suppressed++;
+        self->total_suppressed++;
+        self->pending++;
+        Py_RETURN_FALSE;
+}
+
+static int ratelimiter_append_summary(PyObject *list, RateBucket *b) {
+        _cleanup_Py_DECREF_ PyObject *item = NULL;
+
+        if (b->suppressed == 0)
+                return 0;
+
+        item = Py_BuildValue("(OK)", b->key ?: Py_None, (unsigned long long) b->suppressed);
+        if (!item || PyList_Append(list, item) < 0)
+                return -1;
+
+        b->suppressed = 0;
+        return 0;
+}
+
+PyDoc_STRVAR(RateLimiter_flush__doc__,
+             "flush(force=False) -> list of (key, count)\n\n"
+             "Return the number of messages dropped for each key since the last\n"
+             "summary, and reset the counts. Unless `force` is true, an empty list is\n"
+             "returned if the last summary is more recent than `interval`.");
+static PyObject* RateLimiter_flush(RateLimiter *self, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+        _cleanup_Py_DECREF_ PyObject *list = NULL;
+        int force = false, r;
+        uint64_t now;
+        LOCK_OBJECT(self);
+
+        static const char* const kwlist[] = {"force", NULL};
+        if (!parse_fastcall(args, nargs, kwnames, "|p:flush", kwlist, &force))
+                return NULL;
+
+        list = PyList_New(0);
+        if (!list)
+                return NULL;
+
+        now = now_usec();
+        if (!force && now < self->next_summary)
+                goto finish;
+        self->next_summary = now + self->interval;
+        self->pending = 0;
+
+        for (size_t i = 0; i < self->n_buckets; i++)
+                if (self->buckets[i].key &&
+                    ratelimiter_append_summary(list, self->buckets + i) < 0)
+                        return NULL;
+        if (ratelimiter_append_summary(list, &self->overflow) < 0)
+                return NULL;
+
+        /* Forget keys which have been quiet for long enough to refill their bucket */
+        if (self->n_used * 2 >= self->max_keys) {
+                r = ratelimiter_rehash(self, self->n_buckets, true, now);
+                if (r < 0) {
+                        set_error(r, NULL, NULL);
+                        return NULL;
+                }
+        }
+
+finish:
+        Py_INCREF(list);
+        return list;
+}
+
+PyDoc_STRVAR(RateLimiter_suppressed__doc__,
+             "The total number of messages dropped by this rate limiter.");
+static PyObject* RateLimiter_get_suppressed(RateLimiter *self, void *closure _unused_) {
+        LOCK_OBJECT(self);
+
+        return PyLong_FromUnsignedLongLong(self->total_suppressed);
+}
+
+PyDoc_STRVAR(RateLimiter_keys__doc__,
+             "The number of keys which are currently tracked.");
+static PyObject* RateLimiter_get_keys(RateLimiter *self, void *closure _unused_) {
+        LOCK_OBJECT(self);
+
+        return PyLong_FromSize_t(self->n_used);
+}
+
+PyDoc_STRVAR(RateLimiter_pending__doc__,
+             "The number of dropped messages which .flush() would report now, or 0\n"
+             "if no summary is due yet. This is cheap to check before calling .flush().");
+static PyObject* RateLimiter_get_pending(RateLimiter *self, void *closure _unused_) {
+        LOCK_OBJECT(self);
+
+        if (self->pending == 0 || now_usec() < self->next_summary)
+                return PyLong_FromLong(0);
+
+        return PyLong_FromUnsignedLongLong(self->pending);
+}
+
+static PyGetSetDef RateLimiter_getsetters[] = {
+        { (char*) "suppressed", (getter) RateLimiter_get_suppressed, NULL, (char*) RateLimiter_suppressed__doc__, NULL },
+        { (char*) "keys",       (getter) RateLimiter_get_keys,       NULL, (char*) RateLimiter_keys__doc__,       NULL },
+        { (char*) "pending",    (getter) RateLimiter_get_pending,    NULL, (char*) RateLimiter_pending__doc__,    NULL },
+        {} /* Sentinel */
+};
+
+DISABLE_WARNING_CAST_FUNCTION_TYPE;
+static PyMethodDef RateLimiter_methods[] = {
+        { "check", (PyCFunction) RateLimiter_check, METH_O,                        RateLimiter_check__doc__ },
+        { "flush", (PyCFunction) RateLimiter_flush, METH_FASTCALL | METH_KEYWORDS, RateLimiter_flush__doc__ },
+        {} /* Sentinel */
+};
+REENABLE_WARNING;
+
+static PyType_Slot RateLimiter_slots[] = {
+        { Py_tp_dealloc, RateLimiter_dealloc        },
+        { Py_tp_doc,     (void*) RateLimiter__doc__ },
+        { Py_tp_methods, RateLimiter_methods        },
+        { Py_tp_getset,  RateLimiter_getsetters     },
+        { Py_tp_init,    RateLimiter_init           },
+        { Py_tp_new,     PyType_GenericNew          },
+        {}  /* Sentinel */
+};
+
+static PyType_Spec RateLimiter_spec = {
+        .name = "_journal.RateLimiter",
+        .basicsize = sizeof(RateLimiter),
+        .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_IMMUTABLETYPE,
+        .slots = RateLimiter_slots,
+};
+
+/* SharedLogRing: a bounded multi-producer queue of serialized entries in
+ * shared memory, based on Dmitry Vyukov's MPMC queue. Each slot carries a
+ * sequence number: a slot at position pos may be written when its sequence
+ * number is pos, and read when it is pos + 1. Producers reserve a position by
+ * advancing head, and the consumer releases a slot by setting its sequence
+ * number to pos + n_slots. The region is mapped MAP_SHARED before fork(), so
+ * the same queue is seen by the parent and all children.
+ *
+ * Unlike in the original queue, a producer reserves a slot by setting its
+ * claim word from (pos, 0) to (pos, pid) before advancing head, and producers
+ * which lose the race help to advance head. A slot which head has passed thus
+ * always names its writer, and can be skipped if that process died. */
+
+#define RING_BATCH 64
+
+/* How long the drainer thread waits before trying again when draining
+ * failed, e.g. because another process is draining the ring. */
+#define RING_RETRY_MIN_MSEC 10
+#define RING_RETRY_MAX_MSEC 1000
+
+/* pids are below 2^22 (PID_MAX_LIMIT) */
+#define RING_PID_BITS 22
+#define RING_PID_MASK ((UINT64_C(1) << RING_PID_BITS) - 1)
+#define RING_CLAIM(pos, pid) (((pos) << RING_PID_BITS) | (uint64_t) (pid))
+
+typedef struct {
+        uint64_t seq;
+        uint64_t claim;   /* position and pid of the writer, see RING_CLAIM() */
+        uint32_t len;
+        char data[];
+} RingSlot;
+
+typedef struct {
+        uint64_t head __attribute__((aligned(64)));
+        uint64_t tail __attribute__((aligned(64)));
+        pid_t consumer;   /* the process which is draining the ring, or 0 */
+        uint32_t sleeping;
+        uint64_t dropped;
+        uint64_t overflowed;
+        uint64_t n_slots;
+        uint64_t slot_size;
+} RingHeader;
+
+#define RING_HEADER_SIZE ((sizeof(RingHeader) + 63) & ~(size_t) 63)
+
+typedef struct {
+        PyObject_HEAD
+        RingHeader *header;
+        size_t map_size;
+        int event_fd;
+        int socket_fd;
+        int stop_fd;           /* wakes up the drainers in this process to stop them */
+        pid_t stop_pid;        /* the process which created stop_fd */
+        pid_t owner;           /* the process which created the ring */
+        pthread_t drainer;
+        pid_t drainer_pid;     /* the process running the drainer thread, or 0 */
+        unsigned draining;     /* the number of drain() calls running in this process */
+        bool stop;
+        bool closing;
+        char *identifier;      /* the default SYSLOG_IDENTIFIER= field */
+} SharedLogRing;
+
+static RingSlot* ring_slot(RingHeader *h, uint64_t pos) {
+        return (RingSlot*) ((char*) h + RING_HEADER_SIZE + (pos & (h->n_slots - 1)) * h->slot_size);
+}
+
+static void ring_wake(SharedLogRing *self) {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&self->header->sleeping, __ATOMIC_RELAXED))
+                (void) eventfd_write(self->event_fd, 1);
+}
+
+/* Returns 0 on success, -E2BIG if the entry does not fit into a slot, and
+ * -ENOBUFS if the ring is full. */
+static int ring_push(SharedLogRing *self, pid_t pid, const struct iovec *iov, size_t n) {
+        RingHeader *h = self->header;
+        RingSlot *slot;
+        ssize_t size;
+        uint64_t pos;
+
+        size = native_entry_size(iov, n);
+        if (size < 0)
+                return size;
+        if ((size_t) size > h->slot_size - offsetof(RingSlot, data))
+                return -E2BIG;
+
+        pos = __atomic_load_n(&h->head, __ATOMIC_RELAXED);
+        for (;;) {
+                uint64_t claim, expected;
+                int64_t diff;
+
+                slot = ring_slot(h, pos);
+                diff = (int64_t) (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+                if (diff < 0)
+                        return -ENOBUFS;
+                if (diff == 0) {
+                        claim = RING_CLAIM(pos, 0);
+                        if (__atomic_compare_exchange_n(&slot->claim, &claim, RING_CLAIM(pos, pid), false,
+                                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                                expected = pos;
+                                (void) __atomic_compare_exchange_n(&h->head, &expected, pos + 1, false,
+                                                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+                                break;
+                        }
+
+                        /* Another producer claimed the slot, help it advance head */
+                        if ((claim & ~RING_PID_MASK) == RING_CLAIM(pos, 0)) {
+                                expected = pos;
+                                (void) __atomic_compare_exchange_n(&h->head, &expected, pos + 1, false,
+                                                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+                        }
+                }
+                pos = __atomic_load_n(&h->head, __ATOMIC_RELAXED);
+        }
+
+        native_entry_write(iov, n, slot->data);
+        slot->len = size;
+        __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+        ring_wake(self);
+        return 0;
+}
+
+static void ring_release(RingHeader *h, uint64_t pos) {
+        RingSlot *slot = ring_slot(h, pos);
+
+        __atomic_store_n(&slot->claim, RING_CLAIM(pos + h->n_slots, 0), __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->seq, pos + h->n_slots, __ATOMIC_RELEASE);
+        __atomic_store_n(&h->tail, pos + 1, __ATOMIC_RELEASE);
+}
+
+/* Returns the number of committed entries at the tail of the ring, up to max.
+ * A slot which was reserved by a process that died before committing it is
+ * skipped, so that it does not block the ring forever. */
+static size_t ring_peek(RingHeader *h, RingSlot **slots, size_t max) {
+        uint64_t tail = __atomic_load_n(&h->tail, __ATOMIC_RELAXED);
+        size_t n = 0;
+
+        while (n < max) {
+                RingSlot *slot = ring_slot(h, tail + n);
+
+                if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == tail + n + 1) {
+                        slots[n++] = slot;
+                        continue;
+                }
+
+                if (n == 0 && __atomic_load_n(&h->head, __ATOMIC_ACQUIRE) != tail) {
+                        uint64_t claim = __atomic_load_n(&slot->claim, __ATOMIC_RELAXED);
+                        pid_t pid = claim & RING_PID_MASK;
+
+                        if ((claim & ~RING_PID_MASK) == RING_CLAIM(tail, 0) && pid > 0 &&
+                            kill(pid, 0) < 0 && errno == ESRCH) {
+                                __atomic_add_fetch(&h->dropped, 1, __ATOMIC_RELAXED);
+                                ring_release(h, tail++);
+                                continue;
+                        }
+                }
+
+                break;
+        }
+
+        return n;
+}
+
+static int ring_send_batch(SharedLogRing *self, RingSlot **slots, size_t n) {
+        struct mmsghdr msgs[RING_BATCH] = {};
+        struct iovec iov[RING_BATCH];
+        struct sockaddr_un un;
+        socklen_t len;
+        int r;
+
+        if (self->socket_fd < 0) {
+                self->socket_fd = socket(AF_UNIX, SOCK_DGRAM|SOCK_CLOEXEC, 0);
+                if (self->socket_fd < 0)
+                        return -errno;
+        }
+
+        journal_socket_address(&un, &len);
+        for (size_t i = 0; i < n; i++) {
+                iov[i].iov_base = slots[i]->data;
+                iov[i].iov_len = slots[i]->len;
+                msgs[i].msg_hdr.msg_name = &un;
+                msgs[i].msg_hdr.msg_namelen = len;
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        do
+                r = sendmmsg(self->socket_fd, msgs, n, MSG_NOSIGNAL);
+        while (r < 0 && errno == EINTR);
+        if (r >= 0)
+                return r;
+        if (errno != EMSGSIZE && errno != ENOBUFS)
+                return -errno;
+
+        /* The first entry is too large for a datagram, pass it in a memfd
+         * like journal_send_native() does. */
+        r = send_memfd(self->socket_fd, &un, len, slots[0]->data, slots[0]->len);
+        if (r < 0)
+                return r;
+
+        return 1;
+}
+
+/* Makes this process the consumer of the ring. The lock is taken over if the
+ * process holding it died without releasing it. */
+static int ring_lock_consumer(RingHeader *h) {
+        pid_t pid = getpid(), owner = 0;
+
+        while (!__atomic_compare_exchange_n(&h->consumer, &owner, pid, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                if (owner == pid || kill(owner, 0) >= 0 || errno != ESRCH)
+                        return -EBUSY;
+
+        return 0;
+}
+
+static void ring_unlock_consumer(RingHeader *h) {
+        __atomic_store_n(&h->consumer, 0, __ATOMIC_RELEASE);
+}
+
+/* Forwards entries to the journal until the ring is empty, waiting up to
+ * timeout_usec (or forever if negative) for the first one to arrive. Must be
+ * called without the GIL. Returns the number of entries which were consumed. */
+static ssize_t ring_drain(SharedLogRing *self, int64_t timeout_usec) {
+        RingHeader *h = self->header;
+        ssize_t total = 0;
+        int r;
+
+        r = ring_lock_consumer(h);
+        if (r < 0)
+                return r;
+
+        for (;;) {
+                RingSlot *slots[RING_BATCH];
+                size_t n, consumed;
+
+                n = ring_peek(h, slots, RING_BATCH);
+                if (n == 0) {
+                        struct pollfd pfd[2] = {
+                                { .fd = self->event_fd, .events = POLLIN },
+                                { .fd = self->stop_fd,  .events = POLLIN },
+                        };
+                        eventfd_t v;
+
+                        if (total > 0 || timeout_usec == 0 || __atomic_load_n(&self->stop, __ATOMIC_RELAXED))
+                                break;
+
+                        /* Tell producers to wake us up, and check again, so that
+                         * an entry committed concurrently is not missed. */
+                        __atomic_store_n(&h->sleeping, 1, __ATOMIC_RELAXED);
+                        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+                        n = ring_peek(h, slots, RING_BATCH);
+                        if (n == 0)
+                                r = poll(pfd, 2, timeout_usec < 0 ? -1 : (int) ((timeout_usec + 999) / 1000));
+                        else
+                                r = 0;
+                        __atomic_store_n(&h->sleeping, 0, __ATOMIC_RELAXED);
+                        (void) eventfd_read(self->event_fd, &v);
+
+                        if (r < 0 && errno != EINTR) {
+                                r = -errno;
+                                ring_unlock_consumer(h);
+                                return r;
+                        }
+
+                        if (n == 0) {
+                                /* Only wait once. */
+                                timeout_usec = 0;
+                                continue;
+                        }
+                }
+
+                r = ring_send_batch(self, slots, n);
+                if (r >= 0)
+                        consumed = (size_t) r;
+                else {
+                        /* The first entry could not be sent. If the journal is not
+                         * there, nothing can be sent, otherwise skip this entry. */
+                        if (r == -ENOENT || r == -ECONNREFUSED || r == -ENOTCONN)
+                                consumed = n;
+                        else
+                                consumed = 1;
+                        __atomic_add_fetch(&h->dropped, consumed, __ATOMIC_RELAXED);
+                }
+
+                for (size_t i = 0; i < consumed; i++)
+                        ring_release(h, __atomic_load_n(&h->tail, __ATOMIC_RELAXED));
+                total += consumed;
+        }
+
+        ring_unlock_consumer(h);
+        return total;
+}
+
+static void* ring_drainer_thread(void *p) {
+        SharedLogRing *self = p;
+        int delay = 0;
+
+        while (!__atomic_load_n(&self->stop, __ATOMIC_RELAXED)) {
+                struct pollfd pfd = {
+                        .fd = self->stop_fd,
+                        .events = POLLIN,
+                };
+
+                if (ring_drain(self, -1) >= 0) {
+                        delay = 0;
+                        continue;
+                }
+
+                /* Another process is draining the ring, or waiting failed. Try
+                 * again later, so that the ring is taken over if the other
+                 * drainer dies. */
+                if (delay == 0)
+                        delay = RING_RETRY_MIN_MSEC;
+                else if (delay < RING_RETRY_MAX_MSEC / 2)
+                        delay *= 2;
+                else
+                        delay = RING_RETRY_MAX_MSEC;
+                (void) poll(&pfd, 1, delay);
+        }
+
+        return NULL;
+}
+
+/* The drainers of the parent do not run in a child after fork(), and the
+ * stop_fd inherited from it would wake them, so the child creates its own.
+ * Must be called with the GIL held. */
+static int ring_check_fork(SharedLogRing *self) {
+        int fd;
+
+        if (self->stop_pid == getpid())
+                return 0;
+
+        fd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+        if (fd < 0)
+                return -errno;
+
+        if (self->stop_fd >= 0)
+                close(self->stop_fd);
+        self->stop_fd = fd;
+        self->stop_pid = getpid();
+        self->draining = 0;
+        return 0;
+}
+
+/* Must be called with the GIL held, which is released while waiting for the
+ * thread to exit. */
+static void ring_stop_drainer(SharedLogRing *self) {
+        pthread_t drainer = self->drainer;
+        eventfd_t v;
+
+        if (self->drainer_pid != getpid())
+                return;
+        self->drainer_pid = 0;
+
+        Py_BEGIN_ALLOW_THREADS
+        __atomic_store_n(&self->stop, true, __ATOMIC_RELAXED);
+        (void) eventfd_write(self->stop_fd, 1);
+        (void) pthread_join(drainer, NULL);
+        Py_END_ALLOW_THREADS
+
+        (void) eventfd_read(self->stop_fd, &v);
+        __atomic_store_n(&self->stop, self->closing, __ATOMIC_RELAXED);
+}
+
+static void ring_close(SharedLogRing *self) {
+        bool drainer;
+
+        if (!self->header || self->closing)
+                return;
+        self->closing = true;
+
+        if (self->stop_pid != getpid())
+                self->draining = 0;
+
+        /* drain() in other threads uses the mapping and the eventfds, so wake
+         * them up and wait until they returned. */
+        __atomic_store_n(&self->stop, true, __ATOMIC_RELAXED);
+        while (self->draining > 0) {
+                Py_BEGIN_ALLOW_THREADS
+                (void) eventfd_write(self->stop_fd, 1);
+                (void) poll(NULL, 0, 1);
+                Py_END_ALLOW_THREADS
+        }
+
+        drainer = self->drainer_pid == getpid();
+        ring_stop_drainer(self);
+        if (drainer) {
+                __atomic_store_n(&self->stop, false, __ATOMIC_RELAXED);
+                Py_BEGIN_ALLOW_THREADS
+                (void) ring_drain(self, 0);
+                Py_END_ALLOW_THREADS
+        }
+
+        munmap(self->header, self->map_size);
+        self->header = NULL;
+        self->identifier = mfree(self->identifier);
+
+        if (self->event_fd >= 0)
+                close(self->event_fd);
+        self->event_fd = -1;
+        if (self->socket_fd >= 0)
+                close(self->socket_fd);
+        self->socket_fd = -1;
+        if (self->stop_fd >= 0)
+                close(self->stop_fd);
+        self->stop_fd = -1;
+}
+
+static void SharedLogRing_dealloc(SharedLogRing *self) {
+        PyTypeObject *type = Py_TYPE(self);
+
+        ring_close(self);
+        type->tp_free((PyObject*)self);
+        Py_DECREF(type);
+}
+
+static PyObject* SharedLogRing_new(PyTypeObject *type, PyObject *args _unused_, PyObject *kwds _unused_) {
+        SharedLogRing *self;
+
+        self = (SharedLogRing*) type->tp_alloc(type, 0);
+        if (!self)
+                return NULL;
+
+        self->event_fd = -1;
+        self->socket_fd = -1;
+        self->stop_fd = -1;
+        return (PyObject*) self;
+}
+
+PyDoc_STRVAR(SharedLogRing__doc__,
+             "SharedLogRing(slots=1024, slot_size=4096) -> ...\n\n"
+             "A queue of journal entries in memory shared between processes.\n\n"
+             "The ring should be created before forking worker processes. Workers\n"
+             "queue entries with .sendv() without making any system calls, and a\n"
+             "single drainer, either a native thread started with .start() in one\n"
+             "process, or a loop calling .drain(), forwards them to the journal in\n"
+             "batches using sendmmsg(2). Entries too large for a datagram are\n"
+             "passed in a memfd.\n\n"
+             "`slots` is the capacity of the ring, rounded up to a power of two, and\n"
+             "`slot_size` the maximum size of a serialized entry. Entries which are\n"
+             "too large, or which are sent when the ring is full, are sent directly\n"
+             "instead, like with journal.sendv().");
+static int SharedLogRing_init(SharedLogRing *self, PyObject *args, PyObject *keywds) {
+        unsigned long long slots = 1024, slot_size = 4096, n_slots = 1;
+        void *p;
+
+        static const char* const kwlist[] = {"slots", "slot_size", NULL};
+        if (!PyArg_ParseTupleAndKeywords(args, keywds, "|KK:__init__", (char**) kwlist,
+                                         &slots, &slot_size))
+                return -1;
+
+        if (self->header) {
+                PyErr_SetString(PyExc_RuntimeError, "SharedLogRing is already initialized");
+                return -1;
+        }
+
+        if (slots < 1 || slots > (1 << 20)) {
+                PyErr_SetString(PyExc_ValueError, "slots must be between 1 and 1048576");
+                return -1;
+        }
+        while (n_slots < slots)
+                n_slots <<= 1;
+
+        if (slot_size < 256 || slot_size > (1 << 20)) {
+                PyErr_SetString(PyExc_ValueError, "slot_size must be between 256 and 1048576");
+                return -1;
+        }
+        slot_size = (slot_size + 7) & ~7ULL;
+
+        self->map_size = RING_HEADER_SIZE + n_slots * slot_size;
+        p = mmap(NULL, self->map_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+                return set_error(-errno, NULL, NULL);
+
+        self->event_fd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+        if (self->event_fd < 0) {
+                int r = -errno;
+                munmap(p, self->map_size);
+                return set_error(r, NULL, NULL);
+        }
+
+        if (asprintf(&self->identifier, "SYSLOG_IDENTIFIER=%s", program_invocation_short_name) < 0) {
+                self->identifier = NULL;
+                munmap(p, self->map_size);
+                close(self->event_fd);
+                self->event_fd = -1;
+                return set_error(-ENOMEM, NULL, NULL);
+        }
+
+        self->header = p;
+        self->header->n_slots = n_slots;
+        self->header->slot_size = slot_size;
+        for (uint64_t i = 0; i < n_slots; i++) {
+                ring_slot(self->header, i)->seq = i;
+                ring_slot(self->header, i)->claim = RING_CLAIM(i, 0);
+        }
+        self->owner = getpid();
+
+        return 0;
+}
+
+static int ring_check_open(SharedLogRing *self) {
+        if (!self->header || self->closing) {
+                PyErr_SetString(PyExc_ValueError, "I/O operation on closed SharedLogRing");
+                return -1;
+        }
+        return 0;
+}
+
+static bool has_field(const struct iovec *iov, size_t n, const char *field) {
+        size_t len = strlen(field);
+
+        for (size_t i = 0; i < n; i++)
+                if (iov[i].iov_len > len &&
+                    memcmp(iov[i].iov_base, field, len) == 0 &&
+                    ((const char*) iov[i].iov_base)[len] == '=')
+                        return true;
+
+        return false;
+}
+
+PyDoc_STRVAR(SharedLogRing_sendv__doc__,
+             "sendv('FIELD=value', 'FIELD=value', ...) -> None\n\n"
+             "Queue an entry to be sent to the journal by the drainer.\n"
+             "The arguments are the same as for journal.sendv(). SYSLOG_PID= is\n"
+             "set to the pid of the calling process, unless specified.");
+static PyObject* SharedLogRing_sendv(SharedLogRing *self, PyObject *const *args, Py_ssize_t nargs) {
+        PyObject *ret = NULL;
+        char pid_field[32];
+        size_t n;
+        pid_t pid;
+        int r;
+
+        if (ring_check_open(self) < 0)
+                return NULL;
+
+        int argc = nargs;
+        PyObject **encoded = alloca0(argc * sizeof(PyObject*));
+        struct iovec *iov = alloca0((argc + 2) * sizeof(struct iovec));
+
+        if (fill_iovec(args, argc, iov, encoded) < 0)
+                goto out;
+
+        /* Like sd_journal_sendv(), add SYSLOG_IDENTIFIER= if not specified. */
+        n = argc;
+        if (!has_field(iov, argc, "SYSLOG_IDENTIFIER"))
+                iov[n++] = (struct iovec) {
+                        .iov_base = self->identifier,
+                        .iov_len = strlen(self->identifier),
+                };
+
+        /* The entry is sent by the drainer, so _PID= will be that of the
+         * drainer. Record the process which logged it. */
+        pid = getpid();
+        if (!has_field(iov, argc, "SYSLOG_PID"))
+                iov[n++] = (struct iovec) {
+                        .iov_base = pid_field,
+                        .iov_len = snprintf(pid_field, sizeof(pid_field), "SYSLOG_PID=%d", (int) pid),
+                };
+
+        r = ring_push(self, pid, iov, n);
+        if (r == -E2BIG || r == -ENOBUFS) {
+                __atomic_add_fetch(&self->header->overflowed, 1, __ATOMIC_RELAXED);
+                /* With the same SYSLOG_IDENTIFIER= and SYSLOG_PID= as queued entries */
+                r = journal_send(iov, n);
+        }
+        if (set_error(r, NULL, "Invalid field") < 0)
+                goto out;
+
+        Py_INCREF(Py_None);
+        ret = Py_None;
+
+out:
+        for (int i = 0; i < argc; i++)
+                Py_XDECREF(encoded[i]);
+
+        return ret;
+}
+
+PyDoc_STRVAR(SharedLogRing_drain__doc__,
+             "drain(timeout=0) -> int\n\n"
+             "Forward all queued entries to the journal, waiting up to `timeout`\n"
+             "microseconds for an entry if the ring is empty, or forever if `timeout`\n"
+             "is -1. Returns the number of entries consumed. Only one drainer may be\n"
+             "active at a time, OSError(EBUSY) is raised otherwise, unless the\n"
+             "process of the other drainer has died. .close() from another thread\n"
+             "makes it return early.");
+static PyObject* SharedLogRing_drain(SharedLogRing *self, PyObject *const *args, Py_ssize_t nargs) {
+        int64_t timeout = 0;
+        ssize_t r;
+
+        if (!parse_fastcall(args, nargs, NULL, "|L:drain", NULL, &timeout))
+                return NULL;
+
+        if (ring_check_open(self) < 0 ||
+            set_error(ring_check_fork(self), NULL, NULL) < 0)
+                return NULL;
+
+        self->draining++;
+        Py_BEGIN_ALLOW_THREADS
+        r = ring_drain(self, timeout);
+        Py_END_ALLOW_THREADS
+        self->draining--;
+
+        if (set_error(r, NULL, NULL) < 0)
+                return NULL;
+
+        return PyLong_FromSsize_t(r);
+}
+
+PyDoc_STRVAR(SharedLogRing_start__doc__,
+             "start() -> None\n\n"
+             "Start a native thread in this process which forwards entries to\n"
+             "the journal as they are queued. If another process is draining the\n"
+             "ring, the thread waits and takes over when that process dies.");
+static PyObject* SharedLogRing_start(SharedLogRing *self, PyObject *args) {
+        int r;
+
+        assert(!args);
+
+        if (ring_check_open(self) < 0)
+                return NULL;
+
+        if (self->drainer_pid == getpid()) {
+                PyErr_SetString(PyExc_RuntimeError, "drainer thread is already running");
+                return NULL;
+        }
+
+        if (set_error(ring_check_fork(self), NULL, NULL) < 0)
+                return NULL;
+
+        r = pthread_create(&self->drainer, NULL, ring_drainer_thread, self);
+        if (r != 0) {
+                set_error(-r, NULL, NULL);
+                return NULL;
+        }
+
+        self->drainer_pid = getpid();
+        Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(SharedLogRing_stop__doc__,
+             "stop() -> None\n\n"
+             "Stop the drainer thread started with .start().");
+static PyObject* SharedLogRing_stop(SharedLogRing *self, PyObject *args) {
+        assert(!args);
+
+        ring_stop_drainer(self);
+        Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(SharedLogRing_close__doc__,
+             "close() -> None\n\n"
+             "Stop the drainer thread if it is running in this process, forward\n"
+             "remaining entries, and unmap the ring.");
+static PyObject* SharedLogRing_close(SharedLogRing *self, PyObject *args) {
+        assert(!args);
+
+        ring_close(self);
+        Py_RETURN_NONE;
+}
+
+static PyObject* SharedLogRing___enter__(PyObject *self, PyObject *args) {
+        assert(!args);
+
+        Py_INCREF(self);
+        return self;
+}
+
+static PyObject* SharedLogRing___exit__(SharedLogRing *self, PyObject *const *args _unused_, Py_ssize_t nargs _unused_) {
+        return SharedLogRing_close(self, NULL);
+}
+
+PyDoc_STRVAR(SharedLogRing_pending__doc__,
+             "Number of entries queued but not yet forwarded.");
+static PyObject* SharedLogRing_get_pending(SharedLogRing *self, void *closure _unused_) {
+        if (ring_check_open(self) < 0)
+                return NULL;
+
+        return PyLong_FromUnsignedLongLong(__atomic_load_n(&self->header->head, __ATOMIC_RELAXED) -
+                                           __atomic_load_n(&self->header->tail, __ATOMIC_RELAXED));
+}
+
+PyDoc_STRVAR(SharedLogRing_dropped__doc__,
+             "Number of entries which could not be forwarded to the journal.");
+static PyObject* SharedLogRing_get_dropped(SharedLogRing *self, void *closure _unused_) {
+        if (ring_check_open(self) < 0)
+                return NULL;
+
+        return PyLong_FromUnsignedLongLong(__atomic_load_n(&self->header->dropped, __ATOMIC_RELAXED));
+}
+
+PyDoc_STRVAR(SharedLogRing_overflowed__doc__,
+             "Number of entries which were sent directly because they did not\n"
+             "fit into a slot or the ring was full.");
+static PyObject* SharedLogRing_get_overflowed(SharedLogRing *self, void *closure _unused_) {
+        if (ring_check_open(self) < 0)
+                return NULL;
+
+        return PyLong_FromUnsignedLongLong(__atomic_load_n(&self->header->overflowed, __ATOMIC_RELAXED));
+}
+
+PyDoc_STRVAR(SharedLogRing_closed__doc__,
+             "True iff the ring is closed in this process.");
+static PyObject* SharedLogRing_get_closed(SharedLogRing *self, void *closure _unused_) {
+        return PyBool_FromLong(!self->header);
+}
+
+static PyGetSetDef SharedLogRing_getsetters[] = {
+        { (char*) "pending",    (getter) SharedLogRing_get_pending,    NULL, (char*) SharedLogRing_pending__doc__,    NULL },
+        { (char*) "dropped",    (getter) SharedLogRing_get_dropped,    NULL, (char*) SharedLogRing_dropped__doc__,    NULL },
+        { (char*) "overflowed", (getter) SharedLogRing_get_overflowed, NULL, (char*) SharedLogRing_overflowed__doc__, NULL },
+        { (char*) "closed",     (getter) SharedLogRing_get_closed,     NULL, (char*) SharedLogRing_closed__doc__,     NULL },
+        {} /* Sentinel */
+};
+
+DISABLE_WARNING_CAST_FUNCTION_TYPE;
+static PyMethodDef SharedLogRing_methods[] = {
+        { "sendv",     (PyCFunction) SharedLogRing_sendv,     METH_FASTCALL, SharedLogRing_sendv__doc__ },
+        { "drain",     (PyCFunction) SharedLogRing_drain,     METH_FASTCALL, SharedLogRing_drain__doc__ },
+        { "start",     (PyCFunction) SharedLogRing_start,     METH_NOARGS,   SharedLogRing_start__doc__ },
+        { "stop",      (PyCFunction) SharedLogRing_stop,      METH_NOARGS,   SharedLogRing_stop__doc__  },
+        { "close",     (PyCFunction) SharedLogRing_close,     METH_NOARGS,   SharedLogRing_close__doc__ },
+        { "__enter__", (PyCFunction) SharedLogRing___enter__, METH_NOARGS,   NULL                       },
+        { "__exit__",  (PyCFunction) SharedLogRing___exit__,  METH_FASTCALL, NULL                       },
+        {} /* Sentinel */
+};
+REENABLE_WARNING;
+
+static PyType_Slot SharedLogRing_slots[] = {
+        { Py_tp_dealloc, SharedLogRing_dealloc        },
+        { Py_tp_doc,     (void*) SharedLogRing__doc__ },
+        { Py_tp_methods, SharedLogRing_methods        },
+        { Py_tp_getset,  SharedLogRing_getsetters     },
+        { Py_tp_init,    SharedLogRing_init           },
+        { Py_tp_new,     SharedLogRing_new            },
+        {}  /* Sentinel */
+};
+
+static PyType_Spec SharedLogRing_spec = {
+        .name = "_journal.SharedLogRing",
+        .basicsize = sizeof(SharedLogRing),
+        .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_IMMUTABLETYPE,
+        .slots = SharedLogRing_slots,
+};
+
+/* A stand-in for journald, for tests and benchmarks of the send path. A native
+ * thread receives entries in the native protocol on a datagram socket, also
+ * when they are passed in a memfd, validates them, and updates the counters, a
+ * latency histogram and the queue of kept entries under the mutex, so that it
+ * never needs the GIL. */
+
+#define SERVER_BUFFER_SIZE (1U << 20)
+#define SERVER_HISTOGRAM_BUCKETS 40
+
+typedef struct ServerEntry {
+        struct ServerEntry *next;
+        size_t size;
+        char data[];
+} ServerEntry;
+
+typedef struct {
+        PyObject_HEAD
+        int fd;
+        int event_fd;
+        char *path;              /* NULL iff closed */
+        char *dir;               /* the temporary directory containing path, if we created it */
+        char *timestamp_field;
+        char *buf;
+        bool bound;
+        pid_t owner;             /* the process in which the thread is running, or 0 */
+        pthread_t thread;
+        pthread_mutex_t mutex;   /* the mutex and cond are kept until dealloc */
+        pthread_cond_t cond;
+        bool sync;               /* the mutex and cond are initialized */
+        bool stopped;            /* set under the mutex by close(), to end wait() */
+        uint64_t entries, invalid, fields, ignored, bytes, memfds;
+        uint64_t latency[SERVER_HISTOGRAM_BUCKETS];  /* bucket i counts latencies below 2^i µs */
+        size_t keep, n_kept;
+        ServerEntry *first, *last;
+} JournalServer;
+
+typedef int (*server_field_t)(const char *name, size_t name_len,
+                              const char *value, size_t value_len, void *userdata);
+
+/* Parses an entry in the native protocol, calling field for each field with a
+ * valid name. Fields with invalid names are skipped and counted in ignored,
+ * like journald does. Returns the number of valid fields, -EBADMSG if the
+ * entry is malformed or has no valid fields, or the negative value returned
+ * by field. */
+static int server_parse(const char *p, size_t size, server_field_t field, void *userdata, unsigned *ignored) {
+        int n = 0, r;
+
+        while (size > 0) {
+                const char *nl = memchr(p, '\n', size), *eq, *value;
+                size_t name_len, value_len, consumed;
+
+                if (!nl)
+                        return -EBADMSG;
+
+                eq = memchr(p, '=', nl - p);
+                if (eq) {
+                        /* NAME=value\n */
+                        name_len = eq - p;
+                        value = eq + 1;
+                        value_len = nl - value;
+                        consumed = nl - p + 1;
+                } else {
+                        /* NAME\n, the length as little-endian 64-bit integer, value\n */
+                        uint64_t le;
+
+                        name_len = nl - p;
+                        if (size - name_len - 1 < sizeof(le))
+                                return -EBADMSG;
+                        memcpy(&le, nl + 1, sizeof(le));
+                        value_len = le64toh(le);
+                        value = nl + 1 + sizeof(le);
+                        if (value_len >= size - name_len - 1 - sizeof(le) || value[value_len] != '\n')
+                                return -EBADMSG;
+                        consumed = name_len + 1 + sizeof(le) + value_len + 1;
+                }
+
+                if (!valid_field_name(p, name_len)) {
+                        if (ignored)
+                                (*ignored)++;
+                } else {
+                        if (field) {
+                                r = field(p, name_len, value, value_len, userdata);
+                                if (r < 0)
+                                        return r;
+                        }
+                        n++;
+                }
+
+                p += consumed;
+                size -= consumed;
+        }
+
+        return n > 0 ? n : -EBADMSG;
+}
+
+typedef struct {
+        const char *name;
+        size_t name_len;
+        uint64_t value;
+} ServerTimestamp;
+
+static int server_find_timestamp(const char *name, size_t name_len,
+                                 const char *value, size_t value_len, void *userdata) {
+        ServerTimestamp *t = userdata;
+        uint64_t v = 0;
+
+        if (name_len != t->name_len || memcmp(name, t->name, name_len) != 0)
+                return 0;
+
+        for (size_t i = 0; i < value_len; i++) {
+                if (value[i] < '0' || value[i] > '9')
+                        return 0;
+                v = v * 10 + (value[i] - '0');
+        }
+        t->value = v;
+        return 0;
+}
+
+static void server_account(JournalServer *self, const char *data, size_t size, bool memfd, uint64_t now) {
+        ServerTimestamp t = {
+                .name = self->timestamp_field,
+                .name_len = self->timestamp_field ? strlen(self->timestamp_field) : 0,
+        };
+        ServerEntry *e = NULL;
+        unsigned ignored = 0;
+        int n;
+
+        n = server_parse(data, size, self->timestamp_field ? server_find_timestamp : NULL, &t, &ignored);
+        if (n > 0 && self->keep > 0) {
+                e = malloc(offsetof(ServerEntry, data) + size);
+                if (e) {
+                        e->next = NULL;
+                        e->size = size;
+                        memcpy(e->data, data, size);
+                }
+        }
+
+        pthread_mutex_lock(&self->mutex);
+        if (n < 0)
+                self->invalid++;
+        else {
+                self->entries++;
+                self->fields += n;
+                self->ignored += ignored;
+                self->bytes += size;
+                self->memfds += memfd;
+
+                if (t.value > 0) {
+                        uint64_t latency = now > t.value ? now - t.value : 0;
+                        unsigned i = 0;
+
+                        while (i < SERVER_HISTOGRAM_BUCKETS - 1 && latency >= (UINT64_C(1) << i))
+                                i++;
+                        self->latency[i]++;
+                }
+
+                if (e) {
+                        if (self->last)
+                                self->last->next = e;
+                        else
+                                self->first = e;
+                        self->last = e;
+
+                        if (++self->n_kept > self->keep) {
+                                e = self->first;
+                                self->first = e->next;
+                                self->n_kept--;
+                                free(e);
+                        }
+                }
+        }
+        pthread_cond_broadcast(&self->cond);
+        pthread_mutex_unlock(&self->mutex);
+}
+
+static void server_account_memfd(JournalServer *self, int fd, uint64_t now) {
+        const int required = F_SEAL_SHRINK|F_SEAL_GROW|F_SEAL_WRITE;
+        struct stat st;
+        void *p;
+        int seals;
+
+        /* Like journald, only accept memfds which cannot be modified anymore */
+        seals = fcntl(fd, F_GET_SEALS);
+        if (seals < 0 || (seals & required) != required ||
+            fstat(fd, &st) < 0 || st.st_size <= 0 ||
+            (p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+                server_account(self, NULL, 0, true, now);
+                return;
+        }
+
+        server_account(self, p, st.st_size, true, now);
+        munmap(p, st.st_size);
+}
+
+/* Receives and accounts one datagram. Returns -EAGAIN if there is none. */
+static int server_receive(JournalServer *self) {
+        union {
+                struct cmsghdr cmsghdr;
+                uint8_t buf[CMSG_SPACE(sizeof(int) * 8)];
+        } control;
+        struct iovec iov = {
+                .iov_base = self->buf,
+                .iov_len = SERVER_BUFFER_SIZE,
+        };
+        struct msghdr mh = {
+                .msg_iov = &iov,
+                .msg_iovlen = 1,
+                .msg_control = &control,
+                .msg_controllen = sizeof(control),
+        };
+        int memfd = -1, n_fds = 0;
+        uint64_t now;
+        ssize_t n;
+
+        n = recvmsg(self->fd, &mh, MSG_DONTWAIT|MSG_CMSG_CLOEXEC);
+        if (n < 0)
+                return -errno;
+        now = now_usec();
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&mh); cmsg; cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+                if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+                        continue;
+
+                for (size_t i = 0; i < (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int); i++) {
+                        int fd;
+
+                        memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                        if (n_fds++ == 0)
+                                memfd = fd;
+                        else
+                                close(fd);
+                }
+        }
+
+        /* An entry is either the datagram itself, or a single memfd with an empty datagram */
+        if ((mh.msg_flags & (MSG_TRUNC|MSG_CTRUNC)) || n_fds > 1 || (n_fds == 1 && n > 0))
+                server_account(self, NULL, 0, n_fds > 0, now);
+        else if (memfd >= 0)
+                server_account_memfd(self, memfd, now);
+        else
+                server_account(self, self->buf, n, false, now);
+
+        if (memfd >= 0)
+                close(memfd);
+        return 0;
+}
+
+static void* server_thread(void *p) {
+        JournalServer *self = p;
+
+        for (;;) {
+                struct pollfd pfd[] = {
+                        { .fd = self->fd,       .events = POLLIN },
+                        { .fd = self->event_fd, .events = POLLIN },
+                };
+
+                if (poll(pfd, 2, -1) < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        break;
+                }
+                if (pfd[1].revents)
+                        break;
+
+                while (server_receive(self) >= 0)
+                        ;
+        }
+
+        return NULL;
+}
+
+static void server_free_kept(ServerEntry *e) {
+        while (e) {
+                ServerEntry *next = e->next;
+
+                free(e);
+                e = next;
+        }
+}
+
+/* Stops the thread, removes the socket, and releases all resources except
+ * the mutex and cond, which wait() in other threads might still be using. After
+ * fork(), the thread and the socket belong to the parent, and are left alone. */
+static void server_close(JournalServer *self) {
+        bool owner = self->owner == getpid();
+
+        if (self->owner != 0) {
+                if (owner) {
+                        Py_BEGIN_ALLOW_THREADS
+                        (void) eventfd_write(self->event_fd, 1);
+                        (void) pthread_join(self->thread, NULL);
+
+                        pthread_mutex_lock(&self->mutex);
+                        self->stopped = true;
+                        pthread_cond_broadcast(&self->cond);
+                        pthread_mutex_unlock(&self->mutex);
+                        Py_END_ALLOW_THREADS
+                } else
+                        /* The mutex might have been held by the parent's thread */
+                        self->stopped = true;
+                self->owner = 0;
+        }
+
+        if (self->bound && owner)
+                (void) unlink(self->path);
+        self->bound = false;
+        if (self->dir && owner)
+                (void) rmdir(self->dir);
+
+        if (self->fd >= 0)
+                close(self->fd);
+        self->fd = -1;
+        if (self->event_fd >= 0)
+                close(self->event_fd);
+        self->event_fd = -1;
+
+        server_free_kept(self->first);
+        self->first = self->last = NULL;
+        self->n_kept = 0;
+        self->path = mfree(self->path);
+        self->dir = mfree(self->dir);
+        self->timestamp_field = mfree(self->timestamp_field);
+        self->buf = mfree(self->buf);
+}
+
+static void JournalServer_dealloc(JournalServer *self) {
+        PyTypeObject *type = Py_TYPE(self);
+
+        server_close(self);
+        if (self->sync) {
+                pthread_cond_destroy(&self->cond);
+                pthread_mutex_destroy(&self->mutex);
+        }
+        type->tp_free((PyObject*)self);
+        Py_DECREF(type);
+}
+
+static PyObject* JournalServer_new(PyTypeObject *type, PyObject *args _unused_, PyObject *kwds _unused_) {
+        JournalServer *self;
+
+        self = (JournalServer*) type->tp_alloc(type, 0);
+        if (!self)
+                return NULL;
+
+        self->fd = -1;
+        self->event_fd = -1;
+        return (PyObject*) self;
+}
+
+static int server_open(JournalServer *self, const char *path) {
+        struct sockaddr_un un = {
+                .sun_family = AF_UNIX,
+        };
+        pthread_condattr_t attr;
+        int r, bufsize = 8 * 1024 * 1024;
+
+        if (path)
+                self->path = strdup(path);
+        else {
+                const char *tmp = getenv("TMPDIR");
+
+                if (asprintf(&self->dir, "%s/python-systemd.XXXXXX", tmp && *tmp ? tmp : "/tmp") < 0) {
+                        self->dir = NULL;
+                        return -ENOMEM;
+                }
+                if (!mkdtemp(self->dir)) {
+                        self->dir = mfree(self->dir);
+                        return -errno;
+                }
+                if (asprintf(&self->path, "%s/socket", self->dir) < 0)
+                        self->path = NULL;
+        }
+        if (!self->path)
+                return -ENOMEM;
+        if (strlen(self->path) >= sizeof(un.sun_path))
+                return -EINVAL;
+        strcpy(un.sun_path, self->path);
+
+        self->buf = malloc(SERVER_BUFFER_SIZE);
+        if (!self->buf)
+                return -ENOMEM;
+
+        self->event_fd = eventfd(0, EFD_CLOEXEC);
+        if (self->event_fd < 0)
+                return -errno;
+
+        self->fd = socket(AF_UNIX, SOCK_DGRAM|SOCK_CLOEXEC, 0);
+        if (self->fd < 0)
+                return -errno;
+
+        /* Make room for bursts, as far as net.core.rmem_max allows */
+        (void) setsockopt(self->fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+
+        if (bind(self->fd, (struct sockaddr*) &un, offsetof(struct sockaddr_un, sun_path) + strlen(un.sun_path) + 1) < 0)
+                return -errno;
+        self->bound = true;
+
+        if (!self->sync) {
+                r = pthread_mutex_init(&self->mutex, NULL);
+                if (r != 0)
+                        return -r;
+                r = pthread_condattr_init(&attr);
+                if (r == 0) {
+                        r = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+                        if (r == 0)
+                                r = pthread_cond_init(&self->cond, &attr);
+                        pthread_condattr_destroy(&attr);
+                }
+                if (r != 0) {
+                        pthread_mutex_destroy(&self->mutex);
+                        return -r;
+                }
+                self->sync = true;
+        }
+        self->stopped = false;
+
+        r = pthread_create(&self->thread, NULL, server_thread, self);
+        if (r != 0)
+                return -r;
+        self->owner = getpid();
+
+        return 0;
+}
+
+PyDoc_STRVAR(JournalServer__doc__,
+             "JournalServer(path=None, keep=0, timestamp_field=None) -> ...\n\n"
+             "A stand-in for journald for tests and benchmarks. Entries sent to the\n"
+             "datagram socket at .path in the native protocol, also in memfds, are\n"
+             "received and validated by a native thread. Like journald, fields with\n"
+             "invalid names are ignored. Point the module at it with\n"
+             "set_socket(server.path).\n\n"
+             "The socket is created at `path`, or in a new temporary directory if\n"
+             "`path` is None. The last `keep` entries are kept for .entries(). If\n"
+             "`timestamp_field` is given, it is expected to contain the\n"
+             "CLOCK_MONOTONIC time in microseconds at which the entry was sent, e.g.\n"
+             "time.monotonic_ns() // 1000, and the latency until the entry was\n"
+             "received is recorded, see .stats().");
+static int JournalServer_init(JournalServer *self, PyObject *args, PyObject *keywds) {
+        _cleanup_Py_DECREF_ PyObject *_path = NULL;
+        const char *timestamp_field = NULL;
+        Py_ssize_t keep = 0;
+        int r;
+
+        static const char* const kwlist[] = {"path", "keep", "timestamp_field", NULL};
+        if (!PyArg_ParseTupleAndKeywords(args, keywds, "|O&nz:__init__", (char**) kwlist,
+                                         Unicode_FSConverter, &_path, &keep, &timestamp_field))
+                return -1;
+
+        if (self->path) {
+                PyErr_SetString(PyExc_RuntimeError, "JournalServer is already initialized");
+                return -1;
+        }
+
+        if (keep < 0) {
+                PyErr_SetString(PyExc_ValueError, "keep must not be negative");
+                return -1;
+        }
+        self->keep = keep;
+
+        if (timestamp_field) {
+                if (!valid_field_name(timestamp_field, strlen(timestamp_field))) {
+                        PyErr_SetString(PyExc_ValueError, "Invalid timestamp field name");
+                        return -1;
+                }
+                self->timestamp_field = strdup(timestamp_field);
+                if (!self->timestamp_field)
+                        return set_error(-ENOMEM, NULL, NULL);
+        }
+
+        r = server_open(self, _path ? PyBytes_AS_STRING(_path) : NULL);
+        if (r < 0) {
+                server_close(self);
+                return set_error(r, _path ? PyBytes_AS_STRING(_path) : NULL, "Socket path is too long");
+        }
+
+        return 0;
+}
+
+static int server_check_open(JournalServer *self) {
+        if (!self->path) {
+                PyErr_SetString(PyExc_ValueError, "Operation on closed JournalServer");
+                return -1;
+        }
+        return 0;
+}
+
+PyDoc_STRVAR(JournalServer_wait__doc__,
+             "wait(count, timeout=None) -> bool\n\n"
+             "Wait until `count` entries, including invalid ones, were received since\n"
+             "the last .reset(), or for at most `timeout` seconds. Returns True iff\n"
+             "the count was reached, or False if the server was closed meanwhile.");
+static PyObject* JournalServer_wait(JournalServer *self, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+        PyObject *timeout_obj = Py_None;
+        unsigned long long count;
+        uint64_t deadline = UINT64_MAX;
+        bool done = false, stopped = false;
+
+        static const char* const kwlist[] = {"count", "timeout", NULL};
+        if (!parse_fastcall(args, nargs, kwnames, "K|O:wait", kwlist, &count, &timeout_obj))
+                return NULL;
+
+        if (server_check_open(self) < 0)
+                return NULL;
+
+        if (timeout_obj != Py_None) {
+                double timeout = PyFloat_AsDouble(timeout_obj);
+
+                if (timeout == -1.0 && PyErr_Occurred())
+                        return NULL;
+                deadline = now_usec() + (timeout > 0 ? (uint64_t) (timeout * 1e6) : 0);
+        }
+
+        /* Wait in slices, so that signal handlers can run in between */
+        for (;;) {
+                uint64_t until = now_usec() + 100 * 1000;
+                struct timespec ts;
+
+                if (until > deadline)
+                        until = deadline;
+                ts = (struct timespec) {
+                        .tv_sec = until / 1000000,
+                        .tv_nsec = (until % 1000000) * 1000,
+                };
+
+                /* close() might have run in another thread while we did not hold the GIL */
+                if (!self->path)
+                        break;
+
+                Py_BEGIN_ALLOW_THREADS
+                pthread_mutex_lock(&self->mutex);
+                while (!(done = self->entries + self->invalid >= count) &&
+                       !(stopped = self->stopped) &&
+                       pthread_cond_timedwait(&self->cond, &self->mutex, &ts) != ETIMEDOUT)
+                        ;
+                pthread_mutex_unlock(&self->mutex);
+                Py_END_ALLOW_THREADS
+
+                if (done || stopped || now_usec() >= deadline)
+                        break;
+                if (PyErr_CheckSignals() < 0)
+                        return NULL;
+        }
+
+        return PyBool_FromLong(done);
+}
+
+PyDoc_STRVAR(JournalServer_stats__doc__,
+             "stats() -> dict\n\n"
+             "Return the numbers of valid `entries`, `invalid` entries, valid `fields`,\n"
+             "`ignored` fields with invalid names, `bytes` in valid entries, and of\n"
+             "entries received in `memfds` since the last .reset(), and the `latency`\n"
+             "histogram as a dictionary, which maps the exclusive upper bound of each\n"
+             "non-empty bucket in microseconds to the number of entries.");
+static PyObject* JournalServer_stats(JournalServer *self, PyObject *args) {
+        uint64_t entries, invalid, fields, ignored, bytes, memfds, latency[SERVER_HISTOGRAM_BUCKETS];
+        _cleanup_Py_DECREF_ PyObject *histogram = NULL;
+
+        assert(!args);
+
+        if (server_check_open(self) < 0)
+                return NULL;
+
+        pthread_mutex_lock(&self->mutex);
+        entries = self->entries;
+        invalid = self->invalid;
+        fields = self->fields;
+        ignored = self->ignored;
+        bytes = self->bytes;
+        memfds = self->memfds;
+        memcpy(latency, self->latency, sizeof(latency));
+        pthread_mutex_unlock(&self->mutex);
+
+        histogram = PyDict_New();
+        if (!histogram)
+                return NULL;
+
+        for (unsigned i = 0; i < SERVER_HISTOGRAM_BUCKETS; i++) {
+                _cleanup_Py_DECREF_ PyObject *key = NULL, *value = NULL;
+
+                if (latency[i] == 0)
+                        continue;
+
+                key = PyLong_FromUnsignedLongLong(UINT64_C(1) << i);
+                value = PyLong_FromUnsignedLongLong(latency[i]);
+                if (!key || !value || PyDict_SetItem(histogram, key, value) < 0)
+                        return NULL;
+        }
+
+        return Py_BuildValue("{s:K,s:K,s:K,s:K,s:K,s:K,s:O}",
+                             "entries", (unsigned long long) entries,
+                             "invalid", (unsigned long long) invalid,
+                             "fields", (unsigned long long) fields,
+                             "ignored", (unsigned long long) ignored,
+                             "bytes", (unsigned long long) bytes,
+                             "memfds", (unsigned long long) memfds,
+                             "latency", histogram);
+}
+
+PyDoc_STRVAR(JournalServer_reset__doc__,
+             "reset() -> None\n\n"
+             "Reset the statistics and drop the kept entries.");
+static PyObject* JournalServer_reset(JournalServer *self, PyObject *args) {
+        ServerEntry *first;
+
+        assert(!args);
+
+        if (server_check_open(self) < 0)
+                return NULL;
+
+        pthread_mutex_lock(&self->mutex);
+        self->entries = self->invalid = self->fields = self->ignored = self->bytes = self->memfds = 0;
+        memset(self->latency, 0, sizeof(self->latency));
+        first = self->first;
+        self->first = self->last = NULL;
+        self->n_kept = 0;
+        pthread_mutex_unlock(&self->mutex);
+
+        server_free_kept(first);
+        Py_RETURN_NONE;
+}
+
+static int server_add_field(const char *name, size_t name_len,
+                            const char *value, size_t value_len, void *userdata) {
+        _cleanup_Py_DECREF_ PyObject *key = NULL, *v = NULL;
+        PyObject *dict = userdata, *old;
+
+        key = PyUnicode_FromStringAndSize(name, name_len);
+        v = PyBytes_FromStringAndSize(value, value_len);
+        if (!key || !v)
+                return -ENOMEM;
+
+        /* Like Reader, fields which occur more than once become lists */
+        old = PyDict_GetItemWithError(dict, key);
+        if (!old) {
+                if (PyErr_Occurred() || PyDict_SetItem(dict, key, v) < 0)
+                        return -ENOMEM;
+        } else if (PyList_CheckExact(old)) {
+                if (PyList_Append(old, v) < 0)
+                        return -ENOMEM;
+        } else {
+                _cleanup_Py_DECREF_ PyObject *list = PyList_New(2);
+
+                if (!list)
+                        return -ENOMEM;
+                Py_INCREF(old);
+                PyList_SET_ITEM(list, 0, old);
+                PyList_SET_ITEM(list, 1, v);
+                v = NULL;
+                if (PyDict_SetItem(dict, key, list) < 0)
+                        return -ENOMEM;
+        }
+
+        return 0;
+}
+
+PyDoc_STRVAR(JournalServer_entries__doc__,
+             "entries() -> list\n\n"
+             "Remove the kept entries and return them, oldest first, as dictionaries\n"
+             "mapping field names to bytes, or to lists of bytes for fields which\n"
+             "occur more than once.");
+static PyObject* JournalServer_entries(JournalServer *self, PyObject *args) {
+        _cleanup_Py_DECREF_ PyObject *list = NULL;
+        ServerEntry *first;
+        PyObject *ret = NULL;
+
+        assert(!args);
+
+        if (server_check_open(self) < 0)
+                return NULL;
+
+        pthread_mutex_lock(&self->mutex);
+        first = self->first;
+        self->first = self->last = NULL;
+        self->n_kept = 0;
+        pthread_mutex_unlock(&self->mutex);
+
+        list = PyList_New(0);
+        if (!list)
+                goto finish;
+
+        for (ServerEntry *e = first; e; e = e->next) {
+                _cleanup_Py_DECREF_ PyObject *dict = PyDict_New();
+
+                if (!dict ||
+                    server_parse(e->data, e->size, server_add_field, dict, NULL) < 0 ||
+                    PyList_Append(list, dict) < 0)
+                        goto finish;
+        }
+
+        ret = list;
+        list = NULL;
+
+finish:
+        server_free_kept(first);
+        return ret;
+}
+
+PyDoc_STRVAR(JournalServer_close__doc__,
+             "close() -> None\n\n"
+             "Stop the thread and remove the socket, and the temporary directory\n"
+             "if it was created.");
+static PyObject* JournalServer_close(JournalServer *self, PyObject *args) {
+        assert(!args);
+
+        server_close(self);
+        Py_RETURN_NONE;
+}
+
+static PyObject* JournalServer___enter__(PyObject *self, PyObject *args) {
+        assert(!args);
+
+        Py_INCREF(self);
+        return self;
+}
+
+static PyObject* JournalServer___exit__(JournalServer *self, PyObject *const *args _unused_, Py_ssize_t nargs _unused_) {
+        return JournalServer_close(self, NULL);
+}
+
+PyDoc_STRVAR(JournalServer_path__doc__,
+             "The path of the socket, or None if the server is closed.");
+static PyObject* JournalServer_get_path(JournalServer *self, void *closure _unused_) {
+        if (!self->path)
+                Py_RETURN_NONE;
+
+        return PyUnicode_DecodeFSDefault(self->path);
+}
+
+PyDoc_STRVAR(JournalServer_closed__doc__,
+             "True iff the server is closed.");
+static PyObject* JournalServer_get_closed(JournalServer *self, void *closure _unused_) {
+        return PyBool_FromLong(!self->path);
+}
+
+static PyGetSetDef JournalServer_getsetters[] = {
+        { (char*) "path",   (getter) JournalServer_get_path,   NULL, (char*) JournalServer_path__doc__,   NULL },
+        { (char*) "closed", (getter) JournalServer_get_closed, NULL, (char*) JournalServer_closed__doc__, NULL },
+        {} /* Sentinel */
+};
+
+DISABLE_WARNING_CAST_FUNCTION_TYPE;
+static PyMethodDef JournalServer_methods[] = {
+        { "wait",      (PyCFunction) JournalServer_wait,      METH_FASTCALL | METH_KEYWORDS, JournalServer_wait__doc__    },
+        { "stats",     (PyCFunction) JournalServer_stats,     METH_NOARGS,                   JournalServer_stats__doc__   },
+        { "reset",     (PyCFunction) JournalServer_reset,     METH_NOARGS,                   JournalServer_reset__doc__   },
+        { "entries",   (PyCFunction) JournalServer_entries,   METH_NOARGS,                   JournalServer_entries__doc__ },
+        { "close",     (PyCFunction) JournalServer_close,     METH_NOARGS,                   JournalServer_close__doc__   },
+        { "__enter__", (PyCFunction) JournalServer___enter__, METH_NOARGS,                   NULL                         },
+        { "__exit__",  (PyCFunction) JournalServer___exit__,  METH_FASTCALL,                 NULL                         },
+        {} /* Sentinel */
+};
+REENABLE_WARNING;
+
+static PyType_Slot JournalServer_slots[] = {
+        { Py_tp_dealloc, JournalServer_dealloc        },
+        { Py_tp_doc,     (void*) JournalServer__doc__ },
+        { Py_tp_methods, JournalServer_methods        },
+        { Py_tp_getset,  JournalServer_getsetters     },
+        { Py_tp_init,    JournalServer_init           },
+        { Py_tp_new,     JournalServer_new            },
+        {}  /* Sentinel */
+};
+
+static PyType_Spec JournalServer_spec = {
+        .name = "_journal.JournalServer",
+        .basicsize = sizeof(JournalServer),
+        .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_IMMUTABLETYPE,
+        .slots = JournalServer_slots,
+};
+
+DISABLE_WARNING_CAST_FUNCTION_TYPE;
+static PyMethodDef methods[] = {
+        { "sendv",          (PyCFunction) journal_sendv,         METH_FASTCALL, journal_sendv__doc__         },
+        { "stream_fd",      (PyCFunction) journal_stream_fd,     METH_FASTCALL, journal_stream_fd__doc__     },
+        { "_encode_fields", (PyCFunction) journal_encode_fields, METH_FASTCALL, journal_encode_fields__doc__ },
+        { "set_socket",     (PyCFunction) journal_set_socket,    METH_FASTCALL, journal_set_socket__doc__    },
+        {}        /* Sentinel */
+};
+REENABLE_WARNING;
+
+typedef struct {
+        PyTypeObject *JournalStreamType;
+        PyTypeObject *RateLimiterType;
+        PyTypeObject *SharedLogRingType;
+        PyTypeObject *JournalServerType;
+} ModuleState;
+
+static int module_traverse(PyObject *m, visitproc visit, void *arg) {
+        ModuleState *state = PyModule_GetState(m);
+
+        Py_VISIT(state->JournalStreamType);
+        Py_VISIT(state->RateLimiterType);
+        Py_VISIT(state->SharedLogRingType);
+        Py_VISIT(state->JournalServerType);
+        return 0;
+}
+
+static int module_clear(PyObject *m) {
+        ModuleState *state = PyModule_GetState(m);
+
+        Py_CLEAR(state->JournalStreamType);
+        Py_CLEAR(state->RateLimiterType);
+        Py_CLEAR(state->SharedLogRingType);
+        Py_CLEAR(state->JournalServerType);
+        return 0;
+}
+
+static void module_free(void *m) {
+        module_clear(m);
+}
+
+static int module_exec(PyObject *m) {
+        static pthread_once_t journal_socket_once = PTHREAD_ONCE_INIT;
+        ModuleState *state = PyModule_GetState(m);
+
+        (void) pthread_once(&journal_socket_once, journal_socket_init_once);
+
+        if (PyModule_AddStringConstant(m, "__version__", PACKAGE_VERSION) ||
+            module_add_type(m, &JournalStream_spec, &state->JournalStreamType) < 0 ||
+            module_add_type(m, &RateLimiter_spec, &state->RateLimiterType) < 0 ||
+            module_add_type(m, &SharedLogRing_spec, &state->SharedLogRingType) < 0 ||
+            module_add_type(m, &JournalServer_spec, &state->JournalServerType) < 0)
+                return -1;
+
+        return 0;
+}
+
+/* SharedLogRing, JournalServer and the field encoding still rely on the GIL
+ * to serialize close() against the other methods. */
+static PyModuleDef_Slot module_slots[] = {
+        MODULE_SLOTS_WITH_GIL(module_exec),
+};
+
+static struct PyModuleDef module = {
+        PyModuleDef_HEAD_INIT,
+        .m_name = "_journal", /* name of module */
+        .m_size = sizeof(ModuleState), /* size of per-interpreter state of the module */
+        .m_methods = methods,
+        .m_slots = module_slots,
+        .m_traverse = module_traverse,
+        .m_clear = module_clear,
+        .m_free = module_free,
+};
+
+DISABLE_WARNING_MISSING_PROTOTYPES;
+PyMODINIT_FUNC PyInit__journal(void) {
+        return PyModuleDef_Init(&module);
 }
 REENABLE_WARNING;
@@ -8,11 +8,9 @@
 
 #include "pyutil.h"
 #include "macro.h"
+#include "probes.h"
 #include "strv.h"
 
-/* This needs to be below Python.h include for some reason */
-#include <datetime.h>
-
 #if defined(LIBSYSTEMD_VERSION) || LIBSYSTEMD_JOURNAL_VERSION > 204
 #  define HAVE_JOURNAL_OPEN_FILES 1
 #else
@@ -38,18 +36,73 @@
 #  define HAVE_JOURNAL_OPEN_DIRECTORY_FD 0
 #endif
 
+/* Counters returned by _Reader.stats(). They are only updated while
+ * collect_stats is set, so that the hot paths only test a flag otherwise. */
+typedef struct {
+        uint64_t visited;       /* entries moved over by next() and previous() */
+        uint64_t returned;      /* entries returned by _get_all() */
+        uint64_t fields;        /* fields extracted by _get() and _get_all() */
+        uint64_t bytes;         /* field data copied into Python objects */
+        uint64_t journal_ns;    /* time spent in sd_journal_*() calls with the GIL released */
+        uint64_t seeks;
+        uint64_t cursors;       /* cursors computed or tested */
+        uint64_t process[3];    /* results of process(): NOP, APPEND, INVALIDATE */
+} ReaderStats;
+
 typedef struct {
         PyObject_HEAD
         sd_journal *journal;
+        ObjectLock lock;
+        bool collect_stats;
+        ReaderStats stats;
 } Reader;
-static PyTypeObject ReaderType;
+
+static uint64_t now_nsec(void) {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Runs statement, a call into sd-journal, with the GIL released, and adds the
+ * time it took to the statistics if they are collected. */
+#define JOURNAL_CALL(self, statement)                                   \
+        do {                                                            \
+                bool _timed = (self)->collect_stats;                    \
+                uint64_t _ns = 0;                                       \
+                Py_BEGIN_ALLOW_THREADS                                  \
+                if (_timed)                                             \
+                        _ns = now_nsec();                               \
+                statement;                                              \
+                if (_timed)                                             \
+                        _ns = now_nsec() - _ns;                         \
+                Py_END_ALLOW_THREADS                                    \
+                if (_timed)                                             \
+                        (self)->stats.journal_ns += _ns;                \
+        } while (0)
+
+#define STATS_ADD(self, field, n)                                       \
+        do {                                                            \
+                if ((self)->collect_stats)                              \
+                        (self)->stats.field += (n);                     \
+        } while (0)
+
+typedef struct {
+        PyTypeObject *ReaderType;
+        PyTypeObject *MonotonicType;
+} ModuleState;
+
+static PyModuleDef module;
+
+DEFINE_PROBE(reader_next);
+DEFINE_PROBE(extract);
+DEFINE_PROBE(reader_get_all);
+DEFINE_PROBE(reader_wait);
 
 PyDoc_STRVAR(module__doc__,
              "Class to reads the systemd journal similar to journalctl.");
 
 
-static PyTypeObject MonotonicType;
-
 PyDoc_STRVAR(MonotonicType__doc__,
              "A tuple of (timestamp, bootid) for holding monotonic timestamps");
 
@@ -194,8 +247,11 @@ static int intlist_converter(PyObject* obj, int **_result, size_t *_len) {
 }
 
 static void Reader_dealloc(Reader* self) {
+        PyTypeObject *type = Py_TYPE(self);
+
         sd_journal_close(self->journal);
-        Py_TYPE(self)->tp_free((PyObject*)self);
+        type->tp_free((PyObject*)self);
+        Py_DECREF(type);
 }
 
 PyDoc_STRVAR(Reader__doc__,
@@ -218,18 +274,11 @@ PyDoc_STRVAR(Reader__doc__,
              "`files`, `directory_fd`, `namespace` are exclusive.\n\n"
              "_Reader implements the context manager protocol: the journal will be closed when\n"
              "exiting the block.");
-static int Reader_init(Reader *self, PyObject *args, PyObject *keywds) {
-        unsigned flags = SD_JOURNAL_LOCAL_ONLY;
-        PyObject *_path = NULL, *_files = NULL, *_namespace = NULL;
-        int r;
+static const char* const Reader_kwlist[] = {"flags", "path", "files", "namespace", NULL};
 
-        static const char* const kwlist[] = {"flags", "path", "files", "namespace", NULL};
-        if (!PyArg_ParseTupleAndKeywords(args, keywds, "|iO&O&O&:__init__", (char**) kwlist,
-                                         &flags,
-                                         null_converter, &_path,
-                                         null_converter, &_files,
-                                         null_converter, &_namespace))
-                return -1;
+static int reader_open(Reader *self, unsigned flags, PyObject *_path, PyObject *_files, PyObject *_namespace) {
+        int r;
+        LOCK_OBJECT(self);
 
         if (!!_path + !!_files > 1) {
                 PyErr_SetString(PyExc_ValueError,
@@ -318,6 +367,45 @@ static int Reader_init(Reader *self, PyObject *args, PyObject *keywds) {
         return set_error(r, NULL, "Opening the journal failed");
 }
 
+static int Reader_init(Reader *self, PyObject *args, PyObject *keywds) {
+        unsigned flags = SD_JOURNAL_LOCAL_ONLY;
+        PyObject *_path = NULL, *_files = NULL, *_namespace = NULL;
+
+        if (!PyArg_ParseTupleAndKeywords(args, keywds, "|iO&O&O&:__init__", (char**) Reader_kwlist,
+                                         &flags,
+                                         null_converter, &_path,
+                                         null_converter, &_files,
+                                         null_converter, &_namespace))
+                return -1;
+
+        return reader_open(self, flags, _path, _files, _namespace);
+}
+
+/* _Reader(...) without building argument tuples, and without the lookups of
+ * __new__ and __init__. Subclasses are created through tp_new and tp_init. */
+static PyObject* Reader_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames) {
+        unsigned flags = SD_JOURNAL_LOCAL_ONLY;
+        PyObject *_path = NULL, *_files = NULL, *_namespace = NULL;
+        _cleanup_Py_DECREF_ PyObject *self = NULL;
+
+        if (!parse_fastcall(args, PyVectorcall_NARGS(nargsf), kwnames, "|iO&O&O&:_Reader", Reader_kwlist,
+                            &flags,
+                            null_converter, &_path,
+                            null_converter, &_files,
+                            null_converter, &_namespace))
+                return NULL;
+
+        self = ((PyTypeObject*) type)->tp_alloc((PyTypeObject*) type, 0);
+        if (!self)
+                return NULL;
+
+        if (reader_open((Reader*) self, flags, _path, _files, _namespace) < 0)
+                return NULL;
+
+        Py_INCREF(self);
+        return self;
+}
+
 PyDoc_STRVAR(Reader_fileno__doc__,
              "fileno() -> int\n\n"
              "Get a file descriptor to poll for changes in the journal.\n"
@@ -328,6 +416,7 @@ PyDoc_STRVAR(Reader_fileno__doc__,
              "state of the file descriptor.");
 static PyObject* Reader_fileno(Reader *self, PyObject *args) {
         int fd;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
@@ -346,6 +435,7 @@ PyDoc_STRVAR(Reader_reliable_fd__doc__,
              "See :manpage:`sd_journal_reliable_fd(3)`.");
 static PyObject* Reader_reliable_fd(Reader *self, PyObject *args) {
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
@@ -363,6 +453,7 @@ PyDoc_STRVAR(Reader_get_events__doc__,
              "See :manpage:`sd_journal_get_events(3)` for further discussion.");
 static PyObject* Reader_get_events(Reader *self, PyObject *args) {
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
@@ -384,6 +475,7 @@ PyDoc_STRVAR(Reader_get_timeout__doc__,
 static PyObject* Reader_get_timeout(Reader *self, PyObject *args) {
         int r;
         uint64_t t;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
@@ -407,6 +499,7 @@ PyDoc_STRVAR(Reader_get_timeout_ms__doc__,
 static PyObject* Reader_get_timeout_ms(Reader *self, PyObject *args) {
         int r;
         uint64_t t;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
@@ -426,6 +519,7 @@ PyDoc_STRVAR(Reader_close__doc__,
 static PyObject* Reader_close(Reader *self, PyObject *args) {
         assert(self);
         assert(!args);
+        LOCK_OBJECT(self);
 
         sd_journal_close(self->journal);
         self->journal = NULL;
@@ -444,6 +538,7 @@ PyDoc_STRVAR(Reader_get_usage__doc__,
 static PyObject* Reader_get_usage(Reader *self, PyObject *args) {
         int r;
         uint64_t bytes;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
@@ -472,7 +567,7 @@ PyDoc_STRVAR(Reader___exit____doc__,
              "__exit__(type, value, traceback) -> None\n\n"
              "Part of the context manager protocol.\n"
              "Closes the journal.\n");
-static PyObject* Reader___exit__(Reader *self, PyObject *args _unused_) {
+static PyObject* Reader___exit__(Reader *self, PyObject *const *args _unused_, Py_ssize_t nargs _unused_) {
         assert(self);
 
         return Reader_close(self, NULL);
@@ -483,50 +578,59 @@ PyDoc_STRVAR(Reader_next__doc__,
              "Go to the next log entry. Optional skip value means to go to\n"
              "the `skip`\\-th log entry.\n"
              "Returns False if at end of file, True otherwise.");
-static PyObject* Reader_next(Reader *self, PyObject *args) {
-        int64_t skip = 1;
+static PyObject* reader_move(Reader *self, int64_t skip) {
         int r = -EUCLEAN;
+        uint64_t start;
+        LOCK_OBJECT(self);
 
         assert(self);
 
-        if (!PyArg_ParseTuple(args, "|L:next", &skip))
-                return NULL;
-
         if (skip == 0) {
                 PyErr_SetString(PyExc_ValueError, "skip must be nonzero");
                 return NULL;
         }
 
-        Py_BEGIN_ALLOW_THREADS
-        if (skip == 1)
-                r = sd_journal_next(self->journal);
-        else if (skip == -1)
-                r = sd_journal_previous(self->journal);
-        else if (skip > 1)
-                r = sd_journal_next_skip(self->journal, skip);
-        else if (skip < -1)
-                r = sd_journal_previous_skip(self->journal, -skip);
-        else
-                assert(!"should be here");
-        Py_END_ALLOW_THREADS
+        start = PROBE_START(reader_next);
+        JOURNAL_CALL(self,
+                     if (skip == 1)
+                             r = sd_journal_next(self->journal);
+                     else if (skip == -1)
+                             r = sd_journal_previous(self->journal);
+                     else if (skip > 1)
+                             r = sd_journal_next_skip(self->journal, skip);
+                     else if (skip < -1)
+                             r = sd_journal_previous_skip(self->journal, -skip);
+                     else
+                             assert(!"should be here"));
+        PROBE3(reader_next, skip, r, PROBE_ELAPSED(start));
 
         if (set_error(r, NULL, NULL) < 0)
                 return NULL;
+        STATS_ADD(self, visited, r);
         return PyBool_FromLong(r);
 }
 
+static PyObject* Reader_next(Reader *self, PyObject *const *args, Py_ssize_t nargs) {
+        int64_t skip = 1;
+
+        if (!parse_fastcall(args, nargs, NULL, "|L:next", NULL, &skip))
+                return NULL;
+
+        return reader_move(self, skip);
+}
+
 PyDoc_STRVAR(Reader_previous__doc__,
              "previous([skip]) -> bool\n\n"
              "Go to the previous log entry. Optional skip value means to \n"
              "go to the `skip`\\-th previous log entry.\n"
              "Returns False if at start of file, True otherwise.");
-static PyObject* Reader_previous(Reader *self, PyObject *args) {
-        int64_t skip = 1LL;
-        if (!PyArg_ParseTuple(args, "|L:previous", &skip))
+static PyObject* Reader_previous(Reader *self, PyObject *const *args, Py_ssize_t nargs) {
+        int64_t skip = 1;
+
+        if (!parse_fastcall(args, nargs, NULL, "|L:previous", NULL, &skip))
                 return NULL;
 
-        return PyObject_CallMethod((PyObject *)self, (char*) "_next",
-                                   (char*) "L", -skip);
+        return reader_move(self, -skip);
 }
 
 static int extract(const char* msg, size_t msg_len,
@@ -541,6 +645,8 @@ static int extract(const char* msg, size_t msg_len,
                 return -1;
         }
 
+        PROBE3(extract, msg, delim_ptr - msg, msg + msg_len - (delim_ptr + 1));
+
         if (key) {
                 k = PyUnicode_FromStringAndSize(msg, delim_ptr - (const char*) msg);
                 if (!k)
@@ -568,17 +674,17 @@ PyDoc_STRVAR(Reader_get__doc__,
              "get(str) -> str\n\n"
              "Return data associated with this key in current log entry.\n"
              "Throws KeyError is the data is not available.");
-static PyObject* Reader_get(Reader *self, PyObject *args) {
+static PyObject* Reader_get(Reader *self, PyObject *const *args, Py_ssize_t nargs) {
         const char* field;
         const void* msg;
         size_t msg_len;
         PyObject *value;
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
-        assert(args);
 
-        if (!PyArg_ParseTuple(args, "s:get", &field))
+        if (!parse_fastcall(args, nargs, NULL, "s:get", NULL, &field))
                 return NULL;
 
         r = sd_journal_get_data(self->journal, field, &msg, &msg_len);
@@ -592,6 +698,8 @@ static PyObject* Reader_get(Reader *self, PyObject *args) {
         r = extract(msg, msg_len, NULL, &value);
         if (r < 0)
                 return NULL;
+        STATS_ADD(self, fields, 1);
+        STATS_ADD(self, bytes, msg_len);
         return value;
 }
 
@@ -601,12 +709,16 @@ PyDoc_STRVAR(Reader_get_all__doc__,
 static PyObject* Reader_get_all(Reader *self, PyObject *args) {
         PyObject *dict;
         const void *msg;
-        size_t msg_len;
+        size_t msg_len, n_fields = 0, n_bytes = 0;
+        uint64_t start;
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
 
+        start = PROBE_START(reader_get_all);
+
         dict = PyDict_New();
         if (!dict)
                 return NULL;
@@ -617,6 +729,10 @@ static PyObject* Reader_get_all(Reader *self, PyObject *args) {
                 r = extract(msg, msg_len, &key, &value);
                 if (r < 0)
                         goto error;
+                STATS_ADD(self, fields, 1);
+                STATS_ADD(self, bytes, msg_len);
+                n_fields++;
+                n_bytes += msg_len;
 
                 if (PyDict_Contains(dict, key)) {
                         PyObject *cur_value = PyDict_GetItem(dict, key);
@@ -649,6 +765,8 @@ static PyObject* Reader_get_all(Reader *self, PyObject *args) {
                 }
         }
 
+        STATS_ADD(self, returned, 1);
+        PROBE3(reader_get_all, n_fields, n_bytes, PROBE_ELAPSED(start));
         return dict;
 
 error:
@@ -665,6 +783,7 @@ PyDoc_STRVAR(Reader_get_realtime__doc__,
 static PyObject* Reader_get_realtime(Reader *self, PyObject *args) {
         uint64_t timestamp;
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
@@ -684,14 +803,20 @@ PyDoc_STRVAR(Reader_get_monotonic__doc__,
              "Wraps sd_journal_get_monotonic_usec().\n"
              "See :manpage:`sd_journal_get_monotonic_usec(3)`.");
 static PyObject* Reader_get_monotonic(Reader *self, PyObject *args) {
+        ModuleState *state;
         uint64_t timestamp;
         sd_id128_t id;
         PyObject *monotonic, *bootid, *tuple;
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
 
+        state = get_module_state(Py_TYPE(self), &module);
+        if (!state)
+                return NULL;
+
         r = sd_journal_get_monotonic_usec(self->journal, &timestamp, &id);
         if (set_error(r, NULL, NULL) < 0)
                 return NULL;
@@ -699,7 +824,7 @@ static PyObject* Reader_get_monotonic(Reader *self, PyObject *args) {
         assert_cc(sizeof(unsigned long long) == sizeof(timestamp));
         monotonic = PyLong_FromUnsignedLongLong(timestamp);
         bootid = PyBytes_FromStringAndSize((const char*) &id.bytes, sizeof(id.bytes));
-        tuple = PyStructSequence_New(&MonotonicType);
+        tuple = PyStructSequence_New(state->MonotonicType);
         if (!monotonic || !bootid || !tuple) {
                 Py_XDECREF(monotonic);
                 Py_XDECREF(bootid);
@@ -719,12 +844,13 @@ PyDoc_STRVAR(Reader_add_match__doc__,
              "fields are combined with logical AND, and matches of the same field\n"
              "are automatically combined with logical OR.\n"
              "Match is a string of the form \"FIELD=value\".");
-static PyObject* Reader_add_match(Reader *self, PyObject *args) {
+static PyObject* Reader_add_match(Reader *self, PyObject *const *args, Py_ssize_t nargs) {
         char *match;
         Py_ssize_t match_len;
         int r;
+        LOCK_OBJECT(self);
 
-        if (!PyArg_ParseTuple(args, "s#:add_match", &match, &match_len))
+        if (!parse_fastcall(args, nargs, NULL, "s#:add_match", NULL, &match, &match_len))
                 return NULL;
 
         if (match_len > INT_MAX) {
@@ -747,6 +873,7 @@ PyDoc_STRVAR(Reader_add_disjunction__doc__,
              "See :manpage:`sd_journal_add_disjunction(3)` for explanation.");
 static PyObject* Reader_add_disjunction(Reader *self, PyObject *args) {
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
@@ -765,6 +892,7 @@ PyDoc_STRVAR(Reader_add_conjunction__doc__,
              "See :manpage:`sd_journal_add_disjunction(3)` for explanation.");
 static PyObject* Reader_add_conjunction(Reader *self, PyObject *args) {
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
@@ -781,6 +909,7 @@ PyDoc_STRVAR(Reader_flush_matches__doc__,
 static PyObject* Reader_flush_matches(Reader *self, PyObject *args) {
         assert(self);
         assert(!args);
+        LOCK_OBJECT(self);
 
         sd_journal_flush_matches(self->journal);
         Py_RETURN_NONE;
@@ -793,13 +922,13 @@ PyDoc_STRVAR(Reader_seek_head__doc__,
              "See :manpage:`sd_journal_seek_head(3)`.");
 static PyObject* Reader_seek_head(Reader *self, PyObject *args) {
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
 
-        Py_BEGIN_ALLOW_THREADS
-        r = sd_journal_seek_head(self->journal);
-        Py_END_ALLOW_THREADS
+        JOURNAL_CALL(self, r = sd_journal_seek_head(self->journal));
+        STATS_ADD(self, seeks, 1);
 
         if (set_error(r, NULL, NULL) < 0)
                 return NULL;
@@ -814,13 +943,13 @@ PyDoc_STRVAR(Reader_seek_tail__doc__,
              "See :manpage:`sd_journal_seek_tail(3)`.");
 static PyObject* Reader_seek_tail(Reader *self, PyObject *args) {
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
 
-        Py_BEGIN_ALLOW_THREADS
-        r = sd_journal_seek_tail(self->journal);
-        Py_END_ALLOW_THREADS
+        JOURNAL_CALL(self, r = sd_journal_seek_tail(self->journal));
+        STATS_ADD(self, seeks, 1);
 
         if (set_error(r, NULL, NULL) < 0)
                 return NULL;
@@ -831,18 +960,18 @@ PyDoc_STRVAR(Reader_seek_realtime__doc__,
              "seek_realtime(realtime) -> None\n\n"
              "Seek to nearest matching journal entry to `realtime`. Argument\n"
              "`realtime` in specified in seconds.");
-static PyObject* Reader_seek_realtime(Reader *self, PyObject *args) {
+static PyObject* Reader_seek_realtime(Reader *self, PyObject *const *args, Py_ssize_t nargs) {
         uint64_t timestamp;
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
 
-        if (!PyArg_ParseTuple(args, "K:seek_realtime", &timestamp))
+        if (!parse_fastcall(args, nargs, NULL, "K:seek_realtime", NULL, &timestamp))
                 return NULL;
 
-        Py_BEGIN_ALLOW_THREADS
-        r = sd_journal_seek_realtime_usec(self->journal, timestamp);
-        Py_END_ALLOW_THREADS
+        JOURNAL_CALL(self, r = sd_journal_seek_realtime_usec(self->journal, timestamp));
+        STATS_ADD(self, seeks, 1);
 
         if (set_error(r, NULL, NULL) < 0)
                 return NULL;
@@ -856,15 +985,16 @@ PyDoc_STRVAR(Reader_seek_monotonic__doc__,
              "`monotonic` is an timestamp from boot in microseconds.\n"
              "Argument `bootid` is a string representing which boot the\n"
              "monotonic time is reference to. Defaults to current bootid.");
-static PyObject* Reader_seek_monotonic(Reader *self, PyObject *args) {
+static PyObject* Reader_seek_monotonic(Reader *self, PyObject *const *args, Py_ssize_t nargs) {
         char *bootid = NULL;
         uint64_t timestamp;
         sd_id128_t id;
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
 
-        if (!PyArg_ParseTuple(args, "K|z:seek_monotonic", &timestamp, &bootid))
+        if (!parse_fastcall(args, nargs, NULL, "K|z:seek_monotonic", NULL, &timestamp, &bootid))
                 return NULL;
 
         if (bootid) {
@@ -880,9 +1010,8 @@ static PyObject* Reader_seek_monotonic(Reader *self, PyObject *args) {
                         return NULL;
         }
 
-        Py_BEGIN_ALLOW_THREADS
-        r = sd_journal_seek_monotonic_usec(self->journal, id, timestamp);
-        Py_END_ALLOW_THREADS
+        JOURNAL_CALL(self, r = sd_journal_seek_monotonic_usec(self->journal, id, timestamp));
+        STATS_ADD(self, seeks, 1);
 
         if (set_error(r, NULL, NULL) < 0)
                 return NULL;
@@ -899,6 +1028,7 @@ PyDoc_STRVAR(Reader_get_start__doc__,
 static PyObject* Reader_get_start(Reader *self, PyObject *args) {
         uint64_t start;
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
@@ -920,6 +1050,7 @@ PyDoc_STRVAR(Reader_get_end__doc__,
 static PyObject* Reader_get_end(Reader *self, PyObject *args) {
         uint64_t end;
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
@@ -943,14 +1074,15 @@ PyDoc_STRVAR(Reader_process__doc__,
              "See :manpage:`sd_journal_process(3)` for further discussion.");
 static PyObject* Reader_process(Reader *self, PyObject *args) {
         int r;
+        LOCK_OBJECT(self);
 
         assert(!args);
 
-        Py_BEGIN_ALLOW_THREADS
-        r = sd_journal_process(self->journal);
-        Py_END_ALLOW_THREADS
+        JOURNAL_CALL(self, r = sd_journal_process(self->journal));
         if (set_error(r, NULL, NULL) < 0)
                 return NULL;
+        if (r <= SD_JOURNAL_INVALIDATE)
+                STATS_ADD(self, process[r], 1);
 
         return PyLong_FromLong(r);
 }
@@ -965,16 +1097,20 @@ PyDoc_STRVAR(Reader_wait__doc__,
              "entries have been added to the end of the journal; and\n"
              "INVALIDATE if journal files have been added or removed.\n\n"
              "See :manpage:`sd_journal_wait(3)` for further discussion.");
-static PyObject* Reader_wait(Reader *self, PyObject *args) {
+static PyObject* Reader_wait(Reader *self, PyObject *const *args, Py_ssize_t nargs) {
         int r;
         int64_t timeout = -1;
+        uint64_t start;
+        LOCK_OBJECT(self);
 
-        if (!PyArg_ParseTuple(args, "|L:wait", &timeout))
+        if (!parse_fastcall(args, nargs, NULL, "|L:wait", NULL, &timeout))
                 return NULL;
 
+        start = PROBE_START(reader_wait);
         Py_BEGIN_ALLOW_THREADS
         r = sd_journal_wait(self->journal, timeout);
         Py_END_ALLOW_THREADS
+        PROBE3(reader_wait, timeout, r, PROBE_ELAPSED(start));
 
         if (set_error(r, NULL, NULL) < 0)
                 return NULL;
@@ -985,16 +1121,16 @@ static PyObject* Reader_wait(Reader *self, PyObject *args) {
 PyDoc_STRVAR(Reader_seek_cursor__doc__,
              "seek_cursor(cursor) -> None\n\n"
              "Seek to journal entry by given unique reference `cursor`.");
-static PyObject* Reader_seek_cursor(Reader *self, PyObject *args) {
+static PyObject* Reader_seek_cursor(Reader *self, PyObject *const *args, Py_ssize_t nargs) {
         const char *cursor;
         int r;
+        LOCK_OBJECT(self);
 
-        if (!PyArg_ParseTuple(args, "s:seek_cursor", &cursor))
+        if (!parse_fastcall(args, nargs, NULL, "s:seek_cursor", NULL, &cursor))
                 return NULL;
 
-        Py_BEGIN_ALLOW_THREADS
-        r = sd_journal_seek_cursor(self->journal, cursor);
-        Py_END_ALLOW_THREADS
+        JOURNAL_CALL(self, r = sd_journal_seek_cursor(self->journal, cursor));
+        STATS_ADD(self, seeks, 1);
 
         if (set_error(r, NULL, "Invalid cursor") < 0)
                 return NULL;
@@ -1009,6 +1145,7 @@ PyDoc_STRVAR(Reader_get_cursor__doc__,
 static PyObject* Reader_get_cursor(Reader *self, PyObject *args) {
         _cleanup_free_ char *cursor = NULL;
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
@@ -1016,6 +1153,7 @@ static PyObject* Reader_get_cursor(Reader *self, PyObject *args) {
         r = sd_journal_get_cursor(self->journal, &cursor);
         if (set_error(r, NULL, NULL) < 0)
                 return NULL;
+        STATS_ADD(self, cursors, 1);
 
         return PyUnicode_FromString(cursor);
 }
@@ -1024,19 +1162,20 @@ PyDoc_STRVAR(Reader_test_cursor__doc__,
              "test_cursor(str) -> bool\n\n"
              "Test whether the cursor string matches current journal entry.\n\n"
              "Wraps sd_journal_test_cursor(). See :manpage:`sd_journal_test_cursor(3)`.");
-static PyObject* Reader_test_cursor(Reader *self, PyObject *args) {
+static PyObject* Reader_test_cursor(Reader *self, PyObject *const *args, Py_ssize_t nargs) {
         const char *cursor;
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
-        assert(args);
 
-        if (!PyArg_ParseTuple(args, "s:test_cursor", &cursor))
+        if (!parse_fastcall(args, nargs, NULL, "s:test_cursor", NULL, &cursor))
                 return NULL;
 
         r = sd_journal_test_cursor(self->journal, cursor);
         if (set_error(r, NULL, NULL) < 0)
                 return NULL;
+        STATS_ADD(self, cursors, 1);
 
         return PyBool_FromLong(r);
 }
@@ -1046,20 +1185,19 @@ PyDoc_STRVAR(Reader_query_unique__doc__,
              "Return a set of unique values appearing in journal for the\n"
              "given `field`. Note this does not respect any journal matches.\n"
              "See sd_journal_query_unique(3).");
-static PyObject* Reader_query_unique(Reader *self, PyObject *args) {
+static PyObject* Reader_query_unique(Reader *self, PyObject *const *args, Py_ssize_t nargs) {
         char *query;
         int r;
         const void *uniq;
         size_t uniq_len;
         _cleanup_Py_DECREF_ PyObject *_value_set = NULL, *key = NULL;
         PyObject *value_set;
+        LOCK_OBJECT(self);
 
-        if (!PyArg_ParseTuple(args, "s:query_unique", &query))
+        if (!parse_fastcall(args, nargs, NULL, "s:query_unique", NULL, &query))
                 return NULL;
 
-        Py_BEGIN_ALLOW_THREADS
-        r = sd_journal_query_unique(self->journal, query);
-        Py_END_ALLOW_THREADS
+        JOURNAL_CALL(self, r = sd_journal_query_unique(self->journal, query));
 
         if (set_error(r, NULL, "Invalid field name") < 0)
                 return NULL;
@@ -1090,6 +1228,7 @@ static PyObject* Reader_query_unique(Reader *self, PyObject *args) {
 
                 if (PySet_Add(value_set, value) < 0)
                         return NULL;
+                STATS_ADD(self, bytes, uniq_len);
         }
 
         _value_set = NULL;
@@ -1103,6 +1242,7 @@ PyDoc_STRVAR(Reader_enumerate_fields__doc__,
 static PyObject* Reader_enumerate_fields(Reader *self, PyObject *args) {
         assert(self);
         assert(!args);
+        LOCK_OBJECT(self);
 
 #if HAVE_ENUMERATE_FIELDS
         _cleanup_Py_DECREF_ PyObject *_value_set = NULL;
@@ -1148,6 +1288,7 @@ PyDoc_STRVAR(Reader_has_runtime_files__doc__,
 static PyObject* Reader_has_runtime_files(Reader *self, PyObject *args) {
         assert(self);
         assert(!args);
+        LOCK_OBJECT(self);
 
 #if HAVE_ENUMERATE_FIELDS
         int r;
@@ -1172,6 +1313,7 @@ PyDoc_STRVAR(Reader_has_persistent_files__doc__,
 static PyObject* Reader_has_persistent_files(Reader *self, PyObject *args) {
         assert(self);
         assert(!args);
+        LOCK_OBJECT(self);
 
 #if HAVE_ENUMERATE_FIELDS
         int r;
@@ -1199,6 +1341,7 @@ PyDoc_STRVAR(Reader_get_catalog__doc__,
 static PyObject* Reader_get_catalog(Reader *self, PyObject *args) {
         int r;
         _cleanup_free_ char *msg = NULL;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
@@ -1234,15 +1377,13 @@ PyDoc_STRVAR(get_catalog__doc__,
              "get_catalog(id128) -> str\n\n"
              "Retrieve a message catalog entry for the given id.\n"
              "Wraps :manpage:`sd_journal_get_catalog_for_message_id(3)`.");
-static PyObject* get_catalog(PyObject *self _unused_, PyObject *args) {
+static PyObject* get_catalog(PyObject *self _unused_, PyObject *const *args, Py_ssize_t nargs) {
         int r;
         char *id_ = NULL;
         sd_id128_t id;
         _cleanup_free_ char *msg = NULL;
 
-        assert(args);
-
-        if (!PyArg_ParseTuple(args, "z:get_catalog", &id_))
+        if (!parse_fastcall(args, nargs, NULL, "z:get_catalog", NULL, &id_))
                 return NULL;
 
         r = sd_id128_from_string(id_, &id);
@@ -1259,6 +1400,56 @@ static PyObject* get_catalog(PyObject *self _unused_, PyObject *args) {
         return PyUnicode_FromString(msg);
 }
 
+PyDoc_STRVAR(Reader_stats__doc__,
+             "stats() -> dict\n\n"
+             "Return the statistics collected while `collect_stats` was set: the\n"
+             "number of entries `visited` by next() and previous(), entries\n"
+             "`returned` by _get_all(), `fields` extracted, field data `bytes`\n"
+             "copied into Python objects, nanoseconds spent in sd_journal calls\n"
+             "with the GIL released (`journal_ns`, not counting wait()), `seeks`,\n"
+             "`cursors` computed or tested, and a dictionary of `process` results,\n"
+             "keyed by NOP, APPEND and INVALIDATE.");
+static PyObject* Reader_stats(Reader *self, PyObject *args) {
+        ReaderStats stats;
+        _cleanup_Py_DECREF_ PyObject *process = NULL;
+        LOCK_OBJECT(self);
+
+        assert(self);
+        assert(!args);
+
+        stats = self->stats;
+
+        process = Py_BuildValue("{i:K,i:K,i:K}",
+                                SD_JOURNAL_NOP, (unsigned long long) stats.process[SD_JOURNAL_NOP],
+                                SD_JOURNAL_APPEND, (unsigned long long) stats.process[SD_JOURNAL_APPEND],
+                                SD_JOURNAL_INVALIDATE, (unsigned long long) stats.process[SD_JOURNAL_INVALIDATE]);
+        if (!process)
+                return NULL;
+
+        return Py_BuildValue("{s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:O}",
+                             "visited", (unsigned long long) stats.visited,
+                             "returned", (unsigned long long) stats.returned,
+                             "fields", (unsigned long long) stats.fields,
+                             "bytes", (unsigned long long) stats.bytes,
+                             "journal_ns", (unsigned long long) stats.journal_ns,
+                             "seeks", (unsigned long long) stats.seeks,
+                             "cursors", (unsigned long long) stats.cursors,
+                             "process", process);
+}
+
+PyDoc_STRVAR(Reader_reset_stats__doc__,
+             "reset_stats() -> None\n\n"
+             "Reset all statistics to zero.");
+static PyObject* Reader_reset_stats(Reader *self, PyObject *args) {
+        LOCK_OBJECT(self);
+
+        assert(self);
+        assert(!args);
+
+        memset(&self->stats, 0, sizeof(self->stats));
+        Py_RETURN_NONE;
+}
+
 PyDoc_STRVAR(data_threshold__doc__,
              "Threshold for field size truncation in bytes.\n\n"
              "Fields longer than this will be truncated to the threshold size.\n"
@@ -1267,6 +1458,7 @@ PyDoc_STRVAR(data_threshold__doc__,
 static PyObject* Reader_get_data_threshold(Reader *self, void *closure _unused_) {
         size_t cvalue;
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
 
@@ -1279,6 +1471,7 @@ static PyObject* Reader_get_data_threshold(Reader *self, void *closure _unused_)
 
 static int Reader_set_data_threshold(Reader *self, PyObject *value, void *closure _unused_) {
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
 
@@ -1300,10 +1493,40 @@ PyDoc_STRVAR(closed__doc__,
              "True iff journal is closed");
 static PyObject* Reader_get_closed(Reader *self, void *closure _unused_) {
         assert(self);
+        LOCK_OBJECT(self);
 
         return PyBool_FromLong(!self->journal);
 }
 
+PyDoc_STRVAR(collect_stats__doc__,
+             "Whether statistics are collected for stats().\n\n"
+             "Defaults to False, in which case the counters are not updated,\n"
+             "and keep their values.");
+static PyObject* Reader_get_collect_stats(Reader *self, void *closure _unused_) {
+        assert(self);
+
+        return PyBool_FromLong(self->collect_stats);
+}
+
+static int Reader_set_collect_stats(Reader *self, PyObject *value, void *closure _unused_) {
+        int r;
+        LOCK_OBJECT(self);
+
+        assert(self);
+
+        if (!value) {
+                PyErr_SetString(PyExc_AttributeError, "Cannot delete collect_stats");
+                return -1;
+        }
+
+        r = PyObject_IsTrue(value);
+        if (r < 0)
+                return -1;
+
+        self->collect_stats = r;
+        return 0;
+}
+
 static PyGetSetDef Reader_getsetters[] = {
         { (char*) "data_threshold",
           (getter) Reader_get_data_threshold,
@@ -1315,100 +1538,106 @@ static PyGetSetDef Reader_getsetters[] = {
           NULL,
           (char*) closed__doc__,
           NULL },
+        { (char*) "collect_stats",
+          (getter) Reader_get_collect_stats,
+          (setter) Reader_set_collect_stats,
+          (char*) collect_stats__doc__,
+          NULL },
         {} /* Sentinel */
 };
 
+DISABLE_WARNING_CAST_FUNCTION_TYPE;
 static PyMethodDef Reader_methods[] = {
-        { "fileno",               (PyCFunction) Reader_fileno,               METH_NOARGS,  Reader_fileno__doc__               },
-        { "reliable_fd",          (PyCFunction) Reader_reliable_fd,          METH_NOARGS,  Reader_reliable_fd__doc__          },
-        { "get_events",           (PyCFunction) Reader_get_events,           METH_NOARGS,  Reader_get_events__doc__           },
-        { "get_timeout",          (PyCFunction) Reader_get_timeout,          METH_NOARGS,  Reader_get_timeout__doc__          },
-        { "get_timeout_ms",       (PyCFunction) Reader_get_timeout_ms,       METH_NOARGS,  Reader_get_timeout_ms__doc__       },
-        { "close",                (PyCFunction) Reader_close,                METH_NOARGS,  Reader_close__doc__                },
-        { "get_usage",            (PyCFunction) Reader_get_usage,            METH_NOARGS,  Reader_get_usage__doc__            },
-        { "__enter__",            (PyCFunction) Reader___enter__,            METH_NOARGS,  Reader___enter____doc__            },
-        { "__exit__",             (PyCFunction) Reader___exit__,             METH_VARARGS, Reader___exit____doc__             },
-        { "_next",                (PyCFunction) Reader_next,                 METH_VARARGS, Reader_next__doc__                 },
-        { "_previous",            (PyCFunction) Reader_previous,             METH_VARARGS, Reader_previous__doc__             },
-        { "_get",                 (PyCFunction) Reader_get,                  METH_VARARGS, Reader_get__doc__                  },
-        { "_get_all",             (PyCFunction) Reader_get_all,              METH_NOARGS,  Reader_get_all__doc__              },
-        { "_get_realtime",        (PyCFunction) Reader_get_realtime,         METH_NOARGS,  Reader_get_realtime__doc__         },
-        { "_get_monotonic",       (PyCFunction) Reader_get_monotonic,        METH_NOARGS,  Reader_get_monotonic__doc__        },
-        { "add_match",            (PyCFunction) Reader_add_match,            METH_VARARGS, Reader_add_match__doc__            },
-        { "add_disjunction",      (PyCFunction) Reader_add_disjunction,      METH_NOARGS,  Reader_add_disjunction__doc__      },
-        { "add_conjunction",      (PyCFunction) Reader_add_conjunction,      METH_NOARGS,  Reader_add_conjunction__doc__      },
-        { "flush_matches",        (PyCFunction) Reader_flush_matches,        METH_NOARGS,  Reader_flush_matches__doc__        },
-        { "seek_head",            (PyCFunction) Reader_seek_head,            METH_NOARGS,  Reader_seek_head__doc__            },
-        { "seek_tail",            (PyCFunction) Reader_seek_tail,            METH_NOARGS,  Reader_seek_tail__doc__            },
-        { "seek_realtime",        (PyCFunction) Reader_seek_realtime,        METH_VARARGS, Reader_seek_realtime__doc__        },
-        { "seek_monotonic",       (PyCFunction) Reader_seek_monotonic,       METH_VARARGS, Reader_seek_monotonic__doc__       },
-        { "_get_start",           (PyCFunction) Reader_get_start,            METH_NOARGS,  Reader_get_start__doc__            },
-        { "_get_end",             (PyCFunction) Reader_get_end,              METH_NOARGS,  Reader_get_end__doc__              },
-        { "process",              (PyCFunction) Reader_process,              METH_NOARGS,  Reader_process__doc__              },
-        { "wait",                 (PyCFunction) Reader_wait,                 METH_VARARGS, Reader_wait__doc__                 },
-        { "seek_cursor",          (PyCFunction) Reader_seek_cursor,          METH_VARARGS, Reader_seek_cursor__doc__          },
-        { "_get_cursor",          (PyCFunction) Reader_get_cursor,           METH_NOARGS,  Reader_get_cursor__doc__           },
-        { "test_cursor",          (PyCFunction) Reader_test_cursor,          METH_VARARGS, Reader_test_cursor__doc__          },
-        { "query_unique",         (PyCFunction) Reader_query_unique,         METH_VARARGS, Reader_query_unique__doc__         },
-        { "enumerate_fields",     (PyCFunction) Reader_enumerate_fields,     METH_NOARGS,  Reader_enumerate_fields__doc__     },
-        { "has_runtime_files",    (PyCFunction) Reader_has_runtime_files,    METH_NOARGS,  Reader_has_runtime_files__doc__    },
-        { "has_persistent_files", (PyCFunction) Reader_has_persistent_files, METH_NOARGS,  Reader_has_persistent_files__doc__ },
-        { "get_catalog",          (PyCFunction) Reader_get_catalog,          METH_NOARGS,  Reader_get_catalog__doc__          },
+        { "fileno",               (PyCFunction) Reader_fileno,               METH_NOARGS,   Reader_fileno__doc__               },
+        { "reliable_fd",          (PyCFunction) Reader_reliable_fd,          METH_NOARGS,   Reader_reliable_fd__doc__          },
+        { "get_events",           (PyCFunction) Reader_get_events,           METH_NOARGS,   Reader_get_events__doc__           },
+        { "get_timeout",          (PyCFunction) Reader_get_timeout,          METH_NOARGS,   Reader_get_timeout__doc__          },
+        { "get_timeout_ms",       (PyCFunction) Reader_get_timeout_ms,       METH_NOARGS,   Reader_get_timeout_ms__doc__       },
+        { "close",                (PyCFunction) Reader_close,                METH_NOARGS,   Reader_close__doc__                },
+        { "get_usage",            (PyCFunction) Reader_get_usage,            METH_NOARGS,   Reader_get_usage__doc__            },
+        { "__enter__",            (PyCFunction) Reader___enter__,            METH_NOARGS,   Reader___enter____doc__            },
+        { "__exit__",             (PyCFunction) Reader___exit__,             METH_FASTCALL, Reader___exit____doc__             },
+        { "_next",                (PyCFunction) Reader_next,                 METH_FASTCALL, Reader_next__doc__                 },
+        { "_previous",            (PyCFunction) Reader_previous,             METH_FASTCALL, Reader_previous__doc__             },
+        { "_get",                 (PyCFunction) Reader_get,                  METH_FASTCALL, Reader_get__doc__                  },
+        { "_get_all",             (PyCFunction) Reader_get_all,              METH_NOARGS,   Reader_get_all__doc__              },
+        { "_get_realtime",        (PyCFunction) Reader_get_realtime,         METH_NOARGS,   Reader_get_realtime__doc__         },
+        { "_get_monotonic",       (PyCFunction) Reader_get_monotonic,        METH_NOARGS,   Reader_get_monotonic__doc__        },
+        { "add_match",            (PyCFunction) Reader_add_match,            METH_FASTCALL, Reader_add_match__doc__            },
+        { "add_disjunction",      (PyCFunction) Reader_add_disjunction,      METH_NOARGS,   Reader_add_disjunction__doc__      },
+        { "add_conjunction",      (PyCFunction) Reader_add_conjunction,      METH_NOARGS,   Reader_add_conjunction__doc__      },
+        { "flush_matches",        (PyCFunction) Reader_flush_matches,        METH_NOARGS,   Reader_flush_matches__doc__        },
+        { "seek_head",            (PyCFunction) Reader_seek_head,            METH_NOARGS,   Reader_seek_head__doc__            },
+        { "seek_tail",            (PyCFunction) Reader_seek_tail,            METH_NOARGS,   Reader_seek_tail__doc__            },
+        { "seek_realtime",        (PyCFunction) Reader_seek_realtime,        METH_FASTCALL, Reader_seek_realtime__doc__        },
+        { "seek_monotonic",       (PyCFunction) Reader_seek_monotonic,       METH_FASTCALL, Reader_seek_monotonic__doc__       },
+        { "_get_start",           (PyCFunction) Reader_get_start,            METH_NOARGS,   Reader_get_start__doc__            },
+        { "_get_end",             (PyCFunction) Reader_get_end,              METH_NOARGS,   Reader_get_end__doc__              },
+        { "process",              (PyCFunction) Reader_process,              METH_NOARGS,   Reader_process__doc__              },
+        { "wait",                 (PyCFunction) Reader_wait,                 METH_FASTCALL, Reader_wait__doc__                 },
+        { "seek_cursor",          (PyCFunction) Reader_seek_cursor,          METH_FASTCALL, Reader_seek_cursor__doc__          },
+        { "_get_cursor",          (PyCFunction) Reader_get_cursor,           METH_NOARGS,   Reader_get_cursor__doc__           },
+        { "test_cursor",          (PyCFunction) Reader_test_cursor,          METH_FASTCALL, Reader_test_cursor__doc__          },
+        { "query_unique",         (PyCFunction) Reader_query_unique,         METH_FASTCALL, Reader_query_unique__doc__         },
+        { "enumerate_fields",     (PyCFunction) Reader_enumerate_fields,     METH_NOARGS,   Reader_enumerate_fields__doc__     },
+        { "has_runtime_files",    (PyCFunction) Reader_has_runtime_files,    METH_NOARGS,   Reader_has_runtime_files__doc__    },
+        { "has_persistent_files", (PyCFunction) Reader_has_persistent_files, METH_NOARGS,   Reader_has_persistent_files__doc__ },
+        { "get_catalog",          (PyCFunction) Reader_get_catalog,          METH_NOARGS,   Reader_get_catalog__doc__          },
+        { "stats",                (PyCFunction) Reader_stats,                METH_NOARGS,   Reader_stats__doc__                },
+        { "reset_stats",          (PyCFunction) Reader_reset_stats,          METH_NOARGS,   Reader_reset_stats__doc__          },
         {}  /* Sentinel */
 };
+REENABLE_WARNING;
 
-static PyTypeObject ReaderType = {
-        PyVarObject_HEAD_INIT(NULL, 0)
-        .tp_name = "_reader._Reader",
-        .tp_basicsize = sizeof(Reader),
-        .tp_dealloc = (destructor) Reader_dealloc,
-        .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
-        .tp_doc = Reader__doc__,
-        .tp_methods = Reader_methods,
-        .tp_getset = Reader_getsetters,
-        .tp_init = (initproc) Reader_init,
-        .tp_new = PyType_GenericNew,
+static PyType_Slot Reader_slots[] = {
+        { Py_tp_dealloc, Reader_dealloc           },
+        { Py_tp_doc,     (void*) Reader__doc__    },
+        { Py_tp_methods, Reader_methods           },
+        { Py_tp_getset,  Reader_getsetters        },
+        { Py_tp_init,    Reader_init              },
+        { Py_tp_new,     PyType_GenericNew        },
+        {}  /* Sentinel */
 };
 
-static PyMethodDef methods[] = {
-        { "_get_catalog", get_catalog, METH_VARARGS, get_catalog__doc__ },
-        {} /* Sentinel */
+static PyType_Spec Reader_spec = {
+        .name = "_reader._Reader",
+        .basicsize = sizeof(Reader),
+        .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_IMMUTABLETYPE,
+        .slots = Reader_slots,
 };
 
-static PyModuleDef module = {
-        PyModuleDef_HEAD_INIT,
-        .m_name = "_reader",
-        .m_doc = module__doc__,
-        .m_size = -1,
-        .m_methods = methods,
+DISABLE_WARNING_CAST_FUNCTION_TYPE;
+static PyMethodDef methods[] = {
+        { "_get_catalog", (PyCFunction) get_catalog, METH_FASTCALL, get_catalog__doc__ },
+        {} /* Sentinel */
 };
-static bool initialized = false;
+REENABLE_WARNING;
 
-DISABLE_WARNING_MISSING_PROTOTYPES;
+static int module_traverse(PyObject *m, visitproc visit, void *arg) {
+        ModuleState *state = PyModule_GetState(m);
 
-PyMODINIT_FUNC
-PyInit__reader(void)
-{
-        PyObject* m;
+        Py_VISIT(state->ReaderType);
+        Py_VISIT(state->MonotonicType);
+        return 0;
+}
 
-        PyDateTime_IMPORT;
+static int module_clear(PyObject *m) {
+        ModuleState *state = PyModule_GetState(m);
 
-        if (PyType_Ready(&ReaderType) < 0)
-                return NULL;
+        Py_CLEAR(state->ReaderType);
+        Py_CLEAR(state->MonotonicType);
+        return 0;
+}
 
-        m = PyModule_Create(&module);
-        if (!m)
-                return NULL;
+static void module_free(void *m) {
+        module_clear(m);
+}
 
-        if (!initialized) {
-                PyStructSequence_InitType(&MonotonicType, &Monotonic_desc);
-                initialized = true;
-        }
+static int module_exec(PyObject *m) {
+        ModuleState *state = PyModule_GetState(m);
 
-        Py_INCREF(&ReaderType);
-        Py_INCREF(&MonotonicType);
-        if (PyModule_AddObject(m, "_Reader", (PyObject *) &ReaderType) ||
-            PyModule_AddObject(m, "Monotonic", (PyObject*) &MonotonicType) ||
+        if (module_add_type(m, &Reader_spec, &state->ReaderType) < 0 ||
+            module_add_struct_type(m, &Monotonic_desc, &state->MonotonicType) < 0 ||
             PyModule_AddIntConstant(m, "NOP", SD_JOURNAL_NOP) ||
             PyModule_AddIntConstant(m, "APPEND", SD_JOURNAL_APPEND) ||
             PyModule_AddIntConstant(m, "INVALIDATE", SD_JOURNAL_INVALIDATE) ||
@@ -1418,12 +1647,35 @@ PyInit__reader(void)
             PyModule_AddIntConstant(m, "SYSTEM_ONLY", SD_JOURNAL_SYSTEM) ||
             PyModule_AddIntConstant(m, "CURRENT_USER", SD_JOURNAL_CURRENT_USER) ||
             PyModule_AddIntConstant(m, "OS_ROOT", SD_JOURNAL_OS_ROOT) ||
-            PyModule_AddStringConstant(m, "__version__", PACKAGE_VERSION)) {
-                Py_DECREF(m);
-                return NULL;
-        }
+            PyModule_AddStringConstant(m, "__version__", PACKAGE_VERSION))
+                return -1;
+
+        state->ReaderType->tp_vectorcall = Reader_vectorcall;
+        return 0;
+}
+
+static PyModuleDef_Slot module_slots[] = {
+        MODULE_SLOTS(module_exec),
+};
+
+static PyModuleDef module = {
+        PyModuleDef_HEAD_INIT,
+        .m_name = "_reader",
+        .m_doc = module__doc__,
+        .m_size = sizeof(ModuleState),
+        .m_methods = methods,
+        .m_slots = module_slots,
+        .m_traverse = module_traverse,
+        .m_clear = module_clear,
+        .m_free = module_free,
+};
 
-        return m;
+DISABLE_WARNING_MISSING_PROTOTYPES;
+
+PyMODINIT_FUNC
+PyInit__reader(void)
+{
+        return PyModuleDef_Init(&module);
 }
 
 REENABLE_WARNING;
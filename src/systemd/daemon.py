@@ -1,10 +1,17 @@
 # SPDX-License-Identifier: LGPL-2.1-or-later
 
+import collections as _collections
+import fcntl as _fcntl
+import mmap as _mmap
+import os as _os
+import socket as _socket
+import time as _time
 from socket import AF_UNSPEC as _AF_UNSPEC
 
 from ._daemon import (__version__,
                       booted,
                       notify,
+                      _notify_barrier,
                       _listen_fds,
                       _listen_fds_with_names,
                       _is_fifo,
@@ -13,6 +20,11 @@ from ._daemon import (__version__,
                       _is_socket_sockaddr,
                       _is_socket_unix,
                       _is_mq,
+                      describe_fds,
+                      FdInfo,
+                      Notifier,
+                      StatusPublisher,
+                      Watchdog,
                       LISTEN_FDS_START)
 
 def _convert_fileobj(fileobj):
@@ -55,6 +67,32 @@ def is_mq(fileobj, path=None):
     fd = _convert_fileobj(fileobj)
     return _is_mq(fd, path)
 
+def notify_barrier(timeout=5.0, unset_environment=False, pid=0):
+    """Wait until the init system has processed all previously sent messages
+
+    `timeout` is the maximum time in seconds to wait, or None to wait forever.
+    TimeoutError is raised if it elapses. Returns False if no notification
+    socket is set. The GIL is released while waiting.
+
+    This makes sure that e.g. READY=1 was seen before the process continues
+    or exits::
+
+      notify('READY=1')
+      notify_barrier()
+
+    Wraps sd_notify_barrier(3).
+    """
+    us = -1 if timeout is None else int(timeout * 1000000)
+    return _notify_barrier(unset_environment, us, pid)
+
+async def notify_barrier_async(timeout=5.0, unset_environment=False, pid=0):
+    """Like `notify_barrier`, but wait in a thread of the default executor"""
+    import asyncio
+
+    loop = asyncio.get_running_loop()
+    return await loop.run_in_executor(
+        None, notify_barrier, timeout, unset_environment, pid)
+
 def listen_fds(unset_environment=True):
     """Return a list of socket activated descriptors
 
@@ -93,3 +131,426 @@ def listen_fds_with_names(unset_environment=True):
     for i in range(0, composite[0]):
         retval[i+LISTEN_FDS_START] = composite[1+i]
     return retval
+
+def activated_sockets(unset_environment=True, nonblocking=False):
+    """Return socket activated sockets as {name: [socket.socket, ...]}
+
+    Each socket passed by the service manager is wrapped in a socket.socket
+    object of the family, type and protocol reported by `describe_fds`, so
+    that it can be used just like a socket created by the program itself.
+    Descriptors which are not sockets (e.g. FIFOs) are skipped. Names are the
+    FileDescriptorName= of the socket unit, or "unknown" if none is set. If
+    `nonblocking` is true, the sockets are switched to non-blocking mode.
+
+    Example::
+
+      (in primary window)
+      $ systemd-socket-activate -l 2000 --fdname=http python3 -c \\
+          'from systemd.daemon import activated_sockets; print(activated_sockets())'
+      (in another window)
+      $ telnet localhost 2000
+      (in primary window)
+      ...
+      {'http': [<socket.socket fd=3, family=2, type=1, proto=6, laddr=('0.0.0.0', 2000)>]}
+    """
+    names = listen_fds_with_names(unset_environment)
+    result = {}
+    for info in describe_fds(sorted(names)):
+        if info.kind != 'socket':
+            continue
+        sock = _socket.socket(info.family, info.type, info.protocol, info.fd)
+        if nonblocking:
+            sock.setblocking(False)
+        result.setdefault(names[info.fd], []).append(sock)
+    return result
+
+async def serve_activated(protocol_factory, names=None, unset_environment=True,
+                          close_unused=False, **kwargs):
+    """Start asyncio servers on all socket activated listening sockets
+
+    For each listening stream socket returned by `activated_sockets`,
+    optionally limited to those whose name is in `names`, a server is created
+    with loop.create_server(protocol_factory, sock=..., **kwargs). Return a
+    tuple of the list of asyncio.Server objects, and a dict of all other
+    sockets like the one returned by `activated_sockets`, e.g. datagram
+    sockets or those with other names, to be used by the caller. The sockets
+    are in non-blocking mode. If `close_unused` is true, they are closed
+    instead, and the dict is empty.
+
+    Example::
+
+      async def main():
+          servers, unused = await serve_activated(MyProtocol, close_unused=True)
+          await asyncio.gather(*(s.serve_forever() for s in servers))
+    """
+    import asyncio
+
+    loop = asyncio.get_running_loop()
+    servers = []
+    unused = {}
+    for name, socks in activated_sockets(unset_environment, nonblocking=True).items():
+        for sock in socks:
+            if ((names is not None and name not in names) or
+                sock.type != _socket.SOCK_STREAM or
+                not sock.getsockopt(_socket.SOL_SOCKET, _socket.SO_ACCEPTCONN)):
+                if close_unused:
+                    sock.close()
+                else:
+                    unused.setdefault(name, []).append(sock)
+                continue
+            servers.append(await loop.create_server(protocol_factory, sock=sock, **kwargs))
+    return servers, unused
+
+class PreforkServer:
+    """A pool of forked worker processes serving socket activated sockets
+
+    `worker(index, sockets, ready)` is called in each of the `workers` child
+    processes (by default one per CPU), with `sockets` as returned by
+    `activated_sockets`, and must call `ready()` once it is able to serve.
+    When all workers are ready, READY=1 is sent to the service manager, and
+    STATUS= is kept up to date with the number of ready workers. Workers
+    which exit are restarted unless `respawn` is false. SIGTERM and SIGINT
+    stop all workers, and `run()` returns when no worker is left.
+
+    A worker which exits before calling `ready()` is restarted after
+    `restart_delay` seconds, doubled after each such exit of the same worker
+    up to `restart_delay_max`, and reset once it becomes ready. If workers are
+    restarted more than `restart_limit_burst` times within
+    `restart_limit_interval` seconds, all workers are stopped and `run()`
+    raises RuntimeError, so that the service manager can handle the failure.
+
+    By default, all workers accept connections from the inherited sockets.
+    With `reuseport=True`, every worker but the first binds its own
+    SO_REUSEPORT socket to the address of each listening inet socket, so that
+    the kernel balances connections between the per-worker accept queues.
+    This requires ReusePort=yes in the socket unit. With `incoming_cpu=True`,
+    each worker is additionally pinned to one CPU, and its sockets prefer
+    connections handled on this CPU (SO_INCOMING_CPU), where supported.
+
+    Example::
+
+      def worker(index, sockets, ready):
+          server = http.server.HTTPServer(('', 0), Handler, bind_and_activate=False)
+          server.socket = sockets['http'][0]
+          ready()
+          server.serve_forever()
+
+      PreforkServer(worker, reuseport=True).run()
+    """
+
+    def __init__(self, worker, workers=None, reuseport=False, incoming_cpu=False,
+                 respawn=True, unset_environment=True, restart_delay=0.1,
+                 restart_delay_max=10.0, restart_limit_burst=20,
+                 restart_limit_interval=10.0):
+        self.worker = worker
+        self.workers = workers or len(_os.sched_getaffinity(0))
+        self.reuseport = reuseport
+        self.incoming_cpu = incoming_cpu
+        self.respawn = respawn
+        self.restart_delay = restart_delay
+        self.restart_delay_max = restart_delay_max
+        self.restart_limit_burst = restart_limit_burst
+        self.restart_limit_interval = restart_limit_interval
+        self.sockets = activated_sockets(unset_environment)
+        self._cpus = sorted(_os.sched_getaffinity(0))
+        self._pids = {}
+        self._ready = set()
+        self._stopping = False
+        self._status = None
+        self._delays = {}        # index -> delay before the next restart
+        self._restarts = {}      # index -> time.monotonic() of the pending restart
+        self._restart_times = _collections.deque()
+        self._failure = None
+
+    def _worker_sockets(self, index):
+        if not self.reuseport and not self.incoming_cpu:
+            return self.sockets
+
+        cpu = self._cpus[index % len(self._cpus)] if self.incoming_cpu else None
+        if cpu is not None:
+            _os.sched_setaffinity(0, {cpu})
+
+        result = {}
+        for name, socks in self.sockets.items():
+            result[name] = []
+            for sock in socks:
+                if (self.reuseport and index > 0 and
+                    sock.family in (_socket.AF_INET, _socket.AF_INET6)):
+                    sibling = _socket.socket(sock.family, sock.type, sock.proto)
+                    sibling.setsockopt(_socket.SOL_SOCKET, _socket.SO_REUSEPORT, 1)
+                    if sock.family == _socket.AF_INET6:
+                        sibling.setsockopt(_socket.IPPROTO_IPV6, _socket.IPV6_V6ONLY,
+                                           sock.getsockopt(_socket.IPPROTO_IPV6,
+                                                           _socket.IPV6_V6ONLY))
+                    sibling.bind(sock.getsockname())
+                    if sock.type == _socket.SOCK_STREAM:
+                        sibling.listen(_socket.SOMAXCONN)
+                    sock.close()
+                    sock = sibling
+                so_incoming_cpu = getattr(_socket, 'SO_INCOMING_CPU', None)
+                if cpu is not None and so_incoming_cpu is not None:
+                    try:
+                        sock.setsockopt(_socket.SOL_SOCKET, so_incoming_cpu, cpu)
+                    except OSError:
+                        pass
+                result[name].append(sock)
+        return result
+
+    def _spawn(self, index, ready_fd, close_fds):
+        import signal
+        import traceback
+
+        pid = _os.fork()
+        if pid > 0:
+            self._pids[pid] = index
+            return
+
+        status = 1
+        try:
+            signal.set_wakeup_fd(-1)
+            for signum in (signal.SIGTERM, signal.SIGINT, signal.SIGCHLD):
+                signal.signal(signum, signal.SIG_DFL)
+            for fd in close_fds:
+                _os.close(fd)
+
+            def ready():
+                _os.write(ready_fd, _os.getpid().to_bytes(4, 'little'))
+
+            self.worker(index, self._worker_sockets(index), ready)
+            status = 0
+        except SystemExit as e:
+            status = e.code if isinstance(e.code, int) else 1
+        except BaseException:
+            traceback.print_exc()
+        finally:
+            _os._exit(status)
+
+    def _update_status(self):
+        ready = len(self._ready)
+        if self._stopping:
+            status = 'STOPPING=1\nSTATUS=Stopping, {} workers left'.format(len(self._pids))
+        elif ready == self.workers:
+            status = 'READY=1\nSTATUS={} workers ready'.format(ready)
+        else:
+            status = 'STATUS={} of {} workers ready'.format(ready, self.workers)
+        if status != self._status:
+            notify(status)
+            self._status = status
+
+    def stop(self):
+        """Ask all workers to terminate, run() returns when they are gone"""
+        import signal
+
+        self._stopping = True
+        self._restarts.clear()
+        for pid in self._pids:
+            try:
+                _os.kill(pid, signal.SIGTERM)
+            except ProcessLookupError:
+                pass
+
+    def run(self):
+        """Start the workers and supervise them until they are stopped"""
+        import selectors
+        import signal
+
+        ready_r, ready_w = _os.pipe()
+        wake_r, wake_w = _os.pipe()
+        for fd in (ready_r, wake_r, wake_w):
+            _os.set_blocking(fd, False)
+
+        def on_stop(signum, frame):
+            self.stop()
+
+        old_wakeup = signal.set_wakeup_fd(wake_w)
+        old_handlers = {signal.SIGTERM: signal.signal(signal.SIGTERM, on_stop),
+                        signal.SIGINT: signal.signal(signal.SIGINT, on_stop),
+                        signal.SIGCHLD: signal.signal(signal.SIGCHLD, lambda *args: None)}
+        try:
+            self._stopping = False
+            self._failure = None
+            self._delays.clear()
+            self._restarts.clear()
+            self._restart_times.clear()
+            for index in range(self.workers):
+                self._spawn(index, ready_w, (ready_r, wake_r, wake_w))
+            self._update_status()
+
+            with selectors.DefaultSelector() as selector:
+                selector.register(ready_r, selectors.EVENT_READ)
+                selector.register(wake_r, selectors.EVENT_READ)
+                while self._pids or self._restarts:
+                    timeout = None
+                    if self._restarts:
+                        timeout = max(0, min(self._restarts.values()) - _time.monotonic())
+                    selector.select(timeout)
+                    self._read_pipes(ready_r, wake_r)
+                    self._reap(ready_w, (ready_r, wake_r, wake_w))
+                    self._restart_due(ready_w, (ready_r, wake_r, wake_w))
+                    self._update_status()
+            if self._failure:
+                raise RuntimeError(self._failure)
+        finally:
+            signal.set_wakeup_fd(old_wakeup)
+            for signum, handler in old_handlers.items():
+                signal.signal(signum, handler)
+            for fd in (ready_r, ready_w, wake_r, wake_w):
+                _os.close(fd)
+
+    def _read_pipes(self, ready_r, wake_r):
+        try:
+            while _os.read(wake_r, 512):
+                pass
+        except BlockingIOError:
+            pass
+
+        try:
+            data = _os.read(ready_r, 4096)
+        except BlockingIOError:
+            return
+        for i in range(0, len(data) - 3, 4):
+            pid = int.from_bytes(data[i:i+4], 'little')
+            if pid in self._pids:
+                self._ready.add(pid)
+
+    def _reap(self, ready_w, close_fds):
+        # Only wait for our own workers, other children are none of our business
+        for pid in list(self._pids):
+            if _os.waitpid(pid, _os.WNOHANG)[0] == 0:
+                continue
+            index = self._pids.pop(pid)
+            if pid in self._ready:
+                self._ready.discard(pid)
+                self._delays.pop(index, None)
+            if self.respawn and not self._stopping:
+                self._schedule_restart(index)
+
+    def _schedule_restart(self, index):
+        now = _time.monotonic()
+        times = self._restart_times
+        while times and times[0] <= now - self.restart_limit_interval:
+            times.popleft()
+        if len(times) >= self.restart_limit_burst:
+            self._failure = ('Workers were restarted {} times within {} seconds'
+                             .format(len(times), self.restart_limit_interval))
+            self.stop()
+            return
+        times.append(now)
+
+        delay = self._delays.get(index)
+        if delay is None:
+            delay = self.restart_delay
+        self._delays[index] = min(delay * 2, self.restart_delay_max)
+        self._restarts[index] = now + delay
+
+    def _restart_due(self, ready_w, close_fds):
+        now = _time.monotonic()
+        for index, when in list(self._restarts.items()):
+            if when <= now:
+                del self._restarts[index]
+                self._spawn(index, ready_w, close_fds)
+
+_MEMFD_SEALS = (_fcntl.F_SEAL_SEAL | _fcntl.F_SEAL_SHRINK |
+                _fcntl.F_SEAL_GROW | _fcntl.F_SEAL_WRITE)
+
+# The memfds created by fdstore_push are named with this prefix, so that
+# fdstore_recover does not map sealed memfds stored by other code.
+# Memfd names are limited to 249 bytes.
+_MEMFD_PREFIX = 'python-systemd:'
+_MEMFD_NAME_MAX = 249
+
+def _check_fdname(name):
+    if (not name or len(name) > 255 or ':' in name or
+        not all(' ' < c < '\x7f' for c in name)):
+        raise ValueError('Invalid file descriptor name: {!r}'.format(name))
+
+def _sealed_memfd(name, buffer):
+    """Return a memfd with the contents of buffer, sealed against modification"""
+    data = memoryview(buffer).cast('B')
+    name = (_MEMFD_PREFIX + name)[:_MEMFD_NAME_MAX]
+    fd = _os.memfd_create(name, _os.MFD_CLOEXEC | _os.MFD_ALLOW_SEALING)
+    try:
+        if data.nbytes:
+            _os.ftruncate(fd, data.nbytes)
+            with _mmap.mmap(fd, data.nbytes) as m:
+                m[:] = data
+        _fcntl.fcntl(fd, _fcntl.F_ADD_SEALS, _MEMFD_SEALS)
+    except BaseException:
+        _os.close(fd)
+        raise
+    return fd
+
+def fdstore_push(name, fd_or_buffer, unset_environment=False):
+    """Store a file descriptor or a buffer in the file descriptor store
+
+    `fd_or_buffer` may be a file descriptor, an object with a fileno() method
+    (e.g. a listening socket), or an object supporting the buffer protocol.
+    A buffer is copied into a memfd, which is sealed against any further
+    modification, so that it can be mapped by `fdstore_recover` after a
+    restart of the service. The service needs FileDescriptorStoreMax= set, see
+    systemd.service(5).
+
+    Example::
+
+      sock = socket.socket()
+      ...
+      fdstore_push('listener', sock)
+      fdstore_push('cache', pickle.dumps(cache))
+
+    Return False if the service manager could not be notified, see notify().
+    """
+    _check_fdname(name)
+    if isinstance(fd_or_buffer, int) or hasattr(fd_or_buffer, 'fileno'):
+        fd = _convert_fileobj(fd_or_buffer)
+        return notify('FDSTORE=1\nFDNAME=' + name, unset_environment, fds=[fd])
+
+    fd = _sealed_memfd(name, fd_or_buffer)
+    try:
+        return notify('FDSTORE=1\nFDNAME=' + name, unset_environment, fds=[fd])
+    finally:
+        _os.close(fd)
+
+def fdstore_remove(name, unset_environment=False):
+    """Remove all file descriptors named `name` from the file descriptor store"""
+    _check_fdname(name)
+    return notify('FDSTOREREMOVE=1\nFDNAME=' + name, unset_environment)
+
+def _is_pushed_memfd(fd):
+    """Check if fd is a memfd created and sealed by fdstore_push"""
+    try:
+        seals = _fcntl.fcntl(fd, _fcntl.F_GET_SEALS)
+        target = _os.readlink('/proc/self/fd/{}'.format(fd))
+    except OSError:
+        return False
+    return (seals & _MEMFD_SEALS == _MEMFD_SEALS and
+            target.startswith('/memfd:' + _MEMFD_PREFIX))
+
+def fdstore_recover(unset_environment=False):
+    """Return the file descriptors passed to the service as {name: [object, ...]}
+
+    Buffers stored with `fdstore_push` are returned as read-only mmap objects
+    (or empty bytes), without copying their contents, and their descriptors are
+    closed, since the mapping stays valid and the store keeps its own copy. All
+    other descriptors, including memfds stored by other means, are returned as
+    integers, e.g. to be passed to socket.socket(fileno=...).
+
+    If `unset_environment` is true, $LISTEN_FDS and the related variables are
+    removed, so call this after everything else which looks at them, e.g.
+    `activated_sockets`.
+
+    Example::
+
+      fds = fdstore_recover()
+      if 'cache' in fds:
+          cache = pickle.loads(fds['cache'][0])
+    """
+    result = {}
+    for fd, name in sorted(listen_fds_with_names(unset_environment).items()):
+        if _is_pushed_memfd(fd):
+            size = _os.fstat(fd).st_size
+            obj = _mmap.mmap(fd, size, prot=_mmap.PROT_READ) if size else b''
+            _os.close(fd)
+        else:
+            obj = fd
+        result.setdefault(name, []).append(obj)
+    return result
@@ -1,117 +1,117 @@
-add_id(m, "SD_MESSAGE_BACKTRACE", SD_MESSAGE_BACKTRACE) JOINER
-add_id(m, "SD_MESSAGE_BATTERY_LOW_POWEROFF", SD_MESSAGE_BATTERY_LOW_POWEROFF) JOINER
-add_id(m, "SD_MESSAGE_BATTERY_LOW_WARNING", SD_MESSAGE_BATTERY_LOW_WARNING) JOINER
-add_id(m, "SD_MESSAGE_BOOTCHART", SD_MESSAGE_BOOTCHART) JOINER
-add_id(m, "SD_MESSAGE_CANT_BREAK_ORDERING_CYCLE", SD_MESSAGE_CANT_BREAK_ORDERING_CYCLE) JOINER
-add_id(m, "SD_MESSAGE_CONFIG_ERROR", SD_MESSAGE_CONFIG_ERROR) JOINER
-add_id(m, "SD_MESSAGE_COREDUMP", SD_MESSAGE_COREDUMP) JOINER
-add_id(m, "SD_MESSAGE_CORE_CAPABILITY_BOUNDING", SD_MESSAGE_CORE_CAPABILITY_BOUNDING) JOINER
-add_id(m, "SD_MESSAGE_CORE_CAPABILITY_BOUNDING_USER", SD_MESSAGE_CORE_CAPABILITY_BOUNDING_USER) JOINER
-add_id(m, "SD_MESSAGE_CORE_DISABLE_PRIVILEGES", SD_MESSAGE_CORE_DISABLE_PRIVILEGES) JOINER
-add_id(m, "SD_MESSAGE_CORE_FD_SET_FAILED", SD_MESSAGE_CORE_FD_SET_FAILED) JOINER
-add_id(m, "SD_MESSAGE_CORE_ISOLATE_TARGET_FAILED", SD_MESSAGE_CORE_ISOLATE_TARGET_FAILED) JOINER
-add_id(m, "SD_MESSAGE_CORE_MAINLOOP_FAILED", SD_MESSAGE_CORE_MAINLOOP_FAILED) JOINER
-add_id(m, "SD_MESSAGE_CORE_MANAGER_ALLOCATE", SD_MESSAGE_CORE_MANAGER_ALLOCATE) JOINER
-add_id(m, "SD_MESSAGE_CORE_NO_XDGDIR_PATH", SD_MESSAGE_CORE_NO_XDGDIR_PATH) JOINER
-add_id(m, "SD_MESSAGE_CORE_PID1_ENVIRONMENT", SD_MESSAGE_CORE_PID1_ENVIRONMENT) JOINER
-add_id(m, "SD_MESSAGE_CORE_START_TARGET_FAILED", SD_MESSAGE_CORE_START_TARGET_FAILED) JOINER
-add_id(m, "SD_MESSAGE_CRASH_COREDUMP_FAILED", SD_MESSAGE_CRASH_COREDUMP_FAILED) JOINER
-add_id(m, "SD_MESSAGE_CRASH_COREDUMP_PID", SD_MESSAGE_CRASH_COREDUMP_PID) JOINER
-add_id(m, "SD_MESSAGE_CRASH_EXECLE_FAILED", SD_MESSAGE_CRASH_EXECLE_FAILED) JOINER
-add_id(m, "SD_MESSAGE_CRASH_EXIT", SD_MESSAGE_CRASH_EXIT) JOINER
-add_id(m, "SD_MESSAGE_CRASH_FAILED", SD_MESSAGE_CRASH_FAILED) JOINER
-add_id(m, "SD_MESSAGE_CRASH_FREEZE", SD_MESSAGE_CRASH_FREEZE) JOINER
-add_id(m, "SD_MESSAGE_CRASH_NO_COREDUMP", SD_MESSAGE_CRASH_NO_COREDUMP) JOINER
-add_id(m, "SD_MESSAGE_CRASH_NO_FORK", SD_MESSAGE_CRASH_NO_FORK) JOINER
-add_id(m, "SD_MESSAGE_CRASH_PROCESS_SIGNAL", SD_MESSAGE_CRASH_PROCESS_SIGNAL) JOINER
-add_id(m, "SD_MESSAGE_CRASH_SHELL_FORK_FAILED", SD_MESSAGE_CRASH_SHELL_FORK_FAILED) JOINER
-add_id(m, "SD_MESSAGE_CRASH_SYSTEMD_SIGNAL", SD_MESSAGE_CRASH_SYSTEMD_SIGNAL) JOINER
-add_id(m, "SD_MESSAGE_CRASH_UNKNOWN_SIGNAL", SD_MESSAGE_CRASH_UNKNOWN_SIGNAL) JOINER
-add_id(m, "SD_MESSAGE_CRASH_WAITPID_FAILED", SD_MESSAGE_CRASH_WAITPID_FAILED) JOINER
-add_id(m, "SD_MESSAGE_DELETING_JOB_BECAUSE_ORDERING_CYCLE", SD_MESSAGE_DELETING_JOB_BECAUSE_ORDERING_CYCLE) JOINER
-add_id(m, "SD_MESSAGE_DEVICE_PATH_NOT_SUITABLE", SD_MESSAGE_DEVICE_PATH_NOT_SUITABLE) JOINER
-add_id(m, "SD_MESSAGE_DNSSEC_DOWNGRADE", SD_MESSAGE_DNSSEC_DOWNGRADE) JOINER
-add_id(m, "SD_MESSAGE_DNSSEC_FAILURE", SD_MESSAGE_DNSSEC_FAILURE) JOINER
-add_id(m, "SD_MESSAGE_DNSSEC_TRUST_ANCHOR_REVOKED", SD_MESSAGE_DNSSEC_TRUST_ANCHOR_REVOKED) JOINER
-add_id(m, "SD_MESSAGE_FACTORY_RESET", SD_MESSAGE_FACTORY_RESET) JOINER
-add_id(m, "SD_MESSAGE_FORWARD_SYSLOG_MISSED", SD_MESSAGE_FORWARD_SYSLOG_MISSED) JOINER
-add_id(m, "SD_MESSAGE_HIBERNATE_KEY", SD_MESSAGE_HIBERNATE_KEY) JOINER
-add_id(m, "SD_MESSAGE_HIBERNATE_KEY_LONG_PRESS", SD_MESSAGE_HIBERNATE_KEY_LONG_PRESS) JOINER
-add_id(m, "SD_MESSAGE_INVALID_CONFIGURATION", SD_MESSAGE_INVALID_CONFIGURATION) JOINER
-add_id(m, "SD_MESSAGE_JOURNAL_DROPPED", SD_MESSAGE_JOURNAL_DROPPED) JOINER
-add_id(m, "SD_MESSAGE_JOURNAL_MISSED", SD_MESSAGE_JOURNAL_MISSED) JOINER
-add_id(m, "SD_MESSAGE_JOURNAL_START", SD_MESSAGE_JOURNAL_START) JOINER
-add_id(m, "SD_MESSAGE_JOURNAL_STOP", SD_MESSAGE_JOURNAL_STOP) JOINER
-add_id(m, "SD_MESSAGE_JOURNAL_USAGE", SD_MESSAGE_JOURNAL_USAGE) JOINER
-add_id(m, "SD_MESSAGE_LID_CLOSED", SD_MESSAGE_LID_CLOSED) JOINER
-add_id(m, "SD_MESSAGE_LID_OPENED", SD_MESSAGE_LID_OPENED) JOINER
-add_id(m, "SD_MESSAGE_MACHINE_START", SD_MESSAGE_MACHINE_START) JOINER
-add_id(m, "SD_MESSAGE_MACHINE_STOP", SD_MESSAGE_MACHINE_STOP) JOINER
-add_id(m, "SD_MESSAGE_MEMORY_TRIM", SD_MESSAGE_MEMORY_TRIM) JOINER
-add_id(m, "SD_MESSAGE_MOUNT_POINT_PATH_NOT_SUITABLE", SD_MESSAGE_MOUNT_POINT_PATH_NOT_SUITABLE) JOINER
-add_id(m, "SD_MESSAGE_NOBODY_USER_UNSUITABLE", SD_MESSAGE_NOBODY_USER_UNSUITABLE) JOINER
-add_id(m, "SD_MESSAGE_NON_CANONICAL_MOUNT", SD_MESSAGE_NON_CANONICAL_MOUNT) JOINER
-add_id(m, "SD_MESSAGE_OVERMOUNTING", SD_MESSAGE_OVERMOUNTING) JOINER
-add_id(m, "SD_MESSAGE_PORTABLE_ATTACHED", SD_MESSAGE_PORTABLE_ATTACHED) JOINER
-add_id(m, "SD_MESSAGE_PORTABLE_DETACHED", SD_MESSAGE_PORTABLE_DETACHED) JOINER
-add_id(m, "SD_MESSAGE_POWER_KEY", SD_MESSAGE_POWER_KEY) JOINER
-add_id(m, "SD_MESSAGE_POWER_KEY_LONG_PRESS", SD_MESSAGE_POWER_KEY_LONG_PRESS) JOINER
-add_id(m, "SD_MESSAGE_REBOOT_KEY", SD_MESSAGE_REBOOT_KEY) JOINER
-add_id(m, "SD_MESSAGE_REBOOT_KEY_LONG_PRESS", SD_MESSAGE_REBOOT_KEY_LONG_PRESS) JOINER
-add_id(m, "SD_MESSAGE_SEAT_START", SD_MESSAGE_SEAT_START) JOINER
-add_id(m, "SD_MESSAGE_SEAT_STOP", SD_MESSAGE_SEAT_STOP) JOINER
-add_id(m, "SD_MESSAGE_SECURE_ATTENTION_KEY_PRESS", SD_MESSAGE_SECURE_ATTENTION_KEY_PRESS) JOINER
-add_id(m, "SD_MESSAGE_SELINUX_FAILED", SD_MESSAGE_SELINUX_FAILED) JOINER
-add_id(m, "SD_MESSAGE_SESSION_START", SD_MESSAGE_SESSION_START) JOINER
-add_id(m, "SD_MESSAGE_SESSION_STOP", SD_MESSAGE_SESSION_STOP) JOINER
-add_id(m, "SD_MESSAGE_SHUTDOWN", SD_MESSAGE_SHUTDOWN) JOINER
-add_id(m, "SD_MESSAGE_SHUTDOWN_CANCELED", SD_MESSAGE_SHUTDOWN_CANCELED) JOINER
-add_id(m, "SD_MESSAGE_SHUTDOWN_ERROR", SD_MESSAGE_SHUTDOWN_ERROR) JOINER
-add_id(m, "SD_MESSAGE_SHUTDOWN_SCHEDULED", SD_MESSAGE_SHUTDOWN_SCHEDULED) JOINER
-add_id(m, "SD_MESSAGE_SLEEP_START", SD_MESSAGE_SLEEP_START) JOINER
-add_id(m, "SD_MESSAGE_SLEEP_STOP", SD_MESSAGE_SLEEP_STOP) JOINER
-add_id(m, "SD_MESSAGE_SMACK_FAILED_WRITE", SD_MESSAGE_SMACK_FAILED_WRITE) JOINER
-add_id(m, "SD_MESSAGE_SPAWN_FAILED", SD_MESSAGE_SPAWN_FAILED) JOINER
-add_id(m, "SD_MESSAGE_SRK_ENROLLMENT_NEEDS_AUTHORIZATION", SD_MESSAGE_SRK_ENROLLMENT_NEEDS_AUTHORIZATION) JOINER
-add_id(m, "SD_MESSAGE_STARTUP_FINISHED", SD_MESSAGE_STARTUP_FINISHED) JOINER
-add_id(m, "SD_MESSAGE_SUSPEND_KEY", SD_MESSAGE_SUSPEND_KEY) JOINER
-add_id(m, "SD_MESSAGE_SUSPEND_KEY_LONG_PRESS", SD_MESSAGE_SUSPEND_KEY_LONG_PRESS) JOINER
-add_id(m, "SD_MESSAGE_SYSCTL_CHANGED", SD_MESSAGE_SYSCTL_CHANGED) JOINER
-add_id(m, "SD_MESSAGE_SYSTEMD_UDEV_SETTLE_DEPRECATED", SD_MESSAGE_SYSTEMD_UDEV_SETTLE_DEPRECATED) JOINER
-add_id(m, "SD_MESSAGE_SYSTEM_ACCOUNT_REQUIRED", SD_MESSAGE_SYSTEM_ACCOUNT_REQUIRED) JOINER
-add_id(m, "SD_MESSAGE_SYSTEM_DOCKED", SD_MESSAGE_SYSTEM_DOCKED) JOINER
-add_id(m, "SD_MESSAGE_SYSTEM_UNDOCKED", SD_MESSAGE_SYSTEM_UNDOCKED) JOINER
-add_id(m, "SD_MESSAGE_SYSV_GENERATOR_DEPRECATED", SD_MESSAGE_SYSV_GENERATOR_DEPRECATED) JOINER
-add_id(m, "SD_MESSAGE_TAINTED", SD_MESSAGE_TAINTED) JOINER
-add_id(m, "SD_MESSAGE_TIMEZONE_CHANGE", SD_MESSAGE_TIMEZONE_CHANGE) JOINER
-add_id(m, "SD_MESSAGE_TIME_BUMP", SD_MESSAGE_TIME_BUMP) JOINER
-add_id(m, "SD_MESSAGE_TIME_CHANGE", SD_MESSAGE_TIME_CHANGE) JOINER
-add_id(m, "SD_MESSAGE_TIME_SYNC", SD_MESSAGE_TIME_SYNC) JOINER
-add_id(m, "SD_MESSAGE_TPM2_CLEAR_REQUESTED", SD_MESSAGE_TPM2_CLEAR_REQUESTED) JOINER
-add_id(m, "SD_MESSAGE_TPM_NVINDEX_EXHAUSTED", SD_MESSAGE_TPM_NVINDEX_EXHAUSTED) JOINER
-add_id(m, "SD_MESSAGE_TPM_NVPCR_EXTEND", SD_MESSAGE_TPM_NVPCR_EXTEND) JOINER
-add_id(m, "SD_MESSAGE_TPM_NVPCR_UNSUPPORTED", SD_MESSAGE_TPM_NVPCR_UNSUPPORTED) JOINER
-add_id(m, "SD_MESSAGE_TPM_PCR_EXTEND", SD_MESSAGE_TPM_PCR_EXTEND) JOINER
-add_id(m, "SD_MESSAGE_TRUNCATED_CORE", SD_MESSAGE_TRUNCATED_CORE) JOINER
-add_id(m, "SD_MESSAGE_UNIT_FAILED", SD_MESSAGE_UNIT_FAILED) JOINER
-add_id(m, "SD_MESSAGE_UNIT_FAILURE_RESULT", SD_MESSAGE_UNIT_FAILURE_RESULT) JOINER
-add_id(m, "SD_MESSAGE_UNIT_OOMD_KILL", SD_MESSAGE_UNIT_OOMD_KILL) JOINER
-add_id(m, "SD_MESSAGE_UNIT_ORDERING_CYCLE", SD_MESSAGE_UNIT_ORDERING_CYCLE) JOINER
-add_id(m, "SD_MESSAGE_UNIT_OUT_OF_MEMORY", SD_MESSAGE_UNIT_OUT_OF_MEMORY) JOINER
-add_id(m, "SD_MESSAGE_UNIT_PROCESS_EXIT", SD_MESSAGE_UNIT_PROCESS_EXIT) JOINER
-add_id(m, "SD_MESSAGE_UNIT_RELOADED", SD_MESSAGE_UNIT_RELOADED) JOINER
-add_id(m, "SD_MESSAGE_UNIT_RELOADING", SD_MESSAGE_UNIT_RELOADING) JOINER
-add_id(m, "SD_MESSAGE_UNIT_RESOURCES", SD_MESSAGE_UNIT_RESOURCES) JOINER
-add_id(m, "SD_MESSAGE_UNIT_RESTART_SCHEDULED", SD_MESSAGE_UNIT_RESTART_SCHEDULED) JOINER
-add_id(m, "SD_MESSAGE_UNIT_SKIPPED", SD_MESSAGE_UNIT_SKIPPED) JOINER
-add_id(m, "SD_MESSAGE_UNIT_STARTED", SD_MESSAGE_UNIT_STARTED) JOINER
-add_id(m, "SD_MESSAGE_UNIT_STARTING", SD_MESSAGE_UNIT_STARTING) JOINER
-add_id(m, "SD_MESSAGE_UNIT_STOPPED", SD_MESSAGE_UNIT_STOPPED) JOINER
-add_id(m, "SD_MESSAGE_UNIT_STOPPING", SD_MESSAGE_UNIT_STOPPING) JOINER
-add_id(m, "SD_MESSAGE_UNIT_SUCCESS", SD_MESSAGE_UNIT_SUCCESS) JOINER
-add_id(m, "SD_MESSAGE_UNSAFE_USER_NAME", SD_MESSAGE_UNSAFE_USER_NAME) JOINER
-add_id(m, "SD_MESSAGE_USER_STARTUP_FINISHED", SD_MESSAGE_USER_STARTUP_FINISHED) JOINER
-add_id(m, "SD_MESSAGE_VALGRIND_HELPER_FORK", SD_MESSAGE_VALGRIND_HELPER_FORK) JOINER
-add_id(m, "SD_MESSAGE_WATCHDOG_OPENED", SD_MESSAGE_WATCHDOG_OPENED) JOINER
-add_id(m, "SD_MESSAGE_WATCHDOG_OPEN_FAILED", SD_MESSAGE_WATCHDOG_OPEN_FAILED) JOINER
-add_id(m, "SD_MESSAGE_WATCHDOG_PING_FAILED", SD_MESSAGE_WATCHDOG_PING_FAILED) JOINER
+{ "SD_MESSAGE_BACKTRACE", { 0x1f, 0x4e, 0x0a, 0x44, 0xa8, 0x86, 0x49, 0x93, 0x9a, 0xae, 0xa3, 0x4f, 0xc6, 0xda, 0x8c, 0x95 } },
+{ "SD_MESSAGE_BATTERY_LOW_POWEROFF", { 0x26, 0x74, 0x37, 0xd3, 0x3f, 0xdd, 0x41, 0x09, 0x9a, 0xd7, 0x62, 0x21, 0xcc, 0x24, 0xa3, 0x35 } },
+{ "SD_MESSAGE_BATTERY_LOW_WARNING", { 0xe6, 0xf4, 0x56, 0xbd, 0x92, 0x00, 0x4d, 0x95, 0x80, 0x16, 0x0b, 0x22, 0x07, 0x55, 0x51, 0x86 } },
+{ "SD_MESSAGE_BOOTCHART", { 0x9f, 0x26, 0xaa, 0x56, 0x2c, 0xf4, 0x40, 0xc2, 0xb1, 0x6c, 0x77, 0x3d, 0x04, 0x79, 0xb5, 0x18 } },
+{ "SD_MESSAGE_CANT_BREAK_ORDERING_CYCLE", { 0xb3, 0x11, 0x2d, 0xda, 0xd1, 0x90, 0x45, 0x53, 0x8c, 0x76, 0x68, 0x5b, 0xa5, 0x91, 0x8a, 0x80 } },
+{ "SD_MESSAGE_CONFIG_ERROR", { 0xc7, 0x72, 0xd2, 0x4e, 0x9a, 0x88, 0x4c, 0xbe, 0xb9, 0xea, 0x12, 0x62, 0x5c, 0x30, 0x6c, 0x01 } },
+{ "SD_MESSAGE_COREDUMP", { 0xfc, 0x2e, 0x22, 0xbc, 0x6e, 0xe6, 0x47, 0xb6, 0xb9, 0x07, 0x29, 0xab, 0x34, 0xa2, 0x50, 0xb1 } },
+{ "SD_MESSAGE_CORE_CAPABILITY_BOUNDING", { 0x42, 0x69, 0x5b, 0x50, 0x0d, 0xf0, 0x48, 0x29, 0x8b, 0xee, 0x37, 0x15, 0x9c, 0xaa, 0x9f, 0x2e } },
+{ "SD_MESSAGE_CORE_CAPABILITY_BOUNDING_USER", { 0xed, 0x15, 0x8c, 0x2d, 0xf8, 0x88, 0x4f, 0xa5, 0x84, 0xee, 0xad, 0x2d, 0x90, 0x2c, 0x10, 0x32 } },
+{ "SD_MESSAGE_CORE_DISABLE_PRIVILEGES", { 0xbf, 0xc2, 0x43, 0x07, 0x24, 0xab, 0x44, 0x49, 0x97, 0x35, 0xb4, 0xf9, 0x4c, 0xca, 0x92, 0x95 } },
+{ "SD_MESSAGE_CORE_FD_SET_FAILED", { 0x5e, 0xd8, 0x36, 0xf1, 0x76, 0x6f, 0x4a, 0x8a, 0x9f, 0xc5, 0xda, 0x45, 0xaa, 0xe2, 0x3b, 0x29 } },
+{ "SD_MESSAGE_CORE_ISOLATE_TARGET_FAILED", { 0x68, 0x9b, 0x4f, 0xcc, 0x97, 0xb4, 0x48, 0x6e, 0xa5, 0xda, 0x92, 0xdb, 0x69, 0xc9, 0xe3, 0x14 } },
+{ "SD_MESSAGE_CORE_MAINLOOP_FAILED", { 0x79, 0xe0, 0x5b, 0x67, 0xbc, 0x45, 0x45, 0xd1, 0x92, 0x2f, 0xe4, 0x71, 0x07, 0xee, 0x60, 0xc5 } },
+{ "SD_MESSAGE_CORE_MANAGER_ALLOCATE", { 0x0e, 0x54, 0x47, 0x09, 0x84, 0xac, 0x41, 0x96, 0x89, 0x74, 0x3d, 0x95, 0x7a, 0x11, 0x9e, 0x2e } },
+{ "SD_MESSAGE_CORE_NO_XDGDIR_PATH", { 0xdb, 0xb1, 0x36, 0xb1, 0x0e, 0xf4, 0x45, 0x7b, 0xa4, 0x7a, 0x79, 0x5d, 0x62, 0xf1, 0x08, 0xc9 } },
+{ "SD_MESSAGE_CORE_PID1_ENVIRONMENT", { 0x6a, 0x40, 0xfb, 0xfb, 0xd2, 0xba, 0x4b, 0x8d, 0xb0, 0x2f, 0xb4, 0x0c, 0x9c, 0xd0, 0x90, 0xd7 } },
+{ "SD_MESSAGE_CORE_START_TARGET_FAILED", { 0x59, 0x28, 0x8a, 0xf5, 0x23, 0xbe, 0x43, 0xa2, 0x8d, 0x49, 0x4e, 0x41, 0xe2, 0x6e, 0x45, 0x10 } },
+{ "SD_MESSAGE_CRASH_COREDUMP_FAILED", { 0x56, 0xb1, 0xcd, 0x96, 0xf2, 0x42, 0x46, 0xc5, 0xb6, 0x07, 0x66, 0x6f, 0xda, 0x95, 0x23, 0x56 } },
+{ "SD_MESSAGE_CRASH_COREDUMP_PID", { 0x4a, 0xc7, 0x56, 0x6d, 0x4d, 0x75, 0x48, 0xf4, 0x98, 0x1f, 0x62, 0x9a, 0x28, 0xf0, 0xf8, 0x29 } },
+{ "SD_MESSAGE_CRASH_EXECLE_FAILED", { 0x87, 0x27, 0x29, 0xb4, 0x7d, 0xbe, 0x47, 0x3e, 0xb7, 0x68, 0xcc, 0xec, 0xd4, 0x77, 0xbe, 0xda } },
+{ "SD_MESSAGE_CRASH_EXIT", { 0xd9, 0xec, 0x5e, 0x95, 0xe4, 0xb6, 0x46, 0xaa, 0xae, 0xa2, 0xfd, 0x05, 0x21, 0x4e, 0xdb, 0xda } },
+{ "SD_MESSAGE_CRASH_FAILED", { 0x3e, 0xd0, 0x16, 0x3e, 0x86, 0x8a, 0x44, 0x17, 0xab, 0x8b, 0x9e, 0x21, 0x04, 0x07, 0xa9, 0x6c } },
+{ "SD_MESSAGE_CRASH_FREEZE", { 0x64, 0x5c, 0x73, 0x55, 0x37, 0x63, 0x4a, 0xe0, 0xa3, 0x2b, 0x15, 0xa7, 0xc6, 0xcb, 0xa7, 0xd4 } },
+{ "SD_MESSAGE_CRASH_NO_COREDUMP", { 0x5a, 0xdd, 0xb3, 0xa0, 0x6a, 0x73, 0x4d, 0x33, 0x96, 0xb7, 0x94, 0xbf, 0x98, 0xfb, 0x2d, 0x01 } },
+{ "SD_MESSAGE_CRASH_NO_FORK", { 0x5c, 0x9e, 0x98, 0xde, 0x4a, 0xb9, 0x4c, 0x6a, 0x9d, 0x04, 0xd0, 0xad, 0x79, 0x3b, 0xd9, 0x03 } },
+{ "SD_MESSAGE_CRASH_PROCESS_SIGNAL", { 0x3a, 0x73, 0xa9, 0x8b, 0xaf, 0x5b, 0x4b, 0x19, 0x99, 0x29, 0xe3, 0x22, 0x6c, 0x0b, 0xe7, 0x83 } },
+{ "SD_MESSAGE_CRASH_SHELL_FORK_FAILED", { 0x38, 0xe8, 0xb1, 0xe0, 0x39, 0xad, 0x46, 0x92, 0x91, 0xb1, 0x8b, 0x44, 0xc5, 0x53, 0xa5, 0xb7 } },
+{ "SD_MESSAGE_CRASH_SYSTEMD_SIGNAL", { 0x83, 0xf8, 0x4b, 0x35, 0xee, 0x26, 0x4f, 0x74, 0xa3, 0x89, 0x6a, 0x97, 0x17, 0xaf, 0x34, 0xcb } },
+{ "SD_MESSAGE_CRASH_UNKNOWN_SIGNAL", { 0x5e, 0x6f, 0x1f, 0x5e, 0x4d, 0xb6, 0x4a, 0x0e, 0xae, 0xe3, 0x36, 0x82, 0x49, 0xd2, 0x0b, 0x94 } },
+{ "SD_MESSAGE_CRASH_WAITPID_FAILED", { 0x2e, 0xd1, 0x8d, 0x4f, 0x78, 0xca, 0x47, 0xf0, 0xa9, 0xbc, 0x25, 0x27, 0x1c, 0x26, 0xad, 0xb4 } },
+{ "SD_MESSAGE_DELETING_JOB_BECAUSE_ORDERING_CYCLE", { 0x50, 0x84, 0x36, 0x75, 0x42, 0xf7, 0x47, 0x2d, 0xbc, 0x6a, 0x94, 0x12, 0x5d, 0x5d, 0xeb, 0xce } },
+{ "SD_MESSAGE_DEVICE_PATH_NOT_SUITABLE", { 0x01, 0x01, 0x90, 0x13, 0x8f, 0x49, 0x4e, 0x29, 0xa0, 0xef, 0x66, 0x69, 0x74, 0x95, 0x31, 0xaa } },
+{ "SD_MESSAGE_DNSSEC_DOWNGRADE", { 0x36, 0xdb, 0x2d, 0xfa, 0x5a, 0x90, 0x45, 0xe1, 0xbd, 0x4a, 0xf5, 0xf9, 0x3e, 0x1c, 0xf0, 0x57 } },
+{ "SD_MESSAGE_DNSSEC_FAILURE", { 0x16, 0x75, 0xd7, 0xf1, 0x72, 0x17, 0x40, 0x98, 0xb1, 0x10, 0x8b, 0xf8, 0xc7, 0xdc, 0x8f, 0x5d } },
+{ "SD_MESSAGE_DNSSEC_TRUST_ANCHOR_REVOKED", { 0x4d, 0x44, 0x08, 0xcf, 0xd0, 0xd1, 0x44, 0x85, 0x91, 0x84, 0xd1, 0xe6, 0x5d, 0x7c, 0x8a, 0x65 } },
+{ "SD_MESSAGE_FACTORY_RESET", { 0xc1, 0x4a, 0xaf, 0x76, 0xec, 0x28, 0x4a, 0x5f, 0xa1, 0xf1, 0x05, 0xf8, 0x8d, 0xfb, 0x06, 0x1c } },
+{ "SD_MESSAGE_FORWARD_SYSLOG_MISSED", { 0x00, 0x27, 0x22, 0x9c, 0xa0, 0x64, 0x41, 0x81, 0xa7, 0x6c, 0x4e, 0x92, 0x45, 0x8a, 0xfa, 0x2e } },
+{ "SD_MESSAGE_HIBERNATE_KEY", { 0xb7, 0x2e, 0xa4, 0xa2, 0x88, 0x15, 0x45, 0xa0, 0xb5, 0x0e, 0x20, 0x0e, 0x55, 0xb9, 0xb0, 0x73 } },
+{ "SD_MESSAGE_HIBERNATE_KEY_LONG_PRESS", { 0x16, 0x78, 0x36, 0xdf, 0x6f, 0x7f, 0x42, 0x8e, 0x98, 0x14, 0x72, 0x27, 0xb2, 0xdc, 0x89, 0x45 } },
+{ "SD_MESSAGE_INVALID_CONFIGURATION", { 0xc7, 0x72, 0xd2, 0x4e, 0x9a, 0x88, 0x4c, 0xbe, 0xb9, 0xea, 0x12, 0x62, 0x5c, 0x30, 0x6c, 0x01 } },
+{ "SD_MESSAGE_JOURNAL_DROPPED", { 0xa5, 0x96, 0xd6, 0xfe, 0x7b, 0xfa, 0x49, 0x94, 0x82, 0x8e, 0x72, 0x30, 0x9e, 0x95, 0xd6, 0x1e } },
+{ "SD_MESSAGE_JOURNAL_MISSED", { 0xe9, 0xbf, 0x28, 0xe6, 0xe8, 0x34, 0x48, 0x1b, 0xb6, 0xf4, 0x8f, 0x54, 0x8a, 0xd1, 0x36, 0x06 } },
+{ "SD_MESSAGE_JOURNAL_START", { 0xf7, 0x73, 0x79, 0xa8, 0x49, 0x0b, 0x40, 0x8b, 0xbe, 0x5f, 0x69, 0x40, 0x50, 0x5a, 0x77, 0x7b } },
+{ "SD_MESSAGE_JOURNAL_STOP", { 0xd9, 0x3f, 0xb3, 0xc9, 0xc2, 0x4d, 0x45, 0x1a, 0x97, 0xce, 0xa6, 0x15, 0xce, 0x59, 0xc0, 0x0b } },
+{ "SD_MESSAGE_JOURNAL_USAGE", { 0xec, 0x38, 0x7f, 0x57, 0x7b, 0x84, 0x4b, 0x8f, 0xa9, 0x48, 0xf3, 0x3c, 0xad, 0x9a, 0x75, 0xe6 } },
+{ "SD_MESSAGE_LID_CLOSED", { 0xb7, 0x2e, 0xa4, 0xa2, 0x88, 0x15, 0x45, 0xa0, 0xb5, 0x0e, 0x20, 0x0e, 0x55, 0xb9, 0xb0, 0x70 } },
+{ "SD_MESSAGE_LID_OPENED", { 0xb7, 0x2e, 0xa4, 0xa2, 0x88, 0x15, 0x45, 0xa0, 0xb5, 0x0e, 0x20, 0x0e, 0x55, 0xb9, 0xb0, 0x6f } },
+{ "SD_MESSAGE_MACHINE_START", { 0x24, 0xd8, 0xd4, 0x45, 0x25, 0x73, 0x40, 0x24, 0x96, 0x06, 0x83, 0x81, 0xa6, 0x31, 0x2d, 0xf2 } },
+{ "SD_MESSAGE_MACHINE_STOP", { 0x58, 0x43, 0x2b, 0xd3, 0xba, 0xce, 0x47, 0x7c, 0xb5, 0x14, 0xb5, 0x63, 0x81, 0xb8, 0xa7, 0x58 } },
+{ "SD_MESSAGE_MEMORY_TRIM", { 0xf9, 0xb0, 0xbe, 0x46, 0x5a, 0xd5, 0x40, 0xd0, 0x85, 0x0a, 0xd3, 0x21, 0x72, 0xd5, 0x7c, 0x21 } },
+{ "SD_MESSAGE_MOUNT_POINT_PATH_NOT_SUITABLE", { 0x1b, 0x3b, 0xb9, 0x40, 0x37, 0xf0, 0x4b, 0xbf, 0x81, 0x02, 0x8e, 0x13, 0x5a, 0x12, 0xd2, 0x93 } },
+{ "SD_MESSAGE_NOBODY_USER_UNSUITABLE", { 0xb4, 0x80, 0x32, 0x5f, 0x9c, 0x39, 0x4a, 0x7b, 0x80, 0x2c, 0x23, 0x1e, 0x51, 0xa2, 0x75, 0x2c } },
+{ "SD_MESSAGE_NON_CANONICAL_MOUNT", { 0x1e, 0xda, 0xbb, 0x4e, 0xda, 0x2a, 0x49, 0xc1, 0x9b, 0xc0, 0x20, 0x6f, 0x24, 0xb4, 0x38, 0x89 } },
+{ "SD_MESSAGE_OVERMOUNTING", { 0x1d, 0xee, 0x03, 0x69, 0xc7, 0xfc, 0x47, 0x36, 0xb7, 0x09, 0x9b, 0x38, 0xec, 0xb4, 0x6e, 0xe7 } },
+{ "SD_MESSAGE_PORTABLE_ATTACHED", { 0x18, 0x7c, 0x62, 0xeb, 0x1e, 0x7f, 0x46, 0x3b, 0xb5, 0x30, 0x39, 0x4f, 0x52, 0xcb, 0x09, 0x0f } },
+{ "SD_MESSAGE_PORTABLE_DETACHED", { 0x76, 0xc5, 0xc7, 0x54, 0xd6, 0x28, 0x49, 0x0d, 0x8e, 0xcb, 0xa4, 0xc9, 0xd0, 0x42, 0x11, 0x2b } },
+{ "SD_MESSAGE_POWER_KEY", { 0xb7, 0x2e, 0xa4, 0xa2, 0x88, 0x15, 0x45, 0xa0, 0xb5, 0x0e, 0x20, 0x0e, 0x55, 0xb9, 0xb0, 0x71 } },
+{ "SD_MESSAGE_POWER_KEY_LONG_PRESS", { 0x3e, 0x01, 0x17, 0x10, 0x1e, 0xb2, 0x43, 0xc1, 0xb9, 0xa5, 0x0d, 0xb3, 0x49, 0x4a, 0xb1, 0x0b } },
+{ "SD_MESSAGE_REBOOT_KEY", { 0x9f, 0xa9, 0xd2, 0xc0, 0x12, 0x13, 0x4e, 0xc3, 0x85, 0x45, 0x1f, 0xfe, 0x31, 0x6f, 0x97, 0xd0 } },
+{ "SD_MESSAGE_REBOOT_KEY_LONG_PRESS", { 0xf1, 0xc5, 0x9a, 0x58, 0xc9, 0xd9, 0x43, 0x66, 0x89, 0x65, 0xc3, 0x37, 0xca, 0xec, 0x59, 0x75 } },
+{ "SD_MESSAGE_SEAT_START", { 0xfc, 0xbe, 0xfc, 0x5d, 0xa2, 0x3d, 0x42, 0x80, 0x93, 0xf9, 0x7c, 0x82, 0xa9, 0x29, 0x0f, 0x7b } },
+{ "SD_MESSAGE_SEAT_STOP", { 0xe7, 0x85, 0x2b, 0xfe, 0x46, 0x78, 0x4e, 0xd0, 0xac, 0xcd, 0xe0, 0x4b, 0xc8, 0x64, 0xc2, 0xd5 } },
+{ "SD_MESSAGE_SECURE_ATTENTION_KEY_PRESS", { 0xb2, 0xbc, 0xba, 0xf5, 0xed, 0xf9, 0x48, 0xe0, 0x93, 0xce, 0x50, 0xbb, 0xea, 0x0e, 0x81, 0xec } },
+{ "SD_MESSAGE_SELINUX_FAILED", { 0x65, 0x8a, 0x67, 0xad, 0xc1, 0xc9, 0x40, 0xb3, 0xb3, 0x31, 0x6e, 0x7e, 0x86, 0x28, 0x83, 0x4a } },
+{ "SD_MESSAGE_SESSION_START", { 0x8d, 0x45, 0x62, 0x0c, 0x1a, 0x43, 0x48, 0xdb, 0xb1, 0x74, 0x10, 0xda, 0x57, 0xc6, 0x0c, 0x66 } },
+{ "SD_MESSAGE_SESSION_STOP", { 0x33, 0x54, 0x93, 0x94, 0x24, 0xb4, 0x45, 0x6d, 0x98, 0x02, 0xca, 0x83, 0x33, 0xed, 0x42, 0x4a } },
+{ "SD_MESSAGE_SHUTDOWN", { 0x98, 0x26, 0x88, 0x66, 0xd1, 0xd5, 0x4a, 0x49, 0x9c, 0x4e, 0x98, 0x92, 0x1d, 0x93, 0xbc, 0x40 } },
+{ "SD_MESSAGE_SHUTDOWN_CANCELED", { 0x24, 0x9f, 0x6f, 0xb9, 0xe6, 0xe2, 0x42, 0x8c, 0x96, 0xf3, 0xf0, 0x87, 0x56, 0x81, 0xff, 0xa3 } },
+{ "SD_MESSAGE_SHUTDOWN_ERROR", { 0xaf, 0x55, 0xa6, 0xf7, 0x5b, 0x54, 0x44, 0x31, 0xb7, 0x26, 0x49, 0xf3, 0x6f, 0xf6, 0xd6, 0x2c } },
+{ "SD_MESSAGE_SHUTDOWN_SCHEDULED", { 0x9e, 0x70, 0x66, 0x27, 0x9d, 0xc8, 0x40, 0x3d, 0xa7, 0x9c, 0xe4, 0xb1, 0xa6, 0x90, 0x64, 0xb2 } },
+{ "SD_MESSAGE_SLEEP_START", { 0x6b, 0xbd, 0x95, 0xee, 0x97, 0x79, 0x41, 0xe4, 0x97, 0xc4, 0x8b, 0xe2, 0x7c, 0x25, 0x41, 0x28 } },
+{ "SD_MESSAGE_SLEEP_STOP", { 0x88, 0x11, 0xe6, 0xdf, 0x2a, 0x8e, 0x40, 0xf5, 0x8a, 0x94, 0xce, 0xa2, 0x6f, 0x8e, 0xbf, 0x14 } },
+{ "SD_MESSAGE_SMACK_FAILED_WRITE", { 0xd6, 0x7f, 0xa9, 0xf8, 0x47, 0xaa, 0x4b, 0x04, 0x8a, 0x2a, 0xe3, 0x35, 0x35, 0x33, 0x1a, 0xdb } },
+{ "SD_MESSAGE_SPAWN_FAILED", { 0x64, 0x12, 0x57, 0x65, 0x1c, 0x1b, 0x4e, 0xc9, 0xa8, 0x62, 0x4d, 0x7a, 0x40, 0xa9, 0xe1, 0xe7 } },
+{ "SD_MESSAGE_SRK_ENROLLMENT_NEEDS_AUTHORIZATION", { 0xad, 0x70, 0x89, 0xf9, 0x28, 0xac, 0x4f, 0x7e, 0xa0, 0x0c, 0x07, 0x45, 0x7d, 0x47, 0xba, 0x8a } },
+{ "SD_MESSAGE_STARTUP_FINISHED", { 0xb0, 0x7a, 0x24, 0x9c, 0xd0, 0x24, 0x41, 0x4a, 0x82, 0xdd, 0x00, 0xcd, 0x18, 0x13, 0x78, 0xff } },
+{ "SD_MESSAGE_SUSPEND_KEY", { 0xb7, 0x2e, 0xa4, 0xa2, 0x88, 0x15, 0x45, 0xa0, 0xb5, 0x0e, 0x20, 0x0e, 0x55, 0xb9, 0xb0, 0x72 } },
+{ "SD_MESSAGE_SUSPEND_KEY_LONG_PRESS", { 0xbf, 0xda, 0xf6, 0xd3, 0x12, 0xab, 0x40, 0x07, 0xbc, 0x1f, 0xe4, 0x0a, 0x15, 0xdf, 0x78, 0xe8 } },
+{ "SD_MESSAGE_SYSCTL_CHANGED", { 0x9c, 0xf5, 0x6b, 0x8b, 0xaf, 0x95, 0x46, 0xcf, 0x94, 0x78, 0x78, 0x3a, 0x8d, 0xe4, 0x21, 0x13 } },
+{ "SD_MESSAGE_SYSTEMD_UDEV_SETTLE_DEPRECATED", { 0x1c, 0x04, 0x54, 0xc1, 0xbd, 0x22, 0x41, 0xe0, 0xac, 0x6f, 0xef, 0xb4, 0xbc, 0x63, 0x14, 0x33 } },
+{ "SD_MESSAGE_SYSTEM_ACCOUNT_REQUIRED", { 0x34, 0x05, 0x20, 0x5d, 0x36, 0x8e, 0x49, 0xfe, 0xb5, 0xab, 0x39, 0x25, 0xfe, 0xe1, 0x38, 0x74 } },
+{ "SD_MESSAGE_SYSTEM_DOCKED", { 0xf5, 0xf4, 0x16, 0xb8, 0x62, 0x07, 0x4b, 0x28, 0x92, 0x7a, 0x48, 0xc3, 0xba, 0x7d, 0x51, 0xff } },
+{ "SD_MESSAGE_SYSTEM_UNDOCKED", { 0x51, 0xe1, 0x71, 0xbd, 0x58, 0x52, 0x48, 0x56, 0x81, 0x10, 0x14, 0x4c, 0x51, 0x7c, 0xca, 0x53 } },
+{ "SD_MESSAGE_SYSV_GENERATOR_DEPRECATED", { 0xa8, 0xfa, 0x8d, 0xac, 0xdb, 0x1d, 0x44, 0x3e, 0x95, 0x03, 0xb8, 0xbe, 0x36, 0x7a, 0x6a, 0xdb } },
+{ "SD_MESSAGE_TAINTED", { 0x50, 0x87, 0x6a, 0x9d, 0xb0, 0x0f, 0x4c, 0x40, 0xbd, 0xe1, 0xa2, 0xad, 0x38, 0x1c, 0x3a, 0x1b } },
+{ "SD_MESSAGE_TIMEZONE_CHANGE", { 0x45, 0xf8, 0x2f, 0x4a, 0xef, 0x7a, 0x4b, 0xbf, 0x94, 0x2c, 0xe8, 0x61, 0xd1, 0xf2, 0x09, 0x90 } },
+{ "SD_MESSAGE_TIME_BUMP", { 0x7d, 0xb7, 0x3c, 0x8a, 0xf0, 0xd9, 0x4e, 0xeb, 0x82, 0x2a, 0xe0, 0x43, 0x23, 0xfe, 0x6a, 0xb6 } },
+{ "SD_MESSAGE_TIME_CHANGE", { 0xc7, 0xa7, 0x87, 0x07, 0x9b, 0x35, 0x4e, 0xaa, 0xa9, 0xe7, 0x7b, 0x37, 0x18, 0x93, 0xcd, 0x27 } },
+{ "SD_MESSAGE_TIME_SYNC", { 0x7c, 0x8a, 0x41, 0xf3, 0x7b, 0x76, 0x49, 0x41, 0xa0, 0xe1, 0x78, 0x0b, 0x1b, 0xe2, 0xf0, 0x37 } },
+{ "SD_MESSAGE_TPM2_CLEAR_REQUESTED", { 0x43, 0x81, 0x88, 0x86, 0x1e, 0x0b, 0x42, 0x7a, 0x9d, 0x63, 0x8a, 0x90, 0x48, 0x7a, 0x0c, 0xa6 } },
+{ "SD_MESSAGE_TPM_NVINDEX_EXHAUSTED", { 0xab, 0x98, 0x4e, 0xa0, 0x08, 0x96, 0x4f, 0xb8, 0x8d, 0x6e, 0x38, 0x9f, 0xb5, 0x13, 0xfb, 0x94 } },
+{ "SD_MESSAGE_TPM_NVPCR_EXTEND", { 0x4c, 0x2e, 0x46, 0xd2, 0x66, 0xa7, 0x47, 0xc6, 0xac, 0x14, 0x60, 0xaa, 0x54, 0x48, 0x4f, 0xa7 } },
+{ "SD_MESSAGE_TPM_NVPCR_UNSUPPORTED", { 0x8f, 0x07, 0xa5, 0xb8, 0x14, 0xca, 0x47, 0x62, 0xb8, 0x9f, 0xcc, 0x30, 0x82, 0xe4, 0x8a, 0xed } },
+{ "SD_MESSAGE_TPM_PCR_EXTEND", { 0x3f, 0x7d, 0x5e, 0xf3, 0xe5, 0x4f, 0x43, 0x02, 0xb4, 0xf0, 0xb1, 0x43, 0xbb, 0x27, 0x0c, 0xab } },
+{ "SD_MESSAGE_TRUNCATED_CORE", { 0x5a, 0xad, 0xd8, 0xe9, 0x54, 0xdc, 0x4b, 0x1a, 0x8c, 0x95, 0x4d, 0x63, 0xfd, 0x9e, 0x11, 0x37 } },
+{ "SD_MESSAGE_UNIT_FAILED", { 0xbe, 0x02, 0xcf, 0x68, 0x55, 0xd2, 0x42, 0x8b, 0xa4, 0x0d, 0xf7, 0xe9, 0xd0, 0x22, 0xf0, 0x3d } },
+{ "SD_MESSAGE_UNIT_FAILURE_RESULT", { 0xd9, 0xb3, 0x73, 0xed, 0x55, 0xa6, 0x4f, 0xeb, 0x82, 0x42, 0xe0, 0x2d, 0xbe, 0x79, 0xa4, 0x9c } },
+{ "SD_MESSAGE_UNIT_OOMD_KILL", { 0xd9, 0x89, 0x61, 0x1b, 0x15, 0xe4, 0x4c, 0x9d, 0xbf, 0x31, 0xe3, 0xc8, 0x12, 0x56, 0xe4, 0xed } },
+{ "SD_MESSAGE_UNIT_ORDERING_CYCLE", { 0xf2, 0x7a, 0x3f, 0x94, 0x40, 0x6a, 0x47, 0x83, 0xb9, 0x46, 0xa9, 0xbc, 0x84, 0x9e, 0x94, 0x52 } },
+{ "SD_MESSAGE_UNIT_OUT_OF_MEMORY", { 0xfe, 0x6f, 0xaa, 0x94, 0xe7, 0x77, 0x46, 0x63, 0xa0, 0xda, 0x52, 0x71, 0x78, 0x91, 0xd8, 0xef } },
+{ "SD_MESSAGE_UNIT_PROCESS_EXIT", { 0x98, 0xe3, 0x22, 0x20, 0x3f, 0x7a, 0x4e, 0xd2, 0x90, 0xd0, 0x9f, 0xe0, 0x3c, 0x09, 0xfe, 0x15 } },
+{ "SD_MESSAGE_UNIT_RELOADED", { 0x7b, 0x05, 0xeb, 0xc6, 0x68, 0x38, 0x42, 0x22, 0xba, 0xa8, 0x88, 0x11, 0x79, 0xcf, 0xda, 0x54 } },
+{ "SD_MESSAGE_UNIT_RELOADING", { 0xd3, 0x4d, 0x03, 0x7f, 0xff, 0x18, 0x47, 0xe6, 0xae, 0x66, 0x9a, 0x37, 0x0e, 0x69, 0x47, 0x25 } },
+{ "SD_MESSAGE_UNIT_RESOURCES", { 0xae, 0x8f, 0x7b, 0x86, 0x6b, 0x03, 0x47, 0xb9, 0xaf, 0x31, 0xfe, 0x1c, 0x80, 0xb1, 0x27, 0xc0 } },
+{ "SD_MESSAGE_UNIT_RESTART_SCHEDULED", { 0x5e, 0xb0, 0x34, 0x94, 0xb6, 0x58, 0x48, 0x70, 0xa5, 0x36, 0xb3, 0x37, 0x29, 0x08, 0x09, 0xb3 } },
+{ "SD_MESSAGE_UNIT_SKIPPED", { 0x0e, 0x42, 0x84, 0xa0, 0xca, 0xca, 0x4b, 0xfc, 0x81, 0xc0, 0xbb, 0x67, 0x86, 0x97, 0x26, 0x73 } },
+{ "SD_MESSAGE_UNIT_STARTED", { 0x39, 0xf5, 0x34, 0x79, 0xd3, 0xa0, 0x45, 0xac, 0x8e, 0x11, 0x78, 0x62, 0x48, 0x23, 0x1f, 0xbf } },
+{ "SD_MESSAGE_UNIT_STARTING", { 0x7d, 0x49, 0x58, 0xe8, 0x42, 0xda, 0x4a, 0x75, 0x8f, 0x6c, 0x1c, 0xdc, 0x7b, 0x36, 0xdc, 0xc5 } },
+{ "SD_MESSAGE_UNIT_STOPPED", { 0x9d, 0x1a, 0xaa, 0x27, 0xd6, 0x01, 0x40, 0xbd, 0x96, 0x36, 0x54, 0x38, 0xaa, 0xd2, 0x02, 0x86 } },
+{ "SD_MESSAGE_UNIT_STOPPING", { 0xde, 0x5b, 0x42, 0x6a, 0x63, 0xbe, 0x47, 0xa7, 0xb6, 0xac, 0x3e, 0xaa, 0xc8, 0x2e, 0x2f, 0x6f } },
+{ "SD_MESSAGE_UNIT_SUCCESS", { 0x7a, 0xd2, 0xd1, 0x89, 0xf7, 0xe9, 0x4e, 0x70, 0xa3, 0x8c, 0x78, 0x13, 0x54, 0x91, 0x24, 0x48 } },
+{ "SD_MESSAGE_UNSAFE_USER_NAME", { 0xb6, 0x1f, 0xda, 0xc6, 0x12, 0xe9, 0x4b, 0x91, 0x82, 0x28, 0x5b, 0x99, 0x88, 0x43, 0x06, 0x1f } },
+{ "SD_MESSAGE_USER_STARTUP_FINISHED", { 0xee, 0xd0, 0x0a, 0x68, 0xff, 0xd8, 0x4e, 0x31, 0x88, 0x21, 0x05, 0xfd, 0x97, 0x3a, 0xbd, 0xd1 } },
+{ "SD_MESSAGE_VALGRIND_HELPER_FORK", { 0xd1, 0x8e, 0x03, 0x39, 0xef, 0xb2, 0x4a, 0x06, 0x8d, 0x9c, 0x10, 0x60, 0x22, 0x10, 0x48, 0xc2 } },
+{ "SD_MESSAGE_WATCHDOG_OPENED", { 0x21, 0x66, 0x8d, 0xbd, 0x3d, 0x7a, 0x4a, 0x32, 0xa2, 0x67, 0x6d, 0x53, 0xda, 0xda, 0xb0, 0x22 } },
+{ "SD_MESSAGE_WATCHDOG_OPEN_FAILED", { 0x37, 0x5a, 0xc1, 0x51, 0xef, 0x9d, 0x4d, 0xe3, 0x90, 0x68, 0xb3, 0xef, 0xbf, 0xed, 0x0c, 0xee } },
+{ "SD_MESSAGE_WATCHDOG_PING_FAILED", { 0x87, 0x39, 0x78, 0x9e, 0xca, 0x06, 0x43, 0x25, 0xaf, 0x15, 0xa8, 0xed, 0x0e, 0xcf, 0xc5, 0x56 } },
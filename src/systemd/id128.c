@@ -1,20 +1,31 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
-/* Our include is first, so that our defines are replaced by the ones
- * from the system header. If the system header has the same definitions
- * (or does not have them at all), this replacement is silent. If the
- * system header has a different definition, we get a warning. A warning
- * means that the system headers changed incompatibly, and we should update
- * our definition.
+/* The constants table below is generated from our defines by
+ * update-constants.py as raw bytes, so the values from the system header are
+ * never used. The header is only included after our defines, so that the
+ * compiler checks them: if the system header has the same definitions (or
+ * does not have them at all), this is silent. If it has a different
+ * definition, we get a warning. A warning means that the system headers
+ * changed incompatibly, and id128-defines.h and id128-constants.h should be
+ * regenerated with the update-constants target.
  */
 #include "id128-defines.h"
 #include <systemd/sd-messages.h>
 
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/random.h>
+
 #include "macro.h"
 #include "pyutil.h"
 
 #define HAVE_SD_ID128_GET_MACHINE_APP_SPECIFIC (LIBSYSTEMD_VERSION >= 240)
 
+#ifndef SD_ID128_STRING_MAX
+#  define SD_ID128_STRING_MAX 33U
+#endif
+
 PyDoc_STRVAR(module__doc__,
              "Python interface to the libsystemd-id128 library.\n\n"
              "Provides SD_MESSAGE_* constants and functions to query and generate\n"
@@ -45,30 +56,389 @@ PyDoc_STRVAR(get_boot__doc__,
              "Wraps sd_id128_get_boot(3)."
 );
 
-static PyObject* make_uuid(sd_id128_t id) {
-        _cleanup_Py_DECREF_ PyObject
-                *uuid = NULL, *UUID = NULL, *bytes = NULL,
-                *args = NULL, *kwargs = NULL;
+static PyObject* id128_to_int(sd_id128_t id) {
+        char s[SD_ID128_STRING_MAX];
+
+        return PyLong_FromString(sd_id128_to_string(id, s), NULL, 16);
+}
+
+typedef struct {
+        PyTypeObject *ID128Type;
+
+        /* uuid.UUID and what is needed to create instances of it, looked up
+         * once at module initialization. */
+        PyObject *UUID_type;
+        PyObject *UUID_kwnames;
+        PyObject *UUID_noargs;
+        PyObject *UUID_safe_unknown;
+        PyObject *UUID_int_name;
+        PyObject *UUID_is_safe_name;
+        bool UUID_fast;
+} ModuleState;
+
+static PyModuleDef module;
+
+static ModuleState* get_state(PyObject *m) {
+        return PyModule_GetState(m);
+}
+
+static ModuleState* get_state_by_type(PyTypeObject *type) {
+        return get_module_state(type, &module);
+}
+
+static PyObject* make_uuid_slow(ModuleState *state, sd_id128_t id) {
+        _cleanup_Py_DECREF_ PyObject *bytes = NULL;
+        PyObject *args[2];
+
+        bytes = PyBytes_FromStringAndSize((const char*) &id.bytes, sizeof(id.bytes));
+        if (!bytes)
+                return NULL;
+
+        /* UUID(bytes=bytes), with a free slot in front of the arguments */
+        args[0] = NULL;
+        args[1] = bytes;
+        return PyObject_Vectorcall(state->UUID_type, args + 1, 0 | PY_VECTORCALL_ARGUMENTS_OFFSET, state->UUID_kwnames);
+}
+
+/* UUID.__init__() is written in Python and mostly validates its arguments.
+ * Our identifiers are always valid, so fill the slots of a bare instance
+ * directly, like UUID.__setstate__() does. */
+static PyObject* make_uuid_fast(ModuleState *state, sd_id128_t id) {
+        PyTypeObject *type = (PyTypeObject*) state->UUID_type;
+        _cleanup_Py_DECREF_ PyObject *uuid = NULL, *i = NULL;
+
+        uuid = type->tp_new(type, state->UUID_noargs, NULL);
+        if (!uuid)
+                return NULL;
+
+        i = id128_to_int(id);
+        if (!i)
+                return NULL;
+
+        if (PyObject_GenericSetAttr(uuid, state->UUID_int_name, i) < 0 ||
+            PyObject_GenericSetAttr(uuid, state->UUID_is_safe_name, state->UUID_safe_unknown) < 0)
+                return NULL;
+
+        Py_INCREF(uuid);
+        return uuid;
+}
+
+static PyObject* make_uuid(ModuleState *state, sd_id128_t id) {
+        return state->UUID_fast ? make_uuid_fast(state, id) : make_uuid_slow(state, id);
+}
+
+static int init_uuid(ModuleState *state) {
+        _cleanup_Py_DECREF_ PyObject *uuid = NULL, *SafeUUID = NULL, *a = NULL, *b = NULL;
+        const sd_id128_t probe = SD_ID128_MAKE(01,23,45,67,89,ab,cd,ef,fe,dc,ba,98,76,54,32,10);
+        int r;
 
         uuid = PyImport_ImportModule("uuid");
         if (!uuid)
+                return -1;
+
+        state->UUID_type = PyObject_GetAttrString(uuid, "UUID");
+        state->UUID_kwnames = Py_BuildValue("(s)", "bytes");
+        if (!state->UUID_type || !state->UUID_kwnames)
+                return -1;
+
+        if (!PyType_Check(state->UUID_type)) {
+                PyErr_SetString(PyExc_TypeError, "uuid.UUID is not a type");
+                return -1;
+        }
+
+        /* Use the fast path only if it gives the same result as the constructor */
+        SafeUUID = PyObject_GetAttrString(uuid, "SafeUUID");
+        if (SafeUUID)
+                state->UUID_safe_unknown = PyObject_GetAttrString(SafeUUID, "unknown");
+        state->UUID_noargs = PyTuple_New(0);
+        state->UUID_int_name = PyUnicode_InternFromString("int");
+        state->UUID_is_safe_name = PyUnicode_InternFromString("is_safe");
+        if (!state->UUID_safe_unknown || !state->UUID_noargs ||
+            !state->UUID_int_name || !state->UUID_is_safe_name) {
+                PyErr_Clear();
+                return 0;
+        }
+
+        a = make_uuid_slow(state, probe);
+        if (!a)
+                return -1;
+
+        b = make_uuid_fast(state, probe);
+        r = b ? PyObject_RichCompareBool(a, b, Py_EQ) : 0;
+        if (r < 0 || !b)
+                PyErr_Clear();
+
+        state->UUID_fast = r > 0;
+        return 0;
+}
+
+typedef struct {
+        PyObject_HEAD
+        sd_id128_t id;
+        Py_hash_t hash;
+} ID128;
+
+/* Accepts an ID128, a uuid.UUID, 16 raw bytes, or a str or bytes object
+ * with 32 hexadecimal digits, optionally formatted as a UUID. */
+static int parse_id128(ModuleState *state, PyObject *obj, sd_id128_t *ret) {
+        _cleanup_Py_DECREF_ PyObject *bytes = NULL;
+        const char *s;
+        Py_ssize_t len;
+        int r;
+
+        if (PyObject_TypeCheck(obj, state->ID128Type)) {
+                *ret = ((ID128*) obj)->id;
+                return 0;
+        }
+
+        r = PyObject_IsInstance(obj, state->UUID_type);
+        if (r < 0)
+                return -1;
+        if (r > 0) {
+                bytes = PyObject_GetAttrString(obj, "bytes");
+                if (!bytes)
+                        return -1;
+                obj = bytes;
+        }
+
+        if (PyBytes_Check(obj)) {
+                s = PyBytes_AS_STRING(obj);
+                len = PyBytes_GET_SIZE(obj);
+
+                if (len == sizeof(ret->bytes)) {
+                        memcpy(ret->bytes, s, sizeof(ret->bytes));
+                        return 0;
+                }
+        } else if (PyUnicode_Check(obj)) {
+                s = PyUnicode_AsUTF8AndSize(obj, &len);
+                if (!s)
+                        return -1;
+        } else {
+                PyErr_Format(PyExc_TypeError,
+                             "expected ID128, UUID, bytes or str, not %.200s", Py_TYPE(obj)->tp_name);
+                return -1;
+        }
+
+        if ((size_t) len != strlen(s) || sd_id128_from_string(s, ret) < 0) {
+                PyErr_Format(PyExc_ValueError, "invalid 128-bit identifier: %R", obj);
+                return -1;
+        }
+        return 0;
+}
+
+PyDoc_STRVAR(ID128__doc__,
+             "ID128(value) -> ID128\n\n"
+             "A 128-bit identifier, which is cheaper to create than uuid.UUID.\n"
+             "value may be an ID128, a UUID, 16 bytes, or a string of 32\n"
+             "hexadecimal digits (optionally formatted as a UUID).\n\n"
+             "ID128 objects are immutable and hashable, and compare and hash equal\n"
+             "to the UUID with the same value. str() returns the 32 hexadecimal\n"
+             "digits, like sd_id128_to_string(3).");
+static PyObject* ID128_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+        ModuleState *state;
+        PyObject *value;
+        sd_id128_t id;
+        ID128 *self;
+
+        static const char* const kwlist[] = {"value", NULL};
+        if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:ID128", (char**) kwlist, &value))
                 return NULL;
 
-        UUID = PyObject_GetAttrString(uuid, "UUID");
-        bytes = PyBytes_FromStringAndSize((const char*) &id.bytes, sizeof(id.bytes));
-        args = Py_BuildValue("()");
-        kwargs = PyDict_New();
-        if (!UUID || !bytes || !args || !kwargs)
+        state = get_state_by_type(type);
+        if (!state)
+                return NULL;
+
+        if (parse_id128(state, value, &id) < 0)
+                return NULL;
+
+        self = (ID128*) type->tp_alloc(type, 0);
+        if (!self)
                 return NULL;
 
-        if (PyDict_SetItemString(kwargs, "bytes", bytes) < 0)
+        self->id = id;
+        self->hash = -1;
+        return (PyObject*) self;
+}
+
+static PyObject* make_id128(ModuleState *state, sd_id128_t id) {
+        ID128 *self;
+
+        self = PyObject_New(ID128, state->ID128Type);
+        if (!self)
                 return NULL;
 
-        return PyObject_Call(UUID, args, kwargs);
+        self->id = id;
+        self->hash = -1;
+        return (PyObject*) self;
+}
+
+static PyObject* ID128_str(ID128 *self) {
+        char s[SD_ID128_STRING_MAX];
+
+        return PyUnicode_FromString(sd_id128_to_string(self->id, s));
+}
+
+static PyObject* ID128_repr(ID128 *self) {
+        char s[SD_ID128_STRING_MAX];
+
+        return PyUnicode_FromFormat("ID128('%s')", sd_id128_to_string(self->id, s));
+}
+
+static Py_hash_t ID128_hash(ID128 *self) {
+        /* Must be equal to the hash of the UUID, i.e. of the int */
+        if (self->hash == -1) {
+                _cleanup_Py_DECREF_ PyObject *i = NULL;
+
+                i = id128_to_int(self->id);
+                if (!i)
+                        return -1;
+                self->hash = PyObject_Hash(i);
+        }
+        return self->hash;
+}
+
+static PyObject* ID128_richcompare(ID128 *self, PyObject *other, int op) {
+        ModuleState *state;
+        sd_id128_t id;
+        int r;
+
+        if (Py_IS_TYPE(other, Py_TYPE(self)))
+                id = ((ID128*) other)->id;
+        else {
+                state = get_state_by_type(Py_TYPE(self));
+                if (!state)
+                        return NULL;
+
+                r = PyObject_IsInstance(other, state->UUID_type);
+                if (r < 0)
+                        return NULL;
+                if (r == 0)
+                        Py_RETURN_NOTIMPLEMENTED;
+                if (parse_id128(state, other, &id) < 0)
+                        return NULL;
+        }
+
+        /* The bytes are big-endian, so this is the order of the UUID ints */
+        r = memcmp(self->id.bytes, id.bytes, sizeof(id.bytes));
+        Py_RETURN_RICHCOMPARE(r, 0, op);
+}
+
+PyDoc_STRVAR(ID128_bytes__doc__, "The identifier as 16 bytes");
+static PyObject* ID128_get_bytes(ID128 *self, void *closure _unused_) {
+        return PyBytes_FromStringAndSize((const char*) self->id.bytes, sizeof(self->id.bytes));
+}
+
+PyDoc_STRVAR(ID128_hex__doc__, "The identifier as 32 hexadecimal digits");
+static PyObject* ID128_get_hex(ID128 *self, void *closure _unused_) {
+        return ID128_str(self);
+}
+
+PyDoc_STRVAR(ID128_int__doc__, "The identifier as a 128-bit integer");
+static PyObject* ID128_get_int(ID128 *self, void *closure _unused_) {
+        return id128_to_int(self->id);
+}
+
+PyDoc_STRVAR(ID128_uuid__doc__, "The identifier as uuid.UUID");
+static PyObject* ID128_get_uuid(ID128 *self, void *closure _unused_) {
+        ModuleState *state;
+
+        state = get_state_by_type(Py_TYPE(self));
+        if (!state)
+                return NULL;
+
+        return make_uuid(state, self->id);
+}
+
+static PyGetSetDef ID128_getsetters[] = {
+        { "bytes", (getter) ID128_get_bytes, NULL, ID128_bytes__doc__, NULL },
+        { "hex",   (getter) ID128_get_hex,   NULL, ID128_hex__doc__,   NULL },
+        { "int",   (getter) ID128_get_int,   NULL, ID128_int__doc__,   NULL },
+        { "uuid",  (getter) ID128_get_uuid,  NULL, ID128_uuid__doc__,  NULL },
+        {}  /* Sentinel */
+};
+
+static PyObject* ID128___reduce__(ID128 *self, PyObject *args) {
+        assert(!args);
+
+        return Py_BuildValue("O(N)", Py_TYPE(self), ID128_str(self));
+}
+
+static PyMethodDef ID128_methods[] = {
+        { "__reduce__", (PyCFunction) ID128___reduce__, METH_NOARGS, NULL },
+        {}  /* Sentinel */
+};
+
+static PyType_Slot ID128_slots[] = {
+        { Py_tp_doc,         (void*) ID128__doc__     },
+        { Py_tp_new,         ID128_new                },
+        { Py_tp_str,         ID128_str                },
+        { Py_tp_repr,        ID128_repr               },
+        { Py_tp_hash,        ID128_hash               },
+        { Py_tp_richcompare, ID128_richcompare        },
+        { Py_tp_getset,      ID128_getsetters         },
+        { Py_tp_methods,     ID128_methods            },
+        {}  /* Sentinel */
+};
+
+static PyType_Spec ID128_spec = {
+        .name = "systemd.id128.ID128",
+        .basicsize = sizeof(ID128),
+        .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_IMMUTABLETYPE,
+        .slots = ID128_slots,
+};
+
+PyDoc_STRVAR(_uuid__doc__,
+             "_uuid(value) -> UUID\n\n"
+             "Return a UUID for any value accepted by ID128(), without the\n"
+             "overhead of the UUID constructor parsing strings.\n"
+             "Used to convert fields read from the journal."
+);
+
+static PyObject* _uuid(PyObject *self, PyObject *value) {
+        ModuleState *state = get_state(self);
+        sd_id128_t id;
+
+        if (parse_id128(state, value, &id) < 0)
+                return NULL;
+
+        return make_uuid(state, id);
+}
+
+PyDoc_STRVAR(_uuid_from_string__doc__,
+             "_uuid_from_string(value) -> UUID\n\n"
+             "Return a UUID for a hexadecimal identifier given as str or bytes.\n"
+             "Unlike _uuid(), 16 bytes are not taken as the raw identifier, so that\n"
+             "malformed journal fields like MESSAGE_ID= raise ValueError."
+);
+
+static PyObject* _uuid_from_string(PyObject *self, PyObject *value) {
+        sd_id128_t id;
+        const char *s;
+        Py_ssize_t len;
+
+        if (PyBytes_Check(value)) {
+                s = PyBytes_AS_STRING(value);
+                len = PyBytes_GET_SIZE(value);
+        } else if (PyUnicode_Check(value)) {
+                s = PyUnicode_AsUTF8AndSize(value, &len);
+                if (!s)
+                        return NULL;
+        } else {
+                PyErr_Format(PyExc_TypeError,
+                             "expected bytes or str, not %.200s", Py_TYPE(value)->tp_name);
+                return NULL;
+        }
+
+        if ((size_t) len != strlen(s) || sd_id128_from_string(s, &id) < 0) {
+                PyErr_Format(PyExc_ValueError, "invalid 128-bit identifier: %R", value);
+                return NULL;
+        }
+
+        return make_uuid(get_state(self), id);
 }
 
 #define helper(name)                                                     \
-        static PyObject *name(PyObject *self _unused_, PyObject *args) { \
+        static PyObject *name(PyObject *self, PyObject *args) {          \
                 sd_id128_t id;                                           \
                 int r;                                                   \
                                                                          \
@@ -80,14 +450,126 @@ static PyObject* make_uuid(sd_id128_t id) {
                         return PyErr_SetFromErrno(PyExc_OSError);        \
                 }                                                        \
                                                                          \
-                return make_uuid(id);                                    \
+                return make_uuid(get_state(self), id);                   \
         }
 
 helper(randomize)
 helper(get_machine)
 helper(get_boot)
 
-static PyObject *get_machine_app_specific(PyObject *self _unused_, PyObject *args) {
+/* Fills buf with n random v4 UUIDs, like n calls to sd_id128_randomize(),
+ * but with as few getrandom() calls as possible. */
+static int randomize_buffer(uint8_t *buf, size_t n) {
+        size_t size = n * sizeof(sd_id128_t), done = 0;
+
+        while (done < size) {
+                ssize_t k;
+
+                k = getrandom(buf + done, size - done, 0);
+                if (k < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        if (errno != ENOSYS)
+                                return -errno;
+
+                        /* No getrandom(), let libsystemd find another source */
+                        for (size_t i = done / sizeof(sd_id128_t); i < n; i++) {
+                                int r;
+
+                                r = sd_id128_randomize((sd_id128_t*) (buf + i * sizeof(sd_id128_t)));
+                                if (r < 0)
+                                        return r;
+                        }
+                        return 0;
+                }
+                done += k;
+        }
+
+        /* Turn this into a valid v4 UUID, to be compatible with RFC 4122 */
+        for (size_t i = 0; i < n; i++) {
+                uint8_t *b = buf + i * sizeof(sd_id128_t);
+
+                b[6] = (b[6] & 0x0F) | 0x40;
+                b[8] = (b[8] & 0x3F) | 0x80;
+        }
+        return 0;
+}
+
+PyDoc_STRVAR(randomize_many__doc__,
+             "randomize_many(n, as_='bytes') -> bytes or list\n\n"
+             "Return n new random 128-bit unique identifiers, like n calls to\n"
+             "randomize(), but generated with a single getrandom(2) call.\n"
+             "With as_='bytes' a single bytes object of n*16 bytes is returned,\n"
+             "which can be sliced (e.g. through a memoryview) without creating\n"
+             "an object per identifier. With as_='uuid', 'id128' or 'hex' a list\n"
+             "of UUID, ID128 or str objects is returned."
+);
+
+static PyObject* randomize_many(PyObject *self, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+        _cleanup_Py_DECREF_ PyObject *bytes = NULL, *list = NULL;
+        _cleanup_free_ uint8_t *buf = NULL;
+        const char *as = "bytes";
+        Py_ssize_t n;
+        uint8_t *p;
+        int r;
+
+        static const char* const kwlist[] = {"n", "as_", NULL};
+        if (!parse_fastcall(args, nargs, kwnames, "n|s:randomize_many", kwlist,
+                            &n, &as))
+                return NULL;
+
+        if (n < 0 || n > PY_SSIZE_T_MAX / (Py_ssize_t) sizeof(sd_id128_t)) {
+                PyErr_SetString(PyExc_ValueError, "n is out of range");
+                return NULL;
+        }
+
+        if (strcmp(as, "bytes") == 0) {
+                bytes = PyBytes_FromStringAndSize(NULL, n * sizeof(sd_id128_t));
+                if (!bytes)
+                        return NULL;
+                p = (uint8_t*) PyBytes_AS_STRING(bytes);
+        } else if (strcmp(as, "uuid") == 0 || strcmp(as, "id128") == 0 || strcmp(as, "hex") == 0) {
+                list = PyList_New(n);
+                p = buf = malloc(n > 0 ? n * sizeof(sd_id128_t) : 1);
+                if (!list || !buf)
+                        return list ? PyErr_NoMemory() : NULL;
+        } else {
+                PyErr_Format(PyExc_ValueError, "as_ must be 'bytes', 'uuid', 'id128' or 'hex', not '%s'", as);
+                return NULL;
+        }
+
+        Py_BEGIN_ALLOW_THREADS
+        r = randomize_buffer(p, n);
+        Py_END_ALLOW_THREADS
+        if (set_error(r, NULL, NULL) < 0)
+                return NULL;
+
+        for (Py_ssize_t i = 0; list && i < n; i++) {
+                char s[SD_ID128_STRING_MAX];
+                sd_id128_t id;
+                PyObject *item;
+
+                memcpy(id.bytes, p + i * sizeof(sd_id128_t), sizeof(id.bytes));
+                if (as[0] == 'u')
+                        item = make_uuid(get_state(self), id);
+                else if (as[0] == 'i')
+                        item = make_id128(get_state(self), id);
+                else
+                        item = PyUnicode_FromString(sd_id128_to_string(id, s));
+                if (!item)
+                        return NULL;
+                PyList_SET_ITEM(list, i, item);
+        }
+
+        if (list) {
+                Py_INCREF(list);
+                return list;
+        }
+        Py_INCREF(bytes);
+        return bytes;
+}
+
+static PyObject *get_machine_app_specific(PyObject *self, PyObject *args) {
         _cleanup_Py_DECREF_ PyObject *uuid_bytes = NULL;
 
         uuid_bytes = PyObject_GetAttrString(args, "bytes");
@@ -115,7 +597,7 @@ static PyObject *get_machine_app_specific(PyObject *self _unused_, PyObject *arg
                 return PyErr_SetFromErrno(PyExc_OSError);
         }
 
-        return make_uuid(app_id);
+        return make_uuid(get_state(self), app_id);
 
 #else
         set_error(-ENOSYS, NULL, "Compiled without support for sd_id128_get_machine_app_specific");
@@ -123,49 +605,194 @@ static PyObject *get_machine_app_specific(PyObject *self _unused_, PyObject *arg
 #endif
 }
 
+/* The SD_MESSAGE_* constants. They are created as UUIDs only when first
+ * accessed through the module __getattr__(), and then stored in the module. */
+typedef struct {
+        const char *name;
+        uint8_t bytes[16];
+} Constant;
+
+static const Constant constants[] = {
+#include "id128-constants.h"
+};
+
+static int compare_constant(const void *key, const void *c) {
+        return strcmp(key, ((const Constant*) c)->name);
+}
+
+PyDoc_STRVAR(module_getattr__doc__,
+             "__getattr__(name) -> UUID\n\n"
+             "Create the SD_MESSAGE_* constant name on first access."
+);
+
+static PyObject* module_getattr(PyObject *self, PyObject *name) {
+        _cleanup_Py_DECREF_ PyObject *obj = NULL;
+        const Constant *c = NULL;
+        const char *s;
+        sd_id128_t id;
+
+        s = PyUnicode_Check(name) ? PyUnicode_AsUTF8(name) : NULL;
+        if (s)
+                c = bsearch(s, constants, sizeof(constants) / sizeof(constants[0]),
+                            sizeof(Constant), compare_constant);
+        if (!c) {
+                PyErr_Clear();
+                return PyErr_Format(PyExc_AttributeError,
+                                    "module '%s' has no attribute %R", PyModule_GetName(self), name);
+        }
+
+        memcpy(id.bytes, c->bytes, sizeof(id.bytes));
+        obj = make_uuid(get_state(self), id);
+        if (!obj)
+                return NULL;
+
+        if (PyObject_SetAttr(self, name, obj) < 0)
+                return NULL;
+
+        Py_INCREF(obj);
+        return obj;
+}
+
+PyDoc_STRVAR(module_dir__doc__,
+             "__dir__() -> list\n\n"
+             "Return the module attributes, including constants not created yet."
+);
+
+static PyObject* module_dir(PyObject *self, PyObject *args) {
+        _cleanup_Py_DECREF_ PyObject *names = NULL;
+
+        assert(!args);
+
+        names = PySequence_List(PyModule_GetDict(self));
+        if (!names)
+                return NULL;
+
+        for (size_t i = 0; i < sizeof(constants) / sizeof(constants[0]); i++) {
+                _cleanup_Py_DECREF_ PyObject *name = NULL;
+                int r;
+
+                name = PyUnicode_FromString(constants[i].name);
+                if (!name)
+                        return NULL;
+
+                r = PySequence_Contains(names, name);
+                if (r < 0)
+                        return NULL;
+                if (r == 0 && PyList_Append(names, name) < 0)
+                        return NULL;
+        }
+
+        if (PyList_Sort(names) < 0)
+                return NULL;
+
+        Py_INCREF(names);
+        return names;
+}
+
+static PyObject* make_all(void) {
+        static const char* const functions[] = {
+                "ID128", "get_boot", "get_machine", "get_machine_app_specific", "randomize",
+                "randomize_many",
+        };
+        const size_t n = sizeof(constants) / sizeof(constants[0]);
+        const size_t m = sizeof(functions) / sizeof(functions[0]);
+        PyObject *all;
+
+        all = PyList_New(m + n);
+        if (!all)
+                return NULL;
+
+        for (size_t i = 0; i < m + n; i++) {
+                PyObject *name;
+
+                name = PyUnicode_InternFromString(i < m ? functions[i] : constants[i - m].name);
+                if (!name) {
+                        Py_DECREF(all);
+                        return NULL;
+                }
+                PyList_SET_ITEM(all, i, name);
+        }
+
+        return all;
+}
+
+DISABLE_WARNING_CAST_FUNCTION_TYPE;
 static PyMethodDef methods[] = {
-        { "randomize",                randomize,                METH_NOARGS, randomize__doc__                },
-        { "get_machine",              get_machine,              METH_NOARGS, get_machine__doc__              },
-        { "get_machine_app_specific", get_machine_app_specific, METH_O,      get_machine_app_specific__doc__ },
-        { "get_boot",                 get_boot,                 METH_NOARGS, get_boot__doc__                 },
+        { "randomize",                randomize,                     METH_NOARGS,                   randomize__doc__                },
+        { "randomize_many",           (PyCFunction) randomize_many,  METH_FASTCALL | METH_KEYWORDS, randomize_many__doc__           },
+        { "get_machine",              get_machine,                   METH_NOARGS,                   get_machine__doc__              },
+        { "get_machine_app_specific", get_machine_app_specific,      METH_O,                        get_machine_app_specific__doc__ },
+        { "get_boot",                 get_boot,                      METH_NOARGS,                   get_boot__doc__                 },
+        { "_uuid",                    _uuid,                         METH_O,                        _uuid__doc__                    },
+        { "_uuid_from_string",        _uuid_from_string,             METH_O,                        _uuid_from_string__doc__        },
+        { "__getattr__",              module_getattr,                METH_O,                        module_getattr__doc__           },
+        { "__dir__",                  module_dir,                    METH_NOARGS,                   module_dir__doc__               },
         {}        /* Sentinel */
 };
+REENABLE_WARNING;
 
-static int add_id(PyObject *module, const char* name, sd_id128_t id) {
-        PyObject *obj;
+static int module_traverse(PyObject *m, visitproc visit, void *arg) {
+        ModuleState *state = get_state(m);
+
+        Py_VISIT(state->ID128Type);
+        Py_VISIT(state->UUID_type);
+        Py_VISIT(state->UUID_kwnames);
+        Py_VISIT(state->UUID_noargs);
+        Py_VISIT(state->UUID_safe_unknown);
+        Py_VISIT(state->UUID_int_name);
+        Py_VISIT(state->UUID_is_safe_name);
+        return 0;
+}
 
-        obj = make_uuid(id);
-        if (!obj)
+static int module_clear(PyObject *m) {
+        ModuleState *state = get_state(m);
+
+        Py_CLEAR(state->ID128Type);
+        Py_CLEAR(state->UUID_type);
+        Py_CLEAR(state->UUID_kwnames);
+        Py_CLEAR(state->UUID_noargs);
+        Py_CLEAR(state->UUID_safe_unknown);
+        Py_CLEAR(state->UUID_int_name);
+        Py_CLEAR(state->UUID_is_safe_name);
+        return 0;
+}
+
+static void module_free(void *m) {
+        module_clear(m);
+}
+
+static int module_exec(PyObject *m) {
+        ModuleState *state = get_state(m);
+
+        if (module_add_type(m, &ID128_spec, &state->ID128Type) < 0 ||
+            init_uuid(state) < 0)
+                return -1;
+
+        if (PyModule_AddObject(m, "__all__", make_all()) ||
+            PyModule_AddStringConstant(m, "__version__", PACKAGE_VERSION))
                 return -1;
 
-        return PyModule_AddObject(module, name, obj);
+        return 0;
 }
 
-static struct PyModuleDef module = {
+static PyModuleDef_Slot module_slots[] = {
+        MODULE_SLOTS(module_exec),
+};
+
+static PyModuleDef module = {
         PyModuleDef_HEAD_INIT,
         .m_name = "id128", /* name of module */
         .m_doc = module__doc__, /* module documentation */
-        .m_size = -1, /* size of per-interpreter state of the module */
+        .m_size = sizeof(ModuleState), /* size of per-interpreter state of the module */
         .m_methods = methods,
+        .m_slots = module_slots,
+        .m_traverse = module_traverse,
+        .m_clear = module_clear,
+        .m_free = module_free,
 };
 
 DISABLE_WARNING_MISSING_PROTOTYPES;
 PyMODINIT_FUNC PyInit_id128(void) {
-        PyObject *m;
-
-        m = PyModule_Create(&module);
-        if (!m)
-                return NULL;
-
-        if ( /* a series of lines like 'add_id() ||' follow */
-#define JOINER ||
-#include "id128-constants.h"
-#undef JOINER
-            PyModule_AddStringConstant(m, "__version__", PACKAGE_VERSION)) {
-                Py_DECREF(m);
-                return NULL;
-        }
-
-        return m;
+        return PyModuleDef_Init(&module);
 }
 REENABLE_WARNING;
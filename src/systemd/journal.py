@@ -5,11 +5,13 @@ import datetime as _datetime
 import uuid as _uuid
 import traceback as _traceback
 import os as _os
+import time as _time
 import logging as _logging
 from syslog import (LOG_EMERG, LOG_ALERT, LOG_CRIT, LOG_ERR,
                     LOG_WARNING, LOG_NOTICE, LOG_INFO, LOG_DEBUG)
 
-from ._journal import __version__, sendv, stream_fd
+from ._journal import (__version__, sendv, stream_fd, set_socket, _encode_fields,
+                       JournalStream, RateLimiter, SharedLogRing, JournalServer)
 from ._reader import (_Reader, NOP, APPEND, INVALIDATE,
                       LOCAL_ONLY, RUNTIME_ONLY,
                       SYSTEM, SYSTEM_ONLY, CURRENT_USER,
@@ -20,7 +22,7 @@ from . import id128 as _id128
 
 def _convert_monotonic(m):
     return Monotonic((_datetime.timedelta(microseconds=m[0]),
-                      _uuid.UUID(bytes=m[1])))
+                      _id128._uuid(m[1])))
 
 
 def _convert_source_monotonic(s):
@@ -42,8 +44,7 @@ def _convert_trivial(x):
     return x
 
 
-def _convert_uuid(s):
-    return _uuid.UUID(s.decode())
+_convert_uuid = _id128._uuid_from_string
 
 
 DEFAULT_CONVERTERS = {
@@ -89,6 +90,12 @@ def _valid_field_name(s):
     return not (set(s) - _IDENT_CHARACTER)
 
 
+def _valid_attribute_field_name(s):
+    # Like journald, which drops names starting with a digit or longer than
+    # 64 characters, and trusts only its own names starting with '_'
+    return 0 < len(s) <= 64 and s[0] not in '_0123456789' and _valid_field_name(s)
+
+
 class Reader(_Reader):
     """Access systemd journal entries.
 
@@ -115,7 +122,8 @@ class Reader(_Reader):
     journal.
 
     """
-    def __init__(self, flags=None, path=None, files=None, converters=None, namespace=None):
+    def __init__(self, flags=None, path=None, files=None, converters=None, namespace=None,
+                 collect_stats=False):
         """Create a new Reader.
 
         Argument `flags` defines the open flags of the journal, which can be one
@@ -136,6 +144,10 @@ class Reader(_Reader):
         unconverted bytes object will be returned. (Note that ValueEror is a
         superclass of UnicodeDecodeError).
 
+        If `collect_stats` is true, counters of the work done by the Reader are
+        collected, see `stats`. This can also be switched at runtime through the
+        `collect_stats` attribute.
+
         Reader implements the context manager protocol: the journal will be
         closed when exiting the block.
         """
@@ -150,6 +162,8 @@ class Reader(_Reader):
         self.converters = DEFAULT_CONVERTERS.copy()
         if converters is not None:
             self.converters.update(converters)
+        self.collect_stats = collect_stats
+        self._convert_ns = 0
 
     def _convert_field(self, key, value):
         """Convert value using self.converters[key].
@@ -227,9 +241,30 @@ class Reader(_Reader):
                 entry['__REALTIME_TIMESTAMP'] = self._get_realtime()
                 entry['__MONOTONIC_TIMESTAMP'] = self._get_monotonic()
                 entry['__CURSOR'] = self._get_cursor()
-                return self._convert_entry(entry)
+                if not self.collect_stats:
+                    return self._convert_entry(entry)
+                start = _time.perf_counter_ns()
+                try:
+                    return self._convert_entry(entry)
+                finally:
+                    self._convert_ns += _time.perf_counter_ns() - start
         return dict()
 
+    def stats(self):
+        """Return the statistics collected while `collect_stats` was set.
+
+        In addition to the counters of the underlying _Reader, `convert_ns` is
+        the time spent in converters by get_next() in nanoseconds.
+        """
+        stats = super(Reader, self).stats()
+        stats['convert_ns'] = self._convert_ns
+        return stats
+
+    def reset_stats(self):
+        """Reset all statistics to zero."""
+        super(Reader, self).reset_stats()
+        self._convert_ns = 0
+
     def get_previous(self, skip=1):
         r"""Return the previous log entry.
 
@@ -383,8 +418,61 @@ def _make_line(field, value):
         return field + '=' + str(value)
 
 
+def _encode_line(field, value):
+    """Return "FIELD=value" as bytes, in the form that send() would use."""
+    if field == 'MESSAGE_ID':
+        value = getattr(value, 'hex', value)
+    if isinstance(value, bytes):
+        return field.encode('utf-8') + b'=' + value
+    if not isinstance(value, str):
+        value = str(value)
+    return (field + '=' + value).encode('utf-8')
+
+
+_PRIORITY_LINES = [b'PRIORITY=%d' % pri for pri in range(LOG_DEBUG + 1)]
+
+
+def _priority_line(pri):
+    # map_priority() may be overridden to return something outside of 0…7
+    if type(pri) is int and 0 <= pri <= LOG_DEBUG:
+        return _PRIORITY_LINES[pri]
+    return _encode_line('PRIORITY', format(pri))
+
+# Fields which JournalHandler derives from each record. Attributes whose
+# upper case names collide with them, or with the fields passed to the
+# handler, are not sent when structured=True.
+_RECORD_FIELDS = frozenset({'MESSAGE', 'PRIORITY', 'LOGGER', 'THREAD_NAME',
+                            'PROCESS_NAME', 'CODE_FILE', 'CODE_LINE',
+                            'CODE_FUNC', 'CODE_ARGS', 'EXCEPTION_TEXT',
+                            'EXCEPTION_INFO'})
+
+# Upper bound on the number of distinct encoded LOGGER, CODE_FILE, … lines
+# cached by each JournalHandler.
+_FIELD_CACHE_SIZE = 1024
+
+
+def _suppressed_fields(key, count):
+    """Return the fields of a summary entry for messages dropped by a RateLimiter."""
+    if isinstance(key, tuple):
+        key = ':'.join(map(str, key))
+    elif key is None:
+        key = 'other'
+    return {'MESSAGE': 'Suppressed {:d} messages for {}'.format(count, key),
+            'PRIORITY': LOG_WARNING,
+            'SUPPRESSED_KEY': key,
+            'SUPPRESSED_COUNT': count}
+
+
+def _send_suppressed(ratelimit, sender, *extra):
+    for key, count in ratelimit.flush():
+        fields = _suppressed_fields(key, count)
+        sender(*(_encode_line(name, value) for name, value in fields.items()),
+               *extra)
+
+
 def send(MESSAGE, MESSAGE_ID=None,
          CODE_FILE=None, CODE_LINE=None, CODE_FUNC=None,
+         *, ratelimit=None, ratelimit_key=None,
          **kwargs):
     r"""Send a message to the journal.
 
@@ -410,8 +498,34 @@ def send(MESSAGE, MESSAGE_ID=None,
 
     Other useful fields include PRIORITY, SYSLOG_FACILITY, SYSLOG_IDENTIFIER,
     SYSLOG_PID.
+
+    If a `RateLimiter` is passed as `ratelimit`, the message is dropped when
+    the limit for `ratelimit_key` is exceeded. The key defaults to MESSAGE_ID,
+    or to the CODE_FILE and CODE_LINE of the caller. Counts of dropped
+    messages are periodically sent as summary entries with the fields
+    SUPPRESSED_KEY and SUPPRESSED_COUNT:
+
+    >>> limiter = journal.RateLimiter(rate=10, burst=100)
+    >>> for i in range(1000):
+    ...     journal.send('Connection failed', ratelimit=limiter)
     """
 
+    if ratelimit is not None:
+        if ratelimit_key is not None:
+            pass
+        elif MESSAGE_ID is not None:
+            ratelimit_key = getattr(MESSAGE_ID, 'hex', MESSAGE_ID)
+        elif CODE_FILE is CODE_LINE is None:
+            frame = _sys._getframe(1)
+            ratelimit_key = frame.f_code.co_filename, frame.f_lineno
+        else:
+            ratelimit_key = CODE_FILE, CODE_LINE
+        allowed = ratelimit.check(ratelimit_key)
+        if ratelimit.pending:
+            _send_suppressed(ratelimit, sendv)
+        if not allowed:
+            return
+
     args = ['MESSAGE=' + MESSAGE]
 
     if MESSAGE_ID is not None:
@@ -431,14 +545,18 @@ def send(MESSAGE, MESSAGE_ID=None,
     return sendv(*args)
 
 
-def stream(identifier=None, priority=LOG_INFO, level_prefix=False):
+def stream(identifier=None, priority=LOG_INFO, level_prefix=False,
+           buffered=False, buffer_size=16384, flush_interval=0.1):
     r"""Return a file object wrapping a stream to journal.
 
     Log messages written to this file as simple newline sepearted text strings
     are written to the journal.
 
-    The file will be line buffered, so messages are actually sent after a
-    newline character is written.
+    With `buffered=True`, the file is a `JournalStream` instead of a line
+    buffered text file. It accepts bytes too, buffers written data, and
+    passes it on to the journal with a single write when `buffer_size` bytes
+    have accumulated, when flush() is called, or at the latest
+    `flush_interval` seconds after the first unflushed write.
 
     >>> from systemd import journal
     >>> stream = journal.stream('myapp')                       # doctest: +SKIP
@@ -471,7 +589,13 @@ def stream(identifier=None, priority=LOG_INFO, level_prefix=False):
             identifier = _sys.argv[0]
 
     fd = stream_fd(identifier, priority, level_prefix)
-    return _os.fdopen(fd, 'w', 1)
+    if not buffered:
+        return _os.fdopen(fd, 'w', 1)
+    try:
+        return JournalStream(fd, buffer_size, int(flush_interval * 1000000))
+    except BaseException:
+        _os.close(fd)
+        raise
 
 
 class JournalHandler(_logging.Handler):
@@ -522,11 +646,54 @@ class JournalHandler(_logging.Handler):
     supplied to getLogger call), `MESSAGE_ID` (optional, see above),
     `SYSLOG_IDENTIFIER` (defaults to sys.argv[0]).
 
+    By default, all attributes of the log record are sent as journal fields
+    too. This includes the standard attributes set by the logging module
+    (`msg`, `args`, `created`, …), which journald will discard because their
+    names are not valid field names. With `structured=True`, only attributes
+    not in `standard_attributes` (by default `STANDARD_ATTRIBUTES`) are sent,
+    i.e. those passed through `extra=`, and their names are converted to
+    upper case. Attributes which do not form valid field names, or which would
+    replace one of the fields listed above derived from the record, like
+    `priority` or `code_file`, or a field passed to the handler, like
+    `syslog_identifier`, are skipped:
+
+    >>> handler = JournalHandler(structured=True)
+    >>> log.addHandler(handler)
+    >>> log.warning("Message with fields", extra={'request_id': 42})
+
+    will send `REQUEST_ID=42` along with the usual fields.
+
     The function used to actually send messages can be overridden using
-    the `sender_function` parameter.
+    the `sender_function` parameter. With the default, fields which do not
+    change between records are encoded only once and passed to `sendv`
+    directly.
+
+    In a preforking server, entries can be funneled through a `SharedLogRing`
+    created before the workers are forked by passing it as `ring`. Workers then
+    only queue entries, which are forwarded by the drainer of the ring:
+
+    >>> ring = SharedLogRing()
+    >>> handler = JournalHandler(ring=ring)
+    >>> ring.start()                              # doctest: +SKIP
+
+    Records can be rate limited and sampled by passing a `RateLimiter` as
+    `ratelimit`. This is checked before the record is formatted. Records are
+    grouped by the `ratelimit_key` attribute if set through `extra=`, then by
+    MESSAGE_ID, and otherwise by the location of the logging call. Summaries of
+    dropped records are sent periodically, see `send`:
+
+    >>> handler = JournalHandler(ratelimit=RateLimiter(rate=1, burst=10))
     """
 
-    def __init__(self, level=_logging.NOTSET, sender_function=send, **kwargs):
+    #: Attributes which the logging module sets on every LogRecord. These are
+    #: not sent as journal fields when `structured=True` is used.
+    STANDARD_ATTRIBUTES = frozenset(
+        vars(_logging.LogRecord('', _logging.NOTSET, '', 0, '', (), None))) | {
+            'message', 'asctime', 'taskName'}
+
+    def __init__(self, level=_logging.NOTSET, sender_function=send,
+                 structured=False, standard_attributes=None, ring=None,
+                 ratelimit=None, **kwargs):
         super(JournalHandler, self).__init__(level)
 
         for name in kwargs:
@@ -537,6 +704,23 @@ class JournalHandler(_logging.Handler):
 
         self.send = sender_function
         self._extra = kwargs
+        self._ring = ring
+        self._ratelimit = ratelimit
+        if structured:
+            if standard_attributes is None:
+                standard_attributes = self.STANDARD_ATTRIBUTES
+            # used to group records in rate limiting, not sent
+            self._skip_attributes = frozenset(standard_attributes) | {'ratelimit_key'}
+        else:
+            self._skip_attributes = None
+        self._reserved_fields = _RECORD_FIELDS | frozenset(kwargs)
+
+        # Fields which are constant for the lifetime of the handler are
+        # encoded once here, and fields which only depend on the logger or
+        # the call site are encoded once per distinct value in emit().
+        self._static_fields = [(name, _encode_line(name, value))
+                               for name, value in kwargs.items()]
+        self._field_cache = {}
 
     @classmethod
     def with_args(cls, config=None):
@@ -559,6 +743,27 @@ class JournalHandler(_logging.Handler):
         LOGGER, THREAD_NAME, CODE_{FILE,LINE,FUNC} fields are appended
         automatically. In addition, record.MESSAGE_ID will be used if present.
         """
+        if self._ratelimit is not None:
+            try:
+                allowed = self._ratelimit.check(self._ratelimit_key(record))
+                if self._ratelimit.pending:
+                    self._send_suppressed()
+            except Exception:
+                self.handleError(record)
+                return
+            if not allowed:
+                return
+
+        if self.send is send:
+            try:
+                if self._ring is not None:
+                    self._ring.sendv(*self._encode_record(record))
+                else:
+                    sendv(*self._encode_record(record))
+            except Exception:
+                self.handleError(record)
+            return
+
         try:
             msg = self.format(record)
             pri = self.map_priority(record.levelno)
@@ -576,7 +781,10 @@ class JournalHandler(_logging.Handler):
                 extras['CODE_ARGS'] = str(record.args)
 
             # explicit arguments — highest priority
-            extras.update(record.__dict__)
+            if self._skip_attributes is not None:
+                extras.update(self._record_extras(record))
+            else:
+                extras.update(record.__dict__)
 
             self.send(msg,
                       PRIORITY=format(pri),
@@ -590,6 +798,99 @@ class JournalHandler(_logging.Handler):
         except Exception:
             self.handleError(record)
 
+    @staticmethod
+    def _ratelimit_key(record):
+        key = getattr(record, 'ratelimit_key', None)
+        if key is None:
+            key = getattr(record, 'MESSAGE_ID', None)
+        if key is None:
+            return record.pathname, record.lineno
+        return getattr(key, 'hex', key)
+
+    def _send_suppressed(self):
+        if self.send is send:
+            sender = self._ring.sendv if self._ring is not None else sendv
+            _send_suppressed(self._ratelimit, sender,
+                             *(line for name, line in self._static_fields))
+            return
+
+        for key, count in self._ratelimit.flush():
+            fields = dict(self._extra, **_suppressed_fields(key, count))
+            self.send(fields.pop('MESSAGE'), **fields)
+
+    def _record_extras(self, record):
+        """Return the non-standard attributes of `record` as journal fields.
+
+        This is the dictionary equivalent of _encode_fields(), used when a
+        custom `sender_function` is set.
+        """
+        extras = {}
+        for key, value in record.__dict__.items():
+            if key in self._skip_attributes:
+                continue
+            key = key.upper()
+            if key not in self._reserved_fields and _valid_attribute_field_name(key):
+                extras[key] = value
+        return extras
+
+    def _cached_line(self, field, value):
+        key = (field, value)
+        try:
+            return self._field_cache[key]
+        except KeyError:
+            if len(self._field_cache) >= _FIELD_CACHE_SIZE:
+                self._field_cache.clear()
+            line = self._field_cache[key] = _encode_line(field, value)
+            return line
+
+    def _encode_record(self, record):
+        """Return the fields for `record` as a list of encoded lines for sendv().
+
+        This produces the same entry as the fields passed to `sender_function`
+        in emit(), but reuses lines encoded in earlier calls where possible.
+        """
+        msg = self.format(record)
+        pri = self.map_priority(record.levelno)
+        attrs = record.__dict__
+
+        args = [_encode_line('MESSAGE', msg),
+                _priority_line(pri),
+                self._cached_line('LOGGER', record.name),
+                self._cached_line('THREAD_NAME', record.threadName),
+                self._cached_line('PROCESS_NAME', record.processName),
+                self._cached_line('CODE_FILE', record.pathname),
+                b'CODE_LINE=%d' % record.lineno,
+                self._cached_line('CODE_FUNC', record.funcName)]
+
+        # Without structured=True, the attributes of the record are sent with
+        # their own names, and replace the fields set here. With it, colliding
+        # attributes are skipped by _encode_fields() instead, like in
+        # _record_extras().
+        structured = self._skip_attributes is not None
+        overrides = () if structured else attrs
+
+        # defaults, unless overridden by the record
+        args.extend(line for name, line in self._static_fields
+                    if name not in overrides)
+
+        # higher priority
+        if record.exc_text and 'EXCEPTION_TEXT' not in overrides:
+            args.append(_encode_line('EXCEPTION_TEXT', record.exc_text))
+
+        if record.exc_info and 'EXCEPTION_INFO' not in overrides:
+            args.append(_encode_line('EXCEPTION_INFO', record.exc_info))
+
+        if record.args and 'CODE_ARGS' not in overrides:
+            args.append(_encode_line('CODE_ARGS', str(record.args)))
+
+        # explicit arguments — highest priority
+        if structured:
+            args.extend(_encode_fields(attrs, self._skip_attributes,
+                                       self._reserved_fields))
+        else:
+            args.extend(_encode_line(key, val) for key, val in attrs.items())
+        return args
+
     @staticmethod
     def map_priority(levelno):
         """Map logging levels to journald priorities.
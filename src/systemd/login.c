@@ -1,5 +1,12 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
 #include <systemd/sd-login.h>
 
 #include "pyutil.h"
@@ -98,11 +105,465 @@ PyDoc_STRVAR(uids__doc__,
              "Wraps sd_get_uids(3)."
 );
 
+/* snapshot(): all sessions, users, seats and machines with their properties.
+ * Everything is first collected into plain C structures with the GIL
+ * released, and only then converted into struct sequences. Properties which
+ * cannot be queried, e.g. because the session ended in the meantime or the
+ * property is not set, are None. */
+
+#define HAVE_SESSION_GET_LEADER   (LIBSYSTEMD_VERSION >= 254)
+#define HAVE_SESSION_GET_USERNAME (LIBSYSTEMD_VERSION >= 254)
+
+typedef struct {
+        char *id;
+        uid_t uid;
+        bool has_uid;
+        char *username, *seat, *tty, *display, *state, *class, *type, *service, *desktop;
+        char *remote_host, *remote_user;
+        pid_t leader;
+        unsigned vt;
+        bool has_vt;
+        int remote, active;      /* negative if unknown */
+} SessionData;
+
+typedef struct {
+        uid_t uid;
+        char *state, *display;
+        char **sessions;
+} UserData;
+
+typedef struct {
+        char *id;
+        char *active_session;
+        uid_t active_uid;
+        bool has_active;
+        char **sessions;
+        int can_multi_session, can_tty, can_graphical;
+} SeatData;
+
+typedef struct {
+        char *name;
+        char *class;
+} MachineData;
+
+typedef struct {
+        SessionData *sessions;
+        UserData *users;
+        SeatData *seats;
+        MachineData *machines;
+        size_t n_sessions, n_users, n_seats, n_machines;
+} SnapshotData;
+
+static void session_data_done(SessionData *s) {
+        free(s->id);
+        free(s->username);
+        free(s->seat);
+        free(s->tty);
+        free(s->display);
+        free(s->state);
+        free(s->class);
+        free(s->type);
+        free(s->service);
+        free(s->desktop);
+        free(s->remote_host);
+        free(s->remote_user);
+}
+
+static void user_data_done(UserData *u) {
+        free(u->state);
+        free(u->display);
+        strv_free(u->sessions);
+}
+
+static void seat_data_done(SeatData *s) {
+        free(s->id);
+        free(s->active_session);
+        strv_free(s->sessions);
+}
+
+static void machine_data_done(MachineData *m) {
+        free(m->name);
+        free(m->class);
+}
+
+static void snapshot_data_free(SnapshotData *d) {
+        for (size_t i = 0; i < d->n_sessions; i++)
+                session_data_done(d->sessions + i);
+        for (size_t i = 0; i < d->n_users; i++)
+                user_data_done(d->users + i);
+        for (size_t i = 0; i < d->n_seats; i++)
+                seat_data_done(d->seats + i);
+        for (size_t i = 0; i < d->n_machines; i++)
+                machine_data_done(d->machines + i);
+        free(d->sessions);
+        free(d->users);
+        free(d->seats);
+        free(d->machines);
+}
+
+static void collect_session(SessionData *s) {
+        s->has_uid = sd_session_get_uid(s->id, &s->uid) >= 0;
+#if HAVE_SESSION_GET_USERNAME
+        (void) sd_session_get_username(s->id, &s->username);
+#endif
+        (void) sd_session_get_seat(s->id, &s->seat);
+        (void) sd_session_get_tty(s->id, &s->tty);
+        (void) sd_session_get_display(s->id, &s->display);
+        (void) sd_session_get_state(s->id, &s->state);
+        (void) sd_session_get_class(s->id, &s->class);
+        (void) sd_session_get_type(s->id, &s->type);
+        (void) sd_session_get_service(s->id, &s->service);
+        (void) sd_session_get_desktop(s->id, &s->desktop);
+        (void) sd_session_get_remote_host(s->id, &s->remote_host);
+        (void) sd_session_get_remote_user(s->id, &s->remote_user);
+#if HAVE_SESSION_GET_LEADER
+        if (sd_session_get_leader(s->id, &s->leader) < 0)
+                s->leader = 0;
+#endif
+        s->has_vt = sd_session_get_vt(s->id, &s->vt) >= 0;
+        s->remote = sd_session_is_remote(s->id);
+        s->active = sd_session_is_active(s->id);
+}
+
+static void collect_user(UserData *u) {
+        (void) sd_uid_get_state(u->uid, &u->state);
+        (void) sd_uid_get_display(u->uid, &u->display);
+        if (sd_uid_get_sessions(u->uid, false, &u->sessions) < 0)
+                u->sessions = NULL;
+}
+
+static void collect_seat(SeatData *s) {
+        s->has_active = sd_seat_get_active(s->id, &s->active_session, &s->active_uid) >= 0;
+        if (sd_seat_get_sessions(s->id, &s->sessions, NULL, NULL) < 0)
+                s->sessions = NULL;
+        s->can_multi_session = sd_seat_can_multi_session(s->id);
+        s->can_tty = sd_seat_can_tty(s->id);
+        s->can_graphical = sd_seat_can_graphical(s->id);
+}
+
+/* Moves the strings of a strv into the id field of a newly allocated array of
+ * structures of the given size. */
+static void* strv_to_array(char **l, int n, size_t size, size_t offset) {
+        char *array;
+
+        array = calloc(n > 0 ? n : 1, size);
+        if (!array)
+                return NULL;
+
+        for (int i = 0; i < n; i++) {
+                *(char**) (array + i * size + offset) = l[i];
+                l[i] = NULL;
+        }
+        return array;
+}
+
+static int snapshot_collect(SnapshotData *d) {
+        _cleanup_strv_free_ char **sessions = NULL, **seats = NULL, **machines = NULL;
+        _cleanup_free_ uid_t *uids = NULL;
+        int n_sessions, n_uids, n_seats, n_machines;
+
+        n_sessions = sd_get_sessions(&sessions);
+        if (n_sessions < 0)
+                return n_sessions;
+        n_uids = sd_get_uids(&uids);
+        if (n_uids < 0)
+                return n_uids;
+        n_seats = sd_get_seats(&seats);
+        if (n_seats < 0)
+                return n_seats;
+        n_machines = sd_get_machine_names(&machines);
+        if (n_machines < 0)
+                return n_machines;
+
+        /* Each count is set as soon as its array owns the strings, so that
+         * snapshot_data_free() releases them if a later allocation fails. */
+        d->sessions = strv_to_array(sessions, n_sessions, sizeof(SessionData), offsetof(SessionData, id));
+        if (!d->sessions)
+                return -ENOMEM;
+        d->n_sessions = n_sessions;
+        d->users = calloc(n_uids > 0 ? n_uids : 1, sizeof(UserData));
+        if (!d->users)
+                return -ENOMEM;
+        d->n_users = n_uids;
+        d->seats = strv_to_array(seats, n_seats, sizeof(SeatData), offsetof(SeatData, id));
+        if (!d->seats)
+                return -ENOMEM;
+        d->n_seats = n_seats;
+        d->machines = strv_to_array(machines, n_machines, sizeof(MachineData), offsetof(MachineData, name));
+        if (!d->machines)
+                return -ENOMEM;
+        d->n_machines = n_machines;
+
+        for (size_t i = 0; i < d->n_sessions; i++)
+                collect_session(d->sessions + i);
+        for (size_t i = 0; i < d->n_users; i++) {
+                d->users[i].uid = uids[i];
+                collect_user(d->users + i);
+        }
+        for (size_t i = 0; i < d->n_seats; i++)
+                collect_seat(d->seats + i);
+        for (size_t i = 0; i < d->n_machines; i++)
+                (void) sd_machine_get_class(d->machines[i].name, &d->machines[i].class);
+
+        return 0;
+}
+
+typedef struct {
+        PyTypeObject *MonitorType;
+        PyTypeObject *StateCacheType;
+        PyTypeObject *SessionType;
+        PyTypeObject *UserType;
+        PyTypeObject *SeatType;
+        PyTypeObject *MachineType;
+        PyTypeObject *SnapshotType;
+        PyTypeObject *StateChangeType;
+} ModuleState;
+
+static PyModuleDef module;
+
+static PyStructSequence_Field Session_fields[] = {
+        {(char*) "id", (char*) "Session identifier"},
+        {(char*) "uid", (char*) "User id of the owner"},
+        {(char*) "username", (char*) "User name of the owner (libsystemd >= 254)"},
+        {(char*) "seat", (char*) "Seat the session is attached to"},
+        {(char*) "tty", (char*) "TTY of the session"},
+        {(char*) "display", (char*) "X11 display of the session"},
+        {(char*) "state", (char*) "'online', 'active' or 'closing'"},
+        {(char*) "class", (char*) "Session class, e.g. 'user' or 'greeter'"},
+        {(char*) "type", (char*) "Session type, e.g. 'tty' or 'wayland'"},
+        {(char*) "service", (char*) "PAM service which registered the session"},
+        {(char*) "desktop", (char*) "Desktop environment"},
+        {(char*) "remote", (char*) "True iff the session is remote"},
+        {(char*) "remote_host", (char*) "Remote host of a remote session"},
+        {(char*) "remote_user", (char*) "Remote user of a remote session"},
+        {(char*) "leader", (char*) "PID of the session leader (libsystemd >= 254)"},
+        {(char*) "vt", (char*) "Virtual terminal number"},
+        {(char*) "active", (char*) "True iff the session is active on its seat"},
+        {} /* Sentinel */
+};
+
+static PyStructSequence_Field User_fields[] = {
+        {(char*) "uid", (char*) "User id"},
+        {(char*) "state", (char*) "'offline', 'lingering', 'online', 'active' or 'closing'"},
+        {(char*) "display", (char*) "Primary graphical session of the user"},
+        {(char*) "sessions", (char*) "Tuple of session identifiers of the user"},
+        {} /* Sentinel */
+};
+
+static PyStructSequence_Field Seat_fields[] = {
+        {(char*) "id", (char*) "Seat identifier"},
+        {(char*) "active_session", (char*) "Identifier of the active session"},
+        {(char*) "active_uid", (char*) "User id of the owner of the active session"},
+        {(char*) "sessions", (char*) "Tuple of session identifiers on the seat"},
+        {(char*) "can_multi_session", (char*) "True iff the seat supports multiple sessions"},
+        {(char*) "can_tty", (char*) "True iff the seat has text consoles"},
+        {(char*) "can_graphical", (char*) "True iff the seat has a graphics device"},
+        {} /* Sentinel */
+};
+
+static PyStructSequence_Field Machine_fields[] = {
+        {(char*) "name", (char*) "Machine name"},
+        {(char*) "class", (char*) "'vm' or 'container'"},
+        {} /* Sentinel */
+};
+
+static PyStructSequence_Field Snapshot_fields[] = {
+        {(char*) "sessions", (char*) "Tuple of Session"},
+        {(char*) "users", (char*) "Tuple of User"},
+        {(char*) "seats", (char*) "Tuple of Seat"},
+        {(char*) "machines", (char*) "Tuple of Machine"},
+        {} /* Sentinel */
+};
+
+static PyStructSequence_Desc Session_desc = {
+        (char*) "login.Session", (char*) "Properties of a login session", Session_fields, 17,
+};
+static PyStructSequence_Desc User_desc = {
+        (char*) "login.User", (char*) "Properties of a user with login sessions", User_fields, 4,
+};
+static PyStructSequence_Desc Seat_desc = {
+        (char*) "login.Seat", (char*) "Properties of a seat", Seat_fields, 7,
+};
+static PyStructSequence_Desc Machine_desc = {
+        (char*) "login.Machine", (char*) "Properties of a virtual machine or container", Machine_fields, 2,
+};
+static PyStructSequence_Desc Snapshot_desc = {
+        (char*) "login.Snapshot", (char*) "Login state as returned by snapshot()", Snapshot_fields, 4,
+};
+
+static PyObject* str_or_none(const char *s) {
+        if (!s)
+                Py_RETURN_NONE;
+        return PyUnicode_FromString(s);
+}
+
+static PyObject* bool_or_none(int b) {
+        if (b < 0)
+                Py_RETURN_NONE;
+        return PyBool_FromLong(b);
+}
+
+static PyObject* uid_or_none(bool has, uid_t uid) {
+        if (!has)
+                Py_RETURN_NONE;
+        return PyLong_FromUnsignedLong(uid);
+}
+
+static PyObject* strv_to_tuple(char **l) {
+        PyObject *tuple;
+        size_t n = 0;
+
+        while (l && l[n])
+                n++;
+
+        tuple = PyTuple_New(n);
+        if (!tuple)
+                return NULL;
+
+        for (size_t i = 0; i < n; i++) {
+                PyObject *s = PyUnicode_FromString(l[i]);
+                if (!s) {
+                        Py_DECREF(tuple);
+                        return NULL;
+                }
+                PyTuple_SET_ITEM(tuple, i, s);
+        }
+        return tuple;
+}
+
+/* Creates a struct sequence from the items, and steals their references.
+ * Any NULL item means that an error occurred. */
+static PyObject* make_struct(PyTypeObject *type, PyObject **items, size_t n) {
+        PyObject *s = NULL;
+        bool ok = true;
+
+        for (size_t i = 0; i < n; i++)
+                ok = ok && items[i];
+        if (ok)
+                s = PyStructSequence_New(type);
+
+        for (size_t i = 0; i < n; i++) {
+                if (s)
+                        PyStructSequence_SET_ITEM(s, i, items[i]);
+                else
+                        Py_XDECREF(items[i]);
+        }
+        return s;
+}
+
+static PyObject* session_to_python(ModuleState *state, const SessionData *s) {
+        PyObject *items[] = {
+                str_or_none(s->id),
+                uid_or_none(s->has_uid, s->uid),
+                str_or_none(s->username),
+                str_or_none(s->seat),
+                str_or_none(s->tty),
+                str_or_none(s->display),
+                str_or_none(s->state),
+                str_or_none(s->class),
+                str_or_none(s->type),
+                str_or_none(s->service),
+                str_or_none(s->desktop),
+                bool_or_none(s->remote),
+                str_or_none(s->remote_host),
+                str_or_none(s->remote_user),
+                s->leader > 0 ? PyLong_FromLong(s->leader) : (Py_INCREF(Py_None), Py_None),
+                s->has_vt ? PyLong_FromUnsignedLong(s->vt) : (Py_INCREF(Py_None), Py_None),
+                bool_or_none(s->active),
+        };
+
+        return make_struct(state->SessionType, items, sizeof(items) / sizeof(items[0]));
+}
+
+static PyObject* user_to_python(ModuleState *state, const UserData *u) {
+        PyObject *items[] = {
+                uid_or_none(true, u->uid),
+                str_or_none(u->state),
+                str_or_none(u->display),
+                strv_to_tuple(u->sessions),
+        };
+
+        return make_struct(state->UserType, items, sizeof(items) / sizeof(items[0]));
+}
+
+static PyObject* seat_to_python(ModuleState *state, const SeatData *s) {
+        PyObject *items[] = {
+                str_or_none(s->id),
+                str_or_none(s->active_session),
+                uid_or_none(s->has_active, s->active_uid),
+                strv_to_tuple(s->sessions),
+                bool_or_none(s->can_multi_session),
+                bool_or_none(s->can_tty),
+                bool_or_none(s->can_graphical),
+        };
+
+        return make_struct(state->SeatType, items, sizeof(items) / sizeof(items[0]));
+}
+
+static PyObject* machine_to_python(ModuleState *state, const MachineData *m) {
+        PyObject *items[] = {
+                str_or_none(m->name),
+                str_or_none(m->class),
+        };
+
+        return make_struct(state->MachineType, items, sizeof(items) / sizeof(items[0]));
+}
+
+#define DATA_TO_TUPLE(state, array, n, convert)                         \
+        ({                                                              \
+                PyObject *_t = PyTuple_New(n);                          \
+                for (size_t _i = 0; _t && _i < (n); _i++) {             \
+                        PyObject *_o = convert((state), (array) + _i);  \
+                        if (!_o)                                        \
+                                Py_CLEAR(_t);                           \
+                        else                                            \
+                                PyTuple_SET_ITEM(_t, _i, _o);           \
+                }                                                       \
+                _t;                                                     \
+        })
+
+PyDoc_STRVAR(snapshot__doc__,
+             "snapshot() -> Snapshot\n\n"
+             "Returns all current login sessions, users with sessions, seats and\n"
+             "machines together with their properties, as a struct sequence of\n"
+             "(sessions, users, seats, machines), each a tuple of struct sequences.\n"
+             "Properties which are not set or could not be queried are None.\n"
+             "The state is queried with the GIL released.\n"
+             "Wraps sd_get_sessions(3), sd_session_get_uid(3), sd_uid_get_state(3),\n"
+             "sd_seat_get_active(3), sd_machine_get_class(3) and friends."
+);
+
+static PyObject* snapshot(PyObject *self, PyObject *args) {
+        ModuleState *state = PyModule_GetState(self);
+        SnapshotData d = {};
+        int r;
+
+        assert(!args);
+
+        Py_BEGIN_ALLOW_THREADS
+        r = snapshot_collect(&d);
+        Py_END_ALLOW_THREADS
+
+        PyObject *items[] = {
+                r < 0 ? NULL : DATA_TO_TUPLE(state, d.sessions, d.n_sessions, session_to_python),
+                r < 0 ? NULL : DATA_TO_TUPLE(state, d.users, d.n_users, user_to_python),
+                r < 0 ? NULL : DATA_TO_TUPLE(state, d.seats, d.n_seats, seat_to_python),
+                r < 0 ? NULL : DATA_TO_TUPLE(state, d.machines, d.n_machines, machine_to_python),
+        };
+        snapshot_data_free(&d);
+
+        if (set_error(r, NULL, NULL) < 0)
+                return NULL;
+
+        return make_struct(state->SnapshotType, items, sizeof(items) / sizeof(items[0]));
+}
+
 static PyMethodDef methods[] = {
         { "seats",         seats,         METH_NOARGS, seats__doc__         },
         { "sessions",      sessions,      METH_NOARGS, sessions__doc__      },
         { "machine_names", machine_names, METH_NOARGS, machine_names__doc__ },
         { "uids",          uids,          METH_NOARGS, uids__doc__          },
+        { "snapshot",      snapshot,      METH_NOARGS, snapshot__doc__      },
         {} /* Sentinel */
 };
 
@@ -110,12 +571,15 @@ static PyMethodDef methods[] = {
 typedef struct {
         PyObject_HEAD
         sd_login_monitor *monitor;
+        ObjectLock lock;
 } Monitor;
-static PyTypeObject MonitorType;
 
 static void Monitor_dealloc(Monitor* self) {
+        PyTypeObject *type = Py_TYPE(self);
+
         self->monitor = sd_login_monitor_unref(self->monitor);
-        Py_TYPE(self)->tp_free((PyObject*)self);
+        type->tp_free((PyObject*)self);
+        Py_DECREF(type);
 }
 
 PyDoc_STRVAR(Monitor__doc__,
@@ -124,14 +588,11 @@ PyDoc_STRVAR(Monitor__doc__,
              "machines/containers. Monitor provides a file descriptor which can be\n"
              "integrated in an external event loop.\n\n"
              "See :manpage:`sd_login_monitor_new(3)` for the details about what can be monitored.");
-static int Monitor_init(Monitor *self, PyObject *args, PyObject *keywds) {
-        const char *category = NULL;
-        int r;
+static const char* const Monitor_kwlist[] = {"category", NULL};
 
-        static const char* const kwlist[] = {"category", NULL};
-        if (!PyArg_ParseTupleAndKeywords(args, keywds, "|z:__init__", (char**) kwlist,
-                                         &category))
-                return -1;
+static int monitor_open(Monitor *self, const char *category) {
+        int r;
+        LOCK_OBJECT(self);
 
         Py_BEGIN_ALLOW_THREADS
         r = sd_login_monitor_new(category, &self->monitor);
@@ -140,6 +601,37 @@ static int Monitor_init(Monitor *self, PyObject *args, PyObject *keywds) {
         return set_error(r, NULL, "Invalid category");
 }
 
+static int Monitor_init(Monitor *self, PyObject *args, PyObject *keywds) {
+        const char *category = NULL;
+
+        if (!PyArg_ParseTupleAndKeywords(args, keywds, "|z:__init__", (char**) Monitor_kwlist,
+                                         &category))
+                return -1;
+
+        return monitor_open(self, category);
+}
+
+/* Monitor(...) without building argument tuples. Subclasses are created
+ * through tp_new and tp_init. */
+static PyObject* Monitor_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames) {
+        const char *category = NULL;
+        _cleanup_Py_DECREF_ PyObject *self = NULL;
+
+        if (!parse_fastcall(args, PyVectorcall_NARGS(nargsf), kwnames, "|z:Monitor", Monitor_kwlist,
+                            &category))
+                return NULL;
+
+        self = ((PyTypeObject*) type)->tp_alloc((PyTypeObject*) type, 0);
+        if (!self)
+                return NULL;
+
+        if (monitor_open((Monitor*) self, category) < 0)
+                return NULL;
+
+        Py_INCREF(self);
+        return self;
+}
+
 
 PyDoc_STRVAR(Monitor_fileno__doc__,
              "fileno() -> int\n\n"
@@ -148,6 +640,7 @@ PyDoc_STRVAR(Monitor_fileno__doc__,
 static PyObject* Monitor_fileno(Monitor *self, PyObject *args) {
         assert(self);
         assert(!args);
+        LOCK_OBJECT(self);
 
         int fd = sd_login_monitor_get_fd(self->monitor);
         set_error(fd, NULL, NULL);
@@ -164,6 +657,7 @@ PyDoc_STRVAR(Monitor_get_events__doc__,
              "See :manpage:`sd_login_monitor_get_events(3)` for further discussion.");
 static PyObject* Monitor_get_events(Monitor *self, PyObject *args) {
         int r;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
@@ -187,6 +681,7 @@ PyDoc_STRVAR(Monitor_get_timeout__doc__,
 static PyObject* Monitor_get_timeout(Monitor *self, PyObject *args) {
         int r;
         uint64_t t;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
@@ -212,6 +707,7 @@ PyDoc_STRVAR(Monitor_get_timeout_ms__doc__,
 static PyObject* Monitor_get_timeout_ms(Monitor *self, PyObject *args) {
         int r;
         uint64_t t;
+        LOCK_OBJECT(self);
 
         assert(self);
         assert(!args);
@@ -233,6 +729,7 @@ PyDoc_STRVAR(Monitor_close__doc__,
 static PyObject* Monitor_close(Monitor *self, PyObject *args) {
         assert(self);
         assert(!args);
+        LOCK_OBJECT(self);
 
         self->monitor = sd_login_monitor_unref(self->monitor);
         Py_RETURN_NONE;
@@ -247,6 +744,7 @@ PyDoc_STRVAR(Monitor_flush__doc__,
 static PyObject* Monitor_flush(Monitor *self, PyObject *args) {
         assert(self);
         assert(!args);
+        LOCK_OBJECT(self);
 
         Py_BEGIN_ALLOW_THREADS
         sd_login_monitor_flush(self->monitor);
@@ -272,70 +770,787 @@ PyDoc_STRVAR(Monitor___exit____doc__,
              "__exit__(type, value, traceback) -> None\n\n"
              "Part of the context manager protocol.\n"
              "Closes the monitor..\n");
-static PyObject* Monitor___exit__(Monitor *self, PyObject *args) {
+static PyObject* Monitor___exit__(Monitor *self, PyObject *const *args _unused_, Py_ssize_t nargs _unused_) {
         assert(self);
-        assert(!args);
 
-        return Monitor_close(self, args);
+        return Monitor_close(self, NULL);
 }
 
 
+DISABLE_WARNING_CAST_FUNCTION_TYPE;
 static PyMethodDef Monitor_methods[] = {
-        { "fileno",          (PyCFunction) Monitor_fileno,         METH_NOARGS,  Monitor_fileno__doc__         },
-        { "get_events",      (PyCFunction) Monitor_get_events,     METH_NOARGS,  Monitor_get_events__doc__     },
-        { "get_timeout",     (PyCFunction) Monitor_get_timeout,    METH_NOARGS,  Monitor_get_timeout__doc__    },
-        { "get_timeout_ms",  (PyCFunction) Monitor_get_timeout_ms, METH_NOARGS,  Monitor_get_timeout_ms__doc__ },
-        { "close",           (PyCFunction) Monitor_close,          METH_NOARGS,  Monitor_close__doc__          },
-        { "flush",           (PyCFunction) Monitor_flush,          METH_NOARGS,  Monitor_flush__doc__          },
-        { "__enter__",       (PyCFunction) Monitor___enter__,      METH_NOARGS,  Monitor___enter____doc__      },
-        { "__exit__",        (PyCFunction) Monitor___exit__,       METH_VARARGS, Monitor___exit____doc__       },
+        { "fileno",          (PyCFunction) Monitor_fileno,         METH_NOARGS,   Monitor_fileno__doc__         },
+        { "get_events",      (PyCFunction) Monitor_get_events,     METH_NOARGS,   Monitor_get_events__doc__     },
+        { "get_timeout",     (PyCFunction) Monitor_get_timeout,    METH_NOARGS,   Monitor_get_timeout__doc__    },
+        { "get_timeout_ms",  (PyCFunction) Monitor_get_timeout_ms, METH_NOARGS,   Monitor_get_timeout_ms__doc__ },
+        { "close",           (PyCFunction) Monitor_close,          METH_NOARGS,   Monitor_close__doc__          },
+        { "flush",           (PyCFunction) Monitor_flush,          METH_NOARGS,   Monitor_flush__doc__          },
+        { "__enter__",       (PyCFunction) Monitor___enter__,      METH_NOARGS,   Monitor___enter____doc__      },
+        { "__exit__",        (PyCFunction) Monitor___exit__,       METH_FASTCALL, Monitor___exit____doc__       },
         {}  /* Sentinel */
 };
+REENABLE_WARNING;
 
-static PyTypeObject MonitorType = {
-        PyVarObject_HEAD_INIT(NULL, 0)
-        .tp_name = "login.Monitor",
-        .tp_basicsize = sizeof(Monitor),
-        .tp_dealloc = (destructor) Monitor_dealloc,
-        .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
-        .tp_doc = Monitor__doc__,
-        .tp_methods = Monitor_methods,
-        .tp_init = (initproc) Monitor_init,
-        .tp_new = PyType_GenericNew,
+static PyType_Slot Monitor_slots[] = {
+        { Py_tp_dealloc, Monitor_dealloc        },
+        { Py_tp_doc,     (void*) Monitor__doc__ },
+        { Py_tp_methods, Monitor_methods        },
+        { Py_tp_init,    Monitor_init           },
+        { Py_tp_new,     PyType_GenericNew      },
+        {}  /* Sentinel */
 };
 
-static struct PyModuleDef module = {
-        PyModuleDef_HEAD_INIT,
-        .m_name = "login",      /* name of module */
-        .m_doc = module__doc__, /* module documentation, may be NULL */
-        .m_size = -1,           /* size of per-interpreter state of the module */
-        .m_methods = methods,
-        .m_slots = NULL,
+static PyType_Spec Monitor_spec = {
+        .name = "login.Monitor",
+        .basicsize = sizeof(Monitor),
+        .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_IMMUTABLETYPE,
+        .slots = Monitor_slots,
 };
 
-DISABLE_WARNING_MISSING_PROTOTYPES;
-PyMODINIT_FUNC PyInit_login(void) {
-        PyObject *m;
+/* StateCache keeps the login state as dictionaries of the struct sequences
+ * returned by snapshot(). When the monitor fires, the runtime files of all
+ * entries are stat()ed, and only entries which appeared or whose file changed
+ * are queried again. */
+
+typedef struct {
+        char *key;
+        dev_t dev;
+        ino_t ino;
+        off_t size;
+        struct timespec mtime;
+} CacheEntry;
+
+typedef struct {
+        const char *name;
+        const char *dir;
+        int (*list)(char ***ret);
+        size_t data_size;
+        int (*collect)(void *data, const char *key);
+        void (*done)(void *data);
+        PyObject* (*to_python)(ModuleState *state, const void *data);
+        PyObject* (*key_to_python)(const char *key);
+} CacheKind;
+
+static int list_uids(char ***ret) {
+        _cleanup_free_ uid_t *uids = NULL;
+        char **l;
+        int n;
+
+        n = sd_get_uids(&uids);
+        if (n < 0)
+                return n;
+
+        l = new0(char*, n + 1);
+        if (!l)
+                return -ENOMEM;
+
+        for (int i = 0; i < n; i++) {
+                l[i] = malloc(sizeof("4294967295"));
+                if (!l[i]) {
+                        strv_free(l);
+                        return -ENOMEM;
+                }
+                snprintf(l[i], sizeof("4294967295"), "%u", (unsigned) uids[i]);
+        }
+
+        *ret = l;
+        return n;
+}
+
+static int cache_collect_session(void *data, const char *key) {
+        SessionData *s = data;
+
+        s->id = strdup(key);
+        if (!s->id)
+                return -ENOMEM;
+        collect_session(s);
+        return 0;
+}
+
+static int cache_collect_user(void *data, const char *key) {
+        UserData *u = data;
+
+        u->uid = (uid_t) strtoul(key, NULL, 10);
+        collect_user(u);
+        return 0;
+}
+
+static int cache_collect_seat(void *data, const char *key) {
+        SeatData *s = data;
+
+        s->id = strdup(key);
+        if (!s->id)
+                return -ENOMEM;
+        collect_seat(s);
+        return 0;
+}
+
+static int cache_collect_machine(void *data, const char *key) {
+        MachineData *m = data;
+
+        m->name = strdup(key);
+        if (!m->name)
+                return -ENOMEM;
+        (void) sd_machine_get_class(m->name, &m->class);
+        return 0;
+}
+
+static void cache_done_session(void *data) {
+        session_data_done(data);
+}
+
+static PyObject* cache_session_to_python(ModuleState *state, const void *data) {
+        return session_to_python(state, data);
+}
+
+static void cache_done_user(void *data) {
+        user_data_done(data);
+}
+
+static PyObject* cache_user_to_python(ModuleState *state, const void *data) {
+        return user_to_python(state, data);
+}
+
+static void cache_done_seat(void *data) {
+        seat_data_done(data);
+}
+
+static PyObject* cache_seat_to_python(ModuleState *state, const void *data) {
+        return seat_to_python(state, data);
+}
+
+static void cache_done_machine(void *data) {
+        machine_data_done(data);
+}
+
+static PyObject* cache_machine_to_python(ModuleState *state, const void *data) {
+        return machine_to_python(state, data);
+}
+
+static PyObject* key_to_str(const char *key) {
+        return PyUnicode_FromString(key);
+}
+
+static PyObject* key_to_uid(const char *key) {
+        return PyLong_FromString(key, NULL, 10);
+}
+
+enum {
+        CACHE_SESSIONS,
+        CACHE_USERS,
+        CACHE_SEATS,
+        CACHE_MACHINES,
+        _CACHE_MAX,
+};
+
+static const CacheKind cache_kinds[_CACHE_MAX] = {
+        [CACHE_SESSIONS] = {
+                "session", "/run/systemd/sessions/", sd_get_sessions, sizeof(SessionData),
+                cache_collect_session, cache_done_session,
+                cache_session_to_python, key_to_str,
+        },
+        [CACHE_USERS] = {
+                "user", "/run/systemd/users/", list_uids, sizeof(UserData),
+                cache_collect_user, cache_done_user,
+                cache_user_to_python, key_to_uid,
+        },
+        [CACHE_SEATS] = {
+                "seat", "/run/systemd/seats/", sd_get_seats, sizeof(SeatData),
+                cache_collect_seat, cache_done_seat,
+                cache_seat_to_python, key_to_str,
+        },
+        [CACHE_MACHINES] = {
+                "machine", "/run/systemd/machines/", sd_get_machine_names, sizeof(MachineData),
+                cache_collect_machine, cache_done_machine,
+                cache_machine_to_python, key_to_str,
+        },
+};
+
+typedef struct {
+        CacheEntry *entries;
+        size_t n_entries;
+        PyObject *objects;      /* key → struct sequence */
+} CacheTable;
+
+/* The result of cache_update_prepare(), computed without the GIL */
+typedef struct {
+        CacheEntry *entries;    /* the new, sorted, entry list */
+        size_t n_entries;
+        size_t *refresh;        /* indices into entries which were (re)read */
+        char *data;             /* the data read for them */
+        size_t n_refresh;
+        const char **removed;   /* keys of the old entries which are gone */
+        size_t n_removed;
+} CacheUpdate;
+
+static void cache_entries_free(CacheEntry *entries, size_t n) {
+        for (size_t i = 0; i < n; i++)
+                free(entries[i].key);
+        free(entries);
+}
+
+static void cache_update_done(const CacheKind *kind, CacheUpdate *u) {
+        for (size_t i = 0; i < u->n_refresh; i++)
+                kind->done(u->data + i * kind->data_size);
+        free(u->data);
+        free(u->refresh);
+        free(u->removed);
+        cache_entries_free(u->entries, u->n_entries);
+        *u = (CacheUpdate) {};
+}
 
-        if (PyType_Ready(&MonitorType) < 0)
+static int compare_entries(const void *a, const void *b) {
+        return strcmp(((const CacheEntry*) a)->key, ((const CacheEntry*) b)->key);
+}
+
+static bool cache_entry_changed(const CacheEntry *a, const CacheEntry *b) {
+        return a->dev != b->dev || a->ino != b->ino || a->size != b->size ||
+                a->mtime.tv_sec != b->mtime.tv_sec || a->mtime.tv_nsec != b->mtime.tv_nsec;
+}
+
+static int cache_update_prepare(const CacheKind *kind, const CacheTable *table, bool force, CacheUpdate *u) {
+        _cleanup_strv_free_ char **names = NULL;
+        size_t i = 0, j = 0;
+        int n;
+
+        n = kind->list(&names);
+        if (n < 0)
+                return n;
+
+        u->entries = new0(CacheEntry, n > 0 ? n : 1);
+        u->refresh = new0(size_t, n > 0 ? n : 1);
+        u->removed = new0(const char*, table->n_entries > 0 ? table->n_entries : 1);
+        if (!u->entries || !u->refresh || !u->removed)
+                return -ENOMEM;
+
+        for (int k = 0; k < n; k++) {
+                CacheEntry *e = u->entries + k;
+                char path[strlen(kind->dir) + strlen(names[k]) + 1];
+                struct stat st;
+
+                e->key = names[k];
+                names[k] = NULL;
+                u->n_entries++;
+
+                strcpy(stpcpy(path, kind->dir), e->key);
+                if (stat(path, &st) >= 0) {
+                        e->dev = st.st_dev;
+                        e->ino = st.st_ino;
+                        e->size = st.st_size;
+                        e->mtime = st.st_mtim;
+                }
+        }
+        qsort(u->entries, u->n_entries, sizeof(CacheEntry), compare_entries);
+
+        /* Both lists are sorted, so walk them in parallel */
+        while (i < table->n_entries || j < u->n_entries) {
+                int c;
+
+                if (i >= table->n_entries)
+                        c = 1;
+                else if (j >= u->n_entries)
+                        c = -1;
+                else
+                        c = strcmp(table->entries[i].key, u->entries[j].key);
+
+                if (c < 0)
+                        u->removed[u->n_removed++] = table->entries[i++].key;
+                else if (c > 0)
+                        u->refresh[u->n_refresh++] = j++;
+                else {
+                        if (force || cache_entry_changed(table->entries + i, u->entries + j))
+                                u->refresh[u->n_refresh++] = j;
+                        i++, j++;
+                }
+        }
+
+        u->data = calloc(u->n_refresh > 0 ? u->n_refresh : 1, kind->data_size);
+        if (!u->data)
+                return -ENOMEM;
+
+        for (size_t k = 0; k < u->n_refresh; k++) {
+                int r;
+
+                r = kind->collect(u->data + k * kind->data_size, u->entries[u->refresh[k]].key);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+static PyStructSequence_Field StateChange_fields[] = {
+        {(char*) "kind", (char*) "'session', 'user', 'seat' or 'machine'"},
+        {(char*) "key", (char*) "Identifier, uid or name of the entry"},
+        {(char*) "old", (char*) "Previous properties, or None if the entry is new"},
+        {(char*) "new", (char*) "Current properties, or None if the entry is gone"},
+        {} /* Sentinel */
+};
+
+static PyStructSequence_Desc StateChange_desc = {
+        (char*) "login.StateChange", (char*) "A change of an entry of a StateCache", StateChange_fields, 4,
+};
+
+static int cache_add_change(ModuleState *state, PyObject *changes, const char *kind, PyObject *key, PyObject *old, PyObject *new) {
+        PyObject *items[] = {
+                PyUnicode_FromString(kind),
+                key,
+                old ?: Py_None,
+                new ?: Py_None,
+        };
+        _cleanup_Py_DECREF_ PyObject *change = NULL;
+
+        Py_INCREF(items[1]);
+        Py_INCREF(items[2]);
+        Py_INCREF(items[3]);
+
+        change = make_struct(state->StateChangeType, items, sizeof(items) / sizeof(items[0]));
+        if (!change)
+                return -1;
+        return PyList_Append(changes, change);
+}
+
+/* Applies the update to the dictionary of the table, and appends the changes
+ * to the list. On success the new entry list is moved into the table. */
+static int cache_update_apply(ModuleState *state, const CacheKind *kind, CacheTable *table,
+                              CacheUpdate *u, PyObject *changes) {
+        for (size_t k = 0; k < u->n_removed; k++) {
+                _cleanup_Py_DECREF_ PyObject *key = NULL, *old = NULL;
+
+                key = kind->key_to_python(u->removed[k]);
+                if (!key)
+                        return -1;
+
+                old = PyDict_GetItemWithError(table->objects, key);
+                if (!old) {
+                        if (PyErr_Occurred())
+                                return -1;
+                        continue;
+                }
+                Py_INCREF(old);
+
+                if (PyDict_DelItem(table->objects, key) < 0 ||
+                    cache_add_change(state, changes, kind->name, key, old, NULL) < 0)
+                        return -1;
+        }
+
+        for (size_t k = 0; k < u->n_refresh; k++) {
+                _cleanup_Py_DECREF_ PyObject *key = NULL, *old = NULL, *new = NULL;
+                int r;
+
+                key = kind->key_to_python(u->entries[u->refresh[k]].key);
+                if (!key)
+                        return -1;
+
+                new = kind->to_python(state, u->data + k * kind->data_size);
+                if (!new)
+                        return -1;
+
+                old = PyDict_GetItemWithError(table->objects, key);
+                if (!old && PyErr_Occurred())
+                        return -1;
+                Py_XINCREF(old);
+
+                r = old ? PyObject_RichCompareBool(old, new, Py_EQ) : 0;
+                if (r < 0)
+                        return -1;
+                if (r > 0)
+                        continue;
+
+                if (PyDict_SetItem(table->objects, key, new) < 0 ||
+                    cache_add_change(state, changes, kind->name, key, old, new) < 0)
+                        return -1;
+        }
+
+        cache_entries_free(table->entries, table->n_entries);
+        table->entries = u->entries;
+        table->n_entries = u->n_entries;
+        u->entries = NULL;
+        u->n_entries = 0;
+        return 0;
+}
+
+typedef struct {
+        PyObject_HEAD
+        sd_login_monitor *monitor;
+        PyObject *callback;
+        CacheTable tables[_CACHE_MAX];
+        bool busy;
+        ObjectLock lock;
+} StateCache;
+
+/* Refreshes all tables, and returns the list of changes. Called with the GIL. */
+static PyObject* StateCache_update(StateCache *self, bool flush, bool force) {
+        _cleanup_Py_DECREF_ PyObject *changes = NULL;
+        CacheUpdate updates[_CACHE_MAX] = {};
+        ModuleState *state;
+        int r = 0;
+        LOCK_OBJECT(self);
+
+        state = get_module_state(Py_TYPE(self), &module);
+        if (!state)
                 return NULL;
 
-        m = PyModule_Create(&module);
-        if (!m)
+        if (self->busy) {
+                PyErr_SetString(PyExc_RuntimeError, "StateCache is being refreshed in another thread");
                 return NULL;
+        }
 
-        if (PyModule_AddStringConstant(m, "__version__", PACKAGE_VERSION)) {
-                Py_DECREF(m);
+        changes = PyList_New(0);
+        if (!changes)
                 return NULL;
+
+        self->busy = true;
+
+        Py_BEGIN_ALLOW_THREADS
+        if (flush && self->monitor)
+                sd_login_monitor_flush(self->monitor);
+        for (size_t i = 0; i < _CACHE_MAX && r >= 0; i++)
+                r = cache_update_prepare(cache_kinds + i, self->tables + i, force, updates + i);
+        Py_END_ALLOW_THREADS
+
+        if (set_error(r, NULL, NULL) >= 0)
+                for (size_t i = 0; i < _CACHE_MAX; i++) {
+                        r = cache_update_apply(state, cache_kinds + i, self->tables + i, updates + i, changes);
+                        if (r < 0)
+                                break;
+                }
+
+        for (size_t i = 0; i < _CACHE_MAX; i++)
+                cache_update_done(cache_kinds + i, updates + i);
+
+        self->busy = false;
+
+        if (r < 0)
+                return NULL;
+
+        Py_INCREF(changes);
+        return changes;
+}
+
+static int StateCache_traverse(StateCache *self, visitproc visit, void *arg) {
+        Py_VISIT(Py_TYPE(self));
+        Py_VISIT(self->callback);
+        for (size_t i = 0; i < _CACHE_MAX; i++)
+                Py_VISIT(self->tables[i].objects);
+        return 0;
+}
+
+static int StateCache_clear(StateCache *self) {
+        Py_CLEAR(self->callback);
+        return 0;
+}
+
+static void StateCache_dealloc(StateCache *self) {
+        PyTypeObject *type = Py_TYPE(self);
+
+        PyObject_GC_UnTrack(self);
+        StateCache_clear(self);
+        for (size_t i = 0; i < _CACHE_MAX; i++) {
+                cache_entries_free(self->tables[i].entries, self->tables[i].n_entries);
+                Py_XDECREF(self->tables[i].objects);
+        }
+        self->monitor = sd_login_monitor_unref(self->monitor);
+        type->tp_free((PyObject*)self);
+        Py_DECREF(type);
+}
+
+PyDoc_STRVAR(StateCache__doc__,
+             "StateCache(callback=None) -> ...\n\n"
+             "StateCache keeps the login state in memory: the .sessions, .users,\n"
+             ".seats and .machines attributes are read-only mappings of identifier,\n"
+             "uid or name to the struct sequences also returned by snapshot().\n\n"
+             "The cache is loaded when it is created, and updated by .process(),\n"
+             "which should be called whenever the file descriptor returned by\n"
+             ".fileno() becomes readable. Only entries which appeared, or whose\n"
+             "runtime file in /run/systemd/ changed, are queried again.\n\n"
+             "If callback is given, it is called with each StateChange found\n"
+             "by .process().");
+static int StateCache_init(StateCache *self, PyObject *args, PyObject *keywds) {
+        PyObject *callback = NULL, *changes;
+        int r;
+
+        static const char* const kwlist[] = {"callback", NULL};
+        if (!PyArg_ParseTupleAndKeywords(args, keywds, "|O:__init__", (char**) kwlist,
+                                         &callback))
+                return -1;
+
+        if (callback == Py_None)
+                callback = NULL;
+        if (callback && !PyCallable_Check(callback)) {
+                PyErr_SetString(PyExc_TypeError, "callback must be callable");
+                return -1;
+        }
+
+        if (self->monitor || self->tables[0].objects) {
+                PyErr_SetString(PyExc_RuntimeError, "StateCache is already initialized");
+                return -1;
+        }
+
+        Py_XINCREF(callback);
+        Py_XSETREF(self->callback, callback);
+
+        for (size_t i = 0; i < _CACHE_MAX; i++) {
+                self->tables[i].objects = PyDict_New();
+                if (!self->tables[i].objects)
+                        return -1;
         }
 
-        Py_INCREF(&MonitorType);
-        if (PyModule_AddObject(m, "Monitor", (PyObject *) &MonitorType)) {
-                Py_DECREF(&MonitorType);
-                Py_DECREF(m);
+        Py_BEGIN_ALLOW_THREADS
+        r = sd_login_monitor_new(NULL, &self->monitor);
+        Py_END_ALLOW_THREADS
+        if (set_error(r, NULL, NULL) < 0)
+                return -1;
+
+        changes = StateCache_update(self, false, false);
+        if (!changes)
+                return -1;
+        Py_DECREF(changes);
+        return 0;
+}
+
+
+PyDoc_STRVAR(StateCache_fileno__doc__,
+             "fileno() -> int\n\n"
+             "Get a file descriptor to poll for events.\n"
+             "This method wraps sd_login_monitor_get_fd(3).");
+static PyObject* StateCache_fileno(StateCache *self, PyObject *args) {
+        assert(self);
+        assert(!args);
+        LOCK_OBJECT(self);
+
+        int fd = sd_login_monitor_get_fd(self->monitor);
+        set_error(fd, NULL, NULL);
+        if (fd < 0)
+                return NULL;
+        return PyLong_FromLong(fd);
+}
+
+
+PyDoc_STRVAR(StateCache_get_events__doc__,
+             "get_events() -> int\n\n"
+             "Returns a mask of poll() events to wait for on the file descriptor returned\n"
+             "by .fileno().\n\n"
+             "See :manpage:`sd_login_monitor_get_events(3)` for further discussion.");
+static PyObject* StateCache_get_events(StateCache *self, PyObject *args) {
+        int r;
+        LOCK_OBJECT(self);
+
+        assert(self);
+        assert(!args);
+
+        r = sd_login_monitor_get_events(self->monitor);
+        set_error(r, NULL, NULL);
+        if (r < 0)
+                return NULL;
+        return PyLong_FromLong(r);
+}
+
+
+PyDoc_STRVAR(StateCache_process__doc__,
+             "process(force=False) -> list\n\n"
+             "Reset the wakeup state of the monitor and update the cache.\n"
+             "Returns the list of StateChange for the entries which were added,\n"
+             "modified or removed, after passing each of them to the callback.\n"
+             "With force=True all entries are queried again, even if their\n"
+             "runtime files appear unchanged.");
+static PyObject* StateCache_process(StateCache *self, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames) {
+        _cleanup_Py_DECREF_ PyObject *changes = NULL;
+        int force = false;
+
+        static const char* const kwlist[] = {"force", NULL};
+        if (!parse_fastcall(args, nargs, kwnames, "|p:process", kwlist, &force))
+                return NULL;
+
+        changes = StateCache_update(self, true, force);
+        if (!changes)
+                return NULL;
+
+        if (self->callback) {
+                /* The callback might replace itself */
+                _cleanup_Py_DECREF_ PyObject *callback = self->callback;
+                Py_INCREF(callback);
+
+                for (Py_ssize_t i = 0; i < PyList_GET_SIZE(changes); i++) {
+                        _cleanup_Py_DECREF_ PyObject *res = NULL;
+
+                        res = PyObject_CallOneArg(callback, PyList_GET_ITEM(changes, i));
+                        if (!res)
+                                return NULL;
+                }
+        }
+
+        Py_INCREF(changes);
+        return changes;
+}
+
+
+PyDoc_STRVAR(StateCache_close__doc__,
+             "close() -> None\n\n"
+             "Free the monitor of this StateCache. The cached state stays\n"
+             "available, and .process() can still be used to update it.");
+static PyObject* StateCache_close(StateCache *self, PyObject *args) {
+        assert(self);
+        assert(!args);
+        LOCK_OBJECT(self);
+
+        if (self->busy) {
+                PyErr_SetString(PyExc_RuntimeError, "StateCache is being refreshed in another thread");
                 return NULL;
         }
 
-        return m;
+        self->monitor = sd_login_monitor_unref(self->monitor);
+        Py_RETURN_NONE;
+}
+
+
+PyDoc_STRVAR(StateCache___enter____doc__,
+             "__enter__() -> self\n\n"
+             "Part of the context manager protocol.\n"
+             "Returns self.\n");
+static PyObject* StateCache___enter__(PyObject *self, PyObject *args) {
+        assert(self);
+        assert(!args);
+
+        Py_INCREF(self);
+        return self;
+}
+
+
+PyDoc_STRVAR(StateCache___exit____doc__,
+             "__exit__(type, value, traceback) -> None\n\n"
+             "Part of the context manager protocol.\n"
+             "Closes the monitor.\n");
+static PyObject* StateCache___exit__(StateCache *self, PyObject *const *args _unused_, Py_ssize_t nargs _unused_) {
+        assert(self);
+
+        return StateCache_close(self, NULL);
+}
+
+
+#define STATE_CACHE_GETTER(name, index)                                 \
+static PyObject* StateCache_get_##name(StateCache *self, void *closure _unused_) { \
+        if (!self->tables[index].objects) {                             \
+                PyErr_SetString(PyExc_RuntimeError, "StateCache is not initialized"); \
+                return NULL;                                            \
+        }                                                               \
+        return PyDictProxy_New(self->tables[index].objects);            \
+}
+
+STATE_CACHE_GETTER(sessions, CACHE_SESSIONS);
+STATE_CACHE_GETTER(users, CACHE_USERS);
+STATE_CACHE_GETTER(seats, CACHE_SEATS);
+STATE_CACHE_GETTER(machines, CACHE_MACHINES);
+
+static PyGetSetDef StateCache_getsetters[] = {
+        { "sessions", (getter) StateCache_get_sessions, NULL, "Mapping of session identifier to Session", NULL },
+        { "users",    (getter) StateCache_get_users,    NULL, "Mapping of uid to User",                  NULL },
+        { "seats",    (getter) StateCache_get_seats,    NULL, "Mapping of seat identifier to Seat",      NULL },
+        { "machines", (getter) StateCache_get_machines, NULL, "Mapping of machine name to Machine",      NULL },
+        {}  /* Sentinel */
+};
+
+DISABLE_WARNING_CAST_FUNCTION_TYPE;
+static PyMethodDef StateCache_methods[] = {
+        { "fileno",     (PyCFunction) StateCache_fileno,     METH_NOARGS,                   StateCache_fileno__doc__     },
+        { "get_events", (PyCFunction) StateCache_get_events, METH_NOARGS,                   StateCache_get_events__doc__ },
+        { "process",    (PyCFunction) StateCache_process,    METH_FASTCALL | METH_KEYWORDS, StateCache_process__doc__    },
+        { "close",      (PyCFunction) StateCache_close,      METH_NOARGS,                   StateCache_close__doc__      },
+        { "__enter__",  (PyCFunction) StateCache___enter__,  METH_NOARGS,                   StateCache___enter____doc__  },
+        { "__exit__",   (PyCFunction) StateCache___exit__,   METH_FASTCALL,                 StateCache___exit____doc__   },
+        {}  /* Sentinel */
+};
+REENABLE_WARNING;
+
+static PyType_Slot StateCache_slots[] = {
+        { Py_tp_dealloc,  StateCache_dealloc        },
+        { Py_tp_doc,      (void*) StateCache__doc__ },
+        { Py_tp_traverse, StateCache_traverse       },
+        { Py_tp_clear,    StateCache_clear          },
+        { Py_tp_methods,  StateCache_methods        },
+        { Py_tp_getset,   StateCache_getsetters     },
+        { Py_tp_init,     StateCache_init           },
+        { Py_tp_new,      PyType_GenericNew         },
+        {}  /* Sentinel */
+};
+
+static PyType_Spec StateCache_spec = {
+        .name = "login.StateCache",
+        .basicsize = sizeof(StateCache),
+        .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_HAVE_GC | Py_TPFLAGS_IMMUTABLETYPE,
+        .slots = StateCache_slots,
+};
+
+static int module_traverse(PyObject *m, visitproc visit, void *arg) {
+        ModuleState *state = PyModule_GetState(m);
+
+        Py_VISIT(state->MonitorType);
+        Py_VISIT(state->StateCacheType);
+        Py_VISIT(state->SessionType);
+        Py_VISIT(state->UserType);
+        Py_VISIT(state->SeatType);
+        Py_VISIT(state->MachineType);
+        Py_VISIT(state->SnapshotType);
+        Py_VISIT(state->StateChangeType);
+        return 0;
+}
+
+static int module_clear(PyObject *m) {
+        ModuleState *state = PyModule_GetState(m);
+
+        Py_CLEAR(state->MonitorType);
+        Py_CLEAR(state->StateCacheType);
+        Py_CLEAR(state->SessionType);
+        Py_CLEAR(state->UserType);
+        Py_CLEAR(state->SeatType);
+        Py_CLEAR(state->MachineType);
+        Py_CLEAR(state->SnapshotType);
+        Py_CLEAR(state->StateChangeType);
+        return 0;
+}
+
+static void module_free(void *m) {
+        module_clear(m);
+}
+
+static int module_exec(PyObject *m) {
+        ModuleState *state = PyModule_GetState(m);
+
+        if (PyModule_AddStringConstant(m, "__version__", PACKAGE_VERSION))
+                return -1;
+
+        if (module_add_type(m, &Monitor_spec, &state->MonitorType) < 0 ||
+            module_add_struct_type(m, &Snapshot_desc, &state->SnapshotType) < 0 ||
+            module_add_struct_type(m, &Session_desc, &state->SessionType) < 0 ||
+            module_add_struct_type(m, &User_desc, &state->UserType) < 0 ||
+            module_add_struct_type(m, &Seat_desc, &state->SeatType) < 0 ||
+            module_add_struct_type(m, &Machine_desc, &state->MachineType) < 0 ||
+            module_add_type(m, &StateCache_spec, &state->StateCacheType) < 0 ||
+            module_add_struct_type(m, &StateChange_desc, &state->StateChangeType) < 0)
+                return -1;
+
+        state->MonitorType->tp_vectorcall = Monitor_vectorcall;
+        return 0;
+}
+
+static PyModuleDef_Slot module_slots[] = {
+        MODULE_SLOTS(module_exec),
+};
+
+static PyModuleDef module = {
+        PyModuleDef_HEAD_INIT,
+        .m_name = "login",      /* name of module */
+        .m_doc = module__doc__, /* module documentation, may be NULL */
+        .m_size = sizeof(ModuleState), /* size of per-interpreter state of the module */
+        .m_methods = methods,
+        .m_slots = module_slots,
+        .m_traverse = module_traverse,
+        .m_clear = module_clear,
+        .m_free = module_free,
+};
+
+DISABLE_WARNING_MISSING_PROTOTYPES;
+PyMODINIT_FUNC PyInit_login(void) {
+        return PyModuleDef_Init(&module);
 }
 REENABLE_WARNING;
@@ -40,6 +40,11 @@ static inline void freep(void *p) {
 
 #define _cleanup_free_ _cleanup_(freep)
 
+static inline void *mfree(void *memory) {
+        free(memory);
+        return NULL;
+}
+
 #if defined(static_assert)
 #  define assert_cc(expr)                               \
  static_assert(expr, #expr)
@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+/* Static tracepoints (USDT) in the hot paths, for bpftrace, perf and
+ * systemtap. They use <sys/sdt.h>, which is detected by meson, and compile to
+ * nothing without it. Every probe needs a semaphore, defined at file scope
+ * with DEFINE_PROBE(). The tracer increments it while it is attached, so that
+ * arguments which are not free to compute, like latencies, are only computed
+ * while somebody is listening, see PROBE_ENABLED() and PROBE_START(). */
+
+#if HAVE_SYS_SDT_H
+#  define _SDT_HAS_SEMAPHORES 1
+#  include <sys/sdt.h>
+
+#  define DEFINE_PROBE(name)                                            \
+        __attribute__((used, section(".probes"), visibility("hidden"))) \
+        volatile unsigned short python_systemd_##name##_semaphore
+
+#  define PROBE_ENABLED(name)                                           \
+        __builtin_expect(python_systemd_##name##_semaphore != 0, 0)
+
+#  define PROBE2(name, a, b)        STAP_PROBE2(python_systemd, name, a, b)
+#  define PROBE3(name, a, b, c)     STAP_PROBE3(python_systemd, name, a, b, c)
+#  define PROBE4(name, a, b, c, d)  STAP_PROBE4(python_systemd, name, a, b, c, d)
+#else
+#  define DEFINE_PROBE(name)                                            \
+        struct __useless_struct_to_allow_trailing_semicolon__
+
+#  define PROBE_ENABLED(name) 0
+
+/* The arguments are not evaluated, but still count as used */
+#  define PROBE2(name, a, b)                                            \
+        do { if (0) { (void) (a); (void) (b); } } while (0)
+#  define PROBE3(name, a, b, c)                                         \
+        do { if (0) { (void) (a); (void) (b); (void) (c); } } while (0)
+#  define PROBE4(name, a, b, c, d)                                      \
+        do { if (0) { (void) (a); (void) (b); (void) (c); (void) (d); } } while (0)
+#endif
+
+static inline uint64_t probe_now_nsec(void) {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* The start time for a latency argument of the probe, or 0 if it is not enabled */
+#define PROBE_START(name) (PROBE_ENABLED(name) ? probe_now_nsec() : 0)
+
+/* The nanoseconds since start, or 0 if the probe was not enabled at start */
+#define PROBE_ELAPSED(start) ((start) > 0 ? probe_now_nsec() - (start) : 0)
@@ -1,5 +1,9 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
+#include <limits.h>
+#include <stdarg.h>
+#include <string.h>
+
 #include "pyutil.h"
 
 void cleanup_Py_DECREFp(PyObject **p) {
@@ -56,3 +60,318 @@ int Unicode_FSConverter(PyObject* obj, void *_result) {
 
         return PyUnicode_FSConverter(obj, result);
 }
+
+static int arg_type_error(const char *fname, Py_ssize_t i, const char *expected, PyObject *obj) {
+        PyErr_Format(PyExc_TypeError, "%s() argument %zd must be %s, not %.50s",
+                     fname, i + 1, expected, Py_TYPE(obj)->tp_name);
+        return 0;
+}
+
+static int arg_as_string(const char *fname, Py_ssize_t i, PyObject *obj, const char **ret) {
+        Py_ssize_t len;
+        const char *s;
+
+        if (!PyUnicode_Check(obj))
+                return arg_type_error(fname, i, "str", obj);
+
+        s = PyUnicode_AsUTF8AndSize(obj, &len);
+        if (!s)
+                return 0;
+        if (strlen(s) != (size_t) len) {
+                PyErr_SetString(PyExc_ValueError, "embedded null character");
+                return 0;
+        }
+
+        *ret = s;
+        return 1;
+}
+
+int parse_fastcall(PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames,
+                   const char *format, const char* const *kwlist, ...) {
+        PyObject *values[PARSE_FASTCALL_MAX] = {};
+        Py_ssize_t n = 0, min = -1, i = 0;
+        const char *fname = "function", *f;
+        va_list ap;
+        int r = 1;
+
+        for (f = format; *f && *f != ':'; f++)
+                if (*f == '|')
+                        min = n;
+                else if (!strchr("#!&", *f))
+                        n++;
+        if (*f == ':')
+                fname = f + 1;
+        if (min < 0)
+                min = n;
+        assert(n <= PARSE_FASTCALL_MAX);
+
+        if (nargs > n) {
+                PyErr_Format(PyExc_TypeError, "%s() takes at most %zd argument%s (%zd given)",
+                             fname, n, n == 1 ? "" : "s", nargs);
+                return 0;
+        }
+        if (nargs > 0)
+                memcpy(values, args, nargs * sizeof(PyObject*));
+
+        for (Py_ssize_t k = 0; kwnames && k < PyTuple_GET_SIZE(kwnames); k++) {
+                PyObject *key = PyTuple_GET_ITEM(kwnames, k);
+                Py_ssize_t j;
+
+                if (!kwlist) {
+                        PyErr_Format(PyExc_TypeError, "%s() takes no keyword arguments", fname);
+                        return 0;
+                }
+
+                for (j = 0; j < n; j++)
+                        if (PyUnicode_CompareWithASCIIString(key, kwlist[j]) == 0)
+                                break;
+                if (j >= n) {
+                        PyErr_Format(PyExc_TypeError, "'%U' is an invalid keyword argument for %s()",
+                                     key, fname);
+                        return 0;
+                }
+                if (values[j]) {
+                        PyErr_Format(PyExc_TypeError,
+                                     "argument for %s() given by name ('%s') and position (%zd)",
+                                     fname, kwlist[j], j + 1);
+                        return 0;
+                }
+                values[j] = args[nargs + k];
+        }
+
+        for (Py_ssize_t j = 0; j < min; j++)
+                if (!values[j]) {
+                        if (kwlist)
+                                PyErr_Format(PyExc_TypeError, "%s() missing required argument '%s' (pos %zd)",
+                                             fname, kwlist[j], j + 1);
+                        else
+                                PyErr_Format(PyExc_TypeError, "%s() takes at least %zd argument%s (%zd given)",
+                                             fname, min, min == 1 ? "" : "s", nargs);
+                        return 0;
+                }
+
+        va_start(ap, kwlist);
+        for (f = format; r && *f && *f != ':'; f++) {
+                PyObject *o = values[i];
+
+                switch (*f) {
+                case '|':
+                        continue;
+
+                case 'i': {
+                        int *p = va_arg(ap, int*);
+                        long v;
+
+                        if (!o)
+                                break;
+                        if (PyFloat_Check(o)) {
+                                r = arg_type_error(fname, i, "int", o);
+                                break;
+                        }
+                        v = PyLong_AsLong(o);
+                        if (v == -1 && PyErr_Occurred())
+                                r = 0;
+                        else if (v > INT_MAX || v < INT_MIN) {
+                                PyErr_Format(PyExc_OverflowError, "signed integer is %s",
+                                             v > INT_MAX ? "greater than maximum" : "less than minimum");
+                                r = 0;
+                        } else
+                                *p = (int) v;
+                        break;
+                }
+
+                case 'p': {
+                        int *p = va_arg(ap, int*);
+                        int b;
+
+                        if (!o)
+                                break;
+                        b = PyObject_IsTrue(o);
+                        if (b < 0)
+                                r = 0;
+                        else
+                                *p = b;
+                        break;
+                }
+
+                case 'L': {
+                        long long *p = va_arg(ap, long long*);
+                        long long v;
+
+                        if (!o)
+                                break;
+                        if (PyFloat_Check(o)) {
+                                r = arg_type_error(fname, i, "int", o);
+                                break;
+                        }
+                        v = PyLong_AsLongLong(o);
+                        if (v == -1 && PyErr_Occurred())
+                                r = 0;
+                        else
+                                *p = v;
+                        break;
+                }
+
+                case 'n': {
+                        Py_ssize_t *p = va_arg(ap, Py_ssize_t*);
+                        Py_ssize_t v;
+
+                        if (!o)
+                                break;
+                        if (PyFloat_Check(o)) {
+                                r = arg_type_error(fname, i, "int", o);
+                                break;
+                        }
+                        v = PyNumber_AsSsize_t(o, PyExc_OverflowError);
+                        if (v == -1 && PyErr_Occurred())
+                                r = 0;
+                        else
+                                *p = v;
+                        break;
+                }
+
+                case 'K': {
+                        unsigned long long *p = va_arg(ap, unsigned long long*);
+
+                        if (!o)
+                                break;
+                        if (!PyLong_Check(o))
+                                r = arg_type_error(fname, i, "int", o);
+                        else
+                                *p = PyLong_AsUnsignedLongLongMask(o);
+                        break;
+                }
+
+                case 's':
+                        if (f[1] == '#') {
+                                const char **p = va_arg(ap, const char**);
+                                Py_ssize_t *len = va_arg(ap, Py_ssize_t*);
+
+                                f++;
+                                if (!o)
+                                        break;
+                                if (PyBytes_Check(o)) {
+                                        *p = PyBytes_AS_STRING(o);
+                                        *len = PyBytes_GET_SIZE(o);
+                                } else if (PyUnicode_Check(o)) {
+                                        *p = PyUnicode_AsUTF8AndSize(o, len);
+                                        r = !!*p;
+                                } else
+                                        r = arg_type_error(fname, i, "str or bytes", o);
+                        } else {
+                                const char **p = va_arg(ap, const char**);
+
+                                if (o)
+                                        r = arg_as_string(fname, i, o, p);
+                        }
+                        break;
+
+                case 'z': {
+                        const char **p = va_arg(ap, const char**);
+
+                        if (o == Py_None)
+                                *p = NULL;
+                        else if (o)
+                                r = arg_as_string(fname, i, o, p);
+                        break;
+                }
+
+                case 'O':
+                        if (f[1] == '!') {
+                                PyTypeObject *type = va_arg(ap, PyTypeObject*);
+                                PyObject **p = va_arg(ap, PyObject**);
+
+                                f++;
+                                if (!o)
+                                        break;
+                                if (!PyObject_TypeCheck(o, type))
+                                        r = arg_type_error(fname, i, type->tp_name, o);
+                                else
+                                        *p = o;
+                        } else if (f[1] == '&') {
+                                fastcall_converter converter = va_arg(ap, fastcall_converter);
+                                void *p = va_arg(ap, void*);
+
+                                f++;
+                                if (o)
+                                        r = converter(o, p);
+                        } else {
+                                PyObject **p = va_arg(ap, PyObject**);
+
+                                if (o)
+                                        *p = o;
+                        }
+                        break;
+
+                default:
+                        assert(!"unsupported format unit");
+                        r = 0;
+                }
+
+                i++;
+        }
+        va_end(ap);
+
+        return r;
+}
+
+/* Return the module (borrowed) whose types include type or one of its
+ * bases, e.g. for methods called on a subclass defined in Python. */
+PyObject* get_module_by_def(PyTypeObject *type, PyModuleDef *def) {
+#if PY_VERSION_HEX >= 0x030B0000
+        return PyType_GetModuleByDef(type, def);
+#else
+        PyObject *mro = type->tp_mro;
+
+        for (Py_ssize_t i = 0; mro && i < PyTuple_GET_SIZE(mro); i++) {
+                PyTypeObject *t = (PyTypeObject*) PyTuple_GET_ITEM(mro, i);
+                PyObject *m;
+
+                if (!(t->tp_flags & Py_TPFLAGS_HEAPTYPE))
+                        continue;
+
+                m = ((PyHeapTypeObject*) t)->ht_module;
+                if (m && PyModule_GetDef(m) == def)
+                        return m;
+        }
+
+        PyErr_Format(PyExc_TypeError,
+                     "PyType_GetModuleByDef: No superclass of '%s' has the given module",
+                     type->tp_name);
+        return NULL;
+#endif
+}
+
+void* get_module_state(PyTypeObject *type, PyModuleDef *def) {
+        PyObject *m;
+
+        m = get_module_by_def(type, def);
+        if (!m)
+                return NULL;
+
+        return PyModule_GetState(m);
+}
+
+/* Create a type bound to module m, store it in the module state at *ret,
+ * and add it to the module under the last component of its name. */
+int module_add_type(PyObject *m, PyType_Spec *spec, PyTypeObject **ret) {
+        PyObject *type;
+
+        type = PyType_FromModuleAndSpec(m, spec, NULL);
+        if (!type)
+                return -1;
+
+        *ret = (PyTypeObject*) type;
+        return PyModule_AddType(m, *ret);
+}
+
+int module_add_struct_type(PyObject *m, PyStructSequence_Desc *desc, PyTypeObject **ret) {
+        PyTypeObject *type;
+
+        type = PyStructSequence_NewType(desc);
+        if (!type)
+                return -1;
+
+        *ret = type;
+        return PyModule_AddType(m, *ret);
+}
@@ -21,4 +21,83 @@ int set_error(int r, const char* path, const char* invalid_message);
 
 int Unicode_FSConverter(PyObject* obj, void *_result);
 
+/* Like PyArg_ParseTupleAndKeywords(), but for the arguments of METH_FASTCALL
+ * functions and vectorcall, without building a tuple and a dict first. Only
+ * the format units used in this package are supported: "i", "p", "L", "n",
+ * "K", "s", "s#", "z", "O", "O!" and "O&", with "|" before the optional arguments,
+ * and ":name" at the end. kwlist is NULL for functions which take positional
+ * arguments only. Returns 1 on success, 0 with an exception set otherwise. */
+#define PARSE_FASTCALL_MAX 8
+typedef int (*fastcall_converter)(PyObject *obj, void *result);
+int parse_fastcall(PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames,
+                   const char *format, const char* const *kwlist, ...);
+
+PyObject* get_module_by_def(PyTypeObject *type, PyModuleDef *def);
+void* get_module_state(PyTypeObject *type, PyModuleDef *def);
+int module_add_type(PyObject *m, PyType_Spec *spec, PyTypeObject **ret);
+int module_add_struct_type(PyObject *m, PyStructSequence_Desc *desc, PyTypeObject **ret);
+
 #define _cleanup_Py_DECREF_ _cleanup_(cleanup_Py_DECREFp)
+
+/* Per-object locks for the free-threaded build. Methods which use non
+ * thread-safe state (e.g. an sd_journal*) start with LOCK_OBJECT(self), and
+ * the lock is released when the function returns. Unlike a critical section,
+ * the lock stays held while the thread is detached around blocking calls.
+ * With the GIL this compiles to nothing. */
+#ifdef Py_GIL_DISABLED
+typedef PyMutex ObjectLock;
+
+static inline ObjectLock* object_lock(ObjectLock *l) {
+        PyMutex_Lock(l);
+        return l;
+}
+
+static inline void object_unlockp(ObjectLock **l) {
+        if (*l)
+                PyMutex_Unlock(*l);
+}
+#else
+typedef char ObjectLock;
+
+static inline ObjectLock* object_lock(ObjectLock *l) {
+        return l;
+}
+
+static inline void object_unlockp(ObjectLock **l) {
+}
+#endif
+
+#define LOCK_OBJECT(o)                                                  \
+        _cleanup_(object_unlockp) _unused_ ObjectLock *_object_lock_ = object_lock(&(o)->lock)
+
+#ifndef Py_TPFLAGS_IMMUTABLETYPE
+#  define Py_TPFLAGS_IMMUTABLETYPE 0
+#endif
+
+/* Slots for multi-phase initialization. The modules keep their types and
+ * other objects in module state, so they can be imported into subinterpreters
+ * with their own GIL. Modules whose types all lock their state do not need the
+ * GIL on the free-threaded build, the others use MODULE_SLOTS_WITH_GIL(), so
+ * that importing them enables the GIL. */
+#if PY_VERSION_HEX >= 0x030C0000
+#  define MODULE_SLOT_MULTIPLE_INTERPRETERS { Py_mod_multiple_interpreters, Py_MOD_PER_INTERPRETER_GIL_SUPPORTED },
+#else
+#  define MODULE_SLOT_MULTIPLE_INTERPRETERS
+#endif
+
+#if PY_VERSION_HEX >= 0x030D0000
+#  define MODULE_SLOT_GIL { Py_mod_gil, Py_MOD_GIL_NOT_USED },
+#else
+#  define MODULE_SLOT_GIL
+#endif
+
+#define MODULE_SLOTS(exec)                                              \
+        { Py_mod_exec, (void*) (exec) },                                \
+        MODULE_SLOT_MULTIPLE_INTERPRETERS                               \
+        MODULE_SLOT_GIL                                                 \
+        {}  /* Sentinel */
+
+#define MODULE_SLOTS_WITH_GIL(exec)                                     \
+        { Py_mod_exec, (void*) (exec) },                                \
+        MODULE_SLOT_MULTIPLE_INTERPRETERS                               \
+        {}  /* Sentinel */
@@ -6,6 +6,11 @@ import posix
 import socket
 import contextlib
 import errno
+import array
+import fcntl
+import threading
+import time
+from systemd import daemon
 from systemd.daemon import (booted,
                             is_fifo, _is_fifo,
                             is_socket, _is_socket,
@@ -14,7 +19,8 @@ from systemd.daemon import (booted,
                             is_socket_sockaddr, _is_socket_sockaddr,
                             is_mq, _is_mq,
                             listen_fds, listen_fds_with_names,
-                            notify)
+                            notify, Notifier, StatusPublisher, Watchdog,
+                            fdstore_push, fdstore_remove)
 
 import pytest
 
@@ -341,6 +347,423 @@ def test_notify_with_socket(tmpdir):
     assert notify('FDSTORE=1', pid=os.getpid())
     assert notify('FDSTORE=1', pid=os.getpid(), fds=(1,))
 
+def test_notifier_no_socket(monkeypatch):
+    monkeypatch.delenv('NOTIFY_SOCKET', raising=False)
+    with Notifier() as notifier:
+        assert notifier.address is None
+        assert notifier.fileno() == -1
+        assert not notifier.notify('READY=1')
+
+def test_notifier_bad_socket(monkeypatch):
+    monkeypatch.setenv('NOTIFY_SOCKET', '/dev/null')
+    with pytest.raises(ConnectionRefusedError):
+        Notifier()
+    with pytest.raises(ValueError):
+        Notifier(address='vsock:x')
+    with pytest.raises(OSError):
+        Notifier(address='tcp:1.2.3.4')
+
+def test_notifier(tmpdir, monkeypatch):
+    path = tmpdir.join('socket').strpath
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+    try:
+        sock.bind(path)
+    except socket.error as e:
+        pytest.xfail('failed to bind socket (%s)' % e)
+    monkeypatch.setenv('NOTIFY_SOCKET', path)
+
+    notifier = Notifier(unset_environment=True)
+    # the variable is removed from the C environment, not os.environ
+    assert Notifier().address is None
+    assert notifier.address == path
+    fd = notifier.fileno()
+    for i in range(3):
+        assert notifier.notify('STATUS=step {}'.format(i))
+        assert sock.recv(100) == 'STATUS=step {}'.format(i).encode()
+    assert notifier.fileno() == fd
+
+    r, w = os.pipe()
+    assert notifier.notify('FDSTORE=1', fds=[r, w])
+    msg, ancdata, flags, addr = sock.recvmsg(100, socket.CMSG_SPACE(8))
+    assert msg == b'FDSTORE=1'
+    assert len(ancdata) == 1
+    assert ancdata[0][:2] == (socket.SOL_SOCKET, socket.SCM_RIGHTS)
+    for fd in array.array('i', ancdata[0][2]):
+        os.close(fd)
+    os.close(r)
+    os.close(w)
+
+    notifier.close()
+    with pytest.raises(ValueError):
+        notifier.notify('READY=1')
+
+def test_notifier_abstract():
+    name = 'python-systemd-test-{}'.format(os.getpid())
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+    sock.bind('\0' + name)
+    with Notifier(address='@' + name) as notifier:
+        assert notifier.notify('READY=1')
+        assert sock.recv(100) == b'READY=1'
+
+def test_status_publisher(tmpdir, monkeypatch):
+    path = tmpdir.join('socket').strpath
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+    try:
+        sock.bind(path)
+    except socket.error as e:
+        pytest.xfail('failed to bind socket (%s)' % e)
+    sock.settimeout(5)
+    monkeypatch.setenv('NOTIFY_SOCKET', path)
+
+    with StatusPublisher(min_interval=100000) as publisher:
+        # the socket is connected once, not looked up for every notification
+        monkeypatch.delenv('NOTIFY_SOCKET')
+        publisher.update('starting', EXTEND_TIMEOUT_USEC=1000000)
+        first = sock.recv(1000).decode().splitlines()
+        assert sorted(first) == ['EXTEND_TIMEOUT_USEC=1000000', 'STATUS=starting']
+
+        for i in range(10000):
+            publisher.update('processed {}/10000'.format(i + 1))
+        # unchanged fields are not sent again
+        publisher.update(EXTEND_TIMEOUT_USEC=1000000)
+        assert sock.recv(1000).startswith(b'STATUS=processed ')
+
+        publisher.update('done')
+        with pytest.raises(ValueError):
+            publisher.update('two\nlines')
+        with pytest.raises(ValueError):
+            publisher.update(**{'A=B': 1})
+
+    assert publisher.closed
+    messages = []
+    sock.setblocking(False)
+    while True:
+        try:
+            messages.append(sock.recv(1000))
+        except BlockingIOError:
+            break
+    assert messages[-1] == b'STATUS=done\n'
+    assert publisher.sent == 2 + len(messages)
+    with pytest.raises(ValueError):
+        publisher.update('closed')
+
+def test_status_publisher_close_concurrent(tmpdir, monkeypatch):
+    sock = _notify_socket(tmpdir, monkeypatch)
+    sock.settimeout(0.1)
+
+    def drain():
+        while not done.is_set():
+            try:
+                sock.recv(100)
+            except socket.timeout:
+                pass
+
+    def flush():
+        try:
+            for i in range(1000):
+                publisher.update(i)
+                publisher.flush()
+        except ValueError:
+            pass
+
+    done = threading.Event()
+    reader = threading.Thread(target=drain)
+    reader.start()
+    publisher = StatusPublisher(min_interval=0)
+    threads = [threading.Thread(target=flush) for i in range(4)]
+    try:
+        for thread in threads:
+            thread.start()
+        # flush() might still be running when close() returns
+        publisher.close()
+        for thread in threads:
+            thread.join()
+        assert publisher.closed
+        with pytest.raises(ValueError):
+            publisher.flush()
+    finally:
+        done.set()
+        reader.join()
+
+def test_describe_fds(tmpdir):
+    listener = socket.socket(socket.AF_INET6)
+    listener.bind(('::1', 0))
+    listener.listen()
+    abstract = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+    abstract.bind('\0python-systemd-test-{}'.format(os.getpid()))
+    unix = socket.socket(socket.AF_UNIX)
+    unix.bind(tmpdir.join('socket').strpath)
+    r, w = os.pipe()
+    f = tmpdir.join('file').open('w')
+    null = os.open('/dev/null', os.O_RDONLY)
+
+    infos = daemon.describe_fds([listener.fileno(), abstract.fileno(), unix.fileno(),
+                                 r, f.fileno(), null])
+    assert [info.kind for info in infos] == [
+        'socket', 'socket', 'socket', 'fifo', 'regular', 'character']
+    assert infos[0].fd == listener.fileno()
+    assert infos[0][2:8] == (socket.AF_INET6, socket.SOCK_STREAM, socket.IPPROTO_TCP,
+                             True, '::1', listener.getsockname()[1])
+    assert infos[0].path is None
+    assert infos[1].listening is False
+    assert infos[1].path == '@python-systemd-test-{}'.format(os.getpid())
+    assert infos[1].address is infos[1].port is None
+    assert (infos[2].type, infos[2].listening) == (socket.SOCK_STREAM, False)
+    assert infos[2].path == tmpdir.join('socket').strpath
+    assert infos[3].family is None
+    assert infos[4].path == tmpdir.join('file').strpath
+    assert infos[5].path == '/dev/null'
+    assert infos[5].mq_maxmsg is None
+
+    with pytest.raises(OSError) as e:
+        daemon.describe_fds([r, -1])
+    assert e.value.errno == errno.EBADF
+    with pytest.raises(TypeError):
+        daemon.describe_fds(None)
+
+    for fd in (r, w, null):
+        os.close(fd)
+    for obj in (listener, abstract, unix, f):
+        obj.close()
+
+def test_activated_sockets(tmpdir, monkeypatch):
+    listener = socket.socket()
+    listener.bind(('127.0.0.1', 0))
+    listener.listen()
+    dgram = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+    r, w = os.pipe()
+    fds = {listener.detach(): 'http', dgram.detach(): 'unknown', r: 'unknown'}
+    monkeypatch.setattr(daemon, 'listen_fds_with_names', lambda unset: fds)
+
+    socks = daemon.activated_sockets(nonblocking=True)
+    assert sorted(socks) == ['http', 'unknown']
+    (http,), (unknown,) = socks['http'], socks['unknown']
+    assert (http.family, http.type) == (socket.AF_INET, socket.SOCK_STREAM)
+    assert not http.getblocking()
+    assert (unknown.family, unknown.type) == (socket.AF_UNIX, socket.SOCK_DGRAM)
+    http.close()
+    unknown.close()
+    os.close(r)
+    os.close(w)
+
+def test_serve_activated(monkeypatch):
+    asyncio = pytest.importorskip('asyncio')
+    listener = socket.socket()
+    listener.bind(('127.0.0.1', 0))
+    listener.listen()
+    address = listener.getsockname()
+    dgram = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    fds = {listener.detach(): 'http', dgram.detach(): 'other'}
+    monkeypatch.setattr(daemon, 'listen_fds_with_names', lambda unset: fds)
+
+    class Echo(asyncio.Protocol):
+        def connection_made(self, transport):
+            self.transport = transport
+        def data_received(self, data):
+            self.transport.write(data)
+
+    async def main():
+        servers, unused = await daemon.serve_activated(Echo)
+        assert len(servers) == 1
+        # the datagram socket is left open for the caller
+        other, = unused['other']
+        assert other.type == socket.SOCK_DGRAM
+        other.close()
+        reader, writer = await asyncio.open_connection(*address)
+        writer.write(b'ping')
+        assert await reader.readexactly(4) == b'ping'
+        writer.close()
+        for server in servers:
+            server.close()
+            await server.wait_closed()
+
+    asyncio.run(main())
+
+def test_serve_activated_close_unused(monkeypatch):
+    asyncio = pytest.importorskip('asyncio')
+    listener = socket.socket()
+    listener.bind(('127.0.0.1', 0))
+    listener.listen()
+    fds = {listener.detach(): 'http'}
+    monkeypatch.setattr(daemon, 'listen_fds_with_names', lambda unset: fds)
+
+    async def main():
+        servers, unused = await daemon.serve_activated(asyncio.Protocol, names=['api'],
+                                                       close_unused=True)
+        assert servers == [] and unused == {}
+
+    asyncio.run(main())
+    fd, = fds
+    with pytest.raises(OSError):
+        os.fstat(fd)
+
+def _notify_socket(tmpdir, monkeypatch):
+    path = tmpdir.join('socket').strpath
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+    try:
+        sock.bind(path)
+    except socket.error as e:
+        pytest.xfail('failed to bind socket (%s)' % e)
+    sock.settimeout(5)
+    monkeypatch.setenv('NOTIFY_SOCKET', path)
+    return sock
+
+def _stop_when_ready(sock, server):
+    def watch():
+        while not sock.recv(100).startswith(b'READY=1'):
+            pass
+        server.stop()
+    thread = threading.Thread(target=watch)
+    thread.start()
+    return thread
+
+def _manager(sock, close_barrier=True):
+    def run():
+        while True:
+            msg, ancdata, flags, addr = sock.recvmsg(100, socket.CMSG_SPACE(4))
+            fds = [fd for level, type, data in ancdata
+                   for fd in array.array('i', data)]
+            if msg == b'BARRIER=1':
+                if close_barrier:
+                    os.close(fds[0])
+                else:
+                    time.sleep(0.5)
+                    os.close(fds[0])
+                return
+    thread = threading.Thread(target=run)
+    thread.start()
+    return thread
+
+def test_notify_barrier(tmpdir, monkeypatch):
+    sock = _notify_socket(tmpdir, monkeypatch)
+
+    thread = _manager(sock)
+    notify('READY=1')
+    with skip_enosys():
+        assert daemon.notify_barrier(timeout=5)
+    thread.join()
+
+    thread = _manager(sock, close_barrier=False)
+    with pytest.raises(TimeoutError):
+        daemon.notify_barrier(timeout=0.01)
+    thread.join()
+
+    monkeypatch.delenv('NOTIFY_SOCKET')
+    assert not daemon.notify_barrier()
+
+def test_notify_barrier_async(tmpdir, monkeypatch):
+    asyncio = pytest.importorskip('asyncio')
+    sock = _notify_socket(tmpdir, monkeypatch)
+
+    thread = _manager(sock)
+    with skip_enosys():
+        assert asyncio.run(daemon.notify_barrier_async())
+    thread.join()
+
+def test_prefork_server(tmpdir, monkeypatch):
+    sock = _notify_socket(tmpdir, monkeypatch)
+    listener = socket.socket()
+    listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+    listener.bind(('127.0.0.1', 0))
+    listener.listen()
+    address = listener.getsockname()
+    monkeypatch.setattr(daemon, 'listen_fds_with_names',
+                        lambda unset: {listener.detach(): 'http'})
+    output = tmpdir.join('output')
+
+    def worker(index, sockets, ready):
+        s, = sockets['http']
+        with open(output.strpath, 'a') as f:
+            f.write('{} {} {}\n'.format(index, s.getsockname() == address,
+                                        s.getsockopt(socket.SOL_SOCKET, socket.SO_ACCEPTCONN)))
+        ready()
+        time.sleep(60)
+
+    server = daemon.PreforkServer(worker, workers=3, reuseport=True)
+    thread = _stop_when_ready(sock, server)
+    start = time.monotonic()
+    server.run()
+    thread.join()
+    assert time.monotonic() - start < 30
+    assert sorted(output.read().splitlines()) == ['0 True 1', '1 True 1', '2 True 1']
+    server.sockets['http'][0].close()
+
+def test_prefork_server_restart_limit(tmpdir, monkeypatch):
+    sock = _notify_socket(tmpdir, monkeypatch)
+    monkeypatch.setattr(daemon, 'listen_fds_with_names', lambda unset: {})
+    output = tmpdir.join('output')
+
+    def worker(index, sockets, ready):
+        with open(output.strpath, 'a') as f:
+            f.write('{} {}\n'.format(index, time.monotonic()))
+        sys.exit(1)
+
+    server = daemon.PreforkServer(worker, workers=1, restart_delay=0.02,
+                                  restart_delay_max=0.05, restart_limit_burst=4)
+    with pytest.raises(RuntimeError):
+        server.run()
+    starts = [float(line.split()[1]) for line in output.read().splitlines()]
+    # the first start and 4 restarts, each delayed more than the one before
+    assert len(starts) == 5
+    delays = [b - a for a, b in zip(starts, starts[1:])]
+    assert delays[0] >= 0.02
+    assert delays[1] >= 0.04
+    assert delays[2] >= 0.05 and delays[3] >= 0.05
+    assert sock.recv(100).startswith(b'STATUS=0 of 1 workers ready')
+
+def test_fdstore(tmpdir, monkeypatch):
+    path = tmpdir.join('socket').strpath
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+    try:
+        sock.bind(path)
+    except socket.error as e:
+        pytest.xfail('failed to bind socket (%s)' % e)
+    monkeypatch.setenv('NOTIFY_SOCKET', path)
+
+    def receive():
+        msg, ancdata, flags, addr = sock.recvmsg(100, socket.CMSG_SPACE(4))
+        fds = [fd for level, type, data in ancdata
+               for fd in array.array('i', data)]
+        return msg, fds
+
+    assert fdstore_push('cache', b'x' * 10000 + b'end')
+    msg, (cache,) = receive()
+    assert msg == b'FDSTORE=1\nFDNAME=cache'
+    with pytest.raises(OSError):
+        os.write(cache, b'y')
+    assert fdstore_push('empty', bytearray())
+    msg, (empty,) = receive()
+
+    r, w = os.pipe()
+    assert fdstore_push('pipe', r)
+    msg, (pipe,) = receive()
+    assert msg == b'FDSTORE=1\nFDNAME=pipe'
+
+    assert fdstore_remove('pipe')
+    assert sock.recv(100) == b'FDSTOREREMOVE=1\nFDNAME=pipe'
+    with pytest.raises(ValueError):
+        fdstore_push('a:b', b'')
+    assert fdstore_push('x' * 255, b'long name')
+    msg, (long_name,) = receive()
+
+    # a sealed memfd which was not created by fdstore_push stays a descriptor
+    other = os.memfd_create('other', os.MFD_ALLOW_SEALING)
+    os.write(other, b'data')
+    fcntl.fcntl(other, fcntl.F_ADD_SEALS, daemon._MEMFD_SEALS)
+
+    monkeypatch.setattr(daemon, 'listen_fds_with_names',
+                        lambda unset: {cache: 'cache', empty: 'empty', pipe: 'pipe',
+                                       long_name: 'long', other: 'other'})
+    fds = daemon.fdstore_recover()
+    assert fds['cache'][0][-3:] == b'end'
+    assert len(fds['cache'][0]) == 10003
+    assert fds['empty'] == [b'']
+    assert fds['long'][0][:] == b'long name'
+    assert fds['pipe'] == [pipe]
+    assert fds['other'] == [other]
+    for fd in (r, w, pipe, other):
+        os.close(fd)
+
 def test_daemon_notify_memleak():
     # https://github.com/systemd/python-systemd/pull/51
     fd = 1
@@ -353,3 +776,90 @@ def test_daemon_notify_memleak():
         pass
 
     assert sys.getrefcount(fd) <= ref_cnt, 'leak'
+
+def test_watchdog_disabled():
+    os.environ.pop('WATCHDOG_USEC', None)
+    watchdog = Watchdog()
+    assert not watchdog.enabled
+    assert watchdog.usec == 0
+    watchdog.beat()
+    assert not watchdog.start()
+    assert not watchdog.running
+    watchdog.stop()
+
+def test_watchdog(tmpdir, monkeypatch):
+    path = tmpdir.join('socket').strpath
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+    try:
+        sock.bind(path)
+    except socket.error as e:
+        pytest.xfail('failed to bind socket (%s)' % e)
+    sock.settimeout(5)
+    monkeypatch.setenv('NOTIFY_SOCKET', path)
+    monkeypatch.setenv('WATCHDOG_USEC', '20000')
+    monkeypatch.delenv('WATCHDOG_PID', raising=False)
+
+    with Watchdog(fraction=0.25) as watchdog:
+        assert watchdog.enabled
+        assert watchdog.usec == 20000
+        assert watchdog.running
+        for i in range(3):
+            watchdog.beat()
+            assert sock.recv(100) == b'WATCHDOG=1'
+        assert watchdog.pings >= 3
+
+        # without beats, pings stop after stall_timeout
+        deadline = time.monotonic() + 5
+        while not watchdog.stalled:
+            assert time.monotonic() < deadline
+            time.sleep(0.005)
+        sock.setblocking(False)
+        while True:
+            try:
+                sock.recv(100)
+            except BlockingIOError:
+                break
+        pings = watchdog.pings
+        time.sleep(0.05)
+        assert watchdog.pings == pings
+
+        watchdog.beat()
+        sock.setblocking(True)
+        assert sock.recv(100) == b'WATCHDOG=1'
+    assert not watchdog.running
+
+def test_watchdog_fork(tmpdir, monkeypatch):
+    path = tmpdir.join('socket').strpath
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+    try:
+        sock.bind(path)
+    except socket.error as e:
+        pytest.xfail('failed to bind socket (%s)' % e)
+    monkeypatch.setenv('NOTIFY_SOCKET', path)
+    sock.settimeout(0.1)
+
+    def drain():
+        while not done.is_set():
+            try:
+                sock.recv(100)
+            except socket.timeout:
+                pass
+
+    done = threading.Event()
+    reader = threading.Thread(target=drain)
+    reader.start()
+    try:
+        # the child restarts the thread, even if the parent's thread held the mutex
+        with Watchdog(usec=1000, stall_timeout=0) as watchdog:
+            for i in range(20):
+                pid = os.fork()
+                if pid == 0:
+                    ok = watchdog.start() and watchdog.running
+                    watchdog.stop()
+                    os._exit(0 if ok else 1)
+                assert os.waitpid(pid, 0)[1] == 0
+            assert watchdog.running
+    finally:
+        done.set()
+        reader.join()
+        sock.close()
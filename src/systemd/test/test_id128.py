@@ -2,6 +2,7 @@
 
 import contextlib
 import errno
+import pickle
 import uuid
 import pytest
 
@@ -48,3 +49,92 @@ def test_get_boot():
     u1 = id128.get_boot()
     u2 = id128.get_boot()
     assert u1 == u2
+
+def test_id128_type():
+    u = id128.randomize()
+    i = id128.ID128(u)
+
+    assert i == u
+    assert u == i
+    assert hash(i) == hash(u)
+    assert {u: 1}[i] == 1
+    assert i.uuid == u
+    assert i.bytes == u.bytes
+    assert i.int == u.int
+    assert str(i) == i.hex == u.hex
+    assert repr(i) == "ID128('{}')".format(u.hex)
+
+    assert id128.ID128(str(u)) == i
+    assert id128.ID128(u.hex) == i
+    assert id128.ID128(u.bytes) == i
+    assert id128.ID128(u.hex.encode()) == i
+    assert id128.ID128(i) == i
+    assert pickle.loads(pickle.dumps(i)) == i
+
+    lo = id128.ID128(b'\0' * 16)
+    hi = id128.ID128(b'\xff' * 16)
+    assert lo < i < hi
+    assert sorted([hi, u, lo]) == [lo, u, hi]
+    assert i != 'x'
+
+def test_id128_invalid():
+    with pytest.raises(ValueError):
+        id128.ID128('xyz')
+    with pytest.raises(ValueError):
+        id128.ID128(b'\0' * 15)
+    with pytest.raises(TypeError):
+        id128.ID128(5)
+
+def test_uuid_conversion():
+    u = id128.randomize()
+    assert type(u) is uuid.UUID
+    assert u.is_safe == uuid.SafeUUID.unknown
+    assert u == uuid.UUID(str(u))
+    assert pickle.loads(pickle.dumps(u)) == u
+
+    assert id128._uuid(u.hex.encode()) == u
+    assert id128._uuid(str(u)) == u
+    assert id128._uuid(u.bytes) == u
+    assert id128._uuid_from_string(u.hex.encode()) == u
+    assert id128._uuid_from_string(str(u)) == u
+    with pytest.raises(ValueError):
+        id128._uuid_from_string(b'not-a-uuid-16byt')
+    with pytest.raises(ValueError):
+        id128._uuid_from_string(u.hex.encode() + b'\0')
+    with pytest.raises(TypeError):
+        id128._uuid_from_string(u)
+    assert type(id128.SD_MESSAGE_COREDUMP) is uuid.UUID
+
+def test_constants():
+    c = id128.SD_MESSAGE_JOURNAL_START
+    assert c == uuid.UUID('f77379a8490b408bbe5f6940505a777b')
+    assert id128.SD_MESSAGE_JOURNAL_START is c
+    assert 'SD_MESSAGE_JOURNAL_START' in vars(id128)
+
+    assert 'SD_MESSAGE_COREDUMP' in dir(id128)
+    assert 'SD_MESSAGE_COREDUMP' in id128.__all__
+    assert 'randomize' in id128.__all__
+
+    with pytest.raises(AttributeError):
+        id128.SD_MESSAGE_NO_SUCH_THING
+    assert not hasattr(id128, 'no_such_thing')
+
+def test_randomize_many():
+    b = id128.randomize_many(5)
+    assert type(b) is bytes
+    assert len(b) == 5 * 16
+    ids = [uuid.UUID(bytes=b[i*16:(i+1)*16]) for i in range(5)]
+    assert len(set(ids)) == 5
+    assert all(u.version == 4 for u in ids)
+    assert id128.randomize_many(0) == b''
+
+    uuids = id128.randomize_many(3, as_='uuid')
+    assert all(type(u) is uuid.UUID and u.version == 4 for u in uuids)
+    assert all(type(i) is id128.ID128 for i in id128.randomize_many(3, 'id128'))
+    hexes = id128.randomize_many(3, 'hex')
+    assert all(uuid.UUID(h).hex == h for h in hexes)
+
+    with pytest.raises(ValueError):
+        id128.randomize_many(-1)
+    with pytest.raises(ValueError):
+        id128.randomize_many(1, as_='int')
@@ -5,12 +5,13 @@ import datetime
 import errno
 import logging
 import os
+import threading
 import time
 import uuid
 import sys
 import traceback
 
-from systemd import journal, id128
+from systemd import journal, id128, _reader
 from systemd.journal import _make_line
 
 import pytest
@@ -160,6 +161,505 @@ def test_journalhandler_message_id_on_message_hex():
     assert len(sender.buf) == 1
     assert 'MESSAGE_ID=' + TEST_MID2.hex in sender.buf[0]
 
+def test_journalhandler_default_sender(monkeypatch):
+    sent = []
+    monkeypatch.setattr(journal, 'sendv', lambda *args: sent.append(args))
+
+    record = logging.LogRecord('test-logger', logging.INFO, 'testpath', 1, 'test', None, None)
+    record.__dict__['MESSAGE_ID'] = TEST_MID2
+    handler = journal.JournalHandler(logging.INFO, X=3, MESSAGE_ID=TEST_MID,
+                                     SYSLOG_IDENTIFIER='test')
+    handler.emit(record)
+    handler.emit(record)
+    assert len(sent) == 2
+    assert sent[0] == sent[1]
+
+    args = sent[0]
+    assert all(isinstance(arg, bytes) for arg in args)
+    assert b'MESSAGE=test' in args
+    assert b'PRIORITY=6' in args
+    assert b'LOGGER=test-logger' in args
+    assert b'CODE_FILE=testpath' in args
+    assert b'CODE_LINE=1' in args
+    assert b'X=3' in args
+    assert b'SYSLOG_IDENTIFIER=test' in args
+    assert b'MESSAGE_ID=' + TEST_MID2.hex.encode() in args
+    assert b'MESSAGE_ID=' + TEST_MID.hex.encode() not in args
+
+    # the same lines are reused for the next record from this logger
+    assert sent[0][2] is sent[1][2]
+
+def test_journalhandler_custom_priority(monkeypatch):
+    sent = []
+    monkeypatch.setattr(journal, 'sendv', lambda *args: sent.append(args))
+
+    class Handler(journal.JournalHandler):
+        @staticmethod
+        def map_priority(levelno):
+            return levelno
+
+    record = logging.LogRecord('test-logger', logging.INFO, 'testpath', 1, 'test', None, None)
+    Handler(logging.INFO).emit(record)
+    assert b'PRIORITY=20' in sent[0]
+
+def test_journalhandler_structured(monkeypatch):
+    sent = []
+    monkeypatch.setattr(journal, 'sendv', lambda *args: sent.append(args))
+
+    record = logging.LogRecord('test-logger', logging.INFO, 'testpath', 1, 'test %s', ('arg',), None)
+    record.__dict__.update({'request_id': 42, 'Data': b'\xff', 'MESSAGE_ID': TEST_MID,
+                            'not valid': 1, 'UNICODE': 'ąę'})
+    handler = journal.JournalHandler(logging.INFO, structured=True)
+    handler.emit(record)
+    assert len(sent) == 1
+
+    args = sent[0]
+    assert b'MESSAGE=test arg' in args
+    assert b'REQUEST_ID=42' in args
+    assert b'DATA=\xff' in args
+    assert b'MESSAGE_ID=' + TEST_MID.hex.encode() in args
+    assert 'UNICODE=ąę'.encode() in args
+    assert b"CODE_ARGS=('arg',)" in args
+    names = [arg.split(b'=', 1)[0] for arg in args]
+    assert b'NOT VALID' not in names
+    assert b'MSG' not in names and b'msg' not in names
+    assert b'CREATED' not in names and b'created' not in names
+
+def test_journalhandler_structured_collisions(monkeypatch):
+    sent = []
+    monkeypatch.setattr(journal, 'sendv', lambda *args: sent.append(args))
+
+    extra = {'priority': 1, 'Code_File': 'other', 'CODE_LINE': 2, 'code_func_x': 3}
+    record = logging.LogRecord('test-logger', logging.INFO, 'testpath', 1, 'test', None, None)
+    record.__dict__.update(extra)
+    journal.JournalHandler(logging.INFO, structured=True).emit(record)
+    names = [arg.split(b'=', 1)[0] for arg in sent[0]]
+    for name in (b'PRIORITY', b'CODE_FILE', b'CODE_LINE', b'CODE_FUNC_X'):
+        assert names.count(name) == 1
+    assert b'PRIORITY=6' in sent[0]
+    assert b'CODE_FILE=testpath' in sent[0]
+
+    sender = MockSender()
+    handler = journal.JournalHandler(logging.INFO, sender_function=sender.send,
+                                     structured=True)
+    handler.emit(record)
+    assert len(sender.buf) == 1
+    assert 'PRIORITY=6' in sender.buf[0]
+    assert 'PRIORITY=1' not in sender.buf[0]
+    assert 'CODE_FUNC_X=3' in sender.buf[0]
+
+    # fields passed to the handler, and those derived from the exception and
+    # the arguments, are not replaced either, and both paths agree
+    sent.clear()
+    extra = {'syslog_identifier': 'other', 'exception_text': 'x', 'code_args': 'y',
+             'SYSLOG_IDENTIFIER': 'exact'}
+    record = logging.LogRecord('test-logger', logging.INFO, 'testpath', 1, 'test %s', ('arg',), None)
+    record.exc_text = 'traceback'
+    record.__dict__.update(extra)
+    journal.JournalHandler(logging.INFO, structured=True, SYSLOG_IDENTIFIER='app').emit(record)
+    sender = MockSender()
+    journal.JournalHandler(logging.INFO, sender_function=sender.send, structured=True,
+                           SYSLOG_IDENTIFIER='app').emit(record)
+    for fields in ([arg.decode() for arg in sent[0]], sender.buf[0]):
+        names = [field.split('=', 1)[0] for field in fields]
+        for name in ('SYSLOG_IDENTIFIER', 'EXCEPTION_TEXT', 'CODE_ARGS'):
+            assert names.count(name) == 1
+        assert 'SYSLOG_IDENTIFIER=app' in fields
+        assert 'EXCEPTION_TEXT=traceback' in fields
+        assert "CODE_ARGS=('arg',)" in fields
+
+def test_journalhandler_structured_sender():
+    record = logging.LogRecord('test-logger', logging.INFO, 'testpath', 1, 'test', None, None)
+    record.__dict__.update({'request_id': 42, 'not valid': 1, '_private': 2, '1st': 3})
+    sender = MockSender()
+    handler = journal.JournalHandler(logging.INFO, sender_function=sender.send,
+                                     structured=True,
+                                     standard_attributes=journal.JournalHandler.STANDARD_ATTRIBUTES - {'lineno'})
+    handler.emit(record)
+    assert len(sender.buf) == 1
+    assert 'REQUEST_ID=42' in sender.buf[0]
+    assert 'LINENO=1' in sender.buf[0]
+    assert not any(arg.startswith(('msg=', 'created=', 'NOT VALID', '_PRIVATE', '1ST'))
+                   for arg in sender.buf[0])
+
+def test_encode_fields():
+    fields = journal._encode_fields({'a': 1, 'b_2': 'x', 'skip': 3, 'in-valid': 4, '': 5, 7: 8},
+                                    {'skip'})
+    assert fields == [b'A=1', b'B_2=x']
+    fields = journal._encode_fields({'a': 1, 'b': 2, 'C': 3}, set(), {'A', 'C'})
+    assert fields == [b'B=2']
+    # like journald, which drops or does not trust these
+    fields = journal._encode_fields({'_x': 1, '__y': 2, '1abc': 3, 'z' * 65: 4,
+                                     'a1': 5, 'b' * 64: 6}, set())
+    assert fields == [b'A1=5', b'B' * 64 + b'=6']
+
+    # values whose str() changes the mapping do not invalidate the iteration
+    class Evil:
+        def __str__(self):
+            mapping.clear()
+            return 'evil'
+    mapping = {'first': Evil(), 'second' + 'x' * 10: 'value'}
+    fields = journal._encode_fields(mapping, set())
+    assert fields == [b'FIRST=evil', b'SECONDXXXXXXXXXX=value']
+    with pytest.raises(TypeError):
+        journal._encode_fields({}, ['skip'])
+
+def test_shared_log_ring():
+    with journal.SharedLogRing(slots=5, slot_size=256) as ring:
+        assert ring.pending == 0
+
+        pids = []
+        for i in range(2):
+            pid = os.fork()
+            if pid == 0:
+                for j in range(3):
+                    ring.sendv('MESSAGE=message {} {}'.format(i, j), b'BINARY=\n\0')
+                os._exit(0)
+            pids.append(pid)
+        for pid in pids:
+            assert os.waitpid(pid, 0)[1] == 0
+
+        # the capacity is rounded up to 8
+        assert ring.pending == 6
+        assert ring.overflowed == 0
+
+        # too large for a slot, sent directly
+        ring.sendv('MESSAGE=' + 'x' * 256)
+        assert ring.overflowed == 1
+        assert ring.pending == 6
+
+        assert ring.drain() == 6
+        assert ring.pending == 0
+        assert ring.drain() == 0
+
+        with pytest.raises(ValueError):
+            ring.sendv('MESSAGE')
+
+    assert ring.closed
+    with pytest.raises(ValueError):
+        ring.sendv('MESSAGE=closed')
+
+def test_shared_log_ring_thread():
+    ring = journal.SharedLogRing(slots=16)
+    ring.start()
+    with pytest.raises(RuntimeError):
+        ring.start()
+    for i in range(100):
+        ring.sendv('MESSAGE=message {}'.format(i))
+    ring.stop()
+    ring.close()
+    assert ring.closed
+
+def test_shared_log_ring_dead_drainer():
+    import signal
+    with journal.SharedLogRing(slots=4) as ring:
+        pid = os.fork()
+        if pid == 0:
+            ring.drain(-1)
+            os._exit(0)
+
+        # wait until the child holds the ring
+        for i in range(1000):
+            try:
+                ring.drain()
+            except OSError as e:
+                assert e.errno == errno.EBUSY
+                break
+            time.sleep(0.01)
+        else:
+            pytest.fail('child did not start draining')
+
+        # the thread waits for the other drainer, and takes over when it dies
+        ring.start()
+        os.kill(pid, signal.SIGKILL)
+        os.waitpid(pid, 0)
+        ring.sendv('MESSAGE=after takeover')
+        for i in range(1000):
+            if ring.pending == 0:
+                break
+            time.sleep(0.01)
+        assert ring.pending == 0
+        ring.stop()
+
+def test_shared_log_ring_close_while_draining():
+    ring = journal.SharedLogRing(slots=4)
+    result = []
+    thread = threading.Thread(target=lambda: result.append(ring.drain(-1)))
+    thread.start()
+
+    # wait until the thread holds the ring
+    for i in range(1000):
+        try:
+            ring.drain()
+        except OSError as e:
+            assert e.errno == errno.EBUSY
+            break
+        time.sleep(0.01)
+    else:
+        pytest.fail('thread did not start draining')
+
+    # close() wakes up the drainer and waits for it before unmapping the ring
+    ring.close()
+    assert ring.closed
+    thread.join(5)
+    assert not thread.is_alive()
+    assert result == [0]
+    with pytest.raises(ValueError):
+        ring.drain(-1)
+
+def test_shared_log_ring_handler():
+    record = logging.LogRecord('test-logger', logging.INFO, 'testpath', 1, 'test', None, None)
+    ring = journal.SharedLogRing()
+    handler = journal.JournalHandler(logging.INFO, ring=ring)
+    handler.emit(record)
+    assert ring.pending == 1
+
+@pytest.fixture
+def journal_server():
+    with journal.JournalServer(keep=100, timestamp_field='SENT_USEC') as server:
+        old = journal.set_socket(server.path)
+        try:
+            yield server
+        finally:
+            journal.set_socket(old)
+
+def test_journal_server_send(journal_server):
+    journal.send('message', MESSAGE_ID=TEST_MID, BINARY=b'a\nb')
+    record = logging.LogRecord('test-logger', logging.INFO, 'testpath', 1, 'test', None, None)
+    journal.JournalHandler(SYSLOG_IDENTIFIER='test-handler').emit(record)
+    assert journal_server.wait(2, timeout=10)
+
+    first, second = journal_server.entries()
+    assert first['MESSAGE'] == b'message'
+    assert first['MESSAGE_ID'] == TEST_MID.hex.encode()
+    assert first['BINARY'] == b'a\nb'
+    assert first['CODE_FUNC'] == b'test_journal_server_send'
+    assert second['MESSAGE'] == b'test'
+    assert second['SYSLOG_IDENTIFIER'] == b'test-handler'
+    assert 'msg' not in second
+    assert journal_server.entries() == []
+
+    stats = journal_server.stats()
+    assert stats['entries'] == 2
+    assert stats['invalid'] == stats['memfds'] == 0
+    # like journald, the lower-case attributes of the record are ignored
+    assert stats['ignored'] > 0
+    journal_server.reset()
+    assert journal_server.stats()['entries'] == 0
+
+def test_journal_server_memfd(journal_server):
+    # too large for a datagram, so passed in a sealed memfd
+    journal.sendv('MESSAGE=' + 'x' * (4 << 20))
+    assert journal_server.wait(1, timeout=10)
+    assert journal_server.stats()['memfds'] == 1
+    assert len(journal_server.entries()[0]['MESSAGE']) == 4 << 20
+
+def test_journal_server_invalid(journal_server):
+    import socket
+    with socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM) as sock:
+        for data in (b'MESSAGE', b'MESSAGE=no newline', b'1FIELD=x\n',
+                     b'BINARY\n\xff\0\0\0\0\0\0\0x\n',
+                     b'MESSAGE=valid\nlower=x\n_PID=1\n'):
+            sock.sendto(data, journal_server.path)
+    assert journal_server.wait(5, timeout=10)
+    stats = journal_server.stats()
+    assert stats['invalid'] == 4
+    assert stats['entries'] == 1
+    assert stats['fields'] == 1
+    assert stats['ignored'] == 2
+    assert journal_server.entries() == [{'MESSAGE': b'valid'}]
+
+def test_journal_server_latency(journal_server):
+    for i in range(10):
+        journal.send('message {}'.format(i), SENT_USEC=time.monotonic_ns() // 1000)
+    journal.send('no timestamp')
+    assert journal_server.wait(11, timeout=10)
+    latency = journal_server.stats()['latency']
+    assert sum(latency.values()) == 10
+    assert all(bound & (bound - 1) == 0 for bound in latency)
+
+def test_journal_server_ring(journal_server):
+    with journal.SharedLogRing() as ring:
+        ring.sendv('MESSAGE=via ring', 'REPEATED=1', 'REPEATED=2')
+        assert ring.drain() == 1
+    assert journal_server.wait(1, timeout=10)
+    entry, = journal_server.entries()
+    assert entry['MESSAGE'] == b'via ring'
+    assert entry['REPEATED'] == [b'1', b'2']
+    assert entry['SYSLOG_PID'] == str(os.getpid()).encode()
+
+def test_journal_server_ring_overflow(journal_server):
+    # too large for a slot, sent directly with the same added fields
+    with journal.SharedLogRing(slot_size=256) as ring:
+        ring.sendv('MESSAGE=' + 'x' * 256)
+        assert ring.overflowed == 1
+    assert journal_server.wait(1, timeout=10)
+    entry, = journal_server.entries()
+    assert entry['SYSLOG_PID'] == str(os.getpid()).encode()
+    assert 'SYSLOG_IDENTIFIER' in entry
+
+def test_journal_server_ring_memfd(journal_server):
+    # fits into a slot, but not into a datagram
+    with journal.SharedLogRing(slots=2, slot_size=1 << 20) as ring:
+        ring.sendv('MESSAGE=' + 'x' * (512 << 10))
+        assert ring.overflowed == 0
+        assert ring.drain() == 1
+        assert ring.dropped == 0
+    assert journal_server.wait(1, timeout=10)
+    assert journal_server.stats()['memfds'] == 1
+    assert len(journal_server.entries()[0]['MESSAGE']) == 512 << 10
+
+def test_journal_server_closed(tmp_path):
+    path = str(tmp_path / 'socket')
+    server = journal.JournalServer(path)
+    assert server.path == path
+    assert os.path.exists(path)
+    assert not server.wait(1, timeout=0)
+    server.close()
+    assert server.closed
+    assert server.path is None
+    assert not os.path.exists(path)
+    with pytest.raises(ValueError):
+        server.stats()
+
+def test_journal_server_close_while_waiting():
+    server = journal.JournalServer()
+    result = []
+    thread = threading.Thread(target=lambda: result.append(server.wait(1, timeout=30)))
+    thread.start()
+    time.sleep(0.05)
+    start = time.monotonic()
+    server.close()
+    thread.join(5)
+    assert not thread.is_alive()
+    assert result == [False]
+    assert time.monotonic() - start < 5
+
+def test_journal_server_environment():
+    import subprocess
+    with journal.JournalServer(keep=1) as server:
+        env = dict(os.environ,
+                   PYTHON_SYSTEMD_JOURNAL_SOCKET=server.path,
+                   PYTHONPATH=os.path.dirname(os.path.dirname(journal.__file__)))
+        subprocess.check_call([sys.executable, '-c',
+                               'from systemd import journal; journal.send("from child")'],
+                              env=env)
+        assert server.wait(1, timeout=10)
+        assert server.entries()[0]['MESSAGE'] == b'from child'
+
+def test_set_socket():
+    assert journal.set_socket('/nonexistent/socket') is None
+    try:
+        with pytest.raises(OSError):
+            journal.sendv('MESSAGE=lost')
+    finally:
+        assert journal.set_socket(None) == '/nonexistent/socket'
+    with pytest.raises(ValueError):
+        journal.set_socket('x' * 200)
+    assert journal.set_socket(None) is None
+
+def test_rate_limiter():
+    limiter = journal.RateLimiter(rate=1, burst=3, interval=1000)
+    assert [limiter.check('a') for i in range(5)] == [True] * 3 + [False] * 2
+    assert limiter.check(('file', 1))
+    assert limiter.suppressed == 2
+    assert limiter.keys == 2
+    assert limiter.pending == 0
+    assert limiter.flush() == []
+    assert limiter.flush(force=True) == [('a', 2)]
+    assert limiter.flush(force=True) == []
+    with pytest.raises(TypeError):
+        limiter.check([])
+
+def test_rate_limiter_pending():
+    limiter = journal.RateLimiter(rate=1, burst=1, interval=0)
+    assert limiter.check('a')
+    assert limiter.pending == 0
+    assert not limiter.check('a')
+    assert not limiter.check('a')
+    assert limiter.pending == 2
+    assert limiter.flush() == [('a', 2)]
+    assert limiter.pending == 0
+
+def test_rate_limiter_reentrant_key():
+    limiter = journal.RateLimiter(rate=1, burst=1, max_keys=1000)
+
+    class Key:
+        def __hash__(self):
+            return 0
+        def __eq__(self, other):
+            # grows and rehashes the table during the lookup
+            for i in range(100):
+                limiter.check(('other', i))
+            return self is other
+
+    keys = [Key() for i in range(3)]
+    for key in keys:
+        assert limiter.check(key)
+    assert not limiter.check(keys[0])
+    assert limiter.keys == 103
+
+def test_rate_limiter_overflow():
+    limiter = journal.RateLimiter(rate=1, burst=1, max_keys=2)
+    assert all(limiter.check(i) for i in range(2))
+    assert limiter.check(2)
+    assert not limiter.check(3)
+    assert limiter.keys == 2
+    assert sorted(limiter.flush(force=True), key=str) == [(None, 1)]
+
+def test_rate_limiter_sample():
+    limiter = journal.RateLimiter(None, sample=0.25)
+    passed = sum(limiter.check('key') for i in range(10000))
+    assert 2000 < passed < 3000
+    with pytest.raises(ValueError):
+        journal.RateLimiter(None, sample=0)
+    with pytest.raises(ValueError):
+        journal.RateLimiter(-1)
+
+def test_send_ratelimit(monkeypatch):
+    sent = []
+    monkeypatch.setattr(journal, 'sendv', lambda *args: sent.append(args))
+    limiter = journal.RateLimiter(rate=1, burst=2, interval=0)
+    for i in range(4):
+        journal.send('message', ratelimit=limiter)
+    for i in range(3):
+        journal.send('message', MESSAGE_ID=TEST_MID, ratelimit=limiter)
+
+    assert [args[0] for args in sent].count('MESSAGE=message') == 4
+    summaries = [dict(line.decode().split('=', 1) for line in args)
+                 for args in sent if args[0] != 'MESSAGE=message']
+    assert [s['SUPPRESSED_COUNT'] for s in summaries] == ['1', '1', '1']
+    assert summaries[0]['SUPPRESSED_KEY'].startswith(__file__ + ':')
+    assert summaries[-1]['SUPPRESSED_KEY'] == TEST_MID.hex
+    assert summaries[0]['PRIORITY'] == '4'
+
+def test_journalhandler_ratelimit(monkeypatch):
+    sent = []
+    monkeypatch.setattr(journal, 'sendv', lambda *args: sent.append(args))
+    limiter = journal.RateLimiter(rate=1, burst=1, interval=0)
+    handler = journal.JournalHandler(logging.INFO, ratelimit=limiter, structured=True,
+                                     SYSLOG_IDENTIFIER='test')
+    for key in ['a', 'a', 'b', 'a']:
+        record = logging.LogRecord('test-logger', logging.INFO, 'testpath', 1, 'test', None, None)
+        record.ratelimit_key = key
+        handler.emit(record)
+
+    # the summary is sent as soon as the interval has elapsed
+    assert [args[0] for args in sent] == [
+        b'MESSAGE=test', b'MESSAGE=Suppressed 1 messages for a',
+        b'MESSAGE=test', b'MESSAGE=Suppressed 1 messages for a']
+    assert b'SYSLOG_IDENTIFIER=test' in sent[1]
+    assert not any(line.startswith(b'RATELIMIT_KEY=') for args in sent for line in args)
+
+    sender = MockSender()
+    handler = journal.JournalHandler(logging.INFO, sender_function=sender.send,
+                                     ratelimit=journal.RateLimiter(rate=1, burst=1, interval=0))
+    for i in range(3):
+        record = logging.LogRecord('test-logger', logging.INFO, 'testpath', 1, 'test', None, None)
+        handler.emit(record)
+    assert len(sender.buf) == 3
+    assert 'SUPPRESSED_KEY=testpath:1' in sender.buf[1]
+
 def test_reader_init_flags():
     j1 = journal.Reader()
     j2 = journal.Reader(journal.LOCAL_ONLY)
@@ -168,6 +668,26 @@ def test_reader_init_flags():
     j5 = journal.Reader(journal.LOCAL_ONLY | journal.RUNTIME_ONLY | journal.SYSTEM_ONLY)
     j6 = journal.Reader(0)
 
+def test_reader_init_arguments(tmpdir):
+    j = _reader._Reader(0, path=tmpdir.strpath)
+    assert type(j) is _reader._Reader
+    assert j._next() is False
+    assert j._previous(2) is False
+    with pytest.raises(TypeError):
+        _reader._Reader(0, flags=0)
+    with pytest.raises(TypeError):
+        _reader._Reader(bogus=1)
+    with pytest.raises(TypeError):
+        _reader._Reader(1.5)
+    with pytest.raises(TypeError):
+        j._next(1, 2)
+    with pytest.raises(TypeError):
+        j.seek_realtime(1.5)
+    with pytest.raises(TypeError):
+        j.add_match()
+    with pytest.raises(TypeError):
+        j.wait(timeout=0)
+
 def test_reader_os_root(tmpdir):
     with pytest.raises(ValueError):
         journal.Reader(journal.OS_ROOT)
@@ -218,6 +738,17 @@ def test_reader_as_cm(tmpdir):
     with pytest.raises(OSError):
         next(j)
 
+def test_reader_convert_uuid(tmpdir):
+    j = journal.Reader(path=tmpdir.strpath)
+    mid = uuid.uuid4()
+    assert j._convert_field('MESSAGE_ID', mid.hex.encode()) == mid
+    assert j._convert_field('_BOOT_ID', str(mid).encode()) == mid
+    # 16 bytes which are not hexadecimal are not taken as a raw identifier
+    assert j._convert_field('MESSAGE_ID', b'not-a-uuid-16byt') == b'not-a-uuid-16byt'
+    assert j._convert_field('_BOOT_ID', b'\xff' * 32) == b'\xff' * 32
+    monotonic = j._convert_field('__MONOTONIC_TIMESTAMP', (5, mid.bytes))
+    assert monotonic.bootid == mid
+
 def test_reader_messageid_match(tmpdir):
     j = journal.Reader(path=tmpdir.strpath)
     with j:
@@ -250,6 +781,39 @@ def test_reader_query_unique(tmpdir):
     assert isinstance(ans, set)
     assert ans == set()
 
+def test_reader_stats(tmpdir):
+    with journal.Reader(path=tmpdir.strpath) as j:
+        assert not j.collect_stats
+        j.seek_head()
+        assert j.stats()['seeks'] == 0
+
+        j.collect_stats = True
+        j.seek_head()
+        j.seek_tail()
+        j.seek_realtime(0)
+        assert j.get_next() == {}
+        assert j.process() == journal.NOP
+        stats = j.stats()
+        assert stats['seeks'] == 3
+        assert stats['visited'] == stats['returned'] == stats['fields'] == 0
+        assert stats['process'] == {journal.NOP: 1, journal.APPEND: 0, journal.INVALIDATE: 0}
+        assert stats['journal_ns'] > 0
+        assert stats['convert_ns'] == 0
+
+        j.reset_stats()
+        stats = j.stats()
+        assert stats.pop('process') == {journal.NOP: 0, journal.APPEND: 0, journal.INVALIDATE: 0}
+        assert set(stats.values()) == {0}
+
+        j.collect_stats = False
+        j.seek_head()
+        assert j.stats()['seeks'] == 0
+
+    j = journal.Reader(path=tmpdir.strpath, collect_stats=True)
+    assert j.collect_stats
+    with pytest.raises(AttributeError):
+        del j.collect_stats
+
 def test_reader_enumerate_fields(tmpdir):
     j = journal.Reader(path=tmpdir.strpath)
     with j:
@@ -272,6 +836,42 @@ def test_reader_has_persistent_files(tmpdir):
             ans = j.has_runtime_files()
     assert ans is False
 
+def test_reader_threads(tmpdir):
+    # One Reader per thread. The _reader module does not need the GIL on
+    # free-threaded Python, and each Reader only serializes on its own lock.
+    errors = []
+    start = threading.Barrier(8)
+
+    def run(n):
+        try:
+            start.wait()
+            for i in range(20):
+                with journal.Reader(path=tmpdir.strpath if n % 2 else None) as j:
+                    j.this_boot(TEST_MID)
+                    j.add_disjunction()
+                    j.messageid_match(TEST_MID2)
+                    j.seek_head()
+                    for _, entry in zip(range(50), j):
+                        assert 'MESSAGE_ID' in entry
+                    j.seek_tail()
+                    j.get_previous()
+                    j.query_unique('_PID')
+                    j.get_usage()
+                    j.flush_matches()
+                    j.data_threshold = 1024 + i
+                    assert j.data_threshold == 1024 + i
+        except Exception as e:
+            errors.append(e)
+
+    threads = [threading.Thread(target=run, args=(n,)) for n in range(8)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    assert errors == []
+
+
 def test_reader_converters(tmpdir):
     converters = {'xxx' : lambda arg: 'yyy'}
     j = journal.Reader(path=tmpdir.strpath, converters=converters)
@@ -322,12 +922,80 @@ def test_seek_realtime(tmpdir):
     long_ago = datetime.datetime(1970, 5, 4)
     j.seek_realtime(long_ago)
 
+def test_journal_stream_buffering():
+    r, w = os.pipe()
+    os.set_blocking(r, False)
+    with journal.JournalStream(w, buffer_size=64, flush_interval=10**9) as stream:
+        assert stream.write('line 1\n') == 7
+        assert stream.write(b'line 2\n') == 7
+        assert stream.write(bytearray(b'line 3\n')) == 7
+        stream.writelines(['ą\n', b'b\n'])
+        with pytest.raises(BlockingIOError):
+            os.read(r, 100)
+
+        stream.flush()
+        assert os.read(r, 100) == 'line 1\nline 2\nline 3\ną\nb\n'.encode()
+
+        # data which does not fit in the buffer is written through
+        stream.write(b'x' * 50)
+        stream.write(b'y' * 100)
+        assert os.read(r, 1000) == b'x' * 50 + b'y' * 100
+
+        stream.write('unflushed\n')
+
+    assert stream.closed
+    assert os.read(r, 100) == b'unflushed\n'
+    with pytest.raises(ValueError):
+        stream.write('closed\n')
+    os.close(r)
+
+def test_journal_stream_flush_interval():
+    r, w = os.pipe()
+    with journal.JournalStream(w, flush_interval=10000) as stream:
+        stream.write('message\n')
+        # the background thread flushes within the interval
+        assert os.read(r, 100) == b'message\n'
+    os.close(r)
+
+def test_journal_stream_close_concurrent():
+    r, w = os.pipe()
+    stream = journal.JournalStream(w, buffer_size=1 << 16, flush_interval=10**9)
+    done = threading.Event()
+
+    def writer():
+        try:
+            while not done.is_set():
+                stream.write(b'x' * 100)
+        except (OSError, ValueError):
+            pass
+
+    def reader():
+        while os.read(r, 1 << 16):
+            pass
+
+    threads = [threading.Thread(target=writer) for i in range(4)]
+    threads.append(threading.Thread(target=reader))
+    for t in threads:
+        t.start()
+    time.sleep(0.1)
+    stream.close()
+    done.set()
+    for t in threads:
+        t.join()
+    os.close(r)
+    assert stream.closed
+
 def test_journal_stream():
     # This will fail when running in a bare chroot without /run/systemd/journal/stdout
     with skip_oserror(errno.ENOENT):
         stream = journal.stream('test_journal.py')
 
+    assert stream.encoding.lower() == 'utf-8'
     res = stream.write('message...\n')
     assert res in (11, None) # Python2 returns None
 
     print('printed message...', file=stream)
+
+    with journal.stream('test_journal.py', buffered=True) as stream:
+        assert isinstance(stream, journal.JournalStream)
+        print('buffered message...', file=stream)
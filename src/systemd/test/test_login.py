@@ -47,3 +47,70 @@ def test_monitor():
         login.machine_names()
         p.poll(1)
         login.machine_names()
+
+def test_monitor_init_arguments():
+    with pytest.raises(TypeError):
+        login.Monitor("machine", category="machine")
+    with pytest.raises(TypeError):
+        login.Monitor(bogus=1)
+    with pytest.raises(TypeError):
+        login.Monitor(1)
+
+    with skip_oserror(errno.ENOENT):
+        m = login.Monitor(category=None)
+        with m:
+            assert m.fileno() >= 0
+
+def test_snapshot():
+    with skip_oserror(errno.ENOENT):
+        snap = login.snapshot()
+
+    assert isinstance(snap, login.Snapshot)
+    sessions, users, seats, machines = snap
+    assert sorted(s.id for s in sessions) == sorted(login.sessions())
+    for s in sessions:
+        assert isinstance(s, login.Session)
+        assert s.uid is None or isinstance(s.uid, int)
+        assert s.remote in (None, True, False)
+        assert s.active in (None, True, False)
+    for u in users:
+        assert isinstance(u, login.User)
+        assert isinstance(u.sessions, tuple)
+    for s in seats:
+        assert isinstance(s, login.Seat)
+        assert isinstance(s.sessions, tuple)
+    for m in machines:
+        assert isinstance(m, login.Machine)
+        assert isinstance(m.name, str)
+
+def test_state_cache():
+    changes = []
+
+    with skip_oserror(errno.ENOENT):
+        cache = login.StateCache(changes.append)
+
+    with cache:
+        for key, session in cache.sessions.items():
+            assert isinstance(session, login.Session)
+            assert session.id == key
+        for key, user in cache.users.items():
+            assert user.uid == key
+        with pytest.raises(TypeError):
+            cache.sessions['x'] = None
+
+        p = select.poll()
+        p.register(cache, cache.get_events())
+        p.poll(1)
+
+        result = cache.process(force=True)
+        assert result == changes
+        for change in result:
+            assert isinstance(change, login.StateChange)
+            assert change.kind in ('session', 'user', 'seat', 'machine')
+
+    # the cached state stays available after close()
+    assert isinstance(cache.process(), list)
+
+def test_state_cache_bad_callback():
+    with pytest.raises(TypeError):
+        login.StateCache(callback=1)
@@ -0,0 +1,35 @@
+# SPDX-License-Identifier: LGPL-2.1-or-later
+
+import sys
+import pytest
+
+from systemd import id128
+
+def test_subinterpreter():
+    # All extension modules keep their state per module, so they can be
+    # loaded again in an isolated subinterpreter
+    code = '''
+import sys
+sys.path[:] = {!r}
+from systemd import id128, journal, login, daemon
+u = id128.randomize()
+assert id128.ID128(u) == u and id128.ID128(u).uuid == u
+assert id128.SD_MESSAGE_JOURNAL_START.hex == {!r}
+assert isinstance(journal.Monotonic((0, b'')), tuple)
+assert daemon.describe_fds([])  == []
+assert type(login.snapshot()).__name__ == 'Snapshot'
+'''.format(sys.path, id128.SD_MESSAGE_JOURNAL_START.hex)
+
+    try:
+        import _interpreters as interpreters
+        interp = interpreters.create(interpreters.new_config('isolated'))
+        run = interpreters.exec
+    except ImportError:
+        interpreters = pytest.importorskip('_xxsubinterpreters')
+        interp = interpreters.create()
+        run = interpreters.run_string
+
+    try:
+        assert run(interp, code) is None
+    finally:
+        interpreters.destroy(interp)
@@ -15,6 +15,15 @@ def defines(file):
             yield name, value
 
 
+def raw_bytes(value):
+    # SD_ID128_MAKE(1f,4e,...) → '0x1f, 0x4e, ...'
+    # The module is built from these bytes, the SD_MESSAGE_* defines from the
+    # system header are only compared against ours by the compiler.
+    args = value[value.index('(') + 1:value.rindex(')')].split(',')
+    assert len(args) == 16
+    return ', '.join(f'0x{arg.strip()}' for arg in args)
+
+
 def process(includefile, docfile, *headers):
     # Collects all messages from all headers and saves the sorted list back to
     # headers[0]. Writes includefile (C) and docfile (rst).
@@ -26,7 +35,7 @@ def process(includefile, docfile, *headers):
     with open(includefile, 'wt') as out:
         print(f'Writing {out.name}…')
         for name, value in defs:
-            print(f'add_id(m, "{name}", {name}) JOINER', file=out)
+            print(f'{{ "{name}", {{ {raw_bytes(value)} }} }},', file=out)
 
     with open(headers[0], 'wt') as out:
         print(f'Writing {out.name}…')